@@ -1074,6 +1074,34 @@ void rdpdr_remove_init_handle_data(void* pInitHandle)
 	}
 }
 
+/**
+ * Finds the plugin loaded for a client context, the projector runs one context per session
+ * and can not rely on g_rdpdrPlugin which only remembers the first one.
+ */
+__declspec(dllexport) rdpdrPlugin* rdpdr_find_plugin(rdpContext* context)
+{
+	int index;
+	int count;
+	ULONG_PTR* keys = NULL;
+	rdpdrPlugin* found = NULL;
+
+	if (!g_InitHandles || !context)
+		return NULL;
+
+	count = ListDictionary_GetKeys(g_InitHandles, &keys);
+
+	for (index = 0; index < count && !found; index++)
+	{
+		rdpdrPlugin* plugin = (rdpdrPlugin*) ListDictionary_GetItemValue(g_InitHandles, (void*) keys[index]);
+
+		if (plugin && plugin->rdpcontext == context)
+			found = plugin;
+	}
+
+	free(keys);
+	return found;
+}
+
 /**
  * Function description
  *
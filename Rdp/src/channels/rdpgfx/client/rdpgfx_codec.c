@@ -169,6 +169,108 @@ static UINT rdpgfx_decode_h264(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
 	return error;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_decode_avc444(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
+{
+	UINT error;
+	UINT32 tmp;
+	UINT32 length1;
+	size_t start;
+	wStream* s;
+	RDPGFX_AVC444_BITMAP_STREAM h264;
+	RdpgfxClientContext* context = (RdpgfxClientContext*) gfx->iface.pInterface;
+
+	ZeroMemory(&h264, sizeof(h264));
+
+	s = Stream_New(cmd->data, cmd->length);
+
+	if (!s)
+	{
+		WLog_ERR(TAG, "Stream_New failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	error = ERROR_INVALID_DATA;
+
+	if (Stream_GetRemainingLength(s) < 4)
+	{
+		WLog_ERR(TAG, "not enough data!");
+		goto fail;
+	}
+
+	Stream_Read_UINT32(s, tmp); /* avc420EncodedBitstreamInfo (4 bytes) */
+	length1 = tmp & 0x3FFFFFFF;
+	h264.LC = (tmp >> 30) & 0x03;
+
+	if (h264.LC > RDPGFX_AVC444_LC_CHROMA)
+	{
+		WLog_ERR(TAG, "invalid LC %d", (int) h264.LC);
+		goto fail;
+	}
+
+	start = Stream_GetPosition(s);
+
+	if ((error = rdpgfx_read_h264_metablock(gfx, s, &(h264.bitstream[0].meta))))
+	{
+		WLog_ERR(TAG, "rdpgfx_read_h264_metablock failed with error %lu!", error);
+		goto fail;
+	}
+
+	h264.numStreams = 1;
+	h264.bitstream[0].data = Stream_Pointer(s);
+	h264.bitstream[0].length = (UINT32) Stream_GetRemainingLength(s);
+
+	/* only with both views does the first stream end before the data */
+	if (h264.LC == RDPGFX_AVC444_LC_BOTH)
+	{
+		error = ERROR_INVALID_DATA;
+
+		if ((length1 < (Stream_GetPosition(s) - start)) ||
+			(Stream_GetRemainingLength(s) < (length1 - (Stream_GetPosition(s) - start))))
+		{
+			WLog_ERR(TAG, "invalid cbAvc420EncodedBitstream1 %lu", (unsigned long) length1);
+			goto fail;
+		}
+
+		h264.bitstream[0].length = length1 - (UINT32) (Stream_GetPosition(s) - start);
+		Stream_Seek(s, h264.bitstream[0].length);
+
+		if ((error = rdpgfx_read_h264_metablock(gfx, s, &(h264.bitstream[1].meta))))
+		{
+			WLog_ERR(TAG, "rdpgfx_read_h264_metablock failed with error %lu!", error);
+			goto fail;
+		}
+
+		h264.numStreams = 2;
+		h264.bitstream[1].data = Stream_Pointer(s);
+		h264.bitstream[1].length = (UINT32) Stream_GetRemainingLength(s);
+	}
+
+	cmd->extra = (void*) &h264;
+	error = CHANNEL_RC_OK;
+
+	if (context)
+	{
+		IFCALLRET(context->SurfaceCommand, error, context, cmd);
+		if (error)
+			WLog_ERR(TAG, "context->SurfaceCommand failed with error %lu", error);
+	}
+
+	cmd->extra = NULL;
+
+fail:
+	Stream_Free(s, FALSE);
+	free(h264.bitstream[0].meta.regionRects);
+	free(h264.bitstream[0].meta.quantQualityVals);
+	free(h264.bitstream[1].meta.regionRects);
+	free(h264.bitstream[1].meta.quantQualityVals);
+	return error;
+}
+
 /**
  * Function description
  *
@@ -189,6 +291,14 @@ UINT rdpgfx_decode(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
 			}
 			break;
 
+		case RDPGFX_CODECID_AVC444:
+			if ((error = rdpgfx_decode_avc444(gfx, cmd)))
+			{
+				WLog_ERR(TAG, "rdpgfx_decode_avc444 failed with error %lu", error);
+				return error;
+			}
+			break;
+
 		default:
 			if (context)
 			{
@@ -67,7 +67,7 @@ static UINT rdpgfx_send_caps_advertise_pdu(RDPGFX_CHANNEL_CALLBACK* callback)
 	RDPGFX_PLUGIN* gfx;
 	RDPGFX_HEADER header;
 	RDPGFX_CAPSET* capsSet;
-	RDPGFX_CAPSET capsSets[2];
+	RDPGFX_CAPSET capsSets[3];
 	RDPGFX_CAPS_ADVERTISE_PDU pdu;
 
 	gfx = (RDPGFX_PLUGIN*) callback->plugin;
@@ -101,6 +101,17 @@ static UINT rdpgfx_send_caps_advertise_pdu(RDPGFX_CHANNEL_CALLBACK* callback)
 	if (gfx->H264)
 		capsSet->flags |= RDPGFX_CAPS_FLAG_H264ENABLED;
 
+	/* servers pick the highest version they know, with 10 they may send AVC444 as well as AVC420 */
+	if (gfx->H264 && gfx->AVC444)
+	{
+		capsSet = &capsSets[pdu.capsSetCount++];
+		capsSet->version = RDPGFX_CAPVERSION_10;
+		capsSet->flags = 0;
+
+		if (gfx->SmallCache)
+			capsSet->flags |= RDPGFX_CAPS_FLAG_SMALL_CACHE;
+	}
+
 	header.pduLength = RDPGFX_HEADER_SIZE + 2 + (pdu.capsSetCount * RDPGFX_CAPSET_SIZE);
 
 	WLog_DBG(TAG, "SendCapsAdvertisePdu");
@@ -1186,6 +1197,27 @@ FREERDP_API  UINT rdpgfx_on_data_received_Core(IWTSVirtualChannelCallback* pChan
 
 	return error;
 }
+/**
+ * Handles pdus which were already decompressed by the caller, data is not freed.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+FREERDP_API  UINT rdpgfx_recv_pdus_Core(IWTSVirtualChannelCallback* pChannelCallback, wStream* data)
+{
+	RDPGFX_CHANNEL_CALLBACK* callback = (RDPGFX_CHANNEL_CALLBACK*)pChannelCallback;
+	UINT error = CHANNEL_RC_OK;
+
+	while (((size_t)Stream_GetPosition(data)) < Stream_Length(data))
+	{
+		if ((error = rdpgfx_recv_pdu(callback, data)))
+		{
+			WLog_ERR(TAG, "rdpgfx_recv_pdu failed with error %lu!", error);
+			break;
+		}
+	}
+
+	return error;
+}
 static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback, wStream* data)
 {
 	wStream* s;
@@ -1605,6 +1637,7 @@ UINT DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
 		gfx->Progressive = gfx->settings->GfxProgressive;
 		gfx->ProgressiveV2 = gfx->settings->GfxProgressiveV2;
 		gfx->H264 = gfx->settings->GfxH264;
+		gfx->AVC444 = gfx->settings->GfxAVC444;
 
 		if (gfx->H264)
 			gfx->SmallCache = TRUE;
@@ -66,6 +66,7 @@ struct _RDPGFX_PLUGIN
 	BOOL Progressive;
 	BOOL ProgressiveV2;
 	BOOL H264;
+	BOOL AVC444;
 
 	ZGFX_CONTEXT* zgfx;
 	UINT32 UnacknowledgedFrames;
@@ -80,5 +81,6 @@ struct _RDPGFX_PLUGIN
 };
 typedef struct _RDPGFX_PLUGIN RDPGFX_PLUGIN;
 FREERDP_API  UINT rdpgfx_on_data_received_Core(IWTSVirtualChannelCallback* pChannelCallback, wStream* data);
+FREERDP_API  UINT rdpgfx_recv_pdus_Core(IWTSVirtualChannelCallback* pChannelCallback, wStream* data);
 #endif /* FREERDP_CHANNEL_RDPGFX_CLIENT_MAIN_H */
 
@@ -1124,6 +1124,34 @@ void rdpsnd_remove_init_handle_data(void* pInitHandle)
 	}
 }
 
+/**
+ * Finds the plugin loaded for a client context, the projector runs one context per session
+ * and can not rely on g_rdpsndPlugin which only remembers the first one.
+ */
+__declspec(dllexport) rdpsndPlugin* rdpsnd_find_plugin(rdpContext* context)
+{
+	int index;
+	int count;
+	ULONG_PTR* keys = NULL;
+	rdpsndPlugin* found = NULL;
+
+	if (!g_InitHandles || !context)
+		return NULL;
+
+	count = ListDictionary_GetKeys(g_InitHandles, &keys);
+
+	for (index = 0; index < count && !found; index++)
+	{
+		rdpsndPlugin* plugin = (rdpsndPlugin*) ListDictionary_GetItemValue(g_InitHandles, (void*) keys[index]);
+
+		if (plugin && plugin->rdpcontext == context)
+			found = plugin;
+	}
+
+	free(keys);
+	return found;
+}
+
 BOOL rdpsnd_add_open_handle_data(DWORD openHandle, void* pUserData)
 {
 	void* pOpenHandle = (void*) (size_t) openHandle;
@@ -79,6 +79,8 @@ const char* tirardpgfx_get_codec_id_string(UINT16 codecId)
 		return "TIRAGFX_CODECID_PLANAR";
 	case RDPGFX_CODECID_H264:
 		return "TIRAGFX_CODECID_H264";
+	case RDPGFX_CODECID_AVC444:
+		return "TIRAGFX_CODECID_AVC444";
 	case RDPGFX_CODECID_ALPHA:
 		return "TIRAGFX_CODECID_ALPHA";
 	case RDPGFX_CODECID_CAPROGRESSIVE:
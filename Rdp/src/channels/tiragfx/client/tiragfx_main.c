@@ -59,6 +59,16 @@ typedef struct redirectormessage REDIRECTORMESSAGE;
 
 _declspec(dllexport) void(*gSendScreenData)(void *data, unsigned int size);
 
+/* when set the projector acknowledges the frames it has decoded and those acknowledgements are relayed to
+ * the server, so the server paces itself by the projector instead of by this redirector. */
+_declspec(dllexport) BOOL gRelayFrameAcks = FALSE;
+/* when set the channels opened from now on only relay, the projector decodes the pdus and this end does not even
+ * decompress them once it no longer needs the end of frame pdus for acknowledging. */
+_declspec(dllexport) BOOL gGfxRelayOnly = FALSE;
+static CRITICAL_SECTION gFrameAckLock;
+static BOOL gFrameAckLockInitialized = FALSE;
+static RDPGFX_CHANNEL_CALLBACK* gFrameAckCallback = NULL;
+
 static UINT tirardpgfx_send_caps_advertise_pdu(RDPGFX_CHANNEL_CALLBACK* callback)
 {
 	UINT error;
@@ -67,7 +77,7 @@ static UINT tirardpgfx_send_caps_advertise_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 	RDPGFX_PLUGIN* gfx;
 	RDPGFX_HEADER header;
 	RDPGFX_CAPSET* capsSet;
-	RDPGFX_CAPSET capsSets[2];
+	RDPGFX_CAPSET capsSets[3];
 	RDPGFX_CAPS_ADVERTISE_PDU pdu;
 
 	gfx = (RDPGFX_PLUGIN*) callback->plugin;
@@ -101,6 +111,17 @@ static UINT tirardpgfx_send_caps_advertise_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 	if (gfx->H264)
 		capsSet->flags |= RDPGFX_CAPS_FLAG_H264ENABLED;
 
+	/* servers pick the highest version they know, with 10 they may send AVC444 as well as AVC420 */
+	if (gfx->H264 && gfx->AVC444)
+	{
+		capsSet = &capsSets[pdu.capsSetCount++];
+		capsSet->version = RDPGFX_CAPVERSION_10;
+		capsSet->flags = 0;
+
+		if (gfx->SmallCache)
+			capsSet->flags |= RDPGFX_CAPS_FLAG_SMALL_CACHE;
+	}
+
 	header.pduLength = RDPGFX_HEADER_SIZE + 2 + (pdu.capsSetCount * RDPGFX_CAPSET_SIZE);
 
 	WLog_DBG(TAG, "SendCapsAdvertisePdu");
@@ -182,6 +203,67 @@ static UINT tirardpgfx_send_frame_acknowledge_pdu(RDPGFX_CHANNEL_CALLBACK* callb
 	return error;
 }
 
+/**
+ * Sends a frame acknowledge reported by the projector to the server.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+_declspec(dllexport) UINT tirardpgfx_relay_frame_acknowledge(UINT32 queueDepth, UINT32 frameId, UINT32 totalFramesDecoded)
+{
+	RDPGFX_FRAME_ACKNOWLEDGE_PDU ack;
+	UINT error = CHANNEL_RC_OK;
+
+	if (!gFrameAckLockInitialized)
+		return CHANNEL_RC_NOT_INITIALIZED;
+
+	ack.queueDepth = queueDepth;
+	ack.frameId = frameId;
+	ack.totalFramesDecoded = totalFramesDecoded;
+
+	EnterCriticalSection(&gFrameAckLock);
+	if (gFrameAckCallback)
+		error = tirardpgfx_send_frame_acknowledge_pdu(gFrameAckCallback, &ack);
+	LeaveCriticalSection(&gFrameAckLock);
+
+	if (error)
+		WLog_ERR(TAG, "tirardpgfx_relay_frame_acknowledge failed with error %lu", error);
+	return error;
+}
+
+/**
+ * Advertises the capabilities again, with or without AVC420, the server answers with a caps confirm and
+ * resets the graphics, which the projector decodes as it does the first time.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+_declspec(dllexport) UINT tirardpgfx_advertise_caps(BOOL h264)
+{
+	RDPGFX_PLUGIN* gfx;
+	UINT error = CHANNEL_RC_NOT_CONNECTED;
+
+	if (!gFrameAckLockInitialized)
+		return CHANNEL_RC_NOT_INITIALIZED;
+
+	EnterCriticalSection(&gFrameAckLock);
+	if (gFrameAckCallback)
+	{
+		gfx = (RDPGFX_PLUGIN*) gFrameAckCallback->plugin;
+		gfx->H264 = h264;
+		/* same as for the first advertise, AVC420 goes with the small cache. */
+		if (gfx->H264)
+		{
+			gfx->SmallCache = TRUE;
+			gfx->ThinClient = FALSE;
+		}
+		error = tirardpgfx_send_caps_advertise_pdu(gFrameAckCallback);
+	}
+	LeaveCriticalSection(&gFrameAckLock);
+
+	if (error)
+		WLog_ERR(TAG, "tirardpgfx_advertise_caps failed with error %lu", error);
+	return error;
+}
+
 /**
  * Function description
  *
@@ -207,6 +289,22 @@ static UINT tirardpgfx_recv_end_frame_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wSt
 	gfx->UnacknowledgedFrames--;
 	gfx->TotalDecodedFrames++;
 
+	if (gRelayFrameAcks)
+		return error;
+
+	if (callback->RelayOnly)
+	{
+		/* the projector acknowledgements are not relayed yet, tell the server not to wait for any so the
+		 * channel can stop decompressing. The first relayed acknowledgement turns them on again. */
+		ack.frameId = pdu.frameId;
+		ack.totalFramesDecoded = gfx->TotalDecodedFrames;
+		ack.queueDepth = SUSPEND_FRAME_ACKNOWLEDGEMENT;
+		callback->PassThrough = TRUE;
+		if ((error = tirardpgfx_send_frame_acknowledge_pdu(callback, &ack)))
+			WLog_ERR(TAG, "rdpgfx_send_frame_acknowledge_pdu failed with error %lu", error);
+		return error;
+	}
+
 	ack.frameId = pdu.frameId;
 	ack.totalFramesDecoded = gfx->TotalDecodedFrames;
 
@@ -345,6 +443,13 @@ static UINT tirardpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCall
 
 	gSendScreenData(Stream_Pointer(data), Stream_GetRemainingLength(data));
 
+	/* nothing is read from the pdus once the acknowledgements are taken care of, from then on the history of
+	 * the local zgfx context is stale and the channel must not go back to decompressing. */
+	if (callback->RelayOnly && gRelayFrameAcks)
+		callback->PassThrough = TRUE;
+	if (callback->PassThrough)
+		return CHANNEL_RC_OK;
+
 	status = zgfx_decompress(gfx->zgfx, Stream_Pointer(data), Stream_GetRemainingLength(data), &pDstData, &DstSize, 0);
 	if (status < 0)
 	{
@@ -405,6 +510,11 @@ static UINT tirardpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 
 	WLog_DBG(TAG, "OnClose");
 
+	EnterCriticalSection(&gFrameAckLock);
+	if (gFrameAckCallback == callback)
+		gFrameAckCallback = NULL;
+	LeaveCriticalSection(&gFrameAckLock);
+
 	free(callback);
 
 	gfx->UnacknowledgedFrames = 0;
@@ -481,8 +591,13 @@ static UINT tirardpgfx_on_new_channel_connection(IWTSListenerCallback* pListener
 	callback->plugin = listener_callback->plugin;
 	callback->channel_mgr = listener_callback->channel_mgr;
 	callback->channel = pChannel;
+	callback->RelayOnly = gGfxRelayOnly;
 	listener_callback->channel_callback = callback;
 
+	EnterCriticalSection(&gFrameAckLock);
+	gFrameAckCallback = callback;
+	LeaveCriticalSection(&gFrameAckLock);
+
 	*ppCallback = (IWTSVirtualChannelCallback*) callback;
 
 	return CHANNEL_RC_OK;
@@ -724,6 +839,12 @@ UINT TITADVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
 	RDPGFX_PLUGIN* gfx;
 	RdpgfxClientContext* context;
 
+	if (!gFrameAckLockInitialized)
+	{
+		InitializeCriticalSection(&gFrameAckLock);
+		gFrameAckLockInitialized = TRUE;
+	}
+
 	gfx = (RDPGFX_PLUGIN*) pEntryPoints->GetPlugin(pEntryPoints, "rdpgfx");
 	if (!gfx)
 	{
@@ -756,6 +877,7 @@ UINT TITADVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
 		gfx->Progressive = gfx->settings->GfxProgressive;
 		gfx->ProgressiveV2 = gfx->settings->GfxProgressiveV2;
 		gfx->H264 = gfx->settings->GfxH264;
+		gfx->AVC444 = gfx->settings->GfxAVC444;
 
 		if (gfx->H264)
 			gfx->SmallCache = TRUE;
@@ -39,6 +39,9 @@ struct _RDPGFX_CHANNEL_CALLBACK
 	IWTSPlugin* plugin;
 	IWTSVirtualChannelManager* channel_mgr;
 	IWTSVirtualChannel* channel;
+
+	BOOL RelayOnly;
+	BOOL PassThrough;
 };
 typedef struct _RDPGFX_CHANNEL_CALLBACK RDPGFX_CHANNEL_CALLBACK;
 
@@ -66,6 +69,7 @@ struct _RDPGFX_PLUGIN
 	BOOL Progressive;
 	BOOL ProgressiveV2;
 	BOOL H264;
+	BOOL AVC444;
 
 	ZGFX_CONTEXT* zgfx;
 	UINT32 UnacknowledgedFrames;
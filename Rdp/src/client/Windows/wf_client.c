@@ -89,12 +89,13 @@ BOOL wf_sw_end_paint(wfContext* wfc)
 {
 	int i;
 	rdpGdi* gdi;
+	int nbRects;
 	int ninvalid;
 	RECT updateRect;
 	HGDI_RGN cinvalid;
 	REGION16 invalidRegion;
 	RECTANGLE_16 invalidRect;
-	const RECTANGLE_16* extents;
+	const RECTANGLE_16* rects;
 	rdpContext* context = (rdpContext*) wfc;
 
 	gdi = context->gdi;
@@ -119,14 +120,18 @@ BOOL wf_sw_end_paint(wfContext* wfc)
 
 	if (!region16_is_empty(&invalidRegion))
 	{
-		extents = region16_extents(&invalidRegion);
+		/* the window keeps the rectangles apart in its update region, so WM_PAINT only blits those */
+		rects = region16_rects(&invalidRegion, &nbRects);
 
-		updateRect.left = extents->left;
-		updateRect.top = extents->top;
-		updateRect.right = extents->right;
-		updateRect.bottom = extents->bottom;
+		for (i = 0; i < nbRects; i++)
+		{
+			updateRect.left = rects[i].left;
+			updateRect.top = rects[i].top;
+			updateRect.right = rects[i].right;
+			updateRect.bottom = rects[i].bottom;
 
-		InvalidateRect(wfc->hwnd, &updateRect, FALSE);
+			InvalidateRect(wfc->hwnd, &updateRect, FALSE);
+		}
 
 		if (wfc->rail)
 			wf_rail_invalidate_region(wfc, &invalidRegion);
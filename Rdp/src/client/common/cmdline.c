@@ -121,6 +121,7 @@ COMMAND_LINE_ARGUMENT_A args[] =
 	{ "gfx-small-cache", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "RDP8 graphics pipeline small cache mode" },
 	{ "gfx-progressive", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "RDP8 graphics pipeline progressive codec" },
 	{ "gfx-h264", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "RDP8.1 graphics pipeline H264 codec" },
+	{ "gfx-avc444", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL, "RDP10 graphics pipeline AVC444 (H264 4:4:4) codec" },
 	{ "rfx", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL, "RemoteFX" },
 	{ "rfx-mode", COMMAND_LINE_VALUE_REQUIRED, "<image|video>", NULL, NULL, -1, NULL, "RemoteFX mode" },
 	{ "frame-ack", COMMAND_LINE_VALUE_REQUIRED, "<number>", NULL, NULL, -1, NULL, "Frame acknowledgement" },
@@ -1969,6 +1970,15 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 			settings->GfxH264 = arg->Value ? TRUE : FALSE;
 			settings->SupportGraphicsPipeline = TRUE;
 		}
+		CommandLineSwitchCase(arg, "gfx-avc444")
+		{
+			settings->GfxAVC444 = arg->Value ? TRUE : FALSE;
+
+			if (settings->GfxAVC444)
+				settings->GfxH264 = TRUE;
+
+			settings->SupportGraphicsPipeline = TRUE;
+		}
 		CommandLineSwitchCase(arg, "rfx")
 		{
 			settings->RemoteFxCodec = TRUE;
@@ -43,6 +43,7 @@
 /* #undef WITH_PROFILER */
 /* #undef WITH_GPROF */
 #define WITH_SSE2
+#define WITH_AVX2
 /* #undef WITH_NEON */
 /* #undef WITH_IPP */
 #define WITH_NATIVE_SSPI
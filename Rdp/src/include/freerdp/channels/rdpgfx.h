@@ -99,6 +99,7 @@ typedef struct _RDPGFX_HEADER RDPGFX_HEADER;
 
 #define RDPGFX_CAPVERSION_8			0x00080004
 #define RDPGFX_CAPVERSION_81			0x00080105
+#define RDPGFX_CAPVERSION_10			0x000A0002
 
 #define RDPGFX_CAPSET_SIZE			12
 
@@ -112,6 +113,7 @@ typedef struct _RDPGFX_CAPSET RDPGFX_CAPSET;
 #define RDPGFX_CAPS_FLAG_THINCLIENT		0x00000001 /* 8.0+ */
 #define RDPGFX_CAPS_FLAG_SMALL_CACHE		0x00000002 /* 8.0+ */
 #define RDPGFX_CAPS_FLAG_H264ENABLED		0x00000010 /* 8.1+ */
+#define RDPGFX_CAPS_FLAG_AVC_DISABLED		0x00000020 /* 10.0+ */
 
 struct _RDPGFX_CAPSET_VERSION8
 {
@@ -129,6 +131,14 @@ struct _RDPGFX_CAPSET_VERSION81
 };
 typedef struct _RDPGFX_CAPSET_VERSION81 RDPGFX_CAPSET_VERSION81;
 
+struct _RDPGFX_CAPSET_VERSION10
+{
+	UINT32 version;
+	UINT32 capsDataLength;
+	UINT32 flags;
+};
+typedef struct _RDPGFX_CAPSET_VERSION10 RDPGFX_CAPSET_VERSION10;
+
 /**
  * Graphics Messages
  */
@@ -139,6 +149,7 @@ typedef struct _RDPGFX_CAPSET_VERSION81 RDPGFX_CAPSET_VERSION81;
 #define RDPGFX_CODECID_PLANAR			0x000A
 #define RDPGFX_CODECID_H264			0x000B
 #define RDPGFX_CODECID_ALPHA			0x000C
+#define RDPGFX_CODECID_AVC444			0x000E
 
 struct _RDPGFX_WIRE_TO_SURFACE_PDU_1
 {
@@ -362,5 +373,19 @@ struct _RDPGFX_H264_BITMAP_STREAM
 };
 typedef struct _RDPGFX_H264_BITMAP_STREAM RDPGFX_H264_BITMAP_STREAM;
 
+/* AVC444 */
+
+#define RDPGFX_AVC444_LC_BOTH			0 /* main view in the first stream, auxiliary in the second */
+#define RDPGFX_AVC444_LC_LUMA			1 /* main view only */
+#define RDPGFX_AVC444_LC_CHROMA			2 /* auxiliary view only, in the first stream */
+
+struct _RDPGFX_AVC444_BITMAP_STREAM
+{
+	BYTE LC;
+	UINT32 numStreams;
+	RDPGFX_H264_BITMAP_STREAM bitstream[2];
+};
+typedef struct _RDPGFX_AVC444_BITMAP_STREAM RDPGFX_AVC444_BITMAP_STREAM;
+
 #endif /* FREERDP_CHANNEL_RDPGFX_H */
 
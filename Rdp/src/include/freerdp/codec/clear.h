@@ -22,6 +22,8 @@
 
 typedef struct _CLEAR_CONTEXT CLEAR_CONTEXT;
 
+#include <winpr/pool.h>
+
 #include <freerdp/api.h>
 #include <freerdp/types.h>
 
@@ -45,6 +47,7 @@ struct _CLEAR_VBAR_ENTRY
 	UINT32 size;
 	UINT32 count;
 	UINT32* pixels;
+	UINT32 bandBatch;
 };
 typedef struct _CLEAR_VBAR_ENTRY CLEAR_VBAR_ENTRY;
 
@@ -60,6 +63,20 @@ struct _CLEAR_CONTEXT
 	CLEAR_VBAR_ENTRY VBarStorage[32768];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[16384];
+
+	BOOL UseThreads;
+	DWORD MinThreadCount;
+	DWORD MaxThreadCount;
+	PTP_POOL ThreadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+
+	/* the bands composed on the thread pool, see clear_decompress_bands */
+	UINT32 BandBatch;
+	UINT32 BandWorkCount;
+	PTP_WORK* BandWorkObjects;
+	struct _CLEAR_BAND_WORK_PARAM* BandWorkParams;
+	UINT32 BandVBarCount;
+	CLEAR_VBAR_ENTRY** BandVBars;
 };
 
 #ifdef __cplusplus
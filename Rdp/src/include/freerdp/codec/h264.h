@@ -49,6 +49,17 @@ enum _H264_RATECONTROL_MODE
 };
 typedef enum _H264_RATECONTROL_MODE H264_RATECONTROL_MODE;
 
+#define H264_PENDING_FRAMES_MAX		64
+
+/* the regions of a packet whose frame the decoder still holds */
+struct _H264_PENDING_FRAME
+{
+	UINT32 frameId;
+	UINT32 numRects;
+	RDPGFX_RECT16* rects;
+};
+typedef struct _H264_PENDING_FRAME H264_PENDING_FRAME;
+
 struct _H264_CONTEXT
 {
 	BOOL Compressor;
@@ -61,10 +72,44 @@ struct _H264_CONTEXT
 	FLOAT FrameRate;
 	UINT32 QP;
 	UINT32 NumberOfThreads;
-	
+
+	/* Decoder settings, read from the registry and applied again by h264_context_reset */
+	/* FrameThreading is off unless a benchmark turns it on, the frames it holds back are never drained */
+	BOOL FrameThreading;
+	BOOL LowDelay;
+	BOOL ZeroCopy;
+
+	/* set by a decoder returning earlier frames than the last one it was given */
+	BOOL DelayedOutput;
+
+	/* packets are numbered from the reset, the subsystem tells which one the frame it returned was decoded from */
+	UINT32 InputFrameId;
+	UINT32 OutputFrameId;
+	UINT32 numPendingFrames;
+	H264_PENDING_FRAME PendingFrames[H264_PENDING_FRAMES_MAX];
+
+	/* the regions h264_decompress converted, those of the frame returned, none when it was held back */
+	RDPGFX_RECT16* OutputRects;
+	UINT32 numOutputRects;
+	UINT32 OutputRectsSize;
+
+	/* the AVC420 bitmap streams of one decoder are recorded here, see h264_trace_bitmap_stream */
+	char* TraceFileName;
+	FILE* TraceFile;
+
 	int iStride[3];
 	BYTE* pYUVData[3];
 
+	/* the decoded planes when ZeroCopy is off */
+	BYTE* pYUVCopyData[3];
+	UINT32 YUVCopySize[3];
+
+	/* AVC444 frames are rebuilt here from the main and auxiliary views, which may come apart */
+	UINT32 YUV444Width;
+	UINT32 YUV444Height;
+	int iYUV444Stride[3];
+	BYTE* pYUV444Data[3];
+
 	void* pSystemData;
 	H264_CONTEXT_SUBSYSTEM* subsystem;
 };
@@ -80,6 +125,11 @@ FREERDP_API int h264_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcSi
 		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nDstWidth, int nDstHeight,
 		RDPGFX_RECT16* regionRects, int numRegionRect);
 
+FREERDP_API int h264_decompress_avc444(H264_CONTEXT* h264, RDPGFX_AVC444_BITMAP_STREAM* bs,
+		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nDstWidth, int nDstHeight);
+
+FREERDP_API BOOL h264_trace_bitmap_stream(H264_CONTEXT* h264, RDPGFX_H264_BITMAP_STREAM* bs);
+
 FREERDP_API int h264_context_reset(H264_CONTEXT* h264);
 
 FREERDP_API H264_CONTEXT* h264_context_new(BOOL Compressor);
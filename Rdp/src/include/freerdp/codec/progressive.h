@@ -26,6 +26,7 @@ typedef struct _PROGRESSIVE_CONTEXT PROGRESSIVE_CONTEXT;
 #include <freerdp/types.h>
 
 #include <winpr/wlog.h>
+#include <winpr/pool.h>
 #include <winpr/collections.h>
 
 #include <freerdp/codec/rfx.h>
@@ -228,6 +229,12 @@ struct _PROGRESSIVE_CONTEXT
 	RFX_PROGRESSIVE_CODEC_QUANT quantProgValFull;
 
 	wHashTable* SurfaceContexts;
+
+	BOOL UseThreads;
+	DWORD MinThreadCount;
+	DWORD MaxThreadCount;
+	PTP_POOL ThreadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
 };
 
 #ifdef __cplusplus
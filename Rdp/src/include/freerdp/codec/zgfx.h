@@ -28,24 +28,43 @@
 #define ZGFX_SEGMENTED_SINGLE			0xE0
 #define ZGFX_SEGMENTED_MULTIPART		0xE1
 
+#define ZGFX_SEGMENT_MAX_SIZE			65535
+#define ZGFX_HISTORY_SIZE			2500000
+/* the start of the history is repeated after its end, so no read of a segment's length wraps */
+#define ZGFX_HISTORY_MIRROR			65536
+/* wide match copies may store this much past the end of the output */
+#define ZGFX_OUTPUT_SLACK			32
+#define ZGFX_TOKEN_LOOKUP_BITS			9
+#define ZGFX_HASH_BITS				17
+
+/* 0 only frames the data, higher levels search longer hash chains */
+#define ZGFX_COMPRESSION_LEVEL_NONE		0
+#define ZGFX_COMPRESSION_LEVEL_FAST		1
+#define ZGFX_COMPRESSION_LEVEL_DEFAULT		4
+#define ZGFX_COMPRESSION_LEVEL_MAX		9
+
 struct _ZGFX_CONTEXT
 {
 	BOOL Compressor;
 
-	BYTE* pbInputCurrent;
-	BYTE* pbInputEnd;
-
-	UINT32 bits;
-	UINT32 cBitsRemaining;
-	UINT32 BitsCurrent;
-	UINT32 cBitsCurrent;
-
-	BYTE OutputBuffer[65536];
+	BYTE OutputBuffer[65536 + ZGFX_OUTPUT_SLACK];
 	UINT32 OutputCount;
 
-	BYTE HistoryBuffer[2500000];
+	BYTE HistoryBuffer[ZGFX_HISTORY_SIZE + ZGFX_HISTORY_MIRROR];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	/* decompressor only, the token whose prefix starts the next ZGFX_TOKEN_LOOKUP_BITS bits */
+	BYTE TokenLookup[1 << ZGFX_TOKEN_LOOKUP_BITS];
+
+	/* compressor only */
+	UINT32 CompressionLevel;
+	UINT32 HistoryPosition; /* stream position of HistoryIndex, a multiple of the history size ahead of it */
+	UINT32 HashPosition; /* next stream position to enter into the hash chains */
+	UINT32* HashHead;
+	UINT32* HashChain;
+	UINT16 LiteralCode[256];
+	BYTE LiteralLength[256];
 };
 typedef struct _ZGFX_CONTEXT ZGFX_CONTEXT;
 
@@ -56,6 +75,8 @@ extern "C" {
 FREERDP_API int zgfx_compress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags);
 FREERDP_API int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
 
+FREERDP_API void zgfx_set_compression_level(ZGFX_CONTEXT* zgfx, DWORD CompressionLevel);
+
 FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush);
 
 FREERDP_API ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor);
@@ -309,6 +309,12 @@ struct rdp_gdi
 	UINT16 outputSurfaceId;
 	REGION16 invalidRegion;
 	RdpgfxClientContext* gfx;
+
+	/* bytes copied from the surfaces into the primary buffer, in the current frame and in total */
+	UINT32 frameBytesCopied;
+	UINT64 outputBytesCopied;
+	/* bytes the bounding boxes of the surface damage hold, which one copy per surface would take */
+	UINT64 outputBytesExtents;
 };
 
 #ifdef __cplusplus
@@ -34,6 +34,7 @@ struct gdi_gfx_surface
 	int scanline;
 	UINT32 format;
 	BOOL outputMapped;
+	BOOL outputDirect;
 	UINT32 outputOriginX;
 	UINT32 outputOriginY;
 	REGION16 invalidRegion;
@@ -176,6 +176,14 @@ typedef pstatus_t (*__RGBToYUV420_8u_P3AC4R_t)(
 	const BYTE* pSrc, INT32 srcStep,
 	BYTE* pDst[3], INT32 dstStep[3],
 	const prim_size_t* roi);
+typedef pstatus_t (*__YUV444ToRGB_8u_P3AC4R_t)(
+	const BYTE* pSrc[3], INT32 srcStep[3],
+	BYTE* pDst, INT32 dstStep,
+	const prim_size_t* roi);
+typedef pstatus_t (*__AVC444ToYUV444_8u_P3P3_t)(
+	const BYTE* pSrc[3], INT32 srcStep[3],
+	BYTE* pDst[3], INT32 dstStep[3],
+	const RECTANGLE_16* rect);
 typedef pstatus_t (*__andC_32u_t)(
 	const UINT32 *pSrc,
 	UINT32 val,
@@ -224,6 +232,10 @@ typedef struct
 	__RGB565ToARGB_16u32u_C3C4_t RGB565ToARGB_16u32u_C3C4;
 	__YUV420ToRGB_8u_P3AC4R_t YUV420ToRGB_8u_P3AC4R;
 	__RGBToYUV420_8u_P3AC4R_t RGBToYUV420_8u_P3AC4R;
+	__YUV444ToRGB_8u_P3AC4R_t YUV444ToRGB_8u_P3AC4R;
+	/* AVC444 main and auxiliary views to full resolution YUV planes */
+	__AVC444ToYUV444_8u_P3P3_t AVC444LumaToYUV444_8u_P3P3;
+	__AVC444ToYUV444_8u_P3P3_t AVC444ChromaToYUV444_8u_P3P3;
 } primitives_t;
 
 #ifdef __cplusplus
@@ -23,11 +23,20 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
+#include <winpr/registry.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/clear.h>
 
+#define CLEAR_KEY "Software\\"FREERDP_VENDOR_STRING"\\" \
+		     FREERDP_PRODUCT_STRING"\\ClearCodec"
+
+/* bands and columns submitted to the thread pool before waiting for them */
+#define CLEAR_BAND_WORK_MAX	64
+#define CLEAR_BAND_VBAR_MAX	4096
+
 static UINT32 CLEAR_LOG2_FLOOR[256] =
 {
 	0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
@@ -53,6 +62,427 @@ static BYTE CLEAR_8BIT_MASKS[9] =
 	0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF
 };
 
+struct _CLEAR_BAND_WORK_PARAM
+{
+	BYTE* pDstData;
+	int nDstStep;
+	int nXDst;
+	int nYDst;
+	UINT32 height;
+	UINT32 vBarCount;
+	CLEAR_VBAR_ENTRY** vBars;
+};
+typedef struct _CLEAR_BAND_WORK_PARAM CLEAR_BAND_WORK_PARAM;
+
+static void clear_compose_band(CLEAR_BAND_WORK_PARAM* band)
+{
+	UINT32 x, y;
+	UINT32* pDstPixel32;
+
+	for (y = 0; y < band->height; y++)
+	{
+		pDstPixel32 = (UINT32*) &band->pDstData[((band->nYDst + y) * band->nDstStep) + (band->nXDst * 4)];
+
+		for (x = 0; x < band->vBarCount; x++)
+			pDstPixel32[x] = band->vBars[x]->pixels[y];
+	}
+}
+
+void CALLBACK clear_band_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
+{
+	clear_compose_band((CLEAR_BAND_WORK_PARAM*) context);
+}
+
+/**
+ * Waits for the bands submitted so far. The vBars they read are stamped with the current batch,
+ * which ends here, so they may be replaced again.
+ */
+static void clear_wait_bands(CLEAR_CONTEXT* clear)
+{
+	UINT32 i;
+
+	for (i = 0; i < clear->BandWorkCount; i++)
+	{
+		WaitForThreadpoolWorkCallbacks(clear->BandWorkObjects[i], FALSE);
+		CloseThreadpoolWork(clear->BandWorkObjects[i]);
+	}
+
+	clear->BandWorkCount = 0;
+	clear->BandVBarCount = 0;
+	clear->BandBatch++;
+}
+
+/**
+ * Bands may overlap, the later one wins. A band drawing over pixels a pending one has yet to compose
+ * waits for the pending ones first, like a vBar about to be replaced.
+ */
+static BOOL clear_bands_pending_at(CLEAR_CONTEXT* clear, int nXDst, int nYDst, UINT32 width, UINT32 height)
+{
+	UINT32 i;
+	CLEAR_BAND_WORK_PARAM* band;
+
+	for (i = 0; i < clear->BandWorkCount; i++)
+	{
+		band = &(clear->BandWorkParams[i]);
+
+		if ((nXDst < (int) (band->nXDst + band->vBarCount)) && (band->nXDst < (int) (nXDst + width)) &&
+				(nYDst < (int) (band->nYDst + band->height)) && (band->nYDst < (int) (nYDst + height)))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static CLEAR_BAND_WORK_PARAM* clear_begin_band(CLEAR_CONTEXT* clear, BYTE* pDstData, int nDstStep,
+		int nXDst, int nYDst, UINT32 height)
+{
+	CLEAR_BAND_WORK_PARAM* band;
+
+	if ((clear->BandWorkCount >= CLEAR_BAND_WORK_MAX) || (clear->BandVBarCount >= CLEAR_BAND_VBAR_MAX))
+		clear_wait_bands(clear);
+
+	band = &(clear->BandWorkParams[clear->BandWorkCount]);
+	band->pDstData = pDstData;
+	band->nDstStep = nDstStep;
+	band->nXDst = nXDst;
+	band->nYDst = nYDst;
+	band->height = height;
+	band->vBarCount = 0;
+	band->vBars = &(clear->BandVBars[clear->BandVBarCount]);
+
+	return band;
+}
+
+static void clear_submit_band(CLEAR_CONTEXT* clear, CLEAR_BAND_WORK_PARAM* band)
+{
+	PTP_WORK work;
+
+	clear->BandVBarCount += band->vBarCount;
+
+	work = CreateThreadpoolWork((PTP_WORK_CALLBACK) clear_band_work_callback, (void*) band, &clear->ThreadPoolEnv);
+
+	if (!work)
+	{
+		clear_compose_band(band);
+		return;
+	}
+
+	clear->BandWorkObjects[clear->BandWorkCount++] = work;
+	SubmitThreadpoolWork(work);
+}
+
+/**
+ * The vBar caches are updated in stream order, only the columns the bands resolve to are composed onto
+ * the destination on the thread pool, a band at a time, in stream order where bands overlap. The caller
+ * waits for them with clear_wait_bands before the subcodecs draw over the bands.
+ */
+static int clear_decompress_bands(CLEAR_CONTEXT* clear, BYTE* bandsData, UINT32 bandsByteCount,
+		BYTE* pDstData, int nDstStep, int nXDst, int nYDst, BOOL invert)
+{
+	UINT32 i;
+	UINT32 y;
+	UINT32 count;
+	int nXDstRel;
+	int nYDstRel;
+	UINT32 suboffset = 0;
+	BYTE* pSrcPixel8 = NULL;
+	BYTE* pDstPixel8 = NULL;
+	UINT32* pSrcPixel32 = NULL;
+	UINT32* pDstPixel32 = NULL;
+	CLEAR_BAND_WORK_PARAM* band = NULL;
+
+	while (suboffset < bandsByteCount)
+	{
+		UINT16 xStart;
+		UINT16 xEnd;
+		UINT16 yStart;
+		UINT16 yEnd;
+		BYTE* vBar;
+		BOOL vBarUpdate;
+		UINT32 colorBkg;
+		UINT16 vBarHeader;
+		UINT16 vBarIndex;
+		UINT16 vBarYOn;
+		UINT16 vBarYOff;
+		UINT32 vBarCount;
+		UINT32 vBarHeight;
+		UINT32 vBarPixelCount;
+		UINT32 vBarShortPixelCount;
+		CLEAR_VBAR_ENTRY* vBarEntry;
+		CLEAR_VBAR_ENTRY* vBarShortEntry;
+
+		if ((bandsByteCount - suboffset) < 11)
+			return -1021;
+
+		xStart = *((UINT16*) &bandsData[suboffset]);
+		xEnd = *((UINT16*) &bandsData[suboffset + 2]);
+		yStart = *((UINT16*) &bandsData[suboffset + 4]);
+		yEnd = *((UINT16*) &bandsData[suboffset + 6]);
+		suboffset += 8;
+
+		if (!invert)
+			colorBkg = RGB32(bandsData[suboffset + 2], bandsData[suboffset + 1], bandsData[suboffset + 0]);
+		else
+			colorBkg = BGR32(bandsData[suboffset + 2], bandsData[suboffset + 1], bandsData[suboffset + 0]);
+
+		suboffset += 3;
+
+		if (xEnd < xStart)
+			return -1022;
+
+		if (yEnd < yStart)
+			return -1023;
+
+		vBarCount = (xEnd - xStart) + 1;
+
+		if (clear->UseThreads && clear_bands_pending_at(clear, nXDst + xStart, nYDst + yStart,
+				vBarCount, (yEnd - yStart) + 1))
+			clear_wait_bands(clear);
+
+		for (i = 0; i < vBarCount; i++)
+		{
+			vBarUpdate = FALSE;
+			vBar = &bandsData[suboffset];
+
+			if ((bandsByteCount - suboffset) < 2)
+				return -1024;
+
+			vBarHeader = *((UINT16*) &vBar[0]);
+			suboffset += 2;
+
+			vBarHeight = (yEnd - yStart + 1);
+
+			if (vBarHeight > 52)
+				return -1025;
+
+			if ((vBarHeader & 0xC000) == 0x4000) /* SHORT_VBAR_CACHE_HIT */
+			{
+				vBarIndex = (vBarHeader & 0x3FFF);
+
+				if (vBarIndex >= 16384)
+					return -1026;
+
+				if ((bandsByteCount - suboffset) < 1)
+					return -1027;
+
+				vBarYOn = vBar[2];
+				suboffset += 1;
+
+				vBarShortEntry = &(clear->ShortVBarStorage[vBarIndex]);
+
+				if (!vBarShortEntry)
+					return -1028;
+
+				vBarShortPixelCount = vBarShortEntry->count;
+
+				vBarUpdate = TRUE;
+			}
+			else if ((vBarHeader & 0xC000) == 0x0000) /* SHORT_VBAR_CACHE_MISS */
+			{
+				vBarYOn = (vBarHeader & 0xFF);
+				vBarYOff = ((vBarHeader >> 8) & 0x3F);
+
+				if (vBarYOff < vBarYOn)
+					return -1029;
+
+				pSrcPixel8 = &vBar[2];
+				vBarShortPixelCount = (vBarYOff - vBarYOn);
+
+				if (vBarShortPixelCount > 52)
+					return -1030;
+
+				if ((bandsByteCount - suboffset) < (vBarShortPixelCount * 3))
+					return -1031;
+
+				if (clear->ShortVBarStorageCursor >= 16384)
+					return -1032;
+
+				vBarShortEntry = &(clear->ShortVBarStorage[clear->ShortVBarStorageCursor]);
+
+				vBarShortEntry->count = vBarShortPixelCount;
+
+				if (vBarShortEntry->count > vBarShortEntry->size)
+				{
+					UINT32 *tmp;
+					vBarShortEntry->size = vBarShortEntry->count;
+
+					tmp = (UINT32*) realloc(vBarShortEntry->pixels, vBarShortEntry->count * 4);
+					if (!tmp)
+						return -1;
+					vBarShortEntry->pixels = tmp;
+				}
+
+				if (!vBarShortEntry->pixels && vBarShortEntry->size)
+					return -1033;
+
+				pDstPixel32 = vBarShortEntry->pixels;
+
+				if (!invert)
+				{
+					for (y = 0; y < vBarShortPixelCount; y++)
+					{
+						*pDstPixel32 = RGB32(pSrcPixel8[2], pSrcPixel8[1], pSrcPixel8[0]);
+						pSrcPixel8 += 3;
+						pDstPixel32++;
+					}
+				}
+				else
+				{
+					for (y = 0; y < vBarShortPixelCount; y++)
+					{
+						*pDstPixel32 = BGR32(pSrcPixel8[2], pSrcPixel8[1], pSrcPixel8[0]);
+						pSrcPixel8 += 3;
+						pDstPixel32++;
+					}
+				}
+
+				suboffset += (vBarShortPixelCount * 3);
+
+				vBarShortEntry->count = vBarShortPixelCount;
+				clear->ShortVBarStorageCursor = (clear->ShortVBarStorageCursor + 1) % 16384;
+
+				vBarUpdate = TRUE;
+			}
+			else if ((vBarHeader & 0x8000) == 0x8000) /* VBAR_CACHE_HIT */
+			{
+				vBarIndex = (vBarHeader & 0x7FFF);
+
+				if (vBarIndex >= 32768)
+					return -1034;
+
+				vBarEntry = &(clear->VBarStorage[vBarIndex]);
+			}
+			else
+			{
+				return -1035; /* invalid vBarHeader */
+			}
+
+			if (vBarUpdate)
+			{
+				if (clear->VBarStorageCursor >= 32768)
+					return -1036;
+
+				vBarEntry = &(clear->VBarStorage[clear->VBarStorageCursor]);
+
+				/* a band still to be composed may read the vBar about to be replaced */
+				if (clear->UseThreads && (vBarEntry->bandBatch == clear->BandBatch))
+				{
+					if (band)
+						clear_submit_band(clear, band);
+
+					band = NULL;
+					clear_wait_bands(clear);
+				}
+
+				vBarPixelCount = vBarHeight;
+				vBarEntry->count = vBarPixelCount;
+
+				if (vBarEntry->count > vBarEntry->size)
+				{
+					UINT32 *tmp;
+					vBarEntry->size = vBarEntry->count;
+
+					tmp = (UINT32*) realloc(vBarEntry->pixels, vBarEntry->count * 4);
+					if (!tmp)
+						return -1;
+					vBarEntry->pixels = tmp;
+				}
+
+				if (!vBarEntry->pixels && vBarEntry->size)
+					return -1037;
+
+				pDstPixel32 = vBarEntry->pixels;
+
+				/* if (y < vBarYOn), use colorBkg */
+
+				y = 0;
+				count = vBarYOn;
+
+				if ((y + count) > vBarPixelCount)
+					count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
+
+				while (count--)
+				{
+					*pDstPixel32 = colorBkg;
+					pDstPixel32++;
+				}
+
+				/*
+				 * if ((y >= vBarYOn) && (y < (vBarYOn + vBarShortPixelCount))),
+				 * use vBarShortPixels at index (y - shortVBarYOn)
+				 */
+
+				y = vBarYOn;
+				count = vBarShortPixelCount;
+
+				if ((y + count) > vBarPixelCount)
+					count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
+
+				pSrcPixel32 = &(vBarShortEntry->pixels[y - vBarYOn]);
+				CopyMemory(pDstPixel32, pSrcPixel32, count * 4);
+				pDstPixel32 += count;
+
+				/* if (y >= (vBarYOn + vBarShortPixelCount)), use colorBkg */
+
+				y = vBarYOn + vBarShortPixelCount;
+				count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
+
+				while (count--)
+				{
+					*pDstPixel32 = colorBkg;
+					pDstPixel32++;
+				}
+
+				vBarEntry->count = vBarPixelCount;
+				clear->VBarStorageCursor = (clear->VBarStorageCursor + 1) % 32768;
+			}
+
+			nXDstRel = nXDst + xStart;
+			nYDstRel = nYDst + yStart;
+
+			count = yEnd - yStart + 1;
+
+			if (vBarEntry->count != count)
+				return -1038;
+
+			if (clear->UseThreads)
+			{
+				if (!band)
+					band = clear_begin_band(clear, pDstData, nDstStep, nXDstRel + i, nYDstRel, count);
+
+				band->vBars[band->vBarCount++] = vBarEntry;
+				vBarEntry->bandBatch = clear->BandBatch;
+
+				if ((clear->BandVBarCount + band->vBarCount) >= CLEAR_BAND_VBAR_MAX)
+				{
+					clear_submit_band(clear, band);
+					band = NULL;
+				}
+
+				continue;
+			}
+
+			pSrcPixel32 = vBarEntry->pixels;
+			pDstPixel8 = &pDstData[(nYDstRel * nDstStep) + ((nXDstRel + i) * 4)];
+
+			for (y = 0; y < count; y++)
+			{
+				*((UINT32*) pDstPixel8) = *pSrcPixel32;
+				pDstPixel8 += nDstStep;
+				pSrcPixel32++;
+			}
+		}
+
+		if (band)
+		{
+			clear_submit_band(clear, band);
+			band = NULL;
+		}
+	}
+
+	return 1;
+}
+
 int clear_decompress(CLEAR_CONTEXT* clear, BYTE* pSrcData, UINT32 SrcSize,
 		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nXDst, int nYDst, int nWidth, int nHeight)
 {
@@ -78,7 +508,6 @@ int clear_decompress(CLEAR_CONTEXT* clear, BYTE* pSrcData, UINT32 SrcSize,
 	UINT32 pixelCount = 0;
 	BYTE* pSrcPixel8 = NULL;
 	BYTE* pDstPixel8 = NULL;
-	UINT32* pSrcPixel32 = NULL;
 	UINT32* pDstPixel32 = NULL;
 	CLEAR_GLYPH_ENTRY* glyphEntry;
 
@@ -260,266 +689,19 @@ int clear_decompress(CLEAR_CONTEXT* clear, BYTE* pSrcData, UINT32 SrcSize,
 
 	if (bandsByteCount > 0)
 	{
-		BYTE* bandsData;
-		UINT32 suboffset;
+		int status;
 
 		if ((SrcSize - offset) < bandsByteCount)
 			return -1020;
 
-		suboffset = 0;
-		bandsData = &pSrcData[offset];
-
-		while (suboffset < bandsByteCount)
-		{
-			UINT16 xStart;
-			UINT16 xEnd;
-			UINT16 yStart;
-			UINT16 yEnd;
-			BYTE* vBar;
-			BOOL vBarUpdate;
-			UINT32 colorBkg;
-			UINT16 vBarHeader;
-			UINT16 vBarIndex;
-			UINT16 vBarYOn;
-			UINT16 vBarYOff;
-			UINT32 vBarCount;
-			UINT32 vBarHeight;
-			UINT32 vBarPixelCount;
-			UINT32 vBarShortPixelCount;
-			CLEAR_VBAR_ENTRY* vBarEntry;
-			CLEAR_VBAR_ENTRY* vBarShortEntry;
-
-			if ((bandsByteCount - suboffset) < 11)
-				return -1021;
-
-			xStart = *((UINT16*) &bandsData[suboffset]);
-			xEnd = *((UINT16*) &bandsData[suboffset + 2]);
-			yStart = *((UINT16*) &bandsData[suboffset + 4]);
-			yEnd = *((UINT16*) &bandsData[suboffset + 6]);
-			suboffset += 8;
-
-			if (!invert)
-				colorBkg = RGB32(bandsData[suboffset + 2], bandsData[suboffset + 1], bandsData[suboffset + 0]);
-			else
-				colorBkg = BGR32(bandsData[suboffset + 2], bandsData[suboffset + 1], bandsData[suboffset + 0]);
-
-			suboffset += 3;
-
-			if (xEnd < xStart)
-				return -1022;
+		status = clear_decompress_bands(clear, &pSrcData[offset], bandsByteCount,
+				pDstData, nDstStep, nXDst, nYDst, invert);
 
-			if (yEnd < yStart)
-				return -1023;
-
-			vBarCount = (xEnd - xStart) + 1;
-
-			for (i = 0; i < vBarCount; i++)
-			{
-				vBarUpdate = FALSE;
-				vBar = &bandsData[suboffset];
-
-				if ((bandsByteCount - suboffset) < 2)
-					return -1024;
-
-				vBarHeader = *((UINT16*) &vBar[0]);
-				suboffset += 2;
-
-				vBarHeight = (yEnd - yStart + 1);
-
-				if (vBarHeight > 52)
-					return -1025;
-
-				if ((vBarHeader & 0xC000) == 0x4000) /* SHORT_VBAR_CACHE_HIT */
-				{
-					vBarIndex = (vBarHeader & 0x3FFF);
+		if (clear->UseThreads)
+			clear_wait_bands(clear);
 
-					if (vBarIndex >= 16384)
-						return -1026;
-
-					if ((bandsByteCount - suboffset) < 1)
-						return -1027;
-
-					vBarYOn = vBar[2];
-					suboffset += 1;
-
-					vBarShortEntry = &(clear->ShortVBarStorage[vBarIndex]);
-
-					if (!vBarShortEntry)
-						return -1028;
-
-					vBarShortPixelCount = vBarShortEntry->count;
-
-					vBarUpdate = TRUE;
-				}
-				else if ((vBarHeader & 0xC000) == 0x0000) /* SHORT_VBAR_CACHE_MISS */
-				{
-					vBarYOn = (vBarHeader & 0xFF);
-					vBarYOff = ((vBarHeader >> 8) & 0x3F);
-
-					if (vBarYOff < vBarYOn)
-						return -1029;
-
-					pSrcPixel8 = &vBar[2];
-					vBarShortPixelCount = (vBarYOff - vBarYOn);
-
-					if (vBarShortPixelCount > 52)
-						return -1030;
-
-					if ((bandsByteCount - suboffset) < (vBarShortPixelCount * 3))
-						return -1031;
-
-					if (clear->ShortVBarStorageCursor >= 16384)
-						return -1032;
-
-					vBarShortEntry = &(clear->ShortVBarStorage[clear->ShortVBarStorageCursor]);
-
-					vBarShortEntry->count = vBarShortPixelCount;
-
-					if (vBarShortEntry->count > vBarShortEntry->size)
-					{
-						UINT32 *tmp;
-						vBarShortEntry->size = vBarShortEntry->count;
-
-						tmp = (UINT32*) realloc(vBarShortEntry->pixels, vBarShortEntry->count * 4);
-						if (!tmp)
-							return -1;
-						vBarShortEntry->pixels = tmp;
-					}
-
-					if (!vBarShortEntry->pixels && vBarShortEntry->size)
-						return -1033;
-
-					pDstPixel32 = vBarShortEntry->pixels;
-
-					if (!invert)
-					{
-						for (y = 0; y < vBarShortPixelCount; y++)
-						{
-							*pDstPixel32 = RGB32(pSrcPixel8[2], pSrcPixel8[1], pSrcPixel8[0]);
-							pSrcPixel8 += 3;
-							pDstPixel32++;
-						}
-					}
-					else
-					{
-						for (y = 0; y < vBarShortPixelCount; y++)
-						{
-							*pDstPixel32 = BGR32(pSrcPixel8[2], pSrcPixel8[1], pSrcPixel8[0]);
-							pSrcPixel8 += 3;
-							pDstPixel32++;
-						}
-					}
-
-					suboffset += (vBarShortPixelCount * 3);
-
-					vBarShortEntry->count = vBarShortPixelCount;
-					clear->ShortVBarStorageCursor = (clear->ShortVBarStorageCursor + 1) % 16384;
-
-					vBarUpdate = TRUE;
-				}
-				else if ((vBarHeader & 0x8000) == 0x8000) /* VBAR_CACHE_HIT */
-				{
-					vBarIndex = (vBarHeader & 0x7FFF);
-
-					if (vBarIndex >= 32768)
-						return -1034;
-
-					vBarEntry = &(clear->VBarStorage[vBarIndex]);
-				}
-				else
-				{
-					return -1035; /* invalid vBarHeader */
-				}
-
-				if (vBarUpdate)
-				{
-					if (clear->VBarStorageCursor >= 32768)
-						return -1036;
-
-					vBarEntry = &(clear->VBarStorage[clear->VBarStorageCursor]);
-
-					vBarPixelCount = vBarHeight;
-					vBarEntry->count = vBarPixelCount;
-
-					if (vBarEntry->count > vBarEntry->size)
-					{
-						UINT32 *tmp;
-						vBarEntry->size = vBarEntry->count;
-
-						tmp = (UINT32*) realloc(vBarEntry->pixels, vBarEntry->count * 4);
-						if (!tmp)
-							return -1;
-						vBarEntry->pixels = tmp;
-					}
-
-					if (!vBarEntry->pixels && vBarEntry->size)
-						return -1037;
-
-					pDstPixel32 = vBarEntry->pixels;
-
-					/* if (y < vBarYOn), use colorBkg */
-
-					y = 0;
-					count = vBarYOn;
-
-					if ((y + count) > vBarPixelCount)
-						count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
-
-					while (count--)
-					{
-						*pDstPixel32 = colorBkg;
-						pDstPixel32++;
-					}
-
-					/*
-					 * if ((y >= vBarYOn) && (y < (vBarYOn + vBarShortPixelCount))),
-					 * use vBarShortPixels at index (y - shortVBarYOn)
-					 */
-
-					y = vBarYOn;
-					count = vBarShortPixelCount;
-
-					if ((y + count) > vBarPixelCount)
-						count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
-
-					pSrcPixel32 = &(vBarShortEntry->pixels[y - vBarYOn]);
-					CopyMemory(pDstPixel32, pSrcPixel32, count * 4);
-					pDstPixel32 += count;
-
-					/* if (y >= (vBarYOn + vBarShortPixelCount)), use colorBkg */
-
-					y = vBarYOn + vBarShortPixelCount;
-					count = (vBarPixelCount > y) ? (vBarPixelCount - y) : 0;
-
-					while (count--)
-					{
-						*pDstPixel32 = colorBkg;
-						pDstPixel32++;
-					}
-
-					vBarEntry->count = vBarPixelCount;
-					clear->VBarStorageCursor = (clear->VBarStorageCursor + 1) % 32768;
-				}
-
-				nXDstRel = nXDst + xStart;
-				nYDstRel = nYDst + yStart;
-
-				pSrcPixel32 = vBarEntry->pixels;
-				pDstPixel8 = &pDstData[(nYDstRel * nDstStep) + ((nXDstRel + i) * 4)];
-
-				count = yEnd - yStart + 1;
-
-				if (vBarEntry->count != count)
-					return -1038;
-
-				for (y = 0; y < count; y++)
-				{
-					*((UINT32*) pDstPixel8) = *pSrcPixel32;
-					pDstPixel8 += nDstStep;
-					pSrcPixel32++;
-				}
-			}
-		}
+		if (status < 0)
+			return status;
 
 		offset += bandsByteCount;
 	}
@@ -838,6 +1020,90 @@ int clear_context_reset(CLEAR_CONTEXT* clear)
 	return 1;
 }
 
+/**
+ * Bands are composed on a thread pool unless UseThreads is 0 under CLEAR_KEY, which sizes it
+ * with MinThreadCount and MaxThreadCount like RemoteFX does, by default a thread per processor.
+ */
+static BOOL clear_context_init_threads(CLEAR_CONTEXT* clear)
+{
+	HKEY hKey;
+	LONG status;
+	DWORD dwType;
+	DWORD dwSize;
+	DWORD dwValue;
+	SYSTEM_INFO sysinfo;
+
+	clear->UseThreads = TRUE;
+
+	GetNativeSystemInfo(&sysinfo);
+
+	clear->MinThreadCount = sysinfo.dwNumberOfProcessors;
+	clear->MaxThreadCount = 0;
+
+	status = RegOpenKeyExA(HKEY_LOCAL_MACHINE, CLEAR_KEY, 0, KEY_READ | KEY_WOW64_64KEY, &hKey);
+
+	if (status == ERROR_SUCCESS)
+	{
+		dwSize = sizeof(dwValue);
+
+		if (RegQueryValueEx(hKey, _T("UseThreads"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			clear->UseThreads = dwValue ? 1 : 0;
+
+		if (RegQueryValueEx(hKey, _T("MinThreadCount"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			clear->MinThreadCount = dwValue;
+
+		if (RegQueryValueEx(hKey, _T("MaxThreadCount"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			clear->MaxThreadCount = dwValue;
+
+		RegCloseKey(hKey);
+	}
+
+	if (!clear->UseThreads)
+		return TRUE;
+
+	/* the stamps of the vBars are 0 until a band reads them */
+	clear->BandBatch = 1;
+
+	clear->BandWorkObjects = (PTP_WORK*) calloc(CLEAR_BAND_WORK_MAX, sizeof(PTP_WORK));
+	clear->BandWorkParams = (CLEAR_BAND_WORK_PARAM*) calloc(CLEAR_BAND_WORK_MAX, sizeof(CLEAR_BAND_WORK_PARAM));
+	clear->BandVBars = (CLEAR_VBAR_ENTRY**) calloc(CLEAR_BAND_VBAR_MAX, sizeof(CLEAR_VBAR_ENTRY*));
+
+	if (!clear->BandWorkObjects || !clear->BandWorkParams || !clear->BandVBars)
+		goto error_bands;
+
+	clear->ThreadPool = CreateThreadpool(NULL);
+
+	if (!clear->ThreadPool)
+		goto error_bands;
+
+	InitializeThreadpoolEnvironment(&clear->ThreadPoolEnv);
+	SetThreadpoolCallbackPool(&clear->ThreadPoolEnv, clear->ThreadPool);
+
+	if (clear->MinThreadCount)
+	{
+		if (!SetThreadpoolThreadMinimum(clear->ThreadPool, clear->MinThreadCount))
+			goto error_threadPool_minimum;
+	}
+
+	if (clear->MaxThreadCount)
+		SetThreadpoolThreadMaximum(clear->ThreadPool, clear->MaxThreadCount);
+
+	return TRUE;
+
+error_threadPool_minimum:
+	CloseThreadpool(clear->ThreadPool);
+	DestroyThreadpoolEnvironment(&clear->ThreadPoolEnv);
+	clear->ThreadPool = NULL;
+error_bands:
+	free(clear->BandWorkObjects);
+	free(clear->BandWorkParams);
+	free(clear->BandVBars);
+	clear->BandWorkObjects = NULL;
+	clear->BandWorkParams = NULL;
+	clear->BandVBars = NULL;
+	return FALSE;
+}
+
 CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 {
 	CLEAR_CONTEXT* clear;
@@ -860,10 +1126,15 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear->TempBuffer)
 		goto error_temp_buffer;
 
+	if (!Compressor && !clear_context_init_threads(clear))
+		goto error_threads;
+
 	clear_context_reset(clear);
 
 	return clear;
 
+error_threads:
+	free(clear->TempBuffer);
 error_temp_buffer:
 	nsc_context_free(clear->nsc);
 error_nsc:
@@ -880,6 +1151,16 @@ void clear_context_free(CLEAR_CONTEXT* clear)
 
 	nsc_context_free(clear->nsc);
 
+	if (clear->ThreadPool)
+	{
+		CloseThreadpool(clear->ThreadPool);
+		DestroyThreadpoolEnvironment(&clear->ThreadPoolEnv);
+	}
+
+	free(clear->BandWorkObjects);
+	free(clear->BandWorkParams);
+	free(clear->BandVBars);
+
 	free(clear->TempBuffer);
 
 	for (i = 0; i < 4000; i++)
@@ -22,15 +22,25 @@
 #endif
 
 #include <winpr/crt.h>
+#include <winpr/interlocked.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
+#include <winpr/registry.h>
+#include <winpr/stream.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/codec/h264.h>
+#include <freerdp/codec/region.h>
 #include <freerdp/log.h>
 
+#include "parallel.h"
+
 #define TAG FREERDP_TAG("codec")
 
+#define H264_KEY "Software\\"FREERDP_VENDOR_STRING"\\" \
+		     FREERDP_PRODUCT_STRING"\\H264"
+
 /**
  * Dummy subsystem
  */
@@ -1198,6 +1208,7 @@ struct _H264_CONTEXT_LIBAVCODEC
 	AVCodecContext* codecContext;
 	AVCodecParserContext* codecParser;
 	AVFrame* videoFrame;
+	AVPacket packet;
 };
 typedef struct _H264_CONTEXT_LIBAVCODEC H264_CONTEXT_LIBAVCODEC;
 
@@ -1205,15 +1216,15 @@ static int libavcodec_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcS
 {
 	int status;
 	int gotFrame = 0;
-	AVPacket packet;
 	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*) h264->pSystemData;
 
-	av_init_packet(&packet);
+	sys->packet.data = pSrcData;
+	sys->packet.size = SrcSize;
 
-	packet.data = pSrcData;
-	packet.size = SrcSize;
+	/* passed on to the frame decoded from the packet, however late it is returned */
+	sys->codecContext->reordered_opaque = h264->InputFrameId;
 
-	status = avcodec_decode_video2(sys->codecContext, sys->videoFrame, &gotFrame, &packet);
+	status = avcodec_decode_video2(sys->codecContext, sys->videoFrame, &gotFrame, &sys->packet);
 
 	if (status < 0)
 	{
@@ -1229,21 +1240,22 @@ static int libavcodec_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcS
 		sys->videoFrame->data[2], sys->videoFrame->linesize[2]);
 #endif
 
-	if (gotFrame)
-	{
-		h264->pYUVData[0] = sys->videoFrame->data[0];
-		h264->pYUVData[1] = sys->videoFrame->data[1];
-		h264->pYUVData[2] = sys->videoFrame->data[2];
+	/* a frame threaded decoder holds the first frames back until its threads are busy */
+	if (!gotFrame)
+		return 0;
 
-		h264->iStride[0] = sys->videoFrame->linesize[0];
-		h264->iStride[1] = sys->videoFrame->linesize[1];
-		h264->iStride[2] = sys->videoFrame->linesize[2];
+	h264->pYUVData[0] = sys->videoFrame->data[0];
+	h264->pYUVData[1] = sys->videoFrame->data[1];
+	h264->pYUVData[2] = sys->videoFrame->data[2];
 
-		h264->width = sys->videoFrame->width;
-		h264->height = sys->videoFrame->height;
-	}
-	else
-		return -2;
+	h264->iStride[0] = sys->videoFrame->linesize[0];
+	h264->iStride[1] = sys->videoFrame->linesize[1];
+	h264->iStride[2] = sys->videoFrame->linesize[2];
+
+	h264->width = sys->videoFrame->width;
+	h264->height = sys->videoFrame->height;
+
+	h264->OutputFrameId = (UINT32) sys->videoFrame->reordered_opaque;
 
 	return 1;
 }
@@ -1277,6 +1289,7 @@ static void libavcodec_uninit(H264_CONTEXT* h264)
 
 static BOOL libavcodec_init(H264_CONTEXT* h264)
 {
+	SYSTEM_INFO sysinfo;
 	H264_CONTEXT_LIBAVCODEC* sys;
 
 	sys = (H264_CONTEXT_LIBAVCODEC*) calloc(1, sizeof(H264_CONTEXT_LIBAVCODEC));
@@ -1306,9 +1319,33 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 		goto EXCEPTION;
 	}
 
-	if (sys->codec->capabilities & CODEC_CAP_TRUNCATED)
+	GetNativeSystemInfo(&sysinfo);
+
+	sys->codecContext->thread_count = h264->NumberOfThreads ? h264->NumberOfThreads : sysinfo.dwNumberOfProcessors;
+
+	/**
+	 * Slice threading decodes the slices of a frame in parallel and returns it from the call it
+	 * was passed to, frame threading returns each frame thread_count - 1 calls late. libavcodec
+	 * quietly falls back to slice threading on truncated or low delay input, which RDP doesn't
+	 * need as each packet holds a whole frame.
+	 */
+	if (h264->FrameThreading)
 	{
-		sys->codecContext->flags |= CODEC_FLAG_TRUNCATED;
+		sys->codecContext->thread_type = FF_THREAD_FRAME;
+	}
+	else
+	{
+		sys->codecContext->thread_type = FF_THREAD_SLICE;
+
+		if (sys->codec->capabilities & CODEC_CAP_TRUNCATED)
+		{
+			sys->codecContext->flags |= CODEC_FLAG_TRUNCATED;
+		}
+
+		if (h264->LowDelay)
+		{
+			sys->codecContext->flags |= CODEC_FLAG_LOW_DELAY;
+		}
 	}
 
 	if (avcodec_open2(sys->codecContext, sys->codec, NULL) < 0)
@@ -1317,6 +1354,11 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 		goto EXCEPTION;
 	}
 
+	h264->DelayedOutput = (sys->codecContext->active_thread_type & FF_THREAD_FRAME) ? TRUE : FALSE;
+
+	WLog_DBG(TAG, "libav H.264 decoder: %d threads, %s threading%s", sys->codecContext->thread_count,
+		h264->DelayedOutput ? "frame" : "slice", (sys->codecContext->flags & CODEC_FLAG_LOW_DELAY) ? ", low delay" : "");
+
 	sys->codecParser = av_parser_init(CODEC_ID_H264);
 
 	if (!sys->codecParser)
@@ -1333,6 +1375,8 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 		goto EXCEPTION;
 	}
 
+	av_init_packet(&sys->packet);
+
 	return TRUE;
 
 EXCEPTION:
@@ -1351,21 +1395,302 @@ static H264_CONTEXT_SUBSYSTEM g_Subsystem_libavcodec =
 
 #endif
 
+/**
+ * Region conversion
+ *
+ * The regions are converted in bands of H264_BAND_HEIGHT rows, on the default thread pool once
+ * there are H264_PARALLEL_MIN_PIXELS to convert. The bands start at an even offset from the top
+ * of their region, so the rows sharing a chroma row in a YUV420 frame stay in the same band and
+ * the output is the same as when the region is converted at once.
+ */
+
+#define H264_BAND_HEIGHT		64
+#define H264_PARALLEL_MIN_PIXELS	(256 * 256)
+
+struct _H264_BAND_WORK
+{
+	H264_CONTEXT* h264;
+	RECTANGLE_16* bands;
+	UINT32 numBands;
+	BOOL yuv444;
+	BYTE* pDstData;
+	int nDstStep;
+	const BYTE* pSrc[3];
+	int srcStep[3];
+};
+typedef struct _H264_BAND_WORK H264_BAND_WORK;
+
+static BOOL h264_split_bands(H264_BAND_WORK* work, const RECTANGLE_16* rects, UINT32 numRects, UINT32* pPixels)
+{
+	UINT32 index;
+	UINT32 top;
+	UINT32 count = 0;
+	RECTANGLE_16* band;
+
+	*pPixels = 0;
+
+	for (index = 0; index < numRects; index++)
+	{
+		if (rects[index].bottom > rects[index].top)
+			count += (rects[index].bottom - rects[index].top + H264_BAND_HEIGHT - 1) / H264_BAND_HEIGHT;
+	}
+
+	work->bands = NULL;
+	work->numBands = 0;
+
+	if (!count)
+		return TRUE;
+
+	work->bands = (RECTANGLE_16*) malloc(count * sizeof(RECTANGLE_16));
+
+	if (!work->bands)
+		return FALSE;
+
+	for (index = 0; index < numRects; index++)
+	{
+		for (top = rects[index].top; top < rects[index].bottom; top += H264_BAND_HEIGHT)
+		{
+			band = &work->bands[work->numBands++];
+			*band = rects[index];
+			band->top = top;
+
+			if (top + H264_BAND_HEIGHT < band->bottom)
+				band->bottom = top + H264_BAND_HEIGHT;
+
+			*pPixels += (band->right - band->left) * (band->bottom - band->top);
+		}
+	}
+
+	return TRUE;
+}
+
+static void h264_convert_band(void* param, UINT32 index)
+{
+	int* iStride;
+	BYTE** pYUVData;
+	BYTE* pYUVPoint[3];
+	BYTE* pDstPoint;
+	prim_size_t roi;
+	H264_BAND_WORK* work = (H264_BAND_WORK*) param;
+	RECTANGLE_16* band = &work->bands[index];
+	primitives_t* prims = primitives_get();
+
+	pDstPoint = work->pDstData + band->top * work->nDstStep + band->left * 4;
+	roi.width = band->right - band->left;
+	roi.height = band->bottom - band->top;
+
+	if (work->yuv444)
+	{
+		pYUVData = work->h264->pYUV444Data;
+		iStride = work->h264->iYUV444Stride;
+
+		pYUVPoint[0] = pYUVData[0] + band->top * iStride[0] + band->left;
+		pYUVPoint[1] = pYUVData[1] + band->top * iStride[1] + band->left;
+		pYUVPoint[2] = pYUVData[2] + band->top * iStride[2] + band->left;
+
+		prims->YUV444ToRGB_8u_P3AC4R((const BYTE**) pYUVPoint, iStride, pDstPoint, work->nDstStep, &roi);
+	}
+	else
+	{
+		pYUVData = work->h264->pYUVData;
+		iStride = work->h264->iStride;
+
+		pYUVPoint[0] = pYUVData[0] + band->top * iStride[0] + band->left;
+		pYUVPoint[1] = pYUVData[1] + band->top/2 * iStride[1] + band->left/2;
+		pYUVPoint[2] = pYUVData[2] + band->top/2 * iStride[2] + band->left/2;
+
+		prims->YUV420ToRGB_8u_P3AC4R((const BYTE**) pYUVPoint, iStride, pDstPoint, work->nDstStep, &roi);
+	}
+}
+
+static void h264_run_bands(H264_BAND_WORK* work, UINT32 pixels, CODEC_PARALLEL_FN fn)
+{
+	codec_parallel_for(NULL, (pixels < H264_PARALLEL_MIN_PIXELS) ? 1 : 0,
+		work->numBands, fn, (void*) work, NULL, NULL);
+}
+
+/**
+ * With ZeroCopy off the planes are copied out of the decoder before they are converted. The rows
+ * are copied up to the next macroblock, which the AVC444 auxiliary view reads past the height.
+ */
+static BOOL h264_copy_planes(H264_CONTEXT* h264)
+{
+	int index;
+	UINT32 size;
+	BYTE* pData;
+	UINT32 height = (h264->height + 15) & ~15;
+
+	for (index = 0; index < 3; index++)
+	{
+		size = h264->iStride[index] * (index ? height / 2 : height);
+
+		if (size > h264->YUVCopySize[index])
+		{
+			pData = (BYTE*) realloc(h264->pYUVCopyData[index], size);
+
+			if (!pData)
+				return FALSE;
+
+			h264->pYUVCopyData[index] = pData;
+			h264->YUVCopySize[index] = size;
+		}
+
+		CopyMemory(h264->pYUVCopyData[index], h264->pYUVData[index], size);
+		h264->pYUVData[index] = h264->pYUVCopyData[index];
+	}
+
+	return TRUE;
+}
+
+/**
+ * The rects come from the server, they have to lie within the planes they are read from, the
+ * decoded frame or the YUV444 planes, and within the destination buffer.
+ */
+static int h264_check_rects(RDPGFX_RECT16* regionRects, int numRegionRects, UINT32 frameWidth,
+		UINT32 frameHeight, int nDstWidth, int nDstHeight)
+{
+	int index;
+	RDPGFX_RECT16* rect;
+
+	for (index = 0; index < numRegionRects; index++)
+	{
+		rect = &(regionRects[index]);
+
+		/* Check, if the output rectangle is valid in decoded h264 frame. */
+		if ((rect->right > frameWidth) || (rect->left > rect->right))
+			return -1003;
+		if ((rect->bottom > frameHeight) || (rect->top > rect->bottom))
+			return -1004;
+
+		/* Check, if the output rectangle is valid in destination buffer. */
+		if ((rect->right > nDstWidth) || (rect->left > nDstWidth))
+			return -1005;
+		if ((rect->bottom > nDstHeight) || (rect->top > nDstHeight))
+			return -1006;
+	}
+
+	return 1;
+}
+
+static BOOL h264_set_output_rects(H264_CONTEXT* h264, const RDPGFX_RECT16* rects, UINT32 numRects)
+{
+	RDPGFX_RECT16* newRects;
+
+	if (numRects > h264->OutputRectsSize)
+	{
+		newRects = (RDPGFX_RECT16*) realloc(h264->OutputRects, numRects * sizeof(RDPGFX_RECT16));
+
+		if (!newRects)
+			return FALSE;
+
+		h264->OutputRects = newRects;
+		h264->OutputRectsSize = numRects;
+	}
+
+	if (numRects)
+		CopyMemory(h264->OutputRects, rects, numRects * sizeof(RDPGFX_RECT16));
+
+	h264->numOutputRects = numRects;
+	return TRUE;
+}
+
+/**
+ * With DelayedOutput the regions of each packet are kept until the decoder returns its frame. A
+ * frame the decoder drops is never returned, the oldest regions give way once the queue is full.
+ */
+static BOOL h264_queue_frame(H264_CONTEXT* h264, const RDPGFX_RECT16* rects, UINT32 numRects)
+{
+	H264_PENDING_FRAME* frame;
+
+	if (h264->numPendingFrames == H264_PENDING_FRAMES_MAX)
+	{
+		free(h264->PendingFrames[0].rects);
+		MoveMemory(&h264->PendingFrames[0], &h264->PendingFrames[1],
+			(H264_PENDING_FRAMES_MAX - 1) * sizeof(H264_PENDING_FRAME));
+		h264->numPendingFrames--;
+	}
+
+	frame = &h264->PendingFrames[h264->numPendingFrames];
+	frame->rects = (RDPGFX_RECT16*) malloc(numRects ? numRects * sizeof(RDPGFX_RECT16) : 1);
+
+	if (!frame->rects)
+		return FALSE;
+
+	if (numRects)
+		CopyMemory(frame->rects, rects, numRects * sizeof(RDPGFX_RECT16));
+
+	frame->numRects = numRects;
+	frame->frameId = h264->InputFrameId;
+	h264->numPendingFrames++;
+	return TRUE;
+}
+
+/**
+ * Makes the regions of the returned frame the output ones, FALSE if they have given way.
+ */
+static BOOL h264_take_frame(H264_CONTEXT* h264, UINT32 frameId)
+{
+	UINT32 index;
+	BOOL status;
+	H264_PENDING_FRAME* frame;
+
+	for (index = 0; index < h264->numPendingFrames; index++)
+	{
+		frame = &h264->PendingFrames[index];
+
+		if (frame->frameId != frameId)
+			continue;
+
+		status = h264_set_output_rects(h264, frame->rects, frame->numRects);
+
+		free(frame->rects);
+		MoveMemory(frame, frame + 1, (h264->numPendingFrames - index - 1) * sizeof(H264_PENDING_FRAME));
+		h264->numPendingFrames--;
+
+		return status;
+	}
+
+	return FALSE;
+}
+
+static void h264_clear_pending_frames(H264_CONTEXT* h264)
+{
+	UINT32 index;
+
+	for (index = 0; index < h264->numPendingFrames; index++)
+		free(h264->PendingFrames[index].rects);
+
+	h264->numPendingFrames = 0;
+}
+
+static int h264_convert_rects(H264_CONTEXT* h264, BOOL yuv444, RDPGFX_RECT16* regionRects, int numRegionRects,
+		BYTE* pDstData, int nDstStep)
+{
+	UINT32 pixels;
+	H264_BAND_WORK work;
+
+	ZeroMemory(&work, sizeof(work));
+	work.h264 = h264;
+	work.yuv444 = yuv444;
+	work.pDstData = pDstData;
+	work.nDstStep = nDstStep;
+
+	if (!h264_split_bands(&work, (RECTANGLE_16*) regionRects, numRegionRects, &pixels))
+		return -1007;
+
+	h264_run_bands(&work, pixels, h264_convert_band);
+
+	free(work.bands);
+	return 1;
+}
+
 int h264_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcSize,
 		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nDstWidth,
 		int nDstHeight, RDPGFX_RECT16* regionRects, int numRegionRects)
 {
-	int index;
 	int status;
-	int* iStride;
 	BYTE* pDstData;
-	BYTE* pDstPoint;
-	prim_size_t roi;
-	BYTE** pYUVData;
-	int width, height;
-	BYTE* pYUVPoint[3];
-	RDPGFX_RECT16* rect;
-	primitives_t* prims = primitives_get();
+	RDPGFX_RECT16 frameRect;
 
 	if (!h264)
 		return -1001;
@@ -1378,7 +1703,14 @@ int h264_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcSize,
 	if (!(pDstData = *ppDstData))
 		return -1002;
 
+	h264->numOutputRects = 0;
+	h264->OutputFrameId = h264->InputFrameId;
+
+	if (h264->DelayedOutput && !h264_queue_frame(h264, regionRects, numRegionRects))
+		return -1007;
+
 	status = h264->subsystem->Decompress(h264, pSrcData, SrcSize);
+	h264->InputFrameId++;
 
 	if (status == 0)
 		return 1;
@@ -1386,43 +1718,243 @@ int h264_decompress(H264_CONTEXT* h264, BYTE* pSrcData, UINT32 SrcSize,
 	if (status < 0)
 		return status;
 
-	pYUVData = h264->pYUVData;
-	iStride = h264->iStride;
+	if (!h264->ZeroCopy && !h264_copy_planes(h264))
+		return -1007;
 
-	for (index = 0; index < numRegionRects; index++)
+	if (!h264->DelayedOutput)
 	{
-		rect = &(regionRects[index]);
+		if (!h264_set_output_rects(h264, regionRects, numRegionRects))
+			return -1007;
+	}
+	else if (!h264_take_frame(h264, h264->OutputFrameId))
+	{
+		/* the regions of the frame are lost, it is converted whole */
+		frameRect.left = 0;
+		frameRect.top = 0;
+		frameRect.right = MIN(h264->width, (UINT32) nDstWidth);
+		frameRect.bottom = MIN(h264->height, (UINT32) nDstHeight);
+
+		if (!h264_set_output_rects(h264, &frameRect, 1))
+			return -1007;
+	}
 
-		/* Check, if the output rectangle is valid in decoded h264 frame. */
-		if ((rect->right > h264->width) || (rect->left > h264->width))
-			return -1003;
-		if ((rect->top > h264->height) || (rect->bottom > h264->height))
-			return -1004;
+	status = h264_check_rects(h264->OutputRects, h264->numOutputRects, h264->width, h264->height,
+			nDstWidth, nDstHeight);
 
-		/* Check, if the output rectangle is valid in destination buffer. */
-		if ((rect->right > nDstWidth) || (rect->left > nDstWidth))
-			return -1005;
-		if ((rect->bottom > nDstHeight) || (rect->top > nDstHeight))
-			return -1006;
+	if (status < 0)
+	{
+		h264->numOutputRects = 0;
+		return status;
+	}
 
-		width = rect->right - rect->left;
-		height = rect->bottom - rect->top;
-		
-		pDstPoint = pDstData + rect->top * nDstStep + rect->left * 4;
-		pYUVPoint[0] = pYUVData[0] + rect->top * iStride[0] + rect->left;
+	return h264_convert_rects(h264, FALSE, h264->OutputRects, h264->numOutputRects, pDstData, nDstStep);
+}
 
-		pYUVPoint[1] = pYUVData[1] + rect->top/2 * iStride[1] + rect->left/2;
-		pYUVPoint[2] = pYUVData[2] + rect->top/2 * iStride[2] + rect->left/2;
+/**
+ * AVC444
+ *
+ * Both views are decoded by the same decoder, as the server encodes them as one stream. Each is
+ * merged into the full resolution planes of the context right away, as the decoder reuses its
+ * output buffers, and only the regions it updates. A luma only frame leaves the regions it updates
+ * with the averaged chroma until an auxiliary view follows.
+ */
 
-#if 0
-		WLog_INFO(TAG, "regionRect: x: %d y: %d width: %d height: %d",
-		       rect->left, rect->top, width, height);
-#endif
+static BOOL h264_ensure_yuv444(H264_CONTEXT* h264)
+{
+	int index;
+	UINT32 width = (h264->width + 1) & ~1;
+	UINT32 height = (h264->height + 1) & ~1;
+
+	if (h264->pYUV444Data[0] && (h264->YUV444Width == width) && (h264->YUV444Height == height))
+		return TRUE;
+
+	for (index = 0; index < 3; index++)
+	{
+		free(h264->pYUV444Data[index]);
+		h264->pYUV444Data[index] = NULL;
+	}
+
+	h264->YUV444Width = width;
+	h264->YUV444Height = height;
+
+	for (index = 0; index < 3; index++)
+	{
+		h264->iYUV444Stride[index] = width;
+		h264->pYUV444Data[index] = (BYTE*) calloc(1, width * height);
+
+		if (!h264->pYUV444Data[index])
+			return FALSE;
+	}
+
+	/* mid grey chroma until the first views arrive */
+	FillMemory(h264->pYUV444Data[1], width * height, 0x80);
+	FillMemory(h264->pYUV444Data[2], width * height, 0x80);
+
+	return TRUE;
+}
+
+static void h264_combine_band(void* param, UINT32 index)
+{
+	H264_BAND_WORK* work = (H264_BAND_WORK*) param;
+	primitives_t* prims = primitives_get();
+
+	if (work->yuv444)
+	{
+		prims->AVC444ChromaToYUV444_8u_P3P3(work->pSrc, work->srcStep,
+			work->h264->pYUV444Data, work->h264->iYUV444Stride, &work->bands[index]);
+	}
+	else
+	{
+		prims->AVC444LumaToYUV444_8u_P3P3(work->pSrc, work->srcStep,
+			work->h264->pYUV444Data, work->h264->iYUV444Stride, &work->bands[index]);
+	}
+}
+
+static int h264_decompress_view(H264_CONTEXT* h264, RDPGFX_H264_BITMAP_STREAM* stream, BOOL chroma,
+		int nDstWidth, int nDstHeight)
+{
+	int index;
+	int status;
+	int nbRects;
+	UINT32 pixels;
+	REGION16 region;
+	RECTANGLE_16 rect;
+	const RECTANGLE_16* rects;
+	H264_BAND_WORK work;
+
+	status = h264->subsystem->Decompress(h264, stream->data, stream->length);
+
+	if (status <= 0)
+		return status;
+
+	if (!h264->ZeroCopy && !h264_copy_planes(h264))
+		return -1007;
+
+	status = h264_check_rects(stream->meta.regionRects, stream->meta.numRegionRects, h264->width, h264->height,
+			nDstWidth, nDstHeight);
+
+	if (status < 0)
+		return status;
+
+	if (!h264_ensure_yuv444(h264))
+		return -1007;
+
+	/**
+	 * The views cover whole 2x2 blocks and the chroma filter may not run twice over the same
+	 * block, the rects are widened to even coordinates and merged so they no longer overlap.
+	 * The auxiliary luma rows of the last blocks may lie past the height of the frame, in the
+	 * macroblock padding the decoders keep below it. The widened rects are clipped to the YUV444
+	 * planes, which are as large as the frame rounded up to even.
+	 */
+	region16_init(&region);
+
+	for (index = 0; index < (int) stream->meta.numRegionRects; index++)
+	{
+		rect = *((RECTANGLE_16*) &stream->meta.regionRects[index]);
+		rect.left &= ~1;
+		rect.top &= ~1;
+		rect.right = (rect.right + 1) & ~1;
+		rect.bottom = (rect.bottom + 1) & ~1;
+		rect.right = MIN(rect.right, h264->YUV444Width);
+		rect.bottom = MIN(rect.bottom, h264->YUV444Height);
+
+		if ((rect.left < rect.right) && (rect.top < rect.bottom) &&
+			!region16_union_rect(&region, &region, &rect))
+		{
+			region16_uninit(&region);
+			return -1007;
+		}
+	}
 
-		roi.width = width;
-		roi.height = height;
+	rects = region16_rects(&region, &nbRects);
 
-		prims->YUV420ToRGB_8u_P3AC4R((const BYTE**) pYUVPoint, iStride, pDstPoint, nDstStep, &roi);
+	ZeroMemory(&work, sizeof(work));
+	work.h264 = h264;
+	work.yuv444 = chroma;
+
+	for (index = 0; index < 3; index++)
+	{
+		work.pSrc[index] = h264->pYUVData[index];
+		work.srcStep[index] = h264->iStride[index];
+	}
+
+	if (!h264_split_bands(&work, rects, nbRects, &pixels))
+	{
+		region16_uninit(&region);
+		return -1007;
+	}
+
+	h264_run_bands(&work, pixels, h264_combine_band);
+
+	free(work.bands);
+	region16_uninit(&region);
+	return 1;
+}
+
+int h264_decompress_avc444(H264_CONTEXT* h264, RDPGFX_AVC444_BITMAP_STREAM* bs,
+		BYTE** ppDstData, DWORD DstFormat, int nDstStep, int nDstWidth, int nDstHeight)
+{
+	int status;
+	UINT32 index;
+	BOOL chroma;
+	BOOL decoded = FALSE;
+	BYTE* pDstData;
+	RDPGFX_H264_BITMAP_STREAM* stream;
+
+	if (!h264 || !bs)
+		return -1001;
+
+	if (!(pDstData = *ppDstData))
+		return -1002;
+
+	/**
+	 * A late frame could belong to the other view. The decoder of a surface advertising AVC444 is
+	 * created without frame threading, opening it again now would lose the reference frames.
+	 */
+	if (h264->DelayedOutput)
+	{
+		WLog_ERR(TAG, "AVC444 can't be decoded with frame threading");
+		return -1008;
+	}
+
+	for (index = 0; index < bs->numStreams; index++)
+	{
+		stream = &bs->bitstream[index];
+		chroma = (bs->LC == RDPGFX_AVC444_LC_CHROMA) || (index > 0);
+
+		status = h264_decompress_view(h264, stream, chroma, nDstWidth, nDstHeight);
+
+		if (status < 0)
+			return status;
+
+		if (status > 0)
+			decoded = TRUE;
+	}
+
+	if (!decoded)
+		return 1;
+
+	/* a view without a frame has not checked its rects, and a later view may have resized the planes */
+	for (index = 0; index < bs->numStreams; index++)
+	{
+		stream = &bs->bitstream[index];
+
+		status = h264_check_rects(stream->meta.regionRects, stream->meta.numRegionRects,
+				h264->YUV444Width, h264->YUV444Height, nDstWidth, nDstHeight);
+
+		if (status < 0)
+			return status;
+	}
+
+	for (index = 0; index < bs->numStreams; index++)
+	{
+		stream = &bs->bitstream[index];
+
+		status = h264_convert_rects(h264, TRUE, stream->meta.regionRects, stream->meta.numRegionRects,
+				pDstData, nDstStep);
+
+		if (status < 0)
+			return status;
 	}
 
 	return 1;
@@ -1514,11 +2046,163 @@ BOOL h264_context_init(H264_CONTEXT* h264)
 	return FALSE;
 }
 
+/* the trace file is written from the start of the stream of a single decoder */
+static LONG g_h264_trace_claimed = 0;
+
+/**
+ * With TraceFile set under H264_KEY, the first decoder given an AVC420 bitmap stream writes it and
+ * every later one to that file, each as a little endian UINT32 length and the stream as it came in
+ * the surface command: numRegionRects, the rects, the qpVal and qualityVal pairs and the H.264 data.
+ * TestFreeRDPCodecH264Benchmark decodes such a trace.
+ */
+BOOL h264_trace_bitmap_stream(H264_CONTEXT* h264, RDPGFX_H264_BITMAP_STREAM* bs)
+{
+	UINT32 index;
+	UINT32 length;
+	wStream* s;
+	BOOL success;
+	RDPGFX_RECT16* rect;
+	RDPGFX_H264_QUANT_QUALITY* quant;
+
+	if (!h264 || !bs)
+		return FALSE;
+
+	if (!h264->TraceFile)
+	{
+		if (!h264->TraceFileName)
+			return TRUE;
+
+		/* another decoder records the trace already */
+		if (InterlockedCompareExchange(&g_h264_trace_claimed, 1, 0) != 0)
+		{
+			free(h264->TraceFileName);
+			h264->TraceFileName = NULL;
+			return TRUE;
+		}
+
+		h264->TraceFile = fopen(h264->TraceFileName, "wb");
+
+		if (!h264->TraceFile)
+			WLog_ERR(TAG, "failed to open H.264 trace %s", h264->TraceFileName);
+
+		free(h264->TraceFileName);
+		h264->TraceFileName = NULL;
+
+		if (!h264->TraceFile)
+			return FALSE;
+	}
+
+	length = 4 + (bs->meta.numRegionRects * 10) + bs->length;
+	s = Stream_New(NULL, 4 + length);
+
+	if (!s)
+		return FALSE;
+
+	Stream_Write_UINT32(s, length);
+	Stream_Write_UINT32(s, bs->meta.numRegionRects);
+
+	for (index = 0; index < bs->meta.numRegionRects; index++)
+	{
+		rect = &(bs->meta.regionRects[index]);
+		Stream_Write_UINT16(s, rect->left);
+		Stream_Write_UINT16(s, rect->top);
+		Stream_Write_UINT16(s, rect->right);
+		Stream_Write_UINT16(s, rect->bottom);
+	}
+
+	for (index = 0; index < bs->meta.numRegionRects; index++)
+	{
+		quant = &(bs->meta.quantQualityVals[index]);
+		Stream_Write_UINT8(s, quant->qpVal);
+		Stream_Write_UINT8(s, quant->qualityVal);
+	}
+
+	Stream_Write(s, bs->data, bs->length);
+
+	success = (fwrite(Stream_Buffer(s), 1, Stream_GetPosition(s), h264->TraceFile) == Stream_GetPosition(s));
+	Stream_Free(s, TRUE);
+
+	if (!success)
+		WLog_ERR(TAG, "failed to write H.264 trace");
+
+	return success;
+}
+
 int h264_context_reset(H264_CONTEXT* h264)
 {
+	if (!h264)
+		return -1;
+
+	h264->subsystem->Uninit(h264);
+
+	h264->subsystem = &g_Subsystem_dummy;
+	h264->DelayedOutput = FALSE;
+
+	/* the frames held by the decoder are gone with it */
+	h264_clear_pending_frames(h264);
+	h264->InputFrameId = 0;
+	h264->OutputFrameId = 0;
+
+	h264->pYUVData[0] = NULL;
+	h264->pYUVData[1] = NULL;
+	h264->pYUVData[2] = NULL;
+
+	if (!h264_context_init(h264))
+		return -1;
+
 	return 1;
 }
 
+/**
+ * The decoder uses slice threading on a thread per processor by default. Under H264_KEY,
+ * DecoderThreads sets the number of threads and LowDelay and ZeroCopy turn the settings of the
+ * same name on or off. TraceFile records the stream, see h264_trace_bitmap_stream.
+ *
+ * FrameThreading is left off. It holds back the last frames until more packets come, and nothing
+ * drains them: flushing libavcodec drops the reference frames the next packets need. The final
+ * frames of every update burst would stay on screen late while their acknowledgements went out,
+ * so only a benchmark decoding a whole recorded stream turns it on.
+ */
+static void h264_context_init_decoder(H264_CONTEXT* h264)
+{
+	HKEY hKey;
+	LONG status;
+	DWORD dwType;
+	DWORD dwSize;
+	DWORD dwValue;
+	char szValue[MAX_PATH];
+
+	h264->NumberOfThreads = 0;
+	h264->FrameThreading = FALSE;
+	h264->LowDelay = TRUE;
+	h264->ZeroCopy = TRUE;
+
+	status = RegOpenKeyExA(HKEY_LOCAL_MACHINE, H264_KEY, 0, KEY_READ | KEY_WOW64_64KEY, &hKey);
+
+	if (status == ERROR_SUCCESS)
+	{
+		dwSize = sizeof(dwValue);
+
+		if (RegQueryValueEx(hKey, _T("DecoderThreads"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			h264->NumberOfThreads = dwValue;
+
+		if (RegQueryValueEx(hKey, _T("LowDelay"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			h264->LowDelay = dwValue ? TRUE : FALSE;
+
+		if (RegQueryValueEx(hKey, _T("ZeroCopy"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			h264->ZeroCopy = dwValue ? TRUE : FALSE;
+
+		dwSize = sizeof(szValue) - 1;
+		ZeroMemory(szValue, sizeof(szValue));
+
+		if ((RegQueryValueExA(hKey, "TraceFile", NULL, &dwType, (BYTE*) szValue, &dwSize) == ERROR_SUCCESS) &&
+				(dwType == REG_SZ) && szValue[0])
+			h264->TraceFileName = _strdup(szValue);
+
+		RegCloseKey(hKey);
+	}
+}
+
 H264_CONTEXT* h264_context_new(BOOL Compressor)
 {
 	H264_CONTEXT* h264;
@@ -1537,9 +2221,14 @@ H264_CONTEXT* h264_context_new(BOOL Compressor)
 			h264->BitRate = 1000000;
 			h264->FrameRate = 30;
 		}
+		else
+		{
+			h264_context_init_decoder(h264);
+		}
 
 		if (!h264_context_init(h264))
 		{
+			free(h264->TraceFileName);
 			free(h264);
 			return NULL;
 		}
@@ -1554,6 +2243,22 @@ void h264_context_free(H264_CONTEXT* h264)
 	{
 		h264->subsystem->Uninit(h264);
 
+		free(h264->pYUV444Data[0]);
+		free(h264->pYUV444Data[1]);
+		free(h264->pYUV444Data[2]);
+
+		free(h264->pYUVCopyData[0]);
+		free(h264->pYUVCopyData[1]);
+		free(h264->pYUVCopyData[2]);
+
+		h264_clear_pending_frames(h264);
+		free(h264->OutputRects);
+
+		free(h264->TraceFileName);
+
+		if (h264->TraceFile)
+			fclose(h264->TraceFile);
+
 		free(h264);
 	}
 }
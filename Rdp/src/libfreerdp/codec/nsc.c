@@ -36,6 +36,7 @@
 
 #include "nsc_types.h"
 #include "nsc_encode.h"
+#include "parallel.h"
 
 #include "nsc_sse2.h"
 
@@ -43,10 +44,17 @@
 #define NSC_INIT_SIMD(_nsc_context) do { } while (0)
 #endif
 
-static void nsc_decode(NSC_CONTEXT* context)
+/**
+ * Planes of at least this many pixels are decoded on the default thread pool, the rows of the image and the
+ * four planes in one batch each. Smaller ones, like the 64x64 bitmaps, cost less than waking a thread.
+ */
+#define NSC_PARALLEL_MIN_PIXELS	(256 * 256)
+
+static void nsc_decode_row(void* param, UINT32 index)
 {
+	NSC_CONTEXT* context = (NSC_CONTEXT*) param;
 	UINT16 x;
-	UINT16 y;
+	UINT16 y = (UINT16) index;
 	UINT16 rw;
 	BYTE shift;
 	BYTE* yplane;
@@ -61,48 +69,59 @@ static void nsc_decode(NSC_CONTEXT* context)
 	INT16 b_val;
 	BYTE* bmpdata;
 
-	bmpdata = context->BitmapData;
+	bmpdata = context->BitmapData + y * context->width * 4;
 	rw = ROUND_UP_TO(context->width, 8);
 	shift = context->ColorLossLevel - 1; /* colorloss recovery + YCoCg shift */
 
-	WLog_Print(context->priv->log, WLOG_DEBUG, "NscDecode: width: %d height: %d ChromaSubsamplingLevel: %d",
-			context->width, context->height, context->ChromaSubsamplingLevel);
+	if (context->ChromaSubsamplingLevel)
+	{
+		yplane = context->priv->PlaneBuffers[0] + y * rw; /* Y */
+		coplane = context->priv->PlaneBuffers[1] + (y >> 1) * (rw >> 1); /* Co, supersampled */
+		cgplane = context->priv->PlaneBuffers[2] + (y >> 1) * (rw >> 1); /* Cg, supersampled */
+	}
+	else
+	{
+		yplane = context->priv->PlaneBuffers[0] + y * context->width; /* Y */
+		coplane = context->priv->PlaneBuffers[1] + y * context->width; /* Co */
+		cgplane = context->priv->PlaneBuffers[2] + y * context->width; /* Cg */
+	}
 
-	for (y = 0; y < context->height; y++)
+	aplane = context->priv->PlaneBuffers[3] + y * context->width; /* A */
+
+	for (x = 0; x < context->width; x++)
 	{
-		if (context->ChromaSubsamplingLevel)
-		{
-			yplane = context->priv->PlaneBuffers[0] + y * rw; /* Y */
-			coplane = context->priv->PlaneBuffers[1] + (y >> 1) * (rw >> 1); /* Co, supersampled */
-			cgplane = context->priv->PlaneBuffers[2] + (y >> 1) * (rw >> 1); /* Cg, supersampled */
-		}
-		else
-		{
-			yplane = context->priv->PlaneBuffers[0] + y * context->width; /* Y */
-			coplane = context->priv->PlaneBuffers[1] + y * context->width; /* Co */
-			cgplane = context->priv->PlaneBuffers[2] + y * context->width; /* Cg */
-		}
+		y_val = (INT16) *yplane;
+		co_val = (INT16) (INT8) (*coplane << shift);
+		cg_val = (INT16) (INT8) (*cgplane << shift);
+		r_val = y_val + co_val - cg_val;
+		g_val = y_val + cg_val;
+		b_val = y_val - co_val - cg_val;
+		*bmpdata++ = MINMAX(b_val, 0, 0xFF);
+		*bmpdata++ = MINMAX(g_val, 0, 0xFF);
+		*bmpdata++ = MINMAX(r_val, 0, 0xFF);
+		*bmpdata++ = *aplane;
+		yplane++;
+		coplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
+		cgplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
+		aplane++;
+	}
+}
 
-		aplane = context->priv->PlaneBuffers[3] + y * context->width; /* A */
+static void nsc_decode(NSC_CONTEXT* context)
+{
+	UINT16 y;
 
-		for (x = 0; x < context->width; x++)
-		{
-			y_val = (INT16) *yplane;
-			co_val = (INT16) (INT8) (*coplane << shift);
-			cg_val = (INT16) (INT8) (*cgplane << shift);
-			r_val = y_val + co_val - cg_val;
-			g_val = y_val + cg_val;
-			b_val = y_val - co_val - cg_val;
-			*bmpdata++ = MINMAX(b_val, 0, 0xFF);
-			*bmpdata++ = MINMAX(g_val, 0, 0xFF);
-			*bmpdata++ = MINMAX(r_val, 0, 0xFF);
-			*bmpdata++ = *aplane;
-			yplane++;
-			coplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			cgplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			aplane++;
-		}
+	WLog_Print(context->priv->log, WLOG_DEBUG, "NscDecode: width: %d height: %d ChromaSubsamplingLevel: %d",
+			context->width, context->height, context->ChromaSubsamplingLevel);
+
+	if (context->width * context->height >= NSC_PARALLEL_MIN_PIXELS)
+	{
+		codec_parallel_for(NULL, 0, context->height, nsc_decode_row, (void*) context, NULL, NULL);
+		return;
 	}
+
+	for (y = 0; y < context->height; y++)
+		nsc_decode_row((void*) context, y);
 }
 
 static void nsc_rle_decode(BYTE* in, BYTE* out, UINT32 originalSize)
@@ -152,29 +171,40 @@ static void nsc_rle_decode(BYTE* in, BYTE* out, UINT32 originalSize)
 	*((UINT32*)out) = *((UINT32*)in);
 }
 
-static void nsc_rle_decompress_data(NSC_CONTEXT* context)
+static void nsc_rle_decompress_plane(void* param, UINT32 index)
 {
-	UINT16 i;
-	BYTE* rle;
+	NSC_CONTEXT* context = (NSC_CONTEXT*) param;
+	BYTE* rle = context->Planes;
 	UINT32 planeSize;
 	UINT32 originalSize;
+	UINT32 i;
 
-	rle = context->Planes;
+	for (i = 0; i < index; i++)
+		rle += context->PlaneByteCount[i];
 
-	for (i = 0; i < 4; i++)
-	{
-		originalSize = context->OrgByteCount[i];
-		planeSize = context->PlaneByteCount[i];
+	originalSize = context->OrgByteCount[index];
+	planeSize = context->PlaneByteCount[index];
 
-		if (planeSize == 0)
-			FillMemory(context->priv->PlaneBuffers[i], originalSize, 0xFF);
-		else if (planeSize < originalSize)
-			nsc_rle_decode(rle, context->priv->PlaneBuffers[i], originalSize);
-		else
-			CopyMemory(context->priv->PlaneBuffers[i], rle, originalSize);
+	if (planeSize == 0)
+		FillMemory(context->priv->PlaneBuffers[index], originalSize, 0xFF);
+	else if (planeSize < originalSize)
+		nsc_rle_decode(rle, context->priv->PlaneBuffers[index], originalSize);
+	else
+		CopyMemory(context->priv->PlaneBuffers[index], rle, originalSize);
+}
 
-		rle += planeSize;
+static void nsc_rle_decompress_data(NSC_CONTEXT* context)
+{
+	UINT16 i;
+
+	if (context->width * context->height >= NSC_PARALLEL_MIN_PIXELS)
+	{
+		codec_parallel_for(NULL, 4, 4, nsc_rle_decompress_plane, (void*) context, NULL, NULL);
+		return;
 	}
+
+	for (i = 0; i < 4; i++)
+		nsc_rle_decompress_plane((void*) context, i);
 }
 
 static BOOL nsc_stream_initialize(NSC_CONTEXT* context, wStream* s)
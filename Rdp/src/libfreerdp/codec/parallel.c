@@ -0,0 +1,176 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Library - Batched Thread Pool Work
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/log.h>
+
+#include "parallel.h"
+
+#define TAG FREERDP_TAG("codec")
+
+struct _CODEC_PARALLEL_BATCH
+{
+	CODEC_PARALLEL_FN fn;
+	void* param;
+	UINT32 count;
+	UINT32 chunkSize;
+	LONG chunks;
+	volatile LONG nextChunk;
+	volatile LONG computeTime;
+};
+typedef struct _CODEC_PARALLEL_BATCH CODEC_PARALLEL_BATCH;
+
+static UINT32 codec_parallel_processors(void)
+{
+	static UINT32 processors = 0;
+	SYSTEM_INFO sysinfo;
+
+	if (!processors)
+	{
+		GetNativeSystemInfo(&sysinfo);
+		processors = sysinfo.dwNumberOfProcessors ? sysinfo.dwNumberOfProcessors : 1;
+	}
+
+	return processors;
+}
+
+static void codec_parallel_run(CODEC_PARALLEL_BATCH* batch)
+{
+	LONG chunk;
+	UINT32 index;
+	UINT32 end;
+#ifdef WITH_PROFILER
+	STOPWATCH stopwatch;
+
+	stopwatch_reset(&stopwatch);
+#endif
+
+	while ((chunk = InterlockedIncrement(&batch->nextChunk) - 1) < batch->chunks)
+	{
+		index = chunk * batch->chunkSize;
+		end = index + batch->chunkSize;
+
+		if (end > batch->count)
+			end = batch->count;
+
+#ifdef WITH_PROFILER
+		stopwatch_start(&stopwatch);
+#endif
+
+		for (; index < end; index++)
+			batch->fn(batch->param, index);
+
+#ifdef WITH_PROFILER
+		stopwatch_stop(&stopwatch);
+#endif
+	}
+
+#ifdef WITH_PROFILER
+	InterlockedExchangeAdd(&batch->computeTime, (LONG) stopwatch.elapsed);
+#endif
+}
+
+static void CALLBACK codec_parallel_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
+{
+	codec_parallel_run((CODEC_PARALLEL_BATCH*) context);
+}
+
+#ifdef WITH_PROFILER
+static void codec_parallel_profiler_add(PROFILER* profiler, UINT64 elapsed, UINT32 count)
+{
+	if (!profiler)
+		return;
+
+	profiler->stopwatch->elapsed += elapsed;
+	profiler->stopwatch->count += count;
+}
+#endif
+
+void codec_parallel_for(PTP_CALLBACK_ENVIRON environment, UINT32 threads, UINT32 count,
+	CODEC_PARALLEL_FN fn, void* param, PROFILER_DEFINE(profSchedule), PROFILER_DEFINE(profCompute))
+{
+	LONG index;
+	PTP_WORK work = NULL;
+	CODEC_PARALLEL_BATCH batch;
+#ifdef WITH_PROFILER
+	STOPWATCH schedule;
+
+	stopwatch_reset(&schedule);
+	stopwatch_start(&schedule);
+#endif
+
+	if (!count)
+		return;
+
+	if (!threads)
+		threads = codec_parallel_processors();
+
+	if (threads > count)
+		threads = count;
+
+	batch.fn = fn;
+	batch.param = param;
+	batch.count = count;
+	batch.chunkSize = (count + threads - 1) / threads;
+	batch.chunks = (LONG) ((count + batch.chunkSize - 1) / batch.chunkSize);
+	batch.nextChunk = 0;
+	batch.computeTime = 0;
+
+	if (batch.chunks > 1)
+	{
+		work = CreateThreadpoolWork((PTP_WORK_CALLBACK) codec_parallel_work_callback, (void*) &batch, environment);
+
+		if (!work)
+			WLog_WARN(TAG, "CreateThreadpoolWork failed, running %u items on the calling thread", count);
+	}
+
+	/* the calling thread takes the first chunk, the pool one per submission */
+	if (work)
+	{
+		for (index = 1; index < batch.chunks; index++)
+			SubmitThreadpoolWork(work);
+	}
+
+#ifdef WITH_PROFILER
+	stopwatch_stop(&schedule);
+#endif
+
+	codec_parallel_run(&batch);
+
+#ifdef WITH_PROFILER
+	stopwatch_start(&schedule);
+#endif
+
+	if (work)
+	{
+		WaitForThreadpoolWorkCallbacks(work, FALSE);
+		CloseThreadpoolWork(work);
+	}
+
+#ifdef WITH_PROFILER
+	stopwatch_stop(&schedule);
+	codec_parallel_profiler_add(profSchedule, schedule.elapsed, 1);
+	codec_parallel_profiler_add(profCompute, (UINT64) batch.computeTime, count);
+#endif
+}
@@ -0,0 +1,43 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Library - Batched Thread Pool Work
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CODEC_PARALLEL_H
+#define __CODEC_PARALLEL_H
+
+#include <winpr/pool.h>
+
+#include <freerdp/types.h>
+#include <freerdp/utils/profiler.h>
+
+typedef void (*CODEC_PARALLEL_FN)(void* param, UINT32 index);
+
+/**
+ * Calls fn for every index below count, on the pool of the environment or the default pool if it
+ * is NULL, and returns once all the calls are done.
+ *
+ * The indices are split into threads contiguous chunks, one per processor if threads is 0. A
+ * single work object is submitted once per chunk but one, the pool threads and the calling thread
+ * take chunks until none is left. If the work object can't be created, the calling thread runs
+ * all of them.
+ *
+ * The time the calling thread spends submitting and waiting is added to profSchedule, the time
+ * spent in fn on all threads to profCompute. Either may be NULL.
+ */
+void codec_parallel_for(PTP_CALLBACK_ENVIRON environment, UINT32 threads, UINT32 count,
+	CODEC_PARALLEL_FN fn, void* param, PROFILER_DEFINE(profSchedule), PROFILER_DEFINE(profCompute));
+
+#endif /* __CODEC_PARALLEL_H */
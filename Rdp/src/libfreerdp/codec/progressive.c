@@ -23,6 +23,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
+#include <winpr/registry.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/primitives.h>
@@ -32,9 +34,13 @@
 
 #include "rfx_differential.h"
 #include "rfx_quantization.h"
+#include "parallel.h"
 
 #define TAG FREERDP_TAG("codec.progressive")
 
+#define PROGRESSIVE_KEY "Software\\"FREERDP_VENDOR_STRING"\\" \
+		     FREERDP_PRODUCT_STRING"\\Progressive"
+
 const char* progressive_get_block_type_string(UINT16 blockType)
 {
 	switch (blockType)
@@ -1250,6 +1256,103 @@ int progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* progressive, RFX_PR
 	return 1;
 }
 
+static int progressive_decompress_tile(PROGRESSIVE_CONTEXT* progressive, RFX_PROGRESSIVE_TILE* tile)
+{
+	switch (tile->blockType)
+	{
+		case PROGRESSIVE_WBT_TILE_SIMPLE:
+		case PROGRESSIVE_WBT_TILE_FIRST:
+			return progressive_decompress_tile_first(progressive, tile);
+
+		case PROGRESSIVE_WBT_TILE_UPGRADE:
+			return progressive_decompress_tile_upgrade(progressive, tile);
+	}
+
+	return -1;
+}
+
+struct _PROGRESSIVE_TILE_WORK_PARAM
+{
+	PROGRESSIVE_CONTEXT* progressive;
+	RFX_PROGRESSIVE_TILE** tiles;
+	int* status;
+};
+typedef struct _PROGRESSIVE_TILE_WORK_PARAM PROGRESSIVE_TILE_WORK_PARAM;
+
+static void progressive_process_tile(void* param, UINT32 index)
+{
+	PROGRESSIVE_TILE_WORK_PARAM* work = (PROGRESSIVE_TILE_WORK_PARAM*) param;
+
+	work->status[index] = progressive_decompress_tile(work->progressive, work->tiles[index]);
+}
+
+/**
+ * Decodes the tiles of a region on the thread pool, in one batch. A tile only touches its own buffers, the
+ * quantization values of the region and the synchronized buffer pool. The tiles are composed onto the surface
+ * once all of them are decoded, so the surface is updated in the order of the commands as before.
+ */
+static int progressive_decompress_tiles_threaded(PROGRESSIVE_CONTEXT* progressive, PROGRESSIVE_SURFACE_CONTEXT* surface,
+		RFX_PROGRESSIVE_TILE** tiles, UINT32 numTiles)
+{
+	int status = 1;
+	UINT32 index;
+	UINT32 zIdx;
+	BYTE* listed;
+	PROGRESSIVE_TILE_WORK_PARAM param;
+
+	listed = (BYTE*) calloc(surface->gridSize, 1);
+	param.status = (int*) calloc(numTiles, sizeof(int));
+
+	if (!listed || !param.status)
+	{
+		free(listed);
+		free(param.status);
+		return -1;
+	}
+
+	/* the passes of a tile listed twice build on each other, such a region is decoded in stream order */
+	for (index = 0; index < numTiles; index++)
+	{
+		zIdx = (UINT32) (tiles[index] - surface->tiles);
+
+		if (listed[zIdx])
+			break;
+
+		listed[zIdx] = 1;
+	}
+
+	free(listed);
+
+	if (index < numTiles)
+	{
+		free(param.status);
+
+		for (index = 0; index < numTiles; index++)
+		{
+			if (progressive_decompress_tile(progressive, tiles[index]) < 0)
+				return -1;
+		}
+
+		return 1;
+	}
+
+	param.progressive = progressive;
+	param.tiles = tiles;
+
+	codec_parallel_for(&progressive->ThreadPoolEnv, progressive->MaxThreadCount, numTiles,
+		progressive_process_tile, (void*) &param, NULL, NULL);
+
+	for (index = 0; index < numTiles; index++)
+	{
+		if (param.status[index] < 0)
+			status = -1;
+	}
+
+	free(param.status);
+
+	return status;
+}
+
 int progressive_process_tiles(PROGRESSIVE_CONTEXT* progressive, BYTE* blocks, UINT32 blocksLen, PROGRESSIVE_SURFACE_CONTEXT* surface)
 {
 	int status = -1;
@@ -1511,21 +1614,17 @@ int progressive_process_tiles(PROGRESSIVE_CONTEXT* progressive, BYTE* blocks, UI
 		WLog_WARN(TAG, "numTiles inconsistency: actual: %d, expected: %d\n", count, region->numTiles);
 	}
 
-	for (index = 0; index < region->numTiles; index++)
+	if (progressive->UseThreads && (region->numTiles > 1) && (count == region->numTiles))
 	{
-		tile = tiles[index];
+		if (progressive_decompress_tiles_threaded(progressive, surface, tiles, count) < 0)
+			return -1;
 
-		switch (tile->blockType)
-		{
-			case PROGRESSIVE_WBT_TILE_SIMPLE:
-			case PROGRESSIVE_WBT_TILE_FIRST:
-				status = progressive_decompress_tile_first(progressive, tile);
-				break;
+		return (int) offset;
+	}
 
-			case PROGRESSIVE_WBT_TILE_UPGRADE:
-				status = progressive_decompress_tile_upgrade(progressive, tile);
-				break;
-		}
+	for (index = 0; index < region->numTiles; index++)
+	{
+		status = progressive_decompress_tile(progressive, tiles[index]);
 
 		if (status < 0)
 			return -1;
@@ -1885,6 +1984,75 @@ int progressive_context_reset(PROGRESSIVE_CONTEXT* progressive)
 	return 1;
 }
 
+/**
+ * Tiles are decoded on a thread pool unless UseThreads is 0 under PROGRESSIVE_KEY, which sizes it
+ * with MinThreadCount and MaxThreadCount like RemoteFX does, by default a thread per processor.
+ */
+static BOOL progressive_context_init_threads(PROGRESSIVE_CONTEXT* progressive)
+{
+	HKEY hKey;
+	LONG status;
+	DWORD dwType;
+	DWORD dwSize;
+	DWORD dwValue;
+	SYSTEM_INFO sysinfo;
+
+	progressive->UseThreads = TRUE;
+
+	GetNativeSystemInfo(&sysinfo);
+
+	progressive->MinThreadCount = sysinfo.dwNumberOfProcessors;
+	progressive->MaxThreadCount = 0;
+
+	status = RegOpenKeyExA(HKEY_LOCAL_MACHINE, PROGRESSIVE_KEY, 0, KEY_READ | KEY_WOW64_64KEY, &hKey);
+
+	if (status == ERROR_SUCCESS)
+	{
+		dwSize = sizeof(dwValue);
+
+		if (RegQueryValueEx(hKey, _T("UseThreads"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			progressive->UseThreads = dwValue ? 1 : 0;
+
+		if (RegQueryValueEx(hKey, _T("MinThreadCount"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			progressive->MinThreadCount = dwValue;
+
+		if (RegQueryValueEx(hKey, _T("MaxThreadCount"), NULL, &dwType, (BYTE*) &dwValue, &dwSize) == ERROR_SUCCESS)
+			progressive->MaxThreadCount = dwValue;
+
+		RegCloseKey(hKey);
+	}
+
+	if (!progressive->UseThreads)
+		return TRUE;
+
+	/* initialize the primitives before the tiles are decoded on several threads */
+	primitives_get();
+
+	progressive->ThreadPool = CreateThreadpool(NULL);
+
+	if (!progressive->ThreadPool)
+		return FALSE;
+
+	InitializeThreadpoolEnvironment(&progressive->ThreadPoolEnv);
+	SetThreadpoolCallbackPool(&progressive->ThreadPoolEnv, progressive->ThreadPool);
+
+	if (progressive->MinThreadCount)
+	{
+		if (!SetThreadpoolThreadMinimum(progressive->ThreadPool, progressive->MinThreadCount))
+		{
+			CloseThreadpool(progressive->ThreadPool);
+			DestroyThreadpoolEnvironment(&progressive->ThreadPoolEnv);
+			progressive->ThreadPool = NULL;
+			return FALSE;
+		}
+	}
+
+	if (progressive->MaxThreadCount)
+		SetThreadpoolThreadMaximum(progressive->ThreadPool, progressive->MaxThreadCount);
+
+	return TRUE;
+}
+
 PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor)
 {
 	PROGRESSIVE_CONTEXT* progressive;
@@ -1926,12 +2094,17 @@ PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor)
 
 		progressive->SurfaceContexts = HashTable_New(TRUE);
 
+		if (!Compressor && !progressive_context_init_threads(progressive))
+			goto cleanup;
+
 		progressive_context_reset(progressive);
 	}
 
 	return progressive;
 
 cleanup:
+	BufferPool_Free(progressive->bufferPool);
+	HashTable_Free(progressive->SurfaceContexts);
 	free(progressive->rects);
 	free(progressive->tiles);
 	free(progressive->quantVals);
@@ -1950,6 +2123,12 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 	if (!progressive)
 		return;
 
+	if (progressive->ThreadPool)
+	{
+		CloseThreadpool(progressive->ThreadPool);
+		DestroyThreadpoolEnvironment(&progressive->ThreadPoolEnv);
+	}
+
 	BufferPool_Free(progressive->bufferPool);
 
 	free(progressive->rects);
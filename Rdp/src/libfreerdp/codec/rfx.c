@@ -51,8 +51,10 @@
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
 #include "rfx_rlgr.h"
+#include "parallel.h"
 
 #include "rfx_sse2.h"
+#include "rfx_avx2.h"
 #include "rfx_neon.h"
 
 #define TAG FREERDP_TAG("codec")
@@ -100,6 +102,9 @@ static void rfx_profiler_create(RFX_CONTEXT* context)
 	PROFILER_CREATE(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode");
 	PROFILER_CREATE(context->priv->prof_rfx_rgb_to_ycbcr, "prims->RGBToYCbCr");
 	PROFILER_CREATE(context->priv->prof_rfx_encode_format_rgb, "rfx_encode_format_rgb");
+
+	PROFILER_CREATE(context->priv->prof_rfx_tile_schedule, "rfx_tile_schedule");
+	PROFILER_CREATE(context->priv->prof_rfx_tile_compute, "rfx_tile_compute");
 }
 
 static void rfx_profiler_free(RFX_CONTEXT* context)
@@ -121,6 +126,9 @@ static void rfx_profiler_free(RFX_CONTEXT* context)
 	PROFILER_FREE(context->priv->prof_rfx_dwt_2d_encode);
 	PROFILER_FREE(context->priv->prof_rfx_rgb_to_ycbcr);
 	PROFILER_FREE(context->priv->prof_rfx_encode_format_rgb);
+
+	PROFILER_FREE(context->priv->prof_rfx_tile_schedule);
+	PROFILER_FREE(context->priv->prof_rfx_tile_compute);
 }
 
 static void rfx_profiler_print(RFX_CONTEXT* context)
@@ -145,6 +153,9 @@ static void rfx_profiler_print(RFX_CONTEXT* context)
 	PROFILER_PRINT(context->priv->prof_rfx_rgb_to_ycbcr);
 	PROFILER_PRINT(context->priv->prof_rfx_encode_format_rgb);
 
+	PROFILER_PRINT(context->priv->prof_rfx_tile_schedule);
+	PROFILER_PRINT(context->priv->prof_rfx_tile_compute);
+
 	PROFILER_PRINT_FOOTER;
 }
 
@@ -339,6 +350,9 @@ RFX_CONTEXT* rfx_context_new(BOOL encoder)
 	context->dwt_2d_encode = rfx_dwt_2d_encode;
 
 	RFX_INIT_SIMD(context);
+#ifdef WITH_AVX2
+	rfx_init_avx2(context);
+#endif
 
 	context->state = RFX_STATE_SEND_HEADERS;
 	return context;
@@ -378,9 +392,6 @@ void rfx_context_free(RFX_CONTEXT* context)
 		CloseThreadpool(context->priv->ThreadPool);
 		DestroyThreadpoolEnvironment(&context->priv->ThreadPoolEnv);
 
-		free(priv->workObjects);
-		free(priv->tileWorkParams);
-
 #ifdef WITH_PROFILER
 		WLog_VRB(TAG,  "WARNING: Profiling results probably unusable with multithreaded RemoteFX codec!");
 #endif
@@ -742,23 +753,25 @@ static BOOL rfx_process_message_region(RFX_CONTEXT* context, RFX_MESSAGE* messag
 	return TRUE;
 }
 
-struct _RFX_TILE_PROCESS_WORK_PARAM
+struct _RFX_TILE_WORK_PARAM
 {
-	RFX_TILE* tile;
 	RFX_CONTEXT* context;
+	RFX_MESSAGE* message;
 };
-typedef struct _RFX_TILE_PROCESS_WORK_PARAM RFX_TILE_PROCESS_WORK_PARAM;
+typedef struct _RFX_TILE_WORK_PARAM RFX_TILE_WORK_PARAM;
 
-void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
+static void rfx_process_message_tile(void* param, UINT32 index)
 {
-	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*) context;
-	rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4);
+	RFX_TILE_WORK_PARAM* work = (RFX_TILE_WORK_PARAM*) param;
+	RFX_TILE* tile = work->message->tiles[index];
+
+	rfx_decode_rgb(work->context, tile, tile->data, 64 * 4);
 }
 
 static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* message, wStream* s, UINT16* pExpecedBlockType)
 {
 	BOOL rc;
-	int i, close_cnt;
+	int i;
 	int pos;
 	BYTE quant;
 	RFX_TILE* tile;
@@ -767,8 +780,7 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	UINT32 blockLen;
 	UINT32 blockType;
 	UINT32 tilesDataSize;
-	PTP_WORK* work_objects = NULL;
-	RFX_TILE_PROCESS_WORK_PARAM* params = NULL;
+	RFX_TILE_WORK_PARAM param;
 	void *pmem;
 
 	if (*pExpecedBlockType != WBT_EXTENSION)
@@ -859,26 +871,7 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 		return FALSE;
 	}
 
-	if (context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*) calloc(message->numTiles, sizeof(PTP_WORK));
-		params = (RFX_TILE_PROCESS_WORK_PARAM*) calloc(message->numTiles, sizeof(RFX_TILE_PROCESS_WORK_PARAM));
-
-		if (!work_objects)
-		{
-			free(params);
-			return FALSE;
-		}
-
-		if (!params)
-		{
-			free(work_objects);
-			return FALSE;
-		}
-	}
-
 	/* tiles */
-	close_cnt = 0;
 	rc = TRUE;
 	for (i = 0; i < message->numTiles; i++)
 	{
@@ -938,42 +931,27 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 		tile->x = tile->xIdx * 64;
 		tile->y = tile->yIdx * 64;
 
-		if (context->priv->UseThreads)
-		{
-			assert(params);
-
-			params[i].context = context;
-			params[i].tile = message->tiles[i];
-
-			if (!(work_objects[i] = CreateThreadpoolWork((PTP_WORK_CALLBACK) rfx_process_message_tile_work_callback,
-					(void*) &params[i], &context->priv->ThreadPoolEnv)))
-			{
-				WLog_ERR(TAG, "CreateThreadpoolWork failed.");
-				rc = FALSE;
-				break;
-			}
-
-			SubmitThreadpoolWork(work_objects[i]);
-			close_cnt = i + 1;
-		}
-		else
-		{
-			rfx_decode_rgb(context, tile, tile->data, 64 * 4);
-		}
-
 		Stream_SetPosition(s, pos);
 	}
 
-	if (context->priv->UseThreads)
+	/* the tiles are decoded once the whole tileset is parsed, in one batch when using threads */
+	if (rc)
 	{
-		for (i = 0; i < close_cnt; i++)
+		param.context = context;
+		param.message = message;
+
+		if (context->priv->UseThreads)
 		{
-			WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
-			CloseThreadpoolWork(work_objects[i]);
+			codec_parallel_for(&context->priv->ThreadPoolEnv, context->priv->MaxThreadCount, message->numTiles,
+				rfx_process_message_tile, (void*) &param, context->priv->prof_rfx_tile_schedule,
+				context->priv->prof_rfx_tile_compute);
+		}
+		else
+		{
+			for (i = 0; i < message->numTiles; i++)
+				rfx_process_message_tile((void*) &param, i);
 		}
 	}
-	free(work_objects);
-	free(params);
 
 	for (i = 0; i < message->numTiles; i++)
 	{
@@ -1304,19 +1282,13 @@ static BOOL rfx_write_tile(RFX_CONTEXT* context, wStream* s, RFX_TILE* tile)
 	return TRUE;
 }
 
-struct _RFX_TILE_COMPOSE_WORK_PARAM
+static void rfx_compose_message_tile(void* param, UINT32 index)
 {
-	RFX_TILE* tile;
-	RFX_CONTEXT* context;
-};
+	RFX_TILE_WORK_PARAM* work = (RFX_TILE_WORK_PARAM*) param;
 
-void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
-{
-	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*) context;
-	rfx_encode_rgb(param->context, param->tile);
+	rfx_encode_rgb(work->context, work->message->tiles[index]);
 }
 
-
 static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16 *region, int width, int height)
 {
 	int i;
@@ -1340,27 +1312,6 @@ static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16 *region,
 
 #define TILE_NO(v) ((v) / 64)
 
-BOOL setupWorkers(RFX_CONTEXT *context, int nbTiles)
-{
-	RFX_CONTEXT_PRIV *priv = context->priv;
-	void* pmem;
-
-	if (!context->priv->UseThreads)
-		return TRUE;
-
-	if (!(pmem = realloc((void*) priv->workObjects, sizeof(PTP_WORK) * nbTiles)))
-		return FALSE;
-
-	priv->workObjects = (PTP_WORK*) pmem;
-
-	if (!(pmem = realloc((void*) priv->tileWorkParams, sizeof(RFX_TILE_COMPOSE_WORK_PARAM) * nbTiles)))
-		return FALSE;
-
-	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*) pmem;
-
-	return TRUE;
-}
-
 RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, int numRects,
 		BYTE* data, int width, int height, int scanline)
 {
@@ -1370,8 +1321,7 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, int
 	RFX_TILE* tile;
 	RFX_RECT* rfxRect;
 	RFX_MESSAGE* message = NULL;
-	PTP_WORK* workObject = NULL;
-	RFX_TILE_COMPOSE_WORK_PARAM *workParam = NULL;
+	RFX_TILE_WORK_PARAM param;
 	BOOL success = FALSE;
 
 	REGION16 rectsRegion, tilesRegion;
@@ -1428,15 +1378,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, int
 	if (!(message->tiles = calloc(maxNbTiles, sizeof(RFX_TILE*))))
 		goto skip_encoding_loop;
 
-	if (!setupWorkers(context, maxNbTiles))
-		goto skip_encoding_loop;
-
-	if (context->priv->UseThreads)
-	{
-		workObject = context->priv->workObjects;
-		workParam = context->priv->tileWorkParams;
-	}
-
 	regionRect = region16_rects(&rectsRegion, &regionNbRects);
 
 	if (!(message->rects = calloc(regionNbRects, sizeof(RFX_RECT))))
@@ -1519,35 +1460,28 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, int
 				message->tiles[message->numTiles] = tile;
 				message->numTiles++;
 
-				if (context->priv->UseThreads)
-				{
-					workParam->context = context;
-					workParam->tile = tile;
-
-					if (!(*workObject = CreateThreadpoolWork(
-							(PTP_WORK_CALLBACK)rfx_compose_message_tile_work_callback,
-							(void*) workParam,
-							&context->priv->ThreadPoolEnv)))
-					{
-						goto skip_encoding_loop;
-					}
-
-					SubmitThreadpoolWork(*workObject);
-
-					workObject++;
-					workParam++;
-				}
-				else
-				{
-					rfx_encode_rgb(context, tile);
-				}
-
 				if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
 					goto skip_encoding_loop;
 			} /* xIdx */
 		}  /* yIdx */
 	}  /* rects */
 
+	/* the tiles are encoded once all of them are set up, in one batch when using threads */
+	param.context = context;
+	param.message = message;
+
+	if (context->priv->UseThreads)
+	{
+		codec_parallel_for(&context->priv->ThreadPoolEnv, context->priv->MaxThreadCount, message->numTiles,
+			rfx_compose_message_tile, (void*) &param, context->priv->prof_rfx_tile_schedule,
+			context->priv->prof_rfx_tile_compute);
+	}
+	else
+	{
+		for (i = 0; i < message->numTiles; i++)
+			rfx_compose_message_tile((void*) &param, i);
+	}
+
 	success = TRUE;
 
 skip_encoding_loop:
@@ -1570,25 +1504,10 @@ skip_encoding_loop:
 		}
 	}
 
-	/* when using threads ensure all computations are done */
 	message->tilesDataSize = 0;
-	workObject = context->priv->workObjects;
 
 	for (i = 0; i < message->numTiles; i++)
-	{
-		tile = message->tiles[i];
-		if (context->priv->UseThreads)
-		{
-			if (*workObject)
-			{
-				WaitForThreadpoolWorkCallbacks(*workObject, FALSE);
-				CloseThreadpoolWork(*workObject);
-			}
-			workObject++;
-		}
-
-		message->tilesDataSize += rfx_tile_length(tile);
-	}
+		message->tilesDataSize += rfx_tile_length(message->tiles[i]);
 
 	region16_uninit(&tilesRegion);
 	region16_uninit(&rectsRegion);
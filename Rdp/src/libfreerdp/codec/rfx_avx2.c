@@ -0,0 +1,400 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "rfx_types.h"
+#include "rfx_avx2.h"
+
+#ifdef _MSC_VER
+#define	__attribute__(...)
+#endif
+
+#ifndef __clang__
+#define ATTRIBUTES  __gnu_inline__, __always_inline__, __artificial__
+#else
+#define ATTRIBUTES __gnu_inline__, __always_inline__
+#endif
+
+/**
+ * The buffers taken from the context's BufferPool are only 16-byte aligned,
+ * so the 256-bit loads and stores below are all unaligned ones. On processors
+ * with AVX2 they cost the same as the aligned ones if the data is aligned.
+ */
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_quantization_decode_block_avx2(INT16* buffer, const int buffer_size, const UINT32 factor)
+{
+	__m256i a;
+	__m128i count;
+	__m256i* ptr = (__m256i*) buffer;
+	__m256i* buf_end = (__m256i*) (buffer + buffer_size);
+
+	if (factor == 0)
+		return;
+
+	count = _mm_cvtsi32_si128(factor);
+
+	do
+	{
+		a = _mm256_loadu_si256(ptr);
+		a = _mm256_sll_epi16(a, count);
+		_mm256_storeu_si256(ptr, a);
+
+		ptr++;
+	} while(ptr < buf_end);
+}
+
+static void rfx_quantization_decode_avx2(INT16* buffer, const UINT32* quantVals)
+{
+	rfx_quantization_decode_block_avx2(&buffer[0], 1024, quantVals[8] - 1); /* HL1 */
+	rfx_quantization_decode_block_avx2(&buffer[1024], 1024, quantVals[7] - 1); /* LH1 */
+	rfx_quantization_decode_block_avx2(&buffer[2048], 1024, quantVals[9] - 1); /* HH1 */
+	rfx_quantization_decode_block_avx2(&buffer[3072], 256, quantVals[5] - 1); /* HL2 */
+	rfx_quantization_decode_block_avx2(&buffer[3328], 256, quantVals[4] - 1); /* LH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3584], 256, quantVals[6] - 1); /* HH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3840], 64, quantVals[2] - 1); /* HL3 */
+	rfx_quantization_decode_block_avx2(&buffer[3904], 64, quantVals[1] - 1); /* LH3 */
+	rfx_quantization_decode_block_avx2(&buffer[3968], 64, quantVals[3] - 1); /* HH3 */
+	rfx_quantization_decode_block_avx2(&buffer[4032], 64, quantVals[0] - 1); /* LL3 */
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_quantization_encode_block_avx2(INT16* buffer, const int buffer_size, const UINT32 factor)
+{
+	__m256i a;
+	__m128i count;
+	__m256i* ptr = (__m256i*) buffer;
+	__m256i* buf_end = (__m256i*) (buffer + buffer_size);
+	__m256i half;
+
+	if (factor == 0)
+		return;
+
+	count = _mm_cvtsi32_si128(factor);
+	half = _mm256_set1_epi16(1 << (factor - 1));
+
+	do
+	{
+		a = _mm256_loadu_si256(ptr);
+		a = _mm256_add_epi16(a, half);
+		a = _mm256_sra_epi16(a, count);
+		_mm256_storeu_si256(ptr, a);
+
+		ptr++;
+	} while(ptr < buf_end);
+}
+
+static void rfx_quantization_encode_avx2(INT16* buffer, const UINT32* quantization_values)
+{
+	rfx_quantization_encode_block_avx2(buffer, 1024, quantization_values[8] - 6); /* HL1 */
+	rfx_quantization_encode_block_avx2(buffer + 1024, 1024, quantization_values[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_avx2(buffer + 2048, 1024, quantization_values[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_avx2(buffer + 3072, 256, quantization_values[5] - 6); /* HL2 */
+	rfx_quantization_encode_block_avx2(buffer + 3328, 256, quantization_values[4] - 6); /* LH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3584, 256, quantization_values[6] - 6); /* HH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3840, 64, quantization_values[2] - 6); /* HL3 */
+	rfx_quantization_encode_block_avx2(buffer + 3904, 64, quantization_values[1] - 6); /* LH3 */
+	rfx_quantization_encode_block_avx2(buffer + 3968, 64, quantization_values[3] - 6); /* HH3 */
+	rfx_quantization_encode_block_avx2(buffer + 4032, 64, quantization_values[0] - 6); /* LL3 */
+
+	rfx_quantization_encode_block_avx2(buffer, 4096, 5);
+}
+
+/**
+ * The level 3 sub-bands are 8 coefficients wide, a row of them fits into
+ * one 128-bit register. This is the SSE2 code with VEX encoded instructions.
+ */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_horiz_8_avx2(INT16* l, INT16* h, INT16* dst)
+{
+	int y;
+	INT16* l_ptr = l;
+	INT16* h_ptr = h;
+	INT16* dst_ptr = dst;
+	int first;
+	int last;
+	__m128i l_n;
+	__m128i h_n;
+	__m128i h_n_m;
+	__m128i tmp_n;
+	__m128i dst_n;
+	__m128i dst_n_p;
+
+	for (y = 0; y < 8; y++)
+	{
+		/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+		l_n = _mm_loadu_si128((__m128i*) l_ptr);
+		h_n = _mm_loadu_si128((__m128i*) h_ptr);
+		h_n_m = _mm_loadu_si128((__m128i*) (h_ptr - 1));
+		first = _mm_extract_epi16(h_n_m, 1);
+		h_n_m = _mm_insert_epi16(h_n_m, first, 0);
+
+		tmp_n = _mm_add_epi16(h_n, h_n_m);
+		tmp_n = _mm_add_epi16(tmp_n, _mm_set1_epi16(1));
+		tmp_n = _mm_srai_epi16(tmp_n, 1);
+		dst_n = _mm_sub_epi16(l_n, tmp_n);
+		_mm_storeu_si128((__m128i*) l_ptr, dst_n);
+
+		/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+		h_n = _mm_slli_epi16(h_n, 1);
+		dst_n_p = _mm_loadu_si128((__m128i*) (l_ptr + 1));
+		last = _mm_extract_epi16(dst_n_p, 6);
+		dst_n_p = _mm_insert_epi16(dst_n_p, last, 7);
+
+		tmp_n = _mm_add_epi16(dst_n_p, dst_n);
+		tmp_n = _mm_srai_epi16(tmp_n, 1);
+		tmp_n = _mm_add_epi16(tmp_n, h_n);
+
+		_mm_storeu_si128((__m128i*) dst_ptr, _mm_unpacklo_epi16(dst_n, tmp_n));
+		_mm_storeu_si128((__m128i*) (dst_ptr + 8), _mm_unpackhi_epi16(dst_n, tmp_n));
+
+		l_ptr += 8;
+		h_ptr += 8;
+		dst_ptr += 16;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_horiz_avx2(INT16* l, INT16* h, INT16* dst, int subband_width)
+{
+	int y, n;
+	INT16* l_ptr = l;
+	INT16* h_ptr = h;
+	INT16* dst_ptr = dst;
+	__m256i l_n;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i tmp_n;
+	__m256i dst_n;
+	__m256i dst_n_p;
+	__m256i dst1;
+	__m256i dst2;
+	__m256i one = _mm256_set1_epi16(1);
+	/* selects the first and the last of the 16 coefficients, there is no 256-bit insert */
+	__m256i first_mask = _mm256_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m256i last_mask = _mm256_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+
+	for (y = 0; y < subband_width; y++)
+	{
+		/* Even coefficients */
+		for (n = 0; n < subband_width; n += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+
+			l_n = _mm256_loadu_si256((__m256i*) l_ptr);
+
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+			h_n_m = _mm256_loadu_si256((__m256i*) (h_ptr - 1));
+
+			if (n == 0)
+				h_n_m = _mm256_blendv_epi8(h_n_m, h_n, first_mask);
+
+			tmp_n = _mm256_add_epi16(h_n, h_n_m);
+			tmp_n = _mm256_add_epi16(tmp_n, one);
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			dst_n = _mm256_sub_epi16(l_n, tmp_n);
+
+			_mm256_storeu_si256((__m256i*) l_ptr, dst_n);
+
+			l_ptr += 16;
+			h_ptr += 16;
+		}
+
+		l_ptr -= subband_width;
+		h_ptr -= subband_width;
+
+		/* Odd coefficients */
+		for (n = 0; n < subband_width; n += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+
+			h_n = _mm256_slli_epi16(h_n, 1);
+
+			dst_n = _mm256_loadu_si256((__m256i*) (l_ptr));
+			dst_n_p = _mm256_loadu_si256((__m256i*) (l_ptr + 1));
+
+			if (n == subband_width - 16)
+				dst_n_p = _mm256_blendv_epi8(dst_n_p, dst_n, last_mask);
+
+			tmp_n = _mm256_add_epi16(dst_n_p, dst_n);
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			tmp_n = _mm256_add_epi16(tmp_n, h_n);
+
+			/* the unpacks interleave within the 128-bit lanes, put the lanes back in order */
+			dst1 = _mm256_unpacklo_epi16(dst_n, tmp_n);
+			dst2 = _mm256_unpackhi_epi16(dst_n, tmp_n);
+
+			_mm256_storeu_si256((__m256i*) dst_ptr, _mm256_permute2x128_si256(dst1, dst2, 0x20));
+			_mm256_storeu_si256((__m256i*) (dst_ptr + 16), _mm256_permute2x128_si256(dst1, dst2, 0x31));
+
+			l_ptr += 16;
+			h_ptr += 16;
+			dst_ptr += 32;
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_vert_avx2(INT16* l, INT16* h, INT16* dst, int subband_width)
+{
+	int x, n;
+	INT16* l_ptr = l;
+	INT16* h_ptr = h;
+	INT16* dst_ptr = dst;
+	__m256i l_n;
+	__m256i h_n;
+	__m256i tmp_n;
+	__m256i h_n_m;
+	__m256i dst_n;
+	__m256i dst_n_m;
+	__m256i dst_n_p;
+	__m256i one = _mm256_set1_epi16(1);
+
+	int total_width = subband_width + subband_width;
+
+	/* Even coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+
+			l_n = _mm256_loadu_si256((__m256i*) l_ptr);
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+
+			tmp_n = _mm256_add_epi16(h_n, one);
+			if (n == 0)
+				tmp_n = _mm256_add_epi16(tmp_n, h_n);
+			else
+			{
+				h_n_m = _mm256_loadu_si256((__m256i*) (h_ptr - total_width));
+				tmp_n = _mm256_add_epi16(tmp_n, h_n_m);
+			}
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			dst_n = _mm256_sub_epi16(l_n, tmp_n);
+			_mm256_storeu_si256((__m256i*) dst_ptr, dst_n);
+
+			l_ptr += 16;
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+		dst_ptr += total_width;
+	}
+
+	h_ptr = h;
+	dst_ptr = dst + total_width;
+
+	/* Odd coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+			dst_n_m = _mm256_loadu_si256((__m256i*) (dst_ptr - total_width));
+			h_n = _mm256_slli_epi16(h_n, 1);
+
+			tmp_n = dst_n_m;
+			if (n == subband_width - 1)
+				tmp_n = _mm256_add_epi16(tmp_n, dst_n_m);
+			else
+			{
+				dst_n_p = _mm256_loadu_si256((__m256i*) (dst_ptr + total_width));
+				tmp_n = _mm256_add_epi16(tmp_n, dst_n_p);
+			}
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			dst_n = _mm256_add_epi16(tmp_n, h_n);
+			_mm256_storeu_si256((__m256i*) dst_ptr, dst_n);
+
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+		dst_ptr += total_width;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_avx2(INT16* buffer, INT16* idwt, int subband_width)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_dst, *h_dst;
+
+	/* Inverse DWT in horizontal direction, results in 2 sub-bands in L, H order in tmp buffer idwt. */
+	/* The 4 sub-bands are stored in HL(0), LH(1), HH(2), LL(3) order. */
+	/* The lower part L uses LL(3) and HL(0). */
+	/* The higher part H uses LH(1) and HH(2). */
+
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	l_dst = idwt;
+
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	h_dst = idwt + subband_width * subband_width * 2;
+
+	if (subband_width == 8)
+	{
+		rfx_dwt_2d_decode_block_horiz_8_avx2(ll, hl, l_dst);
+		rfx_dwt_2d_decode_block_horiz_8_avx2(lh, hh, h_dst);
+	}
+	else
+	{
+		rfx_dwt_2d_decode_block_horiz_avx2(ll, hl, l_dst, subband_width);
+		rfx_dwt_2d_decode_block_horiz_avx2(lh, hh, h_dst, subband_width);
+	}
+
+	/* Inverse DWT in vertical direction, results are stored in original buffer. */
+	rfx_dwt_2d_decode_block_vert_avx2(l_dst, h_dst, buffer, subband_width);
+}
+
+static void rfx_dwt_2d_decode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	rfx_dwt_2d_decode_block_avx2(&buffer[3840], dwt_buffer, 8);
+	rfx_dwt_2d_decode_block_avx2(&buffer[3072], dwt_buffer, 16);
+	rfx_dwt_2d_decode_block_avx2(&buffer[0], dwt_buffer, 32);
+}
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return;
+
+	IF_PROFILER(context->priv->prof_rfx_quantization_decode->name = "rfx_quantization_decode_avx2");
+	IF_PROFILER(context->priv->prof_rfx_quantization_encode->name = "rfx_quantization_encode_avx2");
+	IF_PROFILER(context->priv->prof_rfx_dwt_2d_decode->name = "rfx_dwt_2d_decode_avx2");
+
+	context->quantization_decode = rfx_quantization_decode_avx2;
+	context->quantization_encode = rfx_quantization_encode_avx2;
+	context->dwt_2d_decode = rfx_dwt_2d_decode_avx2;
+}
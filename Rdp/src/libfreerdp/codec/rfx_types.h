@@ -39,16 +39,12 @@
 #define DEBUG_RFX(fmt, ...) do { } while (0)
 #endif
 
-typedef struct _RFX_TILE_COMPOSE_WORK_PARAM RFX_TILE_COMPOSE_WORK_PARAM;
-
 struct _RFX_CONTEXT_PRIV
 {
 	wLog* log;
 	wObjectPool* TilePool;
 
 	BOOL UseThreads;
-	PTP_WORK* workObjects;
-	RFX_TILE_COMPOSE_WORK_PARAM* tileWorkParams;
 
 	DWORD MinThreadCount;
 	DWORD MaxThreadCount;
@@ -76,6 +72,10 @@ struct _RFX_CONTEXT_PRIV
 	PROFILER_DEFINE(prof_rfx_dwt_2d_encode);
 	PROFILER_DEFINE(prof_rfx_rgb_to_ycbcr);
 	PROFILER_DEFINE(prof_rfx_encode_format_rgb);
+
+	/* batched tile work: submitting and waiting on the calling thread, the tiles on all threads */
+	PROFILER_DEFINE(prof_rfx_tile_schedule);
+	PROFILER_DEFINE(prof_rfx_tile_compute);
 };
 
 #endif /* __RFX_TYPES_H */
@@ -125,6 +125,176 @@ int test_ClearDecompressExample4()
 	return 1;
 }
 
+static UINT32 test_clear_rand(UINT32* seed)
+{
+	*seed = (*seed * 1103515245) + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+/**
+ * Appends a band of random vBars, cache misses mostly, with hits on the short vBars and on the
+ * vBars of the band itself. The cursors follow the ones of the decoder.
+ */
+static BYTE* test_clear_write_band(BYTE* p, UINT32* seed, UINT16 xStart, UINT16 xEnd, UINT16 yStart, UINT16 yEnd,
+		UINT32* vBarCursor, UINT32* shortVBarCursor)
+{
+	UINT32 x;
+	UINT32 i;
+	UINT32 r;
+	UINT16 vBarHeader;
+	UINT32 yOn;
+	UINT32 count;
+	UINT32 vBarHeight = yEnd - yStart + 1;
+	UINT32 bandVBars = 0;
+
+	*((UINT16*) &p[0]) = xStart;
+	*((UINT16*) &p[2]) = xEnd;
+	*((UINT16*) &p[4]) = yStart;
+	*((UINT16*) &p[6]) = yEnd;
+	p[8] = (BYTE) test_clear_rand(seed);
+	p[9] = (BYTE) test_clear_rand(seed);
+	p[10] = (BYTE) test_clear_rand(seed);
+	p += 11;
+
+	for (x = xStart; x <= xEnd; x++)
+	{
+		r = test_clear_rand(seed) % 8;
+
+		if ((r == 0) && (bandVBars >= 8))
+		{
+			/* VBAR_CACHE_HIT of a vBar as high as the band */
+			vBarHeader = 0x8000 | ((*vBarCursor + 32768 - 1 - (test_clear_rand(seed) % 8)) % 32768);
+			*((UINT16*) &p[0]) = vBarHeader;
+			p += 2;
+			continue;
+		}
+
+		yOn = test_clear_rand(seed) % ((vBarHeight + 1) / 2);
+
+		if ((r == 1) && (*shortVBarCursor > 0))
+		{
+			/* SHORT_VBAR_CACHE_HIT */
+			vBarHeader = 0x4000 | (test_clear_rand(seed) % *shortVBarCursor);
+			*((UINT16*) &p[0]) = vBarHeader;
+			p[2] = (BYTE) yOn;
+			p += 3;
+		}
+		else
+		{
+			/* SHORT_VBAR_CACHE_MISS */
+			count = test_clear_rand(seed) % (vBarHeight - yOn + 1);
+			vBarHeader = (UINT16) (yOn | ((yOn + count) << 8));
+			*((UINT16*) &p[0]) = vBarHeader;
+			p += 2;
+
+			for (i = 0; i < count * 3; i++)
+				*p++ = (BYTE) test_clear_rand(seed);
+
+			*shortVBarCursor = (*shortVBarCursor + 1) % 16384;
+		}
+
+		*vBarCursor = (*vBarCursor + 1) % 32768;
+		bandVBars++;
+	}
+
+	return p;
+}
+
+/**
+ * Decodes the same bands on the thread pool and without it, the surfaces have to match byte for byte.
+ * The wide band in the middle takes the vBar storage around, so vBars of bands not composed yet are
+ * replaced within the message. The last bands overlap each other and the first ones, the later band
+ * has to win like it does in serial decoding.
+ */
+int test_ClearDecompressThreads()
+{
+	int status;
+	UINT32 round;
+	UINT32 index;
+	UINT32 seed = 0x1234;
+	UINT32 vBarCursor = 0;
+	UINT32 shortVBarCursor = 0;
+	UINT32 SrcSize;
+	BYTE* pSrcData;
+	BYTE* p;
+	BYTE* pDstData[2] = { NULL, NULL };
+	CLEAR_CONTEXT* clear[2] = { NULL, NULL };
+	int nWidth = 64 + 40000;
+	int nHeight = 41;
+	int nDstStep = nWidth * 4;
+	int result = -1;
+
+	pSrcData = (BYTE*) malloc(1024 * 1024);
+
+	if (!pSrcData)
+		return -1;
+
+	pSrcData[0] = CLEARCODEC_FLAG_CACHE_RESET; /* glyphFlags, the cursors start over every round */
+	pSrcData[1] = 0; /* seqNumber */
+	*((UINT32*) &pSrcData[2]) = 0; /* residualByteCount */
+	*((UINT32*) &pSrcData[10]) = 0; /* subcodecByteCount */
+
+	p = test_clear_write_band(&pSrcData[14], &seed, 0, 63, 0, 23, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 64, nWidth - 1, 24, 24, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 0, 63, 25, nHeight - 1, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 16, 2047, 8, 36, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 0, 2047, 0, nHeight - 1, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 8, 2039, 4, 31, &vBarCursor, &shortVBarCursor);
+	p = test_clear_write_band(p, &seed, 32, 95, 12, 20, &vBarCursor, &shortVBarCursor);
+
+	SrcSize = (UINT32) (p - pSrcData);
+	*((UINT32*) &pSrcData[6]) = SrcSize - 14; /* bandsByteCount */
+
+	for (index = 0; index < 2; index++)
+	{
+		clear[index] = clear_context_new(FALSE);
+		pDstData[index] = (BYTE*) calloc(nHeight, nDstStep);
+
+		if (!clear[index] || !pDstData[index])
+			goto out;
+	}
+
+	if (!clear[1]->UseThreads)
+		printf("clear threads are disabled, comparing serial decoding with itself\n");
+
+	clear[0]->UseThreads = FALSE;
+
+	for (round = 0; round < 2; round++)
+	{
+		pSrcData[1] = (BYTE) round;
+
+		for (index = 0; index < 2; index++)
+		{
+			status = clear_decompress(clear[index], pSrcData, SrcSize, &pDstData[index], PIXEL_FORMAT_XRGB32,
+					nDstStep, 0, 0, nWidth, nHeight);
+
+			if (status < 0)
+			{
+				printf("clear_decompress %s failure: %d in round %d\n", index ? "threaded" : "serial", status, round);
+				goto out;
+			}
+		}
+
+		if (memcmp(pDstData[0], pDstData[1], nHeight * nDstStep) != 0)
+		{
+			printf("clear_decompress threaded and serial outputs differ in round %d\n", round);
+			goto out;
+		}
+	}
+
+	result = 1;
+
+out:
+	for (index = 0; index < 2; index++)
+	{
+		clear_context_free(clear[index]);
+		free(pDstData[index]);
+	}
+
+	free(pSrcData);
+	return result;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	//test_ClearDecompressExample1();
@@ -135,6 +305,9 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 
 	test_ClearDecompressExample4();
 
+	if (test_ClearDecompressThreads() < 0)
+		return -1;
+
 	return 0;
 }
 
@@ -0,0 +1,307 @@
+#include <winpr/crt.h>
+#include <winpr/print.h>
+#include <winpr/stream.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/h264.h>
+#include <freerdp/utils/stopwatch.h>
+
+/**
+ * Decode throughput of the H.264 decoder on each threading setup, over a recorded AVC420 stream.
+ *
+ * TestFreeRDPCodecH264Benchmark [trace]
+ *
+ * A trace holds the bitmap data of the AVC420 surface commands of one surface from the start of
+ * the stream, each as a little endian UINT32 length and the RDPGFX_AVC420_BITMAP_STREAM. The client
+ * writes one when TraceFile under the H264 registry key names a file, see h264_trace_bitmap_stream.
+ * The frames are decoded into a buffer as large as the regions they update, each pass over the
+ * trace is timed as a whole. The decoder can't encode, without a trace there's nothing to measure.
+ */
+
+#define H264_BENCHMARK_MIN_FRAMES	600
+
+struct _H264_TRACE_FRAME
+{
+	RDPGFX_H264_BITMAP_STREAM bs;
+	BYTE* pdu;
+};
+typedef struct _H264_TRACE_FRAME H264_TRACE_FRAME;
+
+struct _H264_TRACE
+{
+	UINT32 count;
+	H264_TRACE_FRAME* frames;
+	UINT64 totalSize;
+	UINT32 width;
+	UINT32 height;
+};
+typedef struct _H264_TRACE H264_TRACE;
+
+struct _H264_BENCHMARK_SETUP
+{
+	const char* name;
+	UINT32 threads;
+	BOOL frameThreading;
+	BOOL lowDelay;
+	BOOL zeroCopy;
+};
+typedef struct _H264_BENCHMARK_SETUP H264_BENCHMARK_SETUP;
+
+static const H264_BENCHMARK_SETUP h264_benchmark_setups[] =
+{
+	{ "single thread", 1, FALSE, TRUE, TRUE },
+	{ "slice threads", 0, FALSE, TRUE, TRUE },
+	{ "slice threads, copied", 0, FALSE, TRUE, FALSE },
+	{ "slice threads, no low delay", 0, FALSE, FALSE, TRUE },
+	{ "frame threads", 0, TRUE, FALSE, TRUE }
+};
+
+static void h264_trace_free(H264_TRACE* trace)
+{
+	UINT32 index;
+
+	for (index = 0; index < trace->count; index++)
+	{
+		free(trace->frames[index].bs.meta.regionRects);
+		free(trace->frames[index].pdu);
+	}
+
+	free(trace->frames);
+}
+
+static BOOL h264_trace_parse(H264_TRACE* trace, H264_TRACE_FRAME* frame, UINT32 size)
+{
+	UINT32 index;
+	wStream* s;
+	RDPGFX_RECT16* rect;
+	BOOL success = FALSE;
+
+	s = Stream_New(frame->pdu, size);
+
+	if (!s)
+		return FALSE;
+
+	if (Stream_GetRemainingLength(s) < 4)
+		goto out;
+
+	Stream_Read_UINT32(s, frame->bs.meta.numRegionRects);
+
+	if (Stream_GetRemainingLength(s) / 10 < frame->bs.meta.numRegionRects)
+		goto out;
+
+	frame->bs.meta.regionRects = (RDPGFX_RECT16*) calloc(frame->bs.meta.numRegionRects ? frame->bs.meta.numRegionRects : 1,
+			sizeof(RDPGFX_RECT16));
+
+	if (!frame->bs.meta.regionRects)
+		goto out;
+
+	for (index = 0; index < frame->bs.meta.numRegionRects; index++)
+	{
+		rect = &frame->bs.meta.regionRects[index];
+
+		Stream_Read_UINT16(s, rect->left);
+		Stream_Read_UINT16(s, rect->top);
+		Stream_Read_UINT16(s, rect->right);
+		Stream_Read_UINT16(s, rect->bottom);
+
+		if ((rect->left >= rect->right) || (rect->top >= rect->bottom))
+			goto out;
+
+		trace->width = MAX(trace->width, rect->right);
+		trace->height = MAX(trace->height, rect->bottom);
+	}
+
+	/* quantQualityVals */
+	Stream_Seek(s, frame->bs.meta.numRegionRects * 2);
+
+	frame->bs.data = Stream_Pointer(s);
+	frame->bs.length = (UINT32) Stream_GetRemainingLength(s);
+	success = TRUE;
+
+out:
+	Stream_Free(s, FALSE);
+	return success;
+}
+
+static BOOL h264_trace_load(H264_TRACE* trace, const char* filename)
+{
+	FILE* fp;
+	UINT32 size;
+	H264_TRACE_FRAME* frame;
+	H264_TRACE_FRAME* newFrames;
+	BOOL success = TRUE;
+
+	fp = fopen(filename, "rb");
+
+	if (!fp)
+	{
+		printf("failed to open trace %s\n", filename);
+		return FALSE;
+	}
+
+	while (success && (fread(&size, sizeof(size), 1, fp) == 1))
+	{
+		if ((trace->count % 256) == 0)
+		{
+			newFrames = (H264_TRACE_FRAME*) realloc(trace->frames, (trace->count + 256) * sizeof(H264_TRACE_FRAME));
+
+			if (!newFrames)
+			{
+				success = FALSE;
+				break;
+			}
+
+			trace->frames = newFrames;
+		}
+
+		frame = &trace->frames[trace->count];
+		ZeroMemory(frame, sizeof(H264_TRACE_FRAME));
+		frame->pdu = (BYTE*) malloc(size ? size : 1);
+
+		if (!frame->pdu || (fread(frame->pdu, 1, size, fp) != size))
+		{
+			free(frame->pdu);
+			success = FALSE;
+			break;
+		}
+
+		trace->count++;
+		trace->totalSize += size;
+
+		if (!h264_trace_parse(trace, frame, size))
+		{
+			printf("invalid AVC420 bitmap stream %d\n", trace->count - 1);
+			success = FALSE;
+		}
+	}
+
+	fclose(fp);
+
+	return success && (trace->count > 0);
+}
+
+static int h264_benchmark_setup(H264_TRACE* trace, const H264_BENCHMARK_SETUP* setup)
+{
+	int status;
+	UINT32 index;
+	UINT32 passes;
+	UINT32 pass;
+	double decodeTime;
+	STOPWATCH* stopwatch;
+	BYTE* pDstData;
+	BYTE* pDstBuffer;
+	int nDstStep = trace->width * 4;
+	H264_TRACE_FRAME* frame;
+	H264_CONTEXT* h264;
+
+	pDstBuffer = (BYTE*) malloc(nDstStep * trace->height);
+
+	if (!pDstBuffer)
+		return -1;
+
+	stopwatch = stopwatch_create();
+
+	if (!stopwatch)
+	{
+		free(pDstBuffer);
+		return -1;
+	}
+
+	h264 = h264_context_new(FALSE);
+
+	if (!h264)
+	{
+		stopwatch_free(stopwatch);
+		free(pDstBuffer);
+		return -1;
+	}
+
+	h264->NumberOfThreads = setup->threads;
+	h264->FrameThreading = setup->frameThreading;
+	h264->LowDelay = setup->lowDelay;
+	h264->ZeroCopy = setup->zeroCopy;
+
+	passes = (H264_BENCHMARK_MIN_FRAMES + trace->count - 1) / trace->count;
+
+	/* every pass starts with a new decoder, like the recording did */
+	for (pass = 0; pass < passes; pass++)
+	{
+		if (h264_context_reset(h264) < 0)
+		{
+			printf("%s: h264_context_reset failure\n", setup->name);
+			goto fail;
+		}
+
+		stopwatch_start(stopwatch);
+
+		for (index = 0; index < trace->count; index++)
+		{
+			frame = &trace->frames[index];
+			pDstData = pDstBuffer;
+
+			status = h264_decompress(h264, frame->bs.data, frame->bs.length, &pDstData, PIXEL_FORMAT_XRGB32,
+					nDstStep, trace->width, trace->height, frame->bs.meta.regionRects, frame->bs.meta.numRegionRects);
+
+			if (status < 0)
+			{
+				printf("%s: h264_decompress failure %d on frame %d\n", setup->name, status, index);
+				goto fail;
+			}
+		}
+
+		stopwatch_stop(stopwatch);
+	}
+
+	decodeTime = MAX(stopwatch_get_elapsed_time_in_seconds(stopwatch), 0.000001);
+
+	printf("%-28s %-10s %8.2f fps %8.2f MB/s\n", setup->name, h264->subsystem->name,
+			(trace->count * passes) / decodeTime,
+			((trace->totalSize * passes) / (1024.0 * 1024.0)) / decodeTime);
+
+	h264_context_free(h264);
+	stopwatch_free(stopwatch);
+	free(pDstBuffer);
+	return 1;
+
+fail:
+	h264_context_free(h264);
+	stopwatch_free(stopwatch);
+	free(pDstBuffer);
+	return -1;
+}
+
+int TestFreeRDPCodecH264Benchmark(int argc, char* argv[])
+{
+	UINT32 index;
+	int status = 0;
+	H264_TRACE trace;
+
+	ZeroMemory(&trace, sizeof(trace));
+
+	if (argc < 2)
+	{
+		printf("no AVC420 trace given, skipping, set TraceFile under the H264 registry key to record one\n");
+		return 0;
+	}
+
+	if (!h264_trace_load(&trace, argv[1]))
+	{
+		h264_trace_free(&trace);
+		return -1;
+	}
+
+	printf("%d frames, %d bytes, %dx%d\n", trace.count, (UINT32) trace.totalSize, trace.width, trace.height);
+
+	for (index = 0; index < ARRAYSIZE(h264_benchmark_setups); index++)
+	{
+		if (h264_benchmark_setup(&trace, &h264_benchmark_setups[index]) < 0)
+		{
+			status = -1;
+			break;
+		}
+	}
+
+	h264_trace_free(&trace);
+
+	return status;
+}
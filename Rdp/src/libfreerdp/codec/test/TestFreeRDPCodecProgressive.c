@@ -1059,10 +1059,294 @@ int test_progressive_ms_sample(char* ms_sample_path)
 	return 0;
 }
 
+/**
+ * Synthesized streams for comparing the threaded tile decoding with the serial one: the tile data is random,
+ * which RLGR decodes to some coefficients all the same, the decoders only have to agree on the result.
+ */
+
+#define TEST_PROGRESSIVE_WIDTH		256
+#define TEST_PROGRESSIVE_HEIGHT		192
+#define TEST_PROGRESSIVE_GRID_WIDTH	(TEST_PROGRESSIVE_WIDTH / 64)
+#define TEST_PROGRESSIVE_GRID_HEIGHT	(TEST_PROGRESSIVE_HEIGHT / 64)
+#define TEST_PROGRESSIVE_NUM_QUANT	3
+
+struct _TEST_PROGRESSIVE_TILE
+{
+	UINT16 blockType;
+	BYTE quantIdx;
+	UINT16 xIdx;
+	UINT16 yIdx;
+	BYTE flags;
+};
+typedef struct _TEST_PROGRESSIVE_TILE TEST_PROGRESSIVE_TILE;
+
+static const BYTE TEST_PROGRESSIVE_QUANT_VALS[TEST_PROGRESSIVE_NUM_QUANT][5] =
+{
+	{ 0x66, 0x66, 0x66, 0x66, 0x66 },
+	{ 0x76, 0x87, 0x98, 0x6A, 0x77 },
+	{ 0x99, 0x99, 0x99, 0x99, 0x99 }
+};
+
+static UINT32 test_progressive_rand(UINT32* seed)
+{
+	*seed = (*seed * 1103515245) + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+static BYTE* test_progressive_write_block_header(BYTE* p, UINT16 blockType, UINT32 blockLen)
+{
+	*((UINT16*) &p[0]) = blockType;
+	*((UINT32*) &p[2]) = blockLen;
+	return p + 6;
+}
+
+static BYTE* test_progressive_write_tile(BYTE* p, UINT32* seed, const TEST_PROGRESSIVE_TILE* desc)
+{
+	UINT32 index;
+	UINT32 length;
+	UINT16 lengths[3];
+	BYTE* block = p;
+
+	for (index = 0; index < 3; index++)
+		lengths[index] = 64 + (test_progressive_rand(seed) % 448);
+
+	p += 6;
+	p[0] = desc->quantIdx; /* quantIdxY */
+	p[1] = (desc->quantIdx + 1) % TEST_PROGRESSIVE_NUM_QUANT; /* quantIdxCb */
+	p[2] = (desc->quantIdx + 2) % TEST_PROGRESSIVE_NUM_QUANT; /* quantIdxCr */
+	*((UINT16*) &p[3]) = desc->xIdx;
+	*((UINT16*) &p[5]) = desc->yIdx;
+	p[7] = desc->flags;
+	p += 8;
+
+	if (desc->blockType == PROGRESSIVE_WBT_TILE_FIRST)
+		*p++ = 0; /* quality */
+
+	for (index = 0; index < 3; index++)
+	{
+		*((UINT16*) p) = lengths[index];
+		p += 2;
+	}
+
+	*((UINT16*) p) = 0; /* tailLen */
+	p += 2;
+
+	length = lengths[0] + lengths[1] + lengths[2];
+
+	for (index = 0; index < length; index++)
+		*p++ = (BYTE) test_progressive_rand(seed);
+
+	test_progressive_write_block_header(block, desc->blockType, (UINT32) (p - block));
+	return p;
+}
+
+static UINT32 test_progressive_write_frame(BYTE* pSrcData, UINT32* seed, UINT32 frameIndex,
+		const TEST_PROGRESSIVE_TILE* tiles, UINT32 numTiles)
+{
+	UINT32 index;
+	BYTE* region;
+	BYTE* tileData;
+	BYTE* p = pSrcData;
+
+	if (frameIndex == 0)
+	{
+		p = test_progressive_write_block_header(p, PROGRESSIVE_WBT_SYNC, 12);
+		*((UINT32*) &p[0]) = 0xCACCACCA; /* magic */
+		*((UINT16*) &p[4]) = 0x0100; /* version */
+		p += 6;
+
+		p = test_progressive_write_block_header(p, PROGRESSIVE_WBT_CONTEXT, 10);
+		p[0] = 0; /* ctxId */
+		*((UINT16*) &p[1]) = 64; /* tileSize */
+		p[3] = RFX_SUBBAND_DIFFING;
+		p += 4;
+	}
+
+	p = test_progressive_write_block_header(p, PROGRESSIVE_WBT_FRAME_BEGIN, 12);
+	*((UINT32*) &p[0]) = frameIndex;
+	*((UINT16*) &p[4]) = 1; /* regionCount */
+	p += 6;
+
+	region = p;
+	p += 6;
+	p[0] = 64; /* tileSize */
+	*((UINT16*) &p[1]) = 1; /* numRects */
+	p[3] = TEST_PROGRESSIVE_NUM_QUANT; /* numQuant */
+	p[4] = 1; /* numProgQuant */
+	p[5] = RFX_DWT_REDUCE_EXTRAPOLATE; /* flags */
+	*((UINT16*) &p[6]) = (UINT16) numTiles;
+	p += 12;
+
+	*((UINT16*) &p[0]) = 0;
+	*((UINT16*) &p[2]) = 0;
+	*((UINT16*) &p[4]) = TEST_PROGRESSIVE_WIDTH;
+	*((UINT16*) &p[6]) = TEST_PROGRESSIVE_HEIGHT;
+	p += 8;
+
+	for (index = 0; index < TEST_PROGRESSIVE_NUM_QUANT; index++)
+	{
+		CopyMemory(p, TEST_PROGRESSIVE_QUANT_VALS[index], 5);
+		p += 5;
+	}
+
+	ZeroMemory(p, 16); /* quality 0, nothing added to the quantization */
+	p += 16;
+
+	tileData = p;
+
+	for (index = 0; index < numTiles; index++)
+		p = test_progressive_write_tile(p, seed, &tiles[index]);
+
+	*((UINT32*) &region[6 + 8]) = (UINT32) (p - tileData); /* tileDataSize */
+	test_progressive_write_block_header(region, PROGRESSIVE_WBT_REGION, (UINT32) (p - region));
+
+	p = test_progressive_write_block_header(p, PROGRESSIVE_WBT_FRAME_END, 6);
+
+	return (UINT32) (p - pSrcData);
+}
+
+static int test_progressive_compare_tiles(PROGRESSIVE_CONTEXT* serial, PROGRESSIVE_CONTEXT* threaded)
+{
+	UINT32 index;
+	RFX_PROGRESSIVE_TILE* tile[2];
+
+	if (serial->region.numTiles != threaded->region.numTiles)
+		return -1;
+
+	for (index = 0; index < serial->region.numTiles; index++)
+	{
+		tile[0] = serial->region.tiles[index];
+		tile[1] = threaded->region.tiles[index];
+
+		if ((tile[0]->xIdx != tile[1]->xIdx) || (tile[0]->yIdx != tile[1]->yIdx))
+			return -1;
+
+		if (memcmp(tile[0]->data, tile[1]->data, 64 * 64 * 4) != 0)
+			return -1;
+	}
+
+	return 1;
+}
+
+/**
+ * Decodes the same frames with and without the thread pool and compares the tiles byte for byte, the regions
+ * have more than one tile so the pool decodes them in a batch.
+ */
+int test_progressive_threads()
+{
+	int status;
+	UINT32 x, y;
+	UINT32 index;
+	UINT32 frame;
+	UINT32 numTiles;
+	UINT32 SrcSize;
+	UINT32 seed = 0x5678;
+	BYTE* pSrcData;
+	BYTE* pDstData = NULL;
+	PROGRESSIVE_CONTEXT* progressive[2] = { NULL, NULL };
+	TEST_PROGRESSIVE_TILE tiles[(TEST_PROGRESSIVE_GRID_WIDTH * TEST_PROGRESSIVE_GRID_HEIGHT) + 1];
+	int result = -1;
+
+	pSrcData = (BYTE*) malloc(64 * 1024);
+
+	if (!pSrcData)
+		return -1;
+
+	for (index = 0; index < 2; index++)
+	{
+		progressive[index] = progressive_context_new(FALSE);
+
+		if (!progressive[index])
+			goto out;
+
+		if (progressive_create_surface_context(progressive[index], 0, TEST_PROGRESSIVE_WIDTH, TEST_PROGRESSIVE_HEIGHT) < 0)
+			goto out;
+	}
+
+	if (!progressive[1]->UseThreads)
+		printf("progressive threads are disabled, comparing serial decoding with itself\n");
+
+	progressive[0]->UseThreads = FALSE;
+
+	/**
+	 * 0: simple tiles over the whole surface
+	 * 1: first tiles adding differences to every other tile
+	 * 2: simple tiles again, the last one with a quantization index the region does not have, which fails
+	 *    the frame; being the last, the serial decoder has decoded all the others like the pool
+	 * 3: first tiles adding differences, with the first tile listed twice so the region is decoded in order
+	 */
+	for (frame = 0; frame < 4; frame++)
+	{
+		numTiles = 0;
+
+		for (y = 0; y < TEST_PROGRESSIVE_GRID_HEIGHT; y++)
+		{
+			for (x = 0; x < TEST_PROGRESSIVE_GRID_WIDTH; x++)
+			{
+				if ((frame == 1) && ((x + y) % 2))
+					continue;
+
+				tiles[numTiles].blockType = (frame % 2) ? PROGRESSIVE_WBT_TILE_FIRST : PROGRESSIVE_WBT_TILE_SIMPLE;
+				tiles[numTiles].quantIdx = (BYTE) ((x + y) % TEST_PROGRESSIVE_NUM_QUANT);
+				tiles[numTiles].xIdx = (UINT16) x;
+				tiles[numTiles].yIdx = (UINT16) y;
+				tiles[numTiles].flags = (frame % 2) ? RFX_TILE_DIFFERENCE : 0;
+				numTiles++;
+			}
+		}
+
+		if (frame == 2)
+			tiles[numTiles - 1].quantIdx = TEST_PROGRESSIVE_NUM_QUANT + 2;
+
+		if (frame == 3)
+			tiles[numTiles++] = tiles[0];
+
+		SrcSize = test_progressive_write_frame(pSrcData, &seed, frame, tiles, numTiles);
+
+		for (index = 0; index < 2; index++)
+		{
+			status = progressive_decompress(progressive[index], pSrcData, SrcSize, &pDstData, PIXEL_FORMAT_XRGB32,
+					0, 0, 0, TEST_PROGRESSIVE_WIDTH, TEST_PROGRESSIVE_HEIGHT, 0);
+
+			if ((frame == 2) != (status < 0))
+			{
+				printf("progressive_decompress %s unexpected status: %d in frame %d\n", index ? "threaded" : "serial", status, frame);
+				goto out;
+			}
+		}
+
+		if (frame == 2)
+			continue;
+
+		if (test_progressive_compare_tiles(progressive[0], progressive[1]) < 0)
+		{
+			printf("progressive threaded and serial tiles differ in frame %d\n", frame);
+			goto out;
+		}
+	}
+
+	result = 1;
+
+out:
+	for (index = 0; index < 2; index++)
+	{
+		if (progressive[index])
+			progressive_delete_surface_context(progressive[index], 0);
+
+		progressive_context_free(progressive[index]);
+	}
+
+	free(pSrcData);
+	return result;
+}
+
 int TestFreeRDPCodecProgressive(int argc, char* argv[])
 {
 	char* ms_sample_path;
 
+	if (test_progressive_threads() < 0)
+		return -1;
+
 	ms_sample_path = GetKnownSubPath(KNOWN_PATH_TEMP, "EGFX_PROGRESSIVE_MS_SAMPLE");
 	if (!ms_sample_path)
 	{
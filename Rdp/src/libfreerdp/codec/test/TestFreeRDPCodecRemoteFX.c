@@ -1,9 +1,21 @@
 #include <winpr/crt.h>
+#include <winpr/pool.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
+#include <freerdp/primitives.h>
 #include <freerdp/codec/rfx.h>
 
+#include "../rfx_types.h"
+#include "../rfx_decode.h"
+#include "../rfx_quantization.h"
+#include "../rfx_dwt.h"
+#include "../rfx_sse2.h"
+#include "../rfx_avx2.h"
+#include "../parallel.h"
+#include "../../primitives/prim_colors.h"
+
 /**
  * The following is an annotated dump of a TS_RFX_TILESET message containing a single encoded 64x64 tile.
  *
@@ -756,7 +768,592 @@ const UINT32 TEST_RFX_XRGB_IMAGE[4096] =
 	0x00169ff8, 0x00159ef7, 0x00149df7, 0x00139cf6, 0x00129bf5, 0x00129bf5, 0x00129bf5, 0x00129bf5
 };
 
-int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
+/**
+ * Decodes the tile above with the plain C, the SSE2 and, where the processor supports it, the
+ * AVX2 routines of the decoding pipeline: quantization decode and inverse DWT on the context,
+ * YCbCr to RGB and the packing to BGRA from the primitives. Each must give the reference image,
+ * the SIMD ones must agree with each other bit for bit on random input as well, then the stages
+ * are timed against each other.
+ */
+
+#define RFX_BENCHMARK_ITERATIONS	20000
+#define RFX_BENCHMARK_TILES		2000
+
+struct _RFX_TEST_KERNELS
+{
+	const char* name;
+	void (*quantization_decode)(INT16* buffer, const UINT32* quantization_values);
+	void (*dwt_2d_decode)(INT16* buffer, INT16* dwt_buffer);
+	__yCbCrToRGB_16s16s_P3P3_t yCbCrToRGB_16s16s_P3P3;
+	__RGBToRGB_16s8u_P3AC4R_t RGBToRGB_16s8u_P3AC4R;
+};
+typedef struct _RFX_TEST_KERNELS RFX_TEST_KERNELS;
+
+static const prim_size_t rfx_test_roi = { 64, 64 };
+
+static UINT32 rfx_test_random(UINT32* seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+static void rfx_test_use_kernels(RFX_CONTEXT* context, const RFX_TEST_KERNELS* kernels)
+{
+	primitives_t* prims = primitives_get();
+
+	context->quantization_decode = kernels->quantization_decode;
+	context->dwt_2d_decode = kernels->dwt_2d_decode;
+	prims->yCbCrToRGB_16s16s_P3P3 = kernels->yCbCrToRGB_16s16s_P3P3;
+	prims->RGBToRGB_16s8u_P3AC4R = kernels->RGBToRGB_16s8u_P3AC4R;
+}
+
+static int rfx_test_collect_kernels(RFX_CONTEXT* context, RFX_TEST_KERNELS* kernels)
+{
+	int count = 0;
+
+	kernels[count].name = "C";
+	kernels[count].quantization_decode = rfx_quantization_decode;
+	kernels[count].dwt_2d_decode = rfx_dwt_2d_decode;
+	kernels[count].yCbCrToRGB_16s16s_P3P3 = general_yCbCrToRGB_16s16s_P3P3;
+	kernels[count].RGBToRGB_16s8u_P3AC4R = general_RGBToRGB_16s8u_P3AC4R;
+	count++;
+
+#ifdef WITH_SSE2
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+	{
+		rfx_init_sse2(context);
+		kernels[count].name = "SSE2";
+		kernels[count].quantization_decode = context->quantization_decode;
+		kernels[count].dwt_2d_decode = context->dwt_2d_decode;
+		kernels[count].yCbCrToRGB_16s16s_P3P3 = sse2_yCbCrToRGB_16s16s_P3P3;
+		kernels[count].RGBToRGB_16s8u_P3AC4R = sse2_RGBToRGB_16s8u_P3AC4R;
+		count++;
+	}
+#endif
+
+#ifdef WITH_AVX2
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		rfx_init_avx2(context);
+		kernels[count].name = "AVX2";
+		kernels[count].quantization_decode = context->quantization_decode;
+		kernels[count].dwt_2d_decode = context->dwt_2d_decode;
+		kernels[count].yCbCrToRGB_16s16s_P3P3 = avx2_yCbCrToRGB_16s16s_P3P3;
+		kernels[count].RGBToRGB_16s8u_P3AC4R = avx2_RGBToRGB_16s8u_P3AC4R;
+		count++;
+	}
+#endif
+
+	return count;
+}
+
+/**
+ * The tile as rfx_process_message_tileset reads it, see the dump above: YData starts at
+ * offset 46, after the 27 bytes of the tileset header and the 19 of the tile header.
+ */
+static BOOL rfx_test_setup_tile(RFX_CONTEXT* context, RFX_TILE* tile)
+{
+	int i;
+	const BYTE* quantVals = &TEST_RFX_TILESET[22];
+
+	context->mode = RLGR3;
+	context->numQuant = 1;
+	context->quants = (UINT32*) malloc(10 * sizeof(UINT32));
+
+	if (!context->quants)
+		return FALSE;
+
+	for (i = 0; i < 5; i++)
+	{
+		context->quants[i * 2] = quantVals[i] & 0x0F;
+		context->quants[i * 2 + 1] = quantVals[i] >> 4;
+	}
+
+	ZeroMemory(tile, sizeof(RFX_TILE));
+	tile->YLen = 942;
+	tile->CbLen = 975;
+	tile->CrLen = 915;
+	tile->YData = (BYTE*) &TEST_RFX_TILESET[46];
+	tile->CbData = tile->YData + tile->YLen;
+	tile->CrData = tile->CbData + tile->CbLen;
+
+	return TRUE;
+}
+
+/**
+ * The reference image was made with a YCbCr conversion which rounds differently,
+ * each channel may be off by one.
+ */
+static BOOL rfx_test_pixel_matches(UINT32 pixel, UINT32 reference)
+{
+	int shift;
+	int delta;
+
+	for (shift = 0; shift < 24; shift += 8)
+	{
+		delta = (int) ((pixel >> shift) & 0xFF) - (int) ((reference >> shift) & 0xFF);
+
+		if (delta < -1 || delta > 1)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int rfx_test_decode_tile(RFX_CONTEXT* context, RFX_TILE* tile, const RFX_TEST_KERNELS* kernels, UINT32* image)
+{
+	int i;
+	int mismatches = 0;
+
+	rfx_test_use_kernels(context, kernels);
+	ZeroMemory(image, 4096 * sizeof(UINT32));
+	rfx_decode_rgb(context, tile, (BYTE*) image, 64 * sizeof(UINT32));
+
+	for (i = 0; i < 4096; i++)
+	{
+		if (!rfx_test_pixel_matches(image[i], TEST_RFX_XRGB_IMAGE[i]))
+		{
+			if (mismatches++ < 4)
+			{
+				printf("%s: pixel %d,%d is 0x%06X instead of 0x%06X\n", kernels->name, i % 64, i / 64,
+					image[i] & 0x00FFFFFF, TEST_RFX_XRGB_IMAGE[i]);
+			}
+		}
+	}
+
+	if (mismatches)
+		printf("%s: %d pixels differ from the reference image\n", kernels->name, mismatches);
+
+	return mismatches ? -1 : 0;
+}
+
+/**
+ * The SIMD routines have to give the same result as the first one passed on random input,
+ * including coefficients outside of what a valid tile holds.
+ */
+static int rfx_test_compare_kernels(const RFX_TEST_KERNELS* reference, const RFX_TEST_KERNELS* kernels,
+	const UINT32* quants)
+{
+	int i, n;
+	int status = 0;
+	UINT32 seed = 0x2A;
+	INT16* input;
+	INT16* buffers[2];
+	INT16* dwt;
+	BYTE* rgb[2];
+	const INT16* pSrc[3];
+	INT16* pDst[2][3];
+	const RFX_TEST_KERNELS* order[2];
+
+	order[0] = reference;
+	order[1] = kernels;
+	input = (INT16*) _aligned_malloc(4096 * 3 * sizeof(INT16), 32);
+	buffers[0] = (INT16*) _aligned_malloc(4096 * 3 * sizeof(INT16), 32);
+	buffers[1] = (INT16*) _aligned_malloc(4096 * 3 * sizeof(INT16), 32);
+	dwt = (INT16*) _aligned_malloc(4096 * sizeof(INT16), 32);
+	rgb[0] = (BYTE*) _aligned_malloc(4096 * sizeof(UINT32), 32);
+	rgb[1] = (BYTE*) _aligned_malloc(4096 * sizeof(UINT32), 32);
+
+	if (!input || !buffers[0] || !buffers[1] || !dwt || !rgb[0] || !rgb[1])
+	{
+		status = -1;
+		goto fail;
+	}
+
+	for (i = 0; i < 4096 * 3; i++)
+		input[i] = (INT16) (rfx_test_random(&seed) % 1024) - 512;
+
+	for (n = 0; n < 2; n++)
+	{
+		CopyMemory(buffers[n], input, 4096 * sizeof(INT16));
+		order[n]->quantization_decode(buffers[n], quants);
+	}
+
+	if (memcmp(buffers[0], buffers[1], 4096 * sizeof(INT16)) != 0)
+	{
+		printf("%s: quantization_decode differs from %s\n", kernels->name, reference->name);
+		status = -1;
+	}
+
+	for (n = 0; n < 2; n++)
+	{
+		CopyMemory(buffers[n], input, 4096 * sizeof(INT16));
+		order[n]->dwt_2d_decode(buffers[n], dwt);
+	}
+
+	if (memcmp(buffers[0], buffers[1], 4096 * sizeof(INT16)) != 0)
+	{
+		printf("%s: dwt_2d_decode differs from %s\n", kernels->name, reference->name);
+		status = -1;
+	}
+
+	/* YCbCr in 11.5 fixed point, results outside of 0..255 are clamped */
+	for (i = 0; i < 4096 * 3; i++)
+		input[i] = (INT16) ((rfx_test_random(&seed) % 12288) - 6144);
+
+	for (n = 0; n < 2; n++)
+	{
+		pSrc[0] = input;
+		pSrc[1] = input + 4096;
+		pSrc[2] = input + 8192;
+		pDst[n][0] = buffers[n];
+		pDst[n][1] = buffers[n] + 4096;
+		pDst[n][2] = buffers[n] + 8192;
+		order[n]->yCbCrToRGB_16s16s_P3P3(pSrc, 64 * sizeof(INT16), pDst[n], 64 * sizeof(INT16), &rfx_test_roi);
+	}
+
+	if (memcmp(buffers[0], buffers[1], 4096 * 3 * sizeof(INT16)) != 0)
+	{
+		printf("%s: yCbCrToRGB_16s16s_P3P3 differs from %s\n", kernels->name, reference->name);
+		status = -1;
+	}
+
+	for (n = 0; n < 2; n++)
+		order[n]->RGBToRGB_16s8u_P3AC4R((const INT16**) pDst[0], 64 * sizeof(INT16), rgb[n], 64 * sizeof(UINT32), &rfx_test_roi);
+
+	if (memcmp(rgb[0], rgb[1], 4096 * sizeof(UINT32)) != 0)
+	{
+		printf("%s: RGBToRGB_16s8u_P3AC4R differs from %s\n", kernels->name, reference->name);
+		status = -1;
+	}
+
+fail:
+	_aligned_free(input);
+	_aligned_free(buffers[0]);
+	_aligned_free(buffers[1]);
+	_aligned_free(dwt);
+	_aligned_free(rgb[0]);
+	_aligned_free(rgb[1]);
+	return status;
+}
+
+static double rfx_test_microseconds(UINT64 start, UINT64 end, int iterations)
+{
+	return (end - start) * 1000.0 / iterations;
+}
+
+static void rfx_test_benchmark(RFX_CONTEXT* context, RFX_TILE* tile, const RFX_TEST_KERNELS* kernels,
+	UINT32* image, double* times)
+{
+	int i;
+	UINT64 start;
+	INT16* buffer;
+	INT16* dwt;
+	const INT16* pSrc[3];
+	INT16* pDst[3];
+
+	buffer = (INT16*) _aligned_malloc(4096 * 3 * sizeof(INT16), 32);
+	dwt = (INT16*) _aligned_malloc(4096 * sizeof(INT16), 32);
+
+	if (!buffer || !dwt)
+		goto fail;
+
+	ZeroMemory(buffer, 4096 * 3 * sizeof(INT16));
+	pSrc[0] = pDst[0] = buffer;
+	pSrc[1] = pDst[1] = buffer + 4096;
+	pSrc[2] = pDst[2] = buffer + 8192;
+
+	start = GetTickCount64();
+
+	for (i = 0; i < RFX_BENCHMARK_ITERATIONS; i++)
+		kernels->quantization_decode(buffer, context->quants);
+
+	times[0] = rfx_test_microseconds(start, GetTickCount64(), RFX_BENCHMARK_ITERATIONS);
+	start = GetTickCount64();
+
+	for (i = 0; i < RFX_BENCHMARK_ITERATIONS; i++)
+		kernels->dwt_2d_decode(buffer, dwt);
+
+	times[1] = rfx_test_microseconds(start, GetTickCount64(), RFX_BENCHMARK_ITERATIONS);
+	start = GetTickCount64();
+
+	for (i = 0; i < RFX_BENCHMARK_ITERATIONS; i++)
+		kernels->yCbCrToRGB_16s16s_P3P3(pSrc, 64 * sizeof(INT16), pDst, 64 * sizeof(INT16), &rfx_test_roi);
+
+	times[2] = rfx_test_microseconds(start, GetTickCount64(), RFX_BENCHMARK_ITERATIONS);
+	start = GetTickCount64();
+
+	for (i = 0; i < RFX_BENCHMARK_ITERATIONS; i++)
+		kernels->RGBToRGB_16s8u_P3AC4R(pSrc, 64 * sizeof(INT16), (BYTE*) image, 64 * sizeof(UINT32), &rfx_test_roi);
+
+	times[3] = rfx_test_microseconds(start, GetTickCount64(), RFX_BENCHMARK_ITERATIONS);
+
+	/* the whole tile, including the RLGR decoding which has no SIMD version */
+	rfx_test_use_kernels(context, kernels);
+	start = GetTickCount64();
+
+	for (i = 0; i < RFX_BENCHMARK_TILES; i++)
+		rfx_decode_rgb(context, tile, (BYTE*) image, 64 * sizeof(UINT32));
+
+	times[4] = rfx_test_microseconds(start, GetTickCount64(), RFX_BENCHMARK_TILES);
+
+fail:
+	_aligned_free(buffer);
+	_aligned_free(dwt);
+}
+
+/**
+ * A 960x512 frame of 120 tiles decoded on a private pool with 1 to 16 threads, with one work
+ * object per tile as rfx_process_message did before, and in one batch through codec_parallel_for
+ * as it does now. Each frame must hold the tile decoded on the calling thread in every position.
+ * Beyond the number of processors the times only show the overhead of the pool.
+ */
+
+#define RFX_SCALING_FRAMES		100
+#define RFX_SCALING_TILES_X		15
+#define RFX_SCALING_TILES_Y		8
+#define RFX_SCALING_TILES		(RFX_SCALING_TILES_X * RFX_SCALING_TILES_Y)
+#define RFX_SCALING_STRIDE		(RFX_SCALING_TILES_X * 64 * sizeof(UINT32))
+
+struct _RFX_TEST_TILE_WORK
+{
+	RFX_CONTEXT* context;
+	RFX_TILE* tile;
+	BYTE* dst;
+};
+typedef struct _RFX_TEST_TILE_WORK RFX_TEST_TILE_WORK;
+
+static void rfx_test_decode_tile_index(void* param, UINT32 index)
+{
+	RFX_TEST_TILE_WORK* work = &((RFX_TEST_TILE_WORK*) param)[index];
+
+	rfx_decode_rgb(work->context, work->tile, work->dst, RFX_SCALING_STRIDE);
+}
+
+static void CALLBACK rfx_test_tile_work_callback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
 {
+	rfx_test_decode_tile_index(context, 0);
+}
+
+static int rfx_test_check_frame(const BYTE* frame, const UINT32* image)
+{
+	int i, y;
+	const BYTE* dst;
+
+	for (i = 0; i < RFX_SCALING_TILES; i++)
+	{
+		dst = frame + (i / RFX_SCALING_TILES_X) * 64 * RFX_SCALING_STRIDE + (i % RFX_SCALING_TILES_X) * 64 * 4;
+
+		for (y = 0; y < 64; y++)
+		{
+			if (memcmp(dst + y * RFX_SCALING_STRIDE, &image[y * 64], 64 * sizeof(UINT32)) != 0)
+			{
+				printf("tile %d differs in row %d\n", i, y);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void rfx_test_decode_frames(PTP_CALLBACK_ENVIRON environment, DWORD threads, BOOL batched,
+	RFX_TEST_TILE_WORK* params, double* elapsed)
+{
+	int n;
+	int frame;
+	UINT64 start;
+	PTP_WORK works[RFX_SCALING_TILES];
+
+	start = GetTickCount64();
+
+	for (frame = 0; frame < RFX_SCALING_FRAMES; frame++)
+	{
+		if (batched)
+		{
+			codec_parallel_for(environment, threads, RFX_SCALING_TILES, rfx_test_decode_tile_index,
+				(void*) params, NULL, NULL);
+			continue;
+		}
+
+		for (n = 0; n < RFX_SCALING_TILES; n++)
+		{
+			if (!(works[n] = CreateThreadpoolWork((PTP_WORK_CALLBACK) rfx_test_tile_work_callback,
+					(void*) &params[n], environment)))
+				break;
+
+			SubmitThreadpoolWork(works[n]);
+		}
+
+		while (n-- > 0)
+		{
+			WaitForThreadpoolWorkCallbacks(works[n], FALSE);
+			CloseThreadpoolWork(works[n]);
+		}
+	}
+
+	*elapsed = (double) (GetTickCount64() - start) / RFX_SCALING_FRAMES;
+}
+
+static int rfx_test_thread_scaling(RFX_CONTEXT* context, RFX_TILE* tile, const UINT32* image)
+{
+	int i;
+	int status = 0;
+	DWORD threads;
+	double single[2] = { 0.0, 0.0 };
+	double elapsed[2];
+	BYTE* frameBuffer;
+	PTP_POOL pool;
+	TP_CALLBACK_ENVIRON environment;
+	RFX_TEST_TILE_WORK params[RFX_SCALING_TILES];
+	SYSTEM_INFO info;
+
+	frameBuffer = (BYTE*) _aligned_malloc(RFX_SCALING_TILES_Y * 64 * RFX_SCALING_STRIDE, 32);
+
+	if (!frameBuffer)
+		return -1;
+
+	for (i = 0; i < RFX_SCALING_TILES; i++)
+	{
+		params[i].context = context;
+		params[i].tile = tile;
+		params[i].dst = frameBuffer + (i / RFX_SCALING_TILES_X) * 64 * RFX_SCALING_STRIDE +
+			(i % RFX_SCALING_TILES_X) * 64 * 4;
+	}
+
+	GetNativeSystemInfo(&info);
+	printf("\n%d tiles per frame, %u processors\n", RFX_SCALING_TILES, (unsigned) info.dwNumberOfProcessors);
+	printf("%-8s%20s%20s\n", "threads", "per tile ms/frame", "batched ms/frame");
+
+	for (threads = 1; threads <= 16; threads *= 2)
+	{
+		if (!(pool = CreateThreadpool(NULL)))
+			goto fail;
+
+		SetThreadpoolThreadMaximum(pool, threads);
+
+		if (!SetThreadpoolThreadMinimum(pool, threads))
+		{
+			CloseThreadpool(pool);
+			goto fail;
+		}
+
+		InitializeThreadpoolEnvironment(&environment);
+		SetThreadpoolCallbackPool(&environment, pool);
+
+		for (i = 0; (i < 2) && (status == 0); i++)
+		{
+			ZeroMemory(frameBuffer, RFX_SCALING_TILES_Y * 64 * RFX_SCALING_STRIDE);
+			rfx_test_decode_frames(&environment, threads, i ? TRUE : FALSE, params, &elapsed[i]);
+
+			if (rfx_test_check_frame(frameBuffer, image) < 0)
+			{
+				printf("%u threads, %s: wrong frame\n", (unsigned) threads, i ? "batched" : "per tile");
+				status = -1;
+			}
+		}
+
+		DestroyThreadpoolEnvironment(&environment);
+		CloseThreadpool(pool);
+
+		if (status < 0)
+			goto fail;
+
+		if (threads == 1)
+		{
+			single[0] = elapsed[0];
+			single[1] = elapsed[1];
+		}
+
+		printf("%-8u", (unsigned) threads);
+
+		for (i = 0; i < 2; i++)
+			printf("%11.3f (%5.2fx)", elapsed[i], (elapsed[i] > 0) ? single[i] / elapsed[i] : 0.0);
+
+		printf("\n");
+	}
+
+	_aligned_free(frameBuffer);
 	return 0;
+
+fail:
+	_aligned_free(frameBuffer);
+	return -1;
+}
+
+int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
+{
+	int i, j;
+	int count;
+	int status = 0;
+	int baseline;
+	RFX_TILE tile;
+	RFX_CONTEXT* context;
+	RFX_TEST_KERNELS kernels[3];
+	RFX_TEST_KERNELS saved;
+	double times[3][5];
+	UINT32* image;
+	primitives_t* prims = primitives_get();
+	static const char* stages[5] = { "quantization_decode", "dwt_2d_decode", "yCbCrToRGB", "RGBToRGB", "tile" };
+
+	context = rfx_context_new(FALSE);
+	image = (UINT32*) _aligned_malloc(4096 * sizeof(UINT32), 32);
+
+	if (!context || !image || !rfx_test_setup_tile(context, &tile))
+	{
+		printf("failed to create the context\n");
+		status = -1;
+		goto fail;
+	}
+
+	saved.name = "default";
+	saved.quantization_decode = context->quantization_decode;
+	saved.dwt_2d_decode = context->dwt_2d_decode;
+	saved.yCbCrToRGB_16s16s_P3P3 = prims->yCbCrToRGB_16s16s_P3P3;
+	saved.RGBToRGB_16s8u_P3AC4R = prims->RGBToRGB_16s8u_P3AC4R;
+
+	count = rfx_test_collect_kernels(context, kernels);
+
+	for (i = 0; i < count; i++)
+	{
+		if (rfx_test_decode_tile(context, &tile, &kernels[i], image) < 0)
+			status = -1;
+
+		/* the plain C YCbCr conversion rounds differently, the SIMD ones are compared to SSE2 */
+		if (i > 1 && rfx_test_compare_kernels(&kernels[1], &kernels[i], context->quants) < 0)
+			status = -1;
+	}
+
+	if (status < 0)
+		goto restore;
+
+	for (i = 0; i < count; i++)
+		rfx_test_benchmark(context, &tile, &kernels[i], image, times[i]);
+
+	baseline = (count > 1) ? 1 : 0;
+	printf("%-20s", "us per 64x64");
+
+	for (i = 0; i < count; i++)
+		printf("%12s", kernels[i].name);
+
+	printf("\n");
+
+	for (j = 0; j < 5; j++)
+	{
+		printf("%-20s", stages[j]);
+
+		for (i = 0; i < count; i++)
+			printf("%12.3f", times[i][j]);
+
+		if (count > 2 && times[2][j] > 0)
+			printf("   %s %.2fx", kernels[2].name, times[baseline][j] / times[2][j]);
+
+		printf("\n");
+	}
+
+restore:
+	rfx_test_use_kernels(context, &saved);
+
+	if (status == 0)
+	{
+		rfx_decode_rgb(context, &tile, (BYTE*) image, 64 * sizeof(UINT32));
+
+		if (rfx_test_thread_scaling(context, &tile, image) < 0)
+			status = -1;
+	}
+
+fail:
+	rfx_context_free(context);
+	_aligned_free(image);
+	return status;
 }
@@ -3,8 +3,273 @@
 
 #include <freerdp/codec/zgfx.h>
 
+static const char TEST_ZGFX_TEXT[] =
+	"for.whom.the.bell.tolls,.the.bell.tolls.for.thee!"
+	"for.whom.the.bell.tolls,.the.bell.tolls.for.thee!";
+
+/* literals a, b and the short code of 0x00, a match of 10 at distance 3, 4 unencoded bytes, a match of 3 at distance 1 */
+static BYTE TEST_ZGFX_TOKENS_COMPRESSED[] =
+{
+	0xE0, 0x24, 0x30, 0x98, 0xB1, 0x11, 0xE5, 0x10, 0x00, 0x04, 0x57, 0x58, 0x59, 0x5A, 0x88, 0x40,
+	0x05
+};
+
+static BYTE TEST_ZGFX_TOKENS_DECOMPRESSED[] =
+{
+	0x61, 0x62, 0x00, 0x61, 0x62, 0x00, 0x61, 0x62, 0x00, 0x61, 0x62, 0x00, 0x61, 0x57, 0x58, 0x59,
+	0x5A, 0x5A, 0x5A, 0x5A
+};
+
+static BYTE* test_zgfx_surface_data(UINT32 size)
+{
+	UINT32 index;
+	BYTE* data;
+
+	/* rows of a gradient with a few changing pixels, roughly what a surface command carries */
+	data = (BYTE*) malloc(size);
+
+	if (!data)
+		return NULL;
+
+	for (index = 0; index < size; index++)
+		data[index] = (BYTE) (((index % 4096) / 16) + (((index * 2654435761U) >> 28) == 0 ? index : 0));
+
+	return data;
+}
+
+static int test_zgfx_round_trip(ZGFX_CONTEXT* compressor, ZGFX_CONTEXT* decompressor,
+		BYTE* pSrcData, UINT32 SrcSize, UINT32* pCompressedSize, BYTE* pDescriptor)
+{
+	int status;
+	UINT32 Flags;
+	UINT32 DstSize;
+	BYTE* pDstData = NULL;
+	UINT32 OutSize;
+	BYTE* pOutData = NULL;
+
+	status = zgfx_compress(compressor, pSrcData, SrcSize, &pDstData, &DstSize, &Flags);
+
+	if (status < 0)
+	{
+		printf("zgfx_compress failure: %d\n", status);
+		return -1;
+	}
+
+	status = zgfx_decompress(decompressor, pDstData, DstSize, &pOutData, &OutSize, 0);
+
+	if (status < 0)
+	{
+		printf("zgfx_decompress failure: %d\n", status);
+		free(pDstData);
+		return -1;
+	}
+
+	if ((OutSize != SrcSize) || (memcmp(pOutData, pSrcData, SrcSize) != 0))
+	{
+		printf("zgfx round trip mismatch: Actual: %d, Expected: %d\n", OutSize, SrcSize);
+		free(pDstData);
+		free(pOutData);
+		return -1;
+	}
+
+	if (pCompressedSize)
+		*pCompressedSize = DstSize;
+
+	if (pDescriptor)
+		*pDescriptor = pDstData[0];
+
+	free(pDstData);
+	free(pOutData);
+
+	return 1;
+}
+
+int test_ZGfxDecompressTokens()
+{
+	int status;
+	UINT32 DstSize;
+	BYTE* pDstData = NULL;
+	ZGFX_CONTEXT* zgfx = zgfx_context_new(FALSE);
+
+	status = zgfx_decompress(zgfx, TEST_ZGFX_TOKENS_COMPRESSED, sizeof(TEST_ZGFX_TOKENS_COMPRESSED), &pDstData, &DstSize, 0);
+
+	if (status < 0)
+	{
+		printf("ZGfxDecompressTokens: zgfx_decompress failure: %d\n", status);
+	}
+	else if ((DstSize != sizeof(TEST_ZGFX_TOKENS_DECOMPRESSED)) ||
+		(memcmp(pDstData, TEST_ZGFX_TOKENS_DECOMPRESSED, DstSize) != 0))
+	{
+		printf("ZGfxDecompressTokens: output mismatch\n");
+		status = -1;
+	}
+
+	free(pDstData);
+	zgfx_context_free(zgfx);
+
+	return status;
+}
+
+int test_ZGfxCompressText()
+{
+	int status;
+	BYTE descriptor;
+	UINT32 compressedSize;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	status = test_zgfx_round_trip(compressor, decompressor, (BYTE*) TEST_ZGFX_TEXT,
+			sizeof(TEST_ZGFX_TEXT) - 1, &compressedSize, &descriptor);
+
+	if ((status > 0) && ((descriptor != ZGFX_SEGMENTED_SINGLE) || (compressedSize >= sizeof(TEST_ZGFX_TEXT) - 1)))
+	{
+		printf("ZGfxCompressText: descriptor 0x%02X size %d\n", descriptor, compressedSize);
+		status = -1;
+	}
+
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+
+	return status;
+}
+
+int test_ZGfxCompressMultipart()
+{
+	int level;
+	int status = 1;
+	BYTE descriptor;
+	UINT32 compressedSize;
+	UINT32 size = 300000;
+	BYTE* data = test_zgfx_surface_data(size);
+	ZGFX_CONTEXT* compressor;
+	ZGFX_CONTEXT* decompressor;
+
+	if (!data)
+		return -1;
+
+	for (level = ZGFX_COMPRESSION_LEVEL_NONE; (level <= ZGFX_COMPRESSION_LEVEL_MAX) && (status > 0); level++)
+	{
+		compressor = zgfx_context_new(TRUE);
+		decompressor = zgfx_context_new(FALSE);
+		zgfx_set_compression_level(compressor, level);
+
+		status = test_zgfx_round_trip(compressor, decompressor, data, size, &compressedSize, &descriptor);
+
+		if ((status > 0) && (descriptor != ZGFX_SEGMENTED_MULTIPART))
+		{
+			printf("ZGfxCompressMultipart: level %d descriptor 0x%02X\n", level, descriptor);
+			status = -1;
+		}
+
+		if ((status > 0) && (level > ZGFX_COMPRESSION_LEVEL_NONE) && (compressedSize > size / 2))
+		{
+			printf("ZGfxCompressMultipart: level %d size %d of %d\n", level, compressedSize, size);
+			status = -1;
+		}
+
+		zgfx_context_free(compressor);
+		zgfx_context_free(decompressor);
+	}
+
+	free(data);
+
+	return status;
+}
+
+int test_ZGfxCompressHistory()
+{
+	int index;
+	int status = 1;
+	UINT32 firstSize = 0;
+	UINT32 compressedSize = 0;
+	UINT32 size = 100000;
+	BYTE* data = test_zgfx_surface_data(size);
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!data)
+		return -1;
+
+	/* the history outlives the pdu, later copies of the same data reduce to matches */
+	for (index = 0; (index < 40) && (status > 0); index++)
+	{
+		data[(index * 7919) % size]++;
+		status = test_zgfx_round_trip(compressor, decompressor, data, size, &compressedSize, NULL);
+
+		if (index == 0)
+			firstSize = compressedSize;
+	}
+
+	if ((status > 0) && (compressedSize * 10 > firstSize))
+	{
+		printf("ZGfxCompressHistory: repeated pdu %d bytes, first %d bytes\n", compressedSize, firstSize);
+		status = -1;
+	}
+
+	free(data);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+
+	return status;
+}
+
+int test_ZGfxCompressIncompressible()
+{
+	UINT32 index;
+	int status;
+	UINT32 compressedSize;
+	UINT32 size = 150000;
+	BYTE* data = (BYTE*) malloc(size);
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!data)
+		return -1;
+
+	srand(1);
+
+	for (index = 0; index < size; index++)
+		data[index] = (BYTE) rand();
+
+	/* segments which do not shrink go out raw */
+	status = test_zgfx_round_trip(compressor, decompressor, data, size, &compressedSize, NULL);
+
+	if ((status > 0) && (compressedSize > size + 7 + 3 * 5))
+	{
+		printf("ZGfxCompressIncompressible: expanded to %d of %d\n", compressedSize, size);
+		status = -1;
+	}
+
+	/* as are the empty and the one byte pdu */
+	if (status > 0)
+		status = test_zgfx_round_trip(compressor, decompressor, data, 0, NULL, NULL);
+
+	if (status > 0)
+		status = test_zgfx_round_trip(compressor, decompressor, data, 1, NULL, NULL);
+
+	free(data);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+
+	return status;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
+	if (test_ZGfxDecompressTokens() < 0)
+		return -1;
+
+	if (test_ZGfxCompressText() < 0)
+		return -1;
+
+	if (test_ZGfxCompressMultipart() < 0)
+		return -1;
+
+	if (test_ZGfxCompressHistory() < 0)
+		return -1;
+
+	if (test_ZGfxCompressIncompressible() < 0)
+		return -1;
+
 	return 0;
 }
-
@@ -0,0 +1,332 @@
+#include <winpr/crt.h>
+#include <winpr/print.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/zgfx.h>
+
+/**
+ * Throughput and ratio of the ZGFX compressor at each level, and decompressor throughput.
+ *
+ * TestFreeRDPCodecZGfxBenchmark [trace]
+ *
+ * A trace is what the tiragfx channel received, each pdu as a little endian UINT32 length and
+ * the pdu. Pdus still in RDP_SEGMENTED_DATA are timed through the decompressor as recorded,
+ * then decompressed so the compressor sees the GFX pdus the server started from. Without a
+ * trace synthetic surface updates are used.
+ */
+
+#define ZGFX_BENCHMARK_MIN_BYTES	(64 * 1024 * 1024)
+
+struct _ZGFX_TRACE
+{
+	UINT32 count;
+	BYTE** data;
+	UINT32* size;
+	UINT64 totalSize;
+};
+typedef struct _ZGFX_TRACE ZGFX_TRACE;
+
+static BOOL zgfx_trace_add(ZGFX_TRACE* trace, BYTE* data, UINT32 size)
+{
+	BYTE** newData;
+	UINT32* newSize;
+
+	if ((trace->count % 256) == 0)
+	{
+		newData = (BYTE**) realloc(trace->data, (trace->count + 256) * sizeof(BYTE*));
+
+		if (!newData)
+			return FALSE;
+
+		trace->data = newData;
+		newSize = (UINT32*) realloc(trace->size, (trace->count + 256) * sizeof(UINT32));
+
+		if (!newSize)
+			return FALSE;
+
+		trace->size = newSize;
+	}
+
+	trace->data[trace->count] = data;
+	trace->size[trace->count] = size;
+	trace->count++;
+	trace->totalSize += size;
+
+	return TRUE;
+}
+
+static void zgfx_trace_free(ZGFX_TRACE* trace)
+{
+	UINT32 index;
+
+	for (index = 0; index < trace->count; index++)
+		free(trace->data[index]);
+
+	free(trace->data);
+	free(trace->size);
+}
+
+static BOOL zgfx_trace_load(ZGFX_TRACE* trace, ZGFX_TRACE* recorded, const char* filename)
+{
+	FILE* fp;
+	BYTE* pdu;
+	BYTE* plain;
+	UINT32 size;
+	UINT32 plainSize;
+	BOOL success = TRUE;
+	ZGFX_CONTEXT* decompressor;
+
+	fp = fopen(filename, "rb");
+
+	if (!fp)
+	{
+		printf("failed to open trace %s\n", filename);
+		return FALSE;
+	}
+
+	decompressor = zgfx_context_new(FALSE);
+
+	while (success && (fread(&size, sizeof(size), 1, fp) == 1))
+	{
+		pdu = (BYTE*) malloc(size ? size : 1);
+
+		if (!pdu || (fread(pdu, 1, size, fp) != size))
+		{
+			free(pdu);
+			success = FALSE;
+			break;
+		}
+
+		if ((size > 0) && ((pdu[0] == ZGFX_SEGMENTED_SINGLE) || (pdu[0] == ZGFX_SEGMENTED_MULTIPART)))
+		{
+			if ((zgfx_decompress(decompressor, pdu, size, &plain, &plainSize, 0) < 0) ||
+				!zgfx_trace_add(recorded, pdu, size))
+			{
+				free(pdu);
+				success = FALSE;
+				break;
+			}
+
+			pdu = plain;
+			size = plainSize;
+		}
+
+		success = zgfx_trace_add(trace, pdu, size);
+	}
+
+	zgfx_context_free(decompressor);
+	fclose(fp);
+
+	return success && (trace->count > 0);
+}
+
+static BOOL zgfx_trace_synthesize(ZGFX_TRACE* trace)
+{
+	UINT32 x;
+	UINT32 y;
+	UINT32 frame;
+	UINT32 size;
+	BYTE* pdu;
+	UINT32 width = 256;
+	UINT32 height = 64;
+
+	/* uncompressed 32bpp strips of a slowly scrolling gradient with a moving cursor-sized block */
+	for (frame = 0; frame < 600; frame++)
+	{
+		size = width * height * 4;
+		pdu = (BYTE*) malloc(size);
+
+		if (!pdu)
+			return FALSE;
+
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				BYTE* pixel = &pdu[((y * width) + x) * 4];
+				BOOL block = ((x - (frame * 3) % width) < 32) && ((y - frame % height) < 32);
+
+				pixel[0] = block ? 0xFF : (BYTE) (x + frame);
+				pixel[1] = block ? 0xFF : (BYTE) (y * 2);
+				pixel[2] = block ? 0x00 : (BYTE) ((x ^ y) & 0xF0);
+				pixel[3] = 0xFF;
+			}
+		}
+
+		if (!zgfx_trace_add(trace, pdu, size))
+		{
+			free(pdu);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static int zgfx_benchmark_level(ZGFX_TRACE* trace, UINT32 level)
+{
+	UINT32 index;
+	UINT32 Flags;
+	UINT32 DstSize;
+	BYTE* pDstData;
+	UINT32 OutSize;
+	BYTE* pOutData;
+	UINT32 passes;
+	UINT32 pass;
+	UINT64 start;
+	UINT64 compressTime = 0;
+	UINT64 decompressTime = 0;
+	UINT64 compressedSize = 0;
+	UINT64 processedSize;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!compressor || !decompressor)
+		return -1;
+
+	zgfx_set_compression_level(compressor, level);
+
+	/* repeat short traces, the history then holds earlier passes like it would on a long session */
+	passes = (UINT32) ((ZGFX_BENCHMARK_MIN_BYTES + trace->totalSize - 1) / trace->totalSize);
+
+	for (pass = 0; pass < passes; pass++)
+	{
+		for (index = 0; index < trace->count; index++)
+		{
+			start = GetTickCount64();
+
+			if (zgfx_compress(compressor, trace->data[index], trace->size[index], &pDstData, &DstSize, &Flags) < 0)
+			{
+				printf("level %d: zgfx_compress failure on pdu %d\n", level, index);
+				return -1;
+			}
+
+			compressTime += GetTickCount64() - start;
+			compressedSize += DstSize;
+			start = GetTickCount64();
+
+			if (zgfx_decompress(decompressor, pDstData, DstSize, &pOutData, &OutSize, 0) < 0)
+			{
+				printf("level %d: zgfx_decompress failure on pdu %d\n", level, index);
+				free(pDstData);
+				return -1;
+			}
+
+			decompressTime += GetTickCount64() - start;
+
+			if ((OutSize != trace->size[index]) || (memcmp(pOutData, trace->data[index], OutSize) != 0))
+			{
+				printf("level %d: round trip mismatch on pdu %d\n", level, index);
+				free(pDstData);
+				free(pOutData);
+				return -1;
+			}
+
+			free(pDstData);
+			free(pOutData);
+		}
+	}
+
+	processedSize = trace->totalSize * passes;
+
+	printf("level %d: ratio %6.2f%%  compress %8.2f MB/s  decompress %8.2f MB/s\n", level,
+			(compressedSize * 100.0) / processedSize,
+			(processedSize / (1024.0 * 1024.0)) / (MAX(compressTime, 1) / 1000.0),
+			(processedSize / (1024.0 * 1024.0)) / (MAX(decompressTime, 1) / 1000.0));
+
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+
+	return 1;
+}
+
+static int zgfx_benchmark_recorded(ZGFX_TRACE* recorded)
+{
+	UINT32 index;
+	UINT32 OutSize;
+	BYTE* pOutData;
+	UINT32 passes;
+	UINT32 pass;
+	UINT64 start;
+	UINT64 decompressTime = 0;
+	UINT64 decompressedSize = 0;
+	ZGFX_CONTEXT* decompressor;
+
+	passes = (UINT32) ((ZGFX_BENCHMARK_MIN_BYTES + recorded->totalSize - 1) / recorded->totalSize);
+
+	/* every pass starts from an empty history, like the recording did */
+	for (pass = 0; pass < passes; pass++)
+	{
+		decompressor = zgfx_context_new(FALSE);
+
+		if (!decompressor)
+			return -1;
+
+		for (index = 0; index < recorded->count; index++)
+		{
+			start = GetTickCount64();
+
+			if (zgfx_decompress(decompressor, recorded->data[index], recorded->size[index], &pOutData, &OutSize, 0) < 0)
+			{
+				printf("recorded: zgfx_decompress failure on pdu %d\n", index);
+				zgfx_context_free(decompressor);
+				return -1;
+			}
+
+			decompressTime += GetTickCount64() - start;
+			decompressedSize += OutSize;
+			free(pOutData);
+		}
+
+		zgfx_context_free(decompressor);
+	}
+
+	printf("recorded: %d pdus, ratio %6.2f%%  decompress %8.2f MB/s\n", recorded->count,
+			(recorded->totalSize * passes * 100.0) / MAX(decompressedSize, 1),
+			(decompressedSize / (1024.0 * 1024.0)) / (MAX(decompressTime, 1) / 1000.0));
+
+	return 1;
+}
+
+int TestFreeRDPCodecZGfxBenchmark(int argc, char* argv[])
+{
+	UINT32 level;
+	int status = 0;
+	ZGFX_TRACE trace;
+	ZGFX_TRACE recorded;
+
+	ZeroMemory(&trace, sizeof(trace));
+	ZeroMemory(&recorded, sizeof(recorded));
+
+	if (argc > 1)
+	{
+		if (!zgfx_trace_load(&trace, &recorded, argv[1]) ||
+			((recorded.count > 0) && (zgfx_benchmark_recorded(&recorded) < 0)))
+		{
+			zgfx_trace_free(&trace);
+			zgfx_trace_free(&recorded);
+			return -1;
+		}
+	}
+	else if (!zgfx_trace_synthesize(&trace))
+	{
+		zgfx_trace_free(&trace);
+		return -1;
+	}
+
+	printf("%d pdus, %d bytes\n", trace.count, (UINT32) trace.totalSize);
+
+	for (level = ZGFX_COMPRESSION_LEVEL_NONE; level <= ZGFX_COMPRESSION_LEVEL_MAX; level++)
+	{
+		if (zgfx_benchmark_level(&trace, level) < 0)
+		{
+			status = -1;
+			break;
+		}
+	}
+
+	zgfx_trace_free(&trace);
+	zgfx_trace_free(&recorded);
+
+	return status;
+}
@@ -23,8 +23,10 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/endian.h>
 #include <winpr/bitstream.h>
 
+#include <freerdp/settings.h>
 #include <freerdp/codec/zgfx.h>
 
 /**
@@ -93,17 +95,28 @@ static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] =
 	{ 0 }
 };
 
-#define zgfx_GetBits(_zgfx, _nbits) \
-	while (_zgfx->cBitsCurrent < _nbits) { \
-		_zgfx->BitsCurrent <<= 8; \
-		if (_zgfx->pbInputCurrent < _zgfx->pbInputEnd) \
-			_zgfx->BitsCurrent += *(_zgfx->pbInputCurrent)++; \
-		_zgfx->cBitsCurrent += 8; \
-	} \
-	_zgfx->cBitsRemaining -= _nbits; \
-	_zgfx->cBitsCurrent -= _nbits; \
-	_zgfx->bits = _zgfx->BitsCurrent >> _zgfx->cBitsCurrent; \
-	_zgfx->BitsCurrent &= ((1 << _zgfx->cBitsCurrent) - 1);
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(WITH_NEON)
+#include <arm_neon.h>
+#endif
+
+#define ZGFX_TOKEN_INVALID		0xFF
+
+static void zgfx_history_buffer_write_run(ZGFX_CONTEXT* zgfx, UINT32 index, const BYTE* src, UINT32 count)
+{
+	CopyMemory(&(zgfx->HistoryBuffer[index]), src, count);
+
+	/* keep the mirror of the ring start up to date */
+	if (index < ZGFX_HISTORY_MIRROR)
+		CopyMemory(&(zgfx->HistoryBuffer[zgfx->HistoryBufferSize + index]), src, MIN(count, ZGFX_HISTORY_MIRROR - index));
+}
 
 void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* zgfx, BYTE* src, UINT32 count)
 {
@@ -124,7 +137,7 @@ void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* zgfx, BYTE* src, UINT32 count)
 
 	if (zgfx->HistoryIndex + count <= zgfx->HistoryBufferSize)
 	{
-		CopyMemory(&(zgfx->HistoryBuffer[zgfx->HistoryIndex]), src, count);
+		zgfx_history_buffer_write_run(zgfx, zgfx->HistoryIndex, src, count);
 
 		if ((zgfx->HistoryIndex += count) == zgfx->HistoryBufferSize)
 			zgfx->HistoryIndex = 0;
@@ -132,72 +145,145 @@ void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* zgfx, BYTE* src, UINT32 count)
 	else
 	{
 		front = zgfx->HistoryBufferSize - zgfx->HistoryIndex;
-		CopyMemory(&(zgfx->HistoryBuffer[zgfx->HistoryIndex]), src, front);
-		CopyMemory(zgfx->HistoryBuffer, &src[front], count - front);
+		zgfx_history_buffer_write_run(zgfx, zgfx->HistoryIndex, src, front);
+		zgfx_history_buffer_write_run(zgfx, 0, &src[front], count - front);
 		zgfx->HistoryIndex = count - front;
 	}
 }
 
-void zgfx_history_buffer_ring_read(ZGFX_CONTEXT* zgfx, int offset, BYTE* dst, UINT32 count)
+static void zgfx_init_token_lookup(ZGFX_CONTEXT* zgfx)
 {
-	UINT32 front;
-	UINT32 index;
-	UINT32 bytes;
-	UINT32 valid;
-	UINT32 bytesLeft;
-	BYTE* dptr = dst;
-	BYTE* origDst = dst;
+	int opIndex;
+	UINT32 code;
+	UINT32 first;
+	UINT32 count;
+	const ZGFX_TOKEN* token;
 
-	if (count <= 0)
-		return;
+	/**
+	 * The tokens are tried in table order, the first one whose prefix matches wins. Filling the
+	 * slots in the same order and never overwriting one keeps that rule. Bits no prefix starts
+	 * are skipped like the bit by bit search skips them, all nine at once.
+	 */
+	FillMemory(zgfx->TokenLookup, sizeof(zgfx->TokenLookup), ZGFX_TOKEN_INVALID);
 
-	bytesLeft = count;
+	for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+	{
+		token = &ZGFX_TOKEN_TABLE[opIndex];
+		first = token->prefixCode << (ZGFX_TOKEN_LOOKUP_BITS - token->prefixLength);
+		count = 1 << (ZGFX_TOKEN_LOOKUP_BITS - token->prefixLength);
 
-	index = (zgfx->HistoryIndex + zgfx->HistoryBufferSize - offset) % zgfx->HistoryBufferSize;
+		for (code = first; code < first + count; code++)
+		{
+			if (zgfx->TokenLookup[code] == ZGFX_TOKEN_INVALID)
+				zgfx->TokenLookup[code] = (BYTE) opIndex;
+		}
+	}
+}
 
-	bytes = MIN(bytesLeft, offset);
+/**
+ * The 64 bits of the segment starting at the given bit, most significant first. At least 57 of
+ * them are valid, past the end of the data they read as zero.
+ */
+static INLINE UINT64 zgfx_peek_bits(const BYTE* data, UINT32 size, UINT32 position)
+{
+	int index;
+	UINT64 bits;
+	UINT32 offset = position >> 3;
 
-	if ((index + bytes) <= zgfx->HistoryBufferSize)
+	if (offset + 8 <= size)
 	{
-		CopyMemory(dptr, &(zgfx->HistoryBuffer[index]), bytes);
+		CopyMemory(&bits, &data[offset], 8);
+		bits = _byteswap_uint64(bits);
 	}
 	else
 	{
-		front = zgfx->HistoryBufferSize - index;
-		CopyMemory(dptr, &(zgfx->HistoryBuffer[index]), front);
-		CopyMemory(&dptr[front], zgfx->HistoryBuffer, bytes - front);
+		bits = 0;
+
+		for (index = 0; index < 8; index++)
+			bits = (bits << 8) | ((offset + index < size) ? data[offset + index] : 0);
 	}
 
-	if ((bytesLeft -= bytes) == 0)
-		return;
+	return bits << (position & 7);
+}
+
+/**
+ * Copies count bytes to dst from distance bytes before it, the regions may overlap. Short
+ * distances are widened by copying the pattern onto itself until a whole vector fits between
+ * source and destination, the rest goes a vector at a time. Up to ZGFX_OUTPUT_SLACK bytes past
+ * the end may be stored.
+ */
+static INLINE void zgfx_copy_match(BYTE* dst, UINT32 distance, UINT32 count)
+{
+	UINT32 n;
+	const BYTE* src = dst - distance;
+	BYTE* end = dst + count;
 
-	dptr += bytes;
-	valid = bytes;
+	while (((UINT32) (dst - src) < 16) && (dst < end))
+	{
+		n = MIN((UINT32) (dst - src), (UINT32) (end - dst));
+		CopyMemory(dst, src, n);
+		dst += n;
+	}
 
-	do
+#if defined(__AVX2__)
+	if ((dst - src) >= 32)
 	{
-		bytes = valid;
+		while (dst < end)
+		{
+			_mm256_storeu_si256((__m256i*) dst, _mm256_loadu_si256((const __m256i*) src));
+			src += 32;
+			dst += 32;
+		}
 
-		if (bytes > bytesLeft)
-			bytes = bytesLeft;
+		return;
+	}
+#endif
 
-		CopyMemory(dptr, origDst, bytes);
-		dptr += bytes;
-		valid <<= 1;
+#if defined(WITH_SSE2)
+	while (dst < end)
+	{
+		_mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) src));
+		src += 16;
+		dst += 16;
+	}
+#elif defined(WITH_NEON)
+	while (dst < end)
+	{
+		vst1q_u8(dst, vld1q_u8(src));
+		src += 16;
+		dst += 16;
 	}
-	while ((bytesLeft -= bytes) > 0);
+#else
+	while (dst < end)
+	{
+		CopyMemory(dst, src, 16);
+		src += 16;
+		dst += 16;
+	}
+#endif
 }
 
+/**
+ * Decodes into OutputBuffer and adds the output to the history once at the end. While the
+ * segment is decoded the ring still holds everything before it at HistoryIndex, a match
+ * reaching past the start of the output takes its first bytes from there.
+ */
 int zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, BYTE* pbSegment, UINT32 cbSegment)
 {
-	BYTE c;
 	BYTE flags;
-	int extra;
-	int opIndex;
-	int haveBits;
-	int inPrefix;
+	UINT64 bits;
+	UINT32 ones;
+	UINT32 extra;
+	UINT32 value;
 	UINT32 count;
+	UINT32 index;
 	UINT32 distance;
+	UINT32 position;
+	UINT32 cbData;
+	UINT32 cBitsTotal;
+	UINT32 outputCount;
+	BYTE* pbOutput;
+	const ZGFX_TOKEN* token;
 
 	if (cbSegment < 1)
 		return -1;
@@ -211,6 +297,9 @@ int zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, BYTE* pbSegment, UINT32 cbSegmen
 
 	if (!(flags & PACKET_COMPRESSED))
 	{
+		if (cbSegment > sizeof(zgfx->OutputBuffer) - ZGFX_OUTPUT_SLACK)
+			return -1;
+
 		zgfx_history_buffer_ring_write(zgfx, pbSegment, cbSegment);
 		CopyMemory(zgfx->OutputBuffer, pbSegment, cbSegment);
 		zgfx->OutputCount = cbSegment;
@@ -218,107 +307,116 @@ int zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, BYTE* pbSegment, UINT32 cbSegmen
 		return 1;
 	}
 
-	zgfx->pbInputCurrent = pbSegment;
-	zgfx->pbInputEnd = &pbSegment[cbSegment - 1];
+	if (cbSegment < 1)
+		return -1;
 
 	/* NumberOfBitsToDecode = ((NumberOfBytesToDecode - 1) * 8) - ValueOfLastByte */
-	zgfx->cBitsRemaining = 8 * (cbSegment - 1) - *zgfx->pbInputEnd;
-	zgfx->cBitsCurrent = 0;
-	zgfx->BitsCurrent = 0;
+	cbData = cbSegment - 1;
 
-	while (zgfx->cBitsRemaining)
+	if (pbSegment[cbData] > 8 * cbData)
+		return -1;
+
+	cBitsTotal = 8 * cbData - pbSegment[cbData];
+	position = 0;
+	outputCount = 0;
+	pbOutput = zgfx->OutputBuffer;
+
+	while (position < cBitsTotal)
 	{
-		haveBits = 0;
-		inPrefix = 0;
+		bits = zgfx_peek_bits(pbSegment, cbData, position);
+		index = zgfx->TokenLookup[bits >> (64 - ZGFX_TOKEN_LOOKUP_BITS)];
 
-		for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+		if (index == ZGFX_TOKEN_INVALID)
 		{
-			while (haveBits < ZGFX_TOKEN_TABLE[opIndex].prefixLength)
-			{
-				zgfx_GetBits(zgfx, 1);
-				inPrefix = (inPrefix << 1) + zgfx->bits;
-				haveBits++;
-			}
+			position += ZGFX_TOKEN_LOOKUP_BITS;
+			continue;
+		}
 
-			if (inPrefix == ZGFX_TOKEN_TABLE[opIndex].prefixCode)
-			{
-				if (ZGFX_TOKEN_TABLE[opIndex].tokenType == 0)
-				{
-					/* Literal */
+		/* a prefix and its value bits take at most 33 bits */
+		token = &ZGFX_TOKEN_TABLE[index];
+		bits <<= token->prefixLength;
+		value = token->valueBits ? (UINT32) (bits >> (64 - token->valueBits)) : 0;
+		position += token->prefixLength + token->valueBits;
 
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					c = (BYTE) (ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits);
+		if (token->tokenType == 0)
+		{
+			/* Literal */
 
-					zgfx->HistoryBuffer[zgfx->HistoryIndex] = c;
+			if (outputCount >= sizeof(zgfx->OutputBuffer) - ZGFX_OUTPUT_SLACK)
+				return -1;
 
-					if (++zgfx->HistoryIndex == zgfx->HistoryBufferSize)
-						zgfx->HistoryIndex = 0;
+			pbOutput[outputCount++] = (BYTE) (token->valueBase + value);
+			continue;
+		}
 
-					zgfx->OutputBuffer[zgfx->OutputCount++] = c;
-				}
-				else
-				{
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					distance = ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits;
-
-					if (distance != 0)
-					{
-						/* Match */
-
-						zgfx_GetBits(zgfx, 1);
-
-						if (zgfx->bits == 0)
-						{
-							count = 3;
-						}
-						else
-						{
-							count = 4;
-							extra = 2;
-
-							zgfx_GetBits(zgfx, 1);
-
-							while (zgfx->bits == 1)
-							{
-								count *= 2;
-								extra++;
-
-								zgfx_GetBits(zgfx, 1);
-							}
-
-							zgfx_GetBits(zgfx, extra);
-							count += zgfx->bits;
-						}
-
-						zgfx_history_buffer_ring_read(zgfx, distance, &(zgfx->OutputBuffer[zgfx->OutputCount]), count);
-						zgfx_history_buffer_ring_write(zgfx, &(zgfx->OutputBuffer[zgfx->OutputCount]), count);
-						zgfx->OutputCount += count;
-					}
-					else
-					{
-						/* Unencoded */
-
-						zgfx_GetBits(zgfx, 15);
-						count = zgfx->bits;
-
-						zgfx->cBitsRemaining -= zgfx->cBitsCurrent;
-						zgfx->cBitsCurrent = 0;
-						zgfx->BitsCurrent = 0;
-
-						CopyMemory(&(zgfx->OutputBuffer[zgfx->OutputCount]), zgfx->pbInputCurrent, count);
-						zgfx_history_buffer_ring_write(zgfx, zgfx->pbInputCurrent, count);
-
-						zgfx->pbInputCurrent += count;
-						zgfx->cBitsRemaining -= (8 * count);
-						zgfx->OutputCount += count;
-					}
-				}
-
-				break;
-			}
+		distance = token->valueBase + value;
+		bits = zgfx_peek_bits(pbSegment, cbData, position);
+
+		if (distance == 0)
+		{
+			/* Unencoded: 15 bits of count, the bytes start at the next byte boundary */
+
+			count = (UINT32) (bits >> (64 - 15));
+			position = (position + 15 + 7) & ~7;
+
+			if (((position >> 3) + count > cbData) ||
+				(outputCount + count > sizeof(zgfx->OutputBuffer) - ZGFX_OUTPUT_SLACK))
+				return -1;
+
+			CopyMemory(&pbOutput[outputCount], &pbSegment[position >> 3], count);
+			position += 8 * count;
+			outputCount += count;
+			continue;
+		}
+
+		/* Match: '0' for 3 bytes, otherwise n ones, a zero and n + 1 bits added to 4 << (n - 1) */
+
+		if (!(bits >> 63))
+		{
+			count = 3;
+			position += 1;
+		}
+		else
+		{
+			ones = 1;
+
+			while ((ones < 24) && ((bits << ones) >> 63))
+				ones++;
+
+			extra = ones + 1;
+
+			if (ones == 24)
+				return -1;
+
+			count = (4 << (ones - 1)) + (UINT32) ((bits << (ones + 1)) >> (64 - extra));
+			position += ones + 1 + extra;
+		}
+
+		if ((distance > zgfx->HistoryBufferSize) ||
+			(count > sizeof(zgfx->OutputBuffer) - ZGFX_OUTPUT_SLACK - outputCount))
+			return -1;
+
+		if (distance > outputCount)
+		{
+			/* the source starts in the history before this segment, the mirror keeps it contiguous */
+			value = MIN(count, distance - outputCount);
+			index = (zgfx->HistoryIndex + zgfx->HistoryBufferSize - (distance - outputCount)) % zgfx->HistoryBufferSize;
+
+			CopyMemory(&pbOutput[outputCount], &(zgfx->HistoryBuffer[index]), value);
+			outputCount += value;
+			count -= value;
+		}
+
+		if (count)
+		{
+			zgfx_copy_match(&pbOutput[outputCount], distance, count);
+			outputCount += count;
 		}
 	}
 
+	zgfx->OutputCount = outputCount;
+	zgfx_history_buffer_ring_write(zgfx, pbOutput, outputCount);
+
 	return 1;
 }
 
@@ -336,6 +434,9 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** p
 	{
 		status = zgfx_decompress_segment(zgfx, &pSrcData[1], SrcSize - 1);
 
+		if (status < 0)
+			return -1;
+
 		*ppDstData = (BYTE*) malloc(zgfx->OutputCount);
 		if (!*ppDstData)
 			return -1;
@@ -350,30 +451,49 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** p
 		UINT16 segmentCount;
 		UINT32 segmentOffset;
 		UINT32 uncompressedSize;
+		UINT32 concatenatedSize = 0;
 		BYTE* pConcatenated;
 
+		if (SrcSize < 7)
+			return -1;
+
 		segmentOffset = 7;
-		segmentCount = *((UINT16*) &pSrcData[1]); /* segmentCount (2 bytes) */
-		uncompressedSize = *((UINT32*) &pSrcData[3]); /* uncompressedSize (4 bytes) */
+		Data_Read_UINT16(&pSrcData[1], segmentCount); /* segmentCount (2 bytes) */
+		Data_Read_UINT32(&pSrcData[3], uncompressedSize); /* uncompressedSize (4 bytes) */
 
-		pConcatenated = (BYTE*) malloc(uncompressedSize);
+		pConcatenated = (BYTE*) malloc(uncompressedSize ? uncompressedSize : 1);
 		if (!pConcatenated)
 			return -1;
 
-		*ppDstData = pConcatenated;
-		*pDstSize = uncompressedSize;
-
 		for (segmentNumber = 0; segmentNumber < segmentCount; segmentNumber++)
 		{
-			segmentSize = *((UINT32*) &pSrcData[segmentOffset]); /* segmentSize (4 bytes) */
-			segmentOffset += 4;
+			if (SrcSize - segmentOffset < 4)
+				status = -1;
+			else
+			{
+				Data_Read_UINT32(&pSrcData[segmentOffset], segmentSize); /* segmentSize (4 bytes) */
+				segmentOffset += 4;
+
+				if (segmentSize > SrcSize - segmentOffset)
+					status = -1;
+				else
+					status = zgfx_decompress_segment(zgfx, &pSrcData[segmentOffset], segmentSize);
+			}
+
+			if ((status < 0) || (zgfx->OutputCount > uncompressedSize - concatenatedSize))
+			{
+				free(pConcatenated);
+				return -1;
+			}
 
-			status = zgfx_decompress_segment(zgfx, &pSrcData[segmentOffset], segmentSize);
 			segmentOffset += segmentSize;
 
-			CopyMemory(pConcatenated, zgfx->OutputBuffer, zgfx->OutputCount);
-			pConcatenated += zgfx->OutputCount;
+			CopyMemory(&pConcatenated[concatenatedSize], zgfx->OutputBuffer, zgfx->OutputCount);
+			concatenatedSize += zgfx->OutputCount;
 		}
+
+		*ppDstData = pConcatenated;
+		*pDstSize = concatenatedSize;
 	}
 	else
 	{
@@ -383,14 +503,540 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** p
 	return 1;
 }
 
+/**
+ * Compressor
+ *
+ * The history is the same ring the decompressor keeps. Every byte is given a 32-bit stream
+ * position which starts at the history size, so 0 never names a real byte and the ring index
+ * of a position is the position modulo the history size. Positions are linked into hash chains
+ * by their first three bytes, newest first.
+ */
+
+#define ZGFX_HASH_SIZE			(1 << ZGFX_HASH_BITS)
+#define ZGFX_MIN_MATCH			3
+#define ZGFX_MAX_UNENCODED		32767
+
+/* a whole segment is written to the ring before it is encoded, its bytes must not overwrite a match source */
+#define ZGFX_MAX_DISTANCE(_zgfx)	((_zgfx)->HistoryBufferSize - ZGFX_SEGMENT_MAX_SIZE - 1)
+
+struct _ZGFX_LEVEL
+{
+	UINT32 maxChain; /* candidates tried per position */
+	UINT32 goodLength; /* a match this long only tries a quarter of the chain further */
+	UINT32 lazyLength; /* shorter matches are checked against the one a byte later, 0 for never */
+	UINT32 niceLength; /* a match this long ends the search */
+};
+typedef struct _ZGFX_LEVEL ZGFX_LEVEL;
+
+static const ZGFX_LEVEL ZGFX_LEVELS[ZGFX_COMPRESSION_LEVEL_MAX + 1] =
+{
+	{    0,   0,    0,     0 },
+	{    4,   8,    0,    16 },
+	{    8,  16,    0,    32 },
+	{   16,  32,    0,    64 },
+	{   16,  16,   16,    64 },
+	{   32,  16,   32,   128 },
+	{   64,  32,   64,   256 },
+	{  256,  64,  128,   512 },
+	{ 1024, 128,  256,  4096 },
+	{ 4096, 256, 4096, 65535 }
+};
+
+struct _ZGFX_BIT_WRITER
+{
+	BYTE* buffer;
+	UINT32 capacity;
+	UINT32 length;
+	UINT32 accumulator;
+	UINT32 pending;
+	BOOL overflow;
+};
+typedef struct _ZGFX_BIT_WRITER ZGFX_BIT_WRITER;
+
+static INLINE void zgfx_bit_writer_put(ZGFX_BIT_WRITER* bw, UINT32 value, UINT32 nbits)
+{
+	/* nbits never exceeds 24, so the accumulator never holds more than 31 bits */
+	bw->accumulator = (bw->accumulator << nbits) | (value & ((1 << nbits) - 1));
+	bw->pending += nbits;
+
+	while (bw->pending >= 8)
+	{
+		bw->pending -= 8;
+
+		if (bw->length < bw->capacity)
+			bw->buffer[bw->length++] = (BYTE) (bw->accumulator >> bw->pending);
+		else
+			bw->overflow = TRUE;
+	}
+
+	bw->accumulator &= ((1 << bw->pending) - 1);
+}
+
+static INLINE void zgfx_bit_writer_align(ZGFX_BIT_WRITER* bw)
+{
+	if (bw->pending)
+		zgfx_bit_writer_put(bw, 0, 8 - bw->pending);
+}
+
+static INLINE void zgfx_bit_writer_put_bytes(ZGFX_BIT_WRITER* bw, const BYTE* data, UINT32 count)
+{
+	if (bw->length + count > bw->capacity)
+	{
+		bw->overflow = TRUE;
+		return;
+	}
+
+	CopyMemory(&bw->buffer[bw->length], data, count);
+	bw->length += count;
+}
+
+static const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	int index;
+	const ZGFX_TOKEN* token = NULL;
+
+	for (index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		if (ZGFX_TOKEN_TABLE[index].tokenType != 1)
+			continue;
+
+		if ((distance >= ZGFX_TOKEN_TABLE[index].valueBase) &&
+			(distance - ZGFX_TOKEN_TABLE[index].valueBase) < ((UINT32) 1 << ZGFX_TOKEN_TABLE[index].valueBits))
+		{
+			token = &ZGFX_TOKEN_TABLE[index];
+			break;
+		}
+	}
+
+	return token;
+}
+
+static INLINE UINT32 zgfx_length_bits(UINT32 count)
+{
+	UINT32 log2 = 2;
+
+	if (count == 3)
+		return 1;
+
+	while ((count >> (log2 + 1)) != 0)
+		log2++;
+
+	/* prefix of log2 bits followed by log2 bits of value */
+	return 2 * log2;
+}
+
+static UINT32 zgfx_match_bits(UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+
+	return token->prefixLength + token->valueBits + zgfx_length_bits(count);
+}
+
+static void zgfx_write_literal(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, BYTE c)
+{
+	zgfx_bit_writer_put(bw, zgfx->LiteralCode[c], zgfx->LiteralLength[c]);
+}
+
+static void zgfx_write_match(ZGFX_BIT_WRITER* bw, UINT32 distance, UINT32 count)
+{
+	UINT32 log2 = 2;
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+
+	zgfx_bit_writer_put(bw, token->prefixCode, token->prefixLength);
+	zgfx_bit_writer_put(bw, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+	{
+		zgfx_bit_writer_put(bw, 0, 1);
+		return;
+	}
+
+	while ((count >> (log2 + 1)) != 0)
+		log2++;
+
+	/* log2 - 1 ones and a zero, then the count above the power of two in log2 bits */
+	zgfx_bit_writer_put(bw, ((1 << (log2 - 1)) - 1) << 1, log2);
+	zgfx_bit_writer_put(bw, count - (1 << log2), log2);
+}
+
+static void zgfx_write_literals(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, const BYTE* data, UINT32 count)
+{
+	UINT32 index;
+	UINT32 chunk;
+	UINT32 literalBits = 0;
+
+	for (index = 0; index < count; index++)
+		literalBits += zgfx->LiteralLength[data[index]];
+
+	/* a run with little to gain from the short literal codes goes out unencoded, it costs 25 bits and the padding */
+	if (literalBits <= (8 * count) + 32)
+	{
+		for (index = 0; index < count; index++)
+			zgfx_write_literal(zgfx, bw, data[index]);
+
+		return;
+	}
+
+	while (count > 0)
+	{
+		chunk = MIN(count, ZGFX_MAX_UNENCODED);
+
+		/* distance 0 marks unencoded bytes */
+		zgfx_bit_writer_put(bw, ZGFX_TOKEN_TABLE[1].prefixCode, ZGFX_TOKEN_TABLE[1].prefixLength);
+		zgfx_bit_writer_put(bw, 0, ZGFX_TOKEN_TABLE[1].valueBits);
+		zgfx_bit_writer_put(bw, chunk, 15);
+		zgfx_bit_writer_align(bw);
+		zgfx_bit_writer_put_bytes(bw, data, chunk);
+
+		data += chunk;
+		count -= chunk;
+	}
+}
+
+static INLINE UINT32 zgfx_hash(const BYTE* history, UINT32 index)
+{
+	UINT32 value = (history[index] << 16) | (history[index + 1] << 8) | history[index + 2];
+
+	return (value * 2654435761U) >> (32 - ZGFX_HASH_BITS);
+}
+
+static void zgfx_hash_insert(ZGFX_CONTEXT* zgfx, UINT32 position)
+{
+	UINT32 hash;
+	UINT32 size = zgfx->HistoryBufferSize;
+	UINT32 index = zgfx->HashPosition % size;
+
+	/* a position is entered once the two bytes after it are in the history */
+	if (position + ZGFX_MIN_MATCH > zgfx->HistoryPosition)
+		position = zgfx->HistoryPosition - ZGFX_MIN_MATCH + 1;
+
+	while (zgfx->HashPosition < position)
+	{
+		hash = zgfx_hash(zgfx->HistoryBuffer, index);
+		zgfx->HashChain[index] = zgfx->HashHead[hash];
+		zgfx->HashHead[hash] = zgfx->HashPosition;
+		zgfx->HashPosition++;
+
+		if (++index == size)
+			index = 0;
+	}
+}
+
+static INLINE UINT32 zgfx_match_length(const BYTE* history, UINT32 a, UINT32 b, UINT32 maxLength)
+{
+	UINT32 length;
+	UINT64 wordA;
+	UINT64 wordB;
+
+	/* no segment is longer than the mirror, the runs never wrap; compare a word at a time */
+	for (length = 0; length + 8 <= maxLength; length += 8)
+	{
+		CopyMemory(&wordA, &history[a + length], 8);
+		CopyMemory(&wordB, &history[b + length], 8);
+
+		if (wordA != wordB)
+			break;
+	}
+
+	for (; length < maxLength; length++)
+	{
+		if (history[a + length] != history[b + length])
+			break;
+	}
+
+	return length;
+}
+
+static UINT32 zgfx_find_match(ZGFX_CONTEXT* zgfx, UINT32 position, UINT32 maxLength, UINT32* pDistance)
+{
+	UINT32 length;
+	UINT32 candidate;
+	UINT32 candidateIndex;
+	UINT32 distance;
+	UINT32 bestLength = 0;
+	UINT32 size = zgfx->HistoryBufferSize;
+	UINT32 index = position % size;
+	const ZGFX_LEVEL* level = &ZGFX_LEVELS[zgfx->CompressionLevel];
+	UINT32 chain = level->maxChain;
+	UINT32 niceLength = MIN(level->niceLength, maxLength);
+
+	if (maxLength < ZGFX_MIN_MATCH)
+		return 0;
+
+	candidate = zgfx->HashHead[zgfx_hash(zgfx->HistoryBuffer, index)];
+
+	while (candidate && (candidate < position) && chain--)
+	{
+		distance = position - candidate;
+
+		if (distance > ZGFX_MAX_DISTANCE(zgfx))
+			break;
+
+		candidateIndex = (distance > index) ? (index + size - distance) : (index - distance);
+
+		/* check the byte which would make the match longer first */
+		if (zgfx->HistoryBuffer[candidateIndex + bestLength] == zgfx->HistoryBuffer[index + bestLength])
+		{
+			length = zgfx_match_length(zgfx->HistoryBuffer, candidateIndex, index, maxLength);
+
+			if (length > bestLength)
+			{
+				if ((bestLength < level->goodLength) && (length >= level->goodLength))
+					chain >>= 2;
+
+				bestLength = length;
+				*pDistance = distance;
+
+				if (length >= niceLength)
+					break;
+			}
+		}
+
+		candidate = zgfx->HashChain[candidateIndex];
+	}
+
+	if (bestLength < ZGFX_MIN_MATCH)
+		return 0;
+
+	return bestLength;
+}
+
+static BOOL zgfx_match_pays(ZGFX_CONTEXT* zgfx, const BYTE* data, UINT32 distance, UINT32 count)
+{
+	UINT32 index;
+	UINT32 literalBits = 0;
+
+	/* only short matches can lose against literals */
+	if (count > 8)
+		return TRUE;
+
+	for (index = 0; index < count; index++)
+		literalBits += zgfx->LiteralLength[data[index]];
+
+	return zgfx_match_bits(distance, count) < literalBits;
+}
+
+static void zgfx_rebase_positions(ZGFX_CONTEXT* zgfx)
+{
+	UINT32 index;
+	UINT32 shift;
+	UINT32 size = zgfx->HistoryBufferSize;
+
+	/* keep the positions far from wrapping, shifting by whole history sizes keeps their ring indices */
+	shift = ((zgfx->HistoryPosition / size) - 2) * size;
+
+	for (index = 0; index < ZGFX_HASH_SIZE; index++)
+		zgfx->HashHead[index] = (zgfx->HashHead[index] >= shift + size) ? zgfx->HashHead[index] - shift : 0;
+
+	for (index = 0; index < size; index++)
+		zgfx->HashChain[index] = (zgfx->HashChain[index] >= shift + size) ? zgfx->HashChain[index] - shift : 0;
+
+	zgfx->HistoryPosition -= shift;
+	zgfx->HashPosition -= shift;
+}
+
+static UINT32 zgfx_compress_segment(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData)
+{
+	UINT32 start;
+	UINT32 current;
+	UINT32 literals;
+	UINT32 padding;
+	UINT32 length = 0;
+	UINT32 distance = 0;
+	UINT32 nextLength;
+	UINT32 nextDistance = 0;
+	BOOL haveNext = FALSE;
+	ZGFX_BIT_WRITER bw;
+	const ZGFX_LEVEL* level = &ZGFX_LEVELS[zgfx->CompressionLevel];
+
+	if (zgfx->HistoryPosition > 0xC0000000)
+		zgfx_rebase_positions(zgfx);
+
+	start = zgfx->HistoryPosition;
+	zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+	zgfx->HistoryPosition += SrcSize;
+
+	if ((zgfx->CompressionLevel == ZGFX_COMPRESSION_LEVEL_NONE) || (SrcSize < 2))
+		goto raw;
+
+	/* the compressed form must fit where the raw bytes would go, otherwise they go raw */
+	bw.buffer = &pDstData[1];
+	bw.capacity = SrcSize - 1;
+	bw.length = 0;
+	bw.accumulator = 0;
+	bw.pending = 0;
+	bw.overflow = FALSE;
+
+	current = 0;
+	literals = 0;
+
+	while ((current + ZGFX_MIN_MATCH <= SrcSize) && !bw.overflow)
+	{
+		if (haveNext)
+		{
+			length = nextLength;
+			distance = nextDistance;
+			haveNext = FALSE;
+		}
+		else
+		{
+			zgfx_hash_insert(zgfx, start + current);
+			length = zgfx_find_match(zgfx, start + current, SrcSize - current, &distance);
+		}
+
+		if (length && !zgfx_match_pays(zgfx, &pSrcData[current], distance, length))
+			length = 0;
+
+		if (length && (length < level->lazyLength) && (current + 1 + ZGFX_MIN_MATCH <= SrcSize))
+		{
+			/* a longer match one byte later is worth a literal */
+			zgfx_hash_insert(zgfx, start + current + 1);
+			nextLength = zgfx_find_match(zgfx, start + current + 1, SrcSize - current - 1, &nextDistance);
+
+			if (nextLength > length)
+			{
+				haveNext = TRUE;
+				length = 0;
+			}
+		}
+
+		if (!length)
+		{
+			current++;
+			continue;
+		}
+
+		zgfx_write_literals(zgfx, &bw, &pSrcData[literals], current - literals);
+		zgfx_write_match(&bw, distance, length);
+
+		current += length;
+		literals = current;
+	}
+
+	zgfx_write_literals(zgfx, &bw, &pSrcData[literals], SrcSize - literals);
+
+	/* the last byte counts the unused bits of the byte before it */
+	padding = bw.pending ? (8 - bw.pending) : 0;
+	zgfx_bit_writer_align(&bw);
+
+	if (bw.overflow || (bw.length + 1 > bw.capacity))
+		goto raw;
+
+	bw.buffer[bw.length++] = (BYTE) padding;
+	pDstData[0] = PACKET_COMPR_TYPE_RDP8 | PACKET_COMPRESSED;
+
+	return bw.length + 1;
+
+raw:
+	pDstData[0] = PACKET_COMPR_TYPE_RDP8;
+	CopyMemory(&pDstData[1], pSrcData, SrcSize);
+
+	return SrcSize + 1;
+}
+
 int zgfx_compress(ZGFX_CONTEXT* zgfx, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
 {
+	BYTE* pDstData;
+	UINT32 segmentSize;
+	UINT32 segmentCount;
+	UINT32 segmentNumber;
+	UINT32 segmentOffset;
+	UINT32 uncompressedSize;
+	BOOL compressed = FALSE;
+
+	if (!zgfx->Compressor)
+		return -1;
+
+	segmentCount = (SrcSize + ZGFX_SEGMENT_MAX_SIZE - 1) / ZGFX_SEGMENT_MAX_SIZE;
+
+	if (segmentCount > 0xFFFF)
+		return -1;
+
+	/* a segment never grows beyond its header byte, the caller frees the output */
+	pDstData = (BYTE*) malloc(SrcSize + 7 + (segmentCount * 5) + 2);
+
+	if (!pDstData)
+		return -1;
+
+	if (segmentCount <= 1)
+	{
+		pDstData[0] = ZGFX_SEGMENTED_SINGLE;
+		segmentSize = zgfx_compress_segment(zgfx, pSrcData, SrcSize, &pDstData[1]);
+		compressed = (pDstData[1] & PACKET_COMPRESSED) ? TRUE : FALSE;
+		*pDstSize = segmentSize + 1;
+	}
+	else
+	{
+		pDstData[0] = ZGFX_SEGMENTED_MULTIPART;
+		Data_Write_UINT16(&pDstData[1], segmentCount); /* segmentCount (2 bytes) */
+		Data_Write_UINT32(&pDstData[3], SrcSize); /* uncompressedSize (4 bytes) */
+		segmentOffset = 7;
+
+		for (segmentNumber = 0; segmentNumber < segmentCount; segmentNumber++)
+		{
+			uncompressedSize = MIN(SrcSize - (segmentNumber * ZGFX_SEGMENT_MAX_SIZE), ZGFX_SEGMENT_MAX_SIZE);
+			segmentSize = zgfx_compress_segment(zgfx, &pSrcData[segmentNumber * ZGFX_SEGMENT_MAX_SIZE],
+					uncompressedSize, &pDstData[segmentOffset + 4]);
+
+			if (pDstData[segmentOffset + 4] & PACKET_COMPRESSED)
+				compressed = TRUE;
+
+			Data_Write_UINT32(&pDstData[segmentOffset], segmentSize); /* segmentSize (4 bytes) */
+			segmentOffset += 4 + segmentSize;
+		}
+
+		*pDstSize = segmentOffset;
+	}
+
+	*ppDstData = pDstData;
+	*pFlags = PACKET_COMPR_TYPE_RDP8 | (compressed ? PACKET_COMPRESSED : 0);
+
 	return 1;
 }
 
+void zgfx_set_compression_level(ZGFX_CONTEXT* zgfx, DWORD CompressionLevel)
+{
+	zgfx->CompressionLevel = MIN(CompressionLevel, ZGFX_COMPRESSION_LEVEL_MAX);
+}
+
+static void zgfx_init_literal_codes(ZGFX_CONTEXT* zgfx)
+{
+	int index;
+	UINT32 value;
+	const ZGFX_TOKEN* token;
+
+	/* every byte has the 9 bit code, the most frequent ones have a shorter one of their own */
+	for (index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		token = &ZGFX_TOKEN_TABLE[index];
+
+		if (token->tokenType != 0)
+			continue;
+
+		for (value = 0; value < ((UINT32) 1 << token->valueBits); value++)
+		{
+			BYTE c = (BYTE) (token->valueBase + value);
+			UINT32 length = token->prefixLength + token->valueBits;
+
+			if (zgfx->LiteralLength[c] && (zgfx->LiteralLength[c] <= length))
+				continue;
+
+			zgfx->LiteralCode[c] = (UINT16) ((token->prefixCode << token->valueBits) | value);
+			zgfx->LiteralLength[c] = (BYTE) length;
+		}
+	}
+}
+
 void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+
+	if (zgfx->Compressor)
+	{
+		zgfx->HistoryPosition = zgfx->HistoryBufferSize;
+		zgfx->HashPosition = zgfx->HistoryPosition;
+		ZeroMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32));
+	}
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -403,7 +1049,26 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	{
 		zgfx->Compressor = Compressor;
 
-		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+		zgfx->HistoryBufferSize = ZGFX_HISTORY_SIZE;
+
+		if (Compressor)
+		{
+			zgfx->CompressionLevel = ZGFX_COMPRESSION_LEVEL_DEFAULT;
+			zgfx->HashHead = (UINT32*) calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+			zgfx->HashChain = (UINT32*) calloc(zgfx->HistoryBufferSize, sizeof(UINT32));
+
+			if (!zgfx->HashHead || !zgfx->HashChain)
+			{
+				zgfx_context_free(zgfx);
+				return NULL;
+			}
+
+			zgfx_init_literal_codes(zgfx);
+		}
+		else
+		{
+			zgfx_init_token_lookup(zgfx);
+		}
 
 		zgfx_context_reset(zgfx, FALSE);
 	}
@@ -413,6 +1078,10 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->HashHead);
+	free(zgfx->HashChain);
 	free(zgfx);
 }
-
@@ -465,6 +465,7 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 		settings->GfxProgressive = FALSE;
 		settings->GfxProgressiveV2 = FALSE;
 		settings->GfxH264 = FALSE;
+		settings->GfxAVC444 = FALSE;
 
 		settings->ClientAutoReconnectCookie = (ARC_CS_PRIVATE_PACKET*) calloc(1, sizeof(ARC_CS_PRIVATE_PACKET));
 		if (!settings->ClientAutoReconnectCookie)
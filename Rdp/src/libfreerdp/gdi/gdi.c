@@ -1247,6 +1247,9 @@ BOOL gdi_resize(rdpGdi* gdi, int width, int height)
 	if (gdi->width == width && gdi->height == height)
 		return TRUE;
 
+	if (!gdi_graphics_pipeline_detach_output(gdi))
+		return FALSE;
+
 	if (gdi->drawing == gdi->primary)
 		gdi->drawing = NULL;
 
@@ -1409,6 +1412,9 @@ void gdi_free(freerdp* instance)
 
 	if (gdi)
 	{
+		if (!gdi_graphics_pipeline_detach_output(gdi))
+			WLog_ERR(TAG, "failed to detach direct surfaces from the primary buffer");
+
 		gdi_bitmap_free_ex(gdi->primary);
 		gdi_bitmap_free_ex(gdi->tile);
 		gdi_bitmap_free_ex(gdi->image);
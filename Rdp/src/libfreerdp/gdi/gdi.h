@@ -24,5 +24,6 @@
 
 gdiBitmap* gdi_bitmap_new_ex(rdpGdi* gdi, int width, int height, int bpp, BYTE* data);
 void gdi_bitmap_free_ex(gdiBitmap* gdi_bmp);
+BOOL gdi_graphics_pipeline_detach_output(rdpGdi* gdi);
 
 #endif /* __GDI_CORE_H */
@@ -25,8 +25,115 @@
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/gdi/region.h>
 
+#include "gdi.h"
+
 #define TAG FREERDP_TAG("gdi")
 
+/**
+ * A surface mapped 1:1 onto the output, with the size and the format of the
+ * primary buffer, is decoded straight into the primary buffer instead of
+ * being copied there on every update. Its data then points into the primary
+ * buffer, so it gets a buffer of its own again before the primary buffer is
+ * reallocated or another surface is mapped on top of it.
+ */
+static BOOL gdi_SurfaceFitsOutput(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	if (!gdi->primary_buffer || (gdi->bytesPerPixel != 4) || (surface->format != gdi->format))
+		return FALSE;
+
+	if ((surface->outputOriginX != 0) || (surface->outputOriginY != 0))
+		return FALSE;
+
+	return (surface->width == (UINT32) gdi->width) && (surface->height == (UINT32) gdi->height);
+}
+
+static void gdi_AttachSurfaceToOutput(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	int nDstStep = gdi->bytesPerPixel * gdi->width;
+
+	freerdp_image_copy(gdi->primary_buffer, gdi->format, nDstStep, 0, 0,
+			surface->width, surface->height, surface->data, surface->format,
+			surface->scanline, 0, 0, NULL);
+
+	free(surface->data);
+
+	surface->data = gdi->primary_buffer;
+	surface->scanline = nDstStep;
+	surface->outputDirect = TRUE;
+}
+
+static BOOL gdi_DetachSurfaceFromOutput(rdpGdi* gdi, gdiGfxSurface* surface)
+{
+	BYTE* data;
+	int scanline;
+
+	if (!surface->outputDirect)
+		return TRUE;
+
+	scanline = (surface->width + (surface->width % 4)) * 4;
+	data = (BYTE*) calloc(1, scanline * surface->height);
+
+	if (!data)
+		return FALSE;
+
+	freerdp_image_copy(data, surface->format, scanline, 0, 0,
+			surface->width, surface->height, surface->data, surface->format,
+			surface->scanline, 0, 0, NULL);
+
+	surface->data = data;
+	surface->scanline = scanline;
+	surface->outputDirect = FALSE;
+
+	return TRUE;
+}
+
+static BOOL gdi_DetachSurfacesFromOutput(rdpGdi* gdi, UINT16 exceptSurfaceId, UINT16* pMappedCount)
+{
+	int index;
+	UINT16 count;
+	BOOL status = TRUE;
+	UINT16 mappedCount = 0;
+	gdiGfxSurface* surface;
+	UINT16* pSurfaceIds = NULL;
+	RdpgfxClientContext* context = gdi->gfx;
+
+	context->GetSurfaceIds(context, &pSurfaceIds, &count);
+
+	for (index = 0; index < count; index++)
+	{
+		surface = (gdiGfxSurface*) context->GetSurfaceData(context, pSurfaceIds[index]);
+
+		if (!surface || (surface->surfaceId == exceptSurfaceId))
+			continue;
+
+		if (surface->outputMapped)
+			mappedCount++;
+
+		if (!gdi_DetachSurfaceFromOutput(gdi, surface))
+			status = FALSE;
+	}
+
+	free(pSurfaceIds);
+
+	if (pMappedCount)
+		*pMappedCount = mappedCount;
+
+	return status;
+}
+
+/**
+ * Gives every direct surface its own copy of its pixels, called by the gdi
+ * before the primary buffer those surfaces point into is freed or reallocated.
+ */
+
+BOOL gdi_graphics_pipeline_detach_output(rdpGdi* gdi)
+{
+	if (!gdi->gfx)
+		return TRUE;
+
+	return gdi_DetachSurfacesFromOutput(gdi, 0xFFFF, NULL);
+}
+
 /**
  * Function description
  *
@@ -49,6 +156,9 @@ UINT gdi_ResetGraphics(RdpgfxClientContext* context, RDPGFX_RESET_GRAPHICS_PDU*
 
 	if ((DesktopWidth != settings->DesktopWidth) || (DesktopHeight != settings->DesktopHeight))
 	{
+		if (!gdi_DetachSurfacesFromOutput(gdi, 0xFFFF, NULL))
+			return CHANNEL_RC_NO_MEMORY;
+
 		settings->DesktopWidth = DesktopWidth;
 		settings->DesktopHeight = DesktopHeight;
 
@@ -79,15 +189,73 @@ UINT gdi_ResetGraphics(RdpgfxClientContext* context, RDPGFX_RESET_GRAPHICS_PDU*
 	return CHANNEL_RC_OK;
 }
 
+/**
+ * What a copy into the primary buffer costs, in pixels: each freerdp_image_copy
+ * call and each row it copies come with an overhead on top of the pixels. Two
+ * damaged rectangles are copied as their bounding box when the pixels in
+ * between cost less than the overhead this saves.
+ */
+#define GDI_OUTPUT_COPY_COST	1024
+#define GDI_OUTPUT_ROW_COST	16
+
+static UINT32 gdi_OutputCopyCost(const RECTANGLE_16* rect)
+{
+	UINT32 width = rect->right - rect->left;
+	UINT32 height = rect->bottom - rect->top;
+
+	return GDI_OUTPUT_COPY_COST + height * (GDI_OUTPUT_ROW_COST + width);
+}
+
+/**
+ * Merges the rectangles of the region into as many copies as are cheaper
+ * than the rectangles on their own, a cursor in one corner and a clock in
+ * the other stay two small copies.
+ *
+ * @return the number of copies in pCopies, which has room for nbRects
+ */
+static int gdi_OutputMergeRects(const RECTANGLE_16* rects, int nbRects, RECTANGLE_16* pCopies)
+{
+	int i, j;
+	int nbCopies = 0;
+	RECTANGLE_16 bounds;
+
+	for (i = 0; i < nbRects; i++)
+	{
+		for (j = 0; j < nbCopies; j++)
+		{
+			bounds.left = MIN(pCopies[j].left, rects[i].left);
+			bounds.top = MIN(pCopies[j].top, rects[i].top);
+			bounds.right = MAX(pCopies[j].right, rects[i].right);
+			bounds.bottom = MAX(pCopies[j].bottom, rects[i].bottom);
+
+			if (gdi_OutputCopyCost(&bounds) <= gdi_OutputCopyCost(&pCopies[j]) + gdi_OutputCopyCost(&rects[i]))
+			{
+				pCopies[j] = bounds;
+				break;
+			}
+		}
+
+		if (j == nbCopies)
+			pCopies[nbCopies++] = rects[i];
+	}
+
+	return nbCopies;
+}
+
 int gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 {
+	int index;
+	int nbRects;
+	int nbCopies;
 	int nDstStep;
 	BYTE* pDstData;
 	int nXDst, nYDst;
-	int nXSrc, nYSrc;
 	UINT16 width, height;
 	UINT32 surfaceX, surfaceY;
+	UINT32 bytesCopied;
 	RECTANGLE_16 surfaceRect;
+	RECTANGLE_16* pCopies;
+	const RECTANGLE_16* rects;
 	const RECTANGLE_16* extents;
 	rdpUpdate* update = gdi->context->update;
 
@@ -106,26 +274,47 @@ int gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 
 	if (!region16_is_empty(&(surface->invalidRegion)))
 	{
+		rects = region16_rects(&(surface->invalidRegion), &nbRects);
 		extents = region16_extents(&(surface->invalidRegion));
 
-		nXSrc = extents->left;
-		nYSrc = extents->top;
+		pCopies = (RECTANGLE_16*) malloc(sizeof(RECTANGLE_16) * nbRects);
 
-		nXDst = surfaceX + extents->left;
-		nYDst = surfaceY + extents->top;
+		if (!pCopies)
+			return -1;
 
-		width = extents->right - extents->left;
-		height = extents->bottom - extents->top;
+		nbCopies = gdi_OutputMergeRects(rects, nbRects, pCopies);
+		bytesCopied = 0;
 
 		update->BeginPaint(gdi->context);
 
-		freerdp_image_copy(pDstData, gdi->format, nDstStep, nXDst, nYDst,
-				width, height, surface->data, surface->format,
-				surface->scanline, nXSrc, nYSrc, NULL);
+		for (index = 0; index < nbCopies; index++)
+		{
+			nXDst = surfaceX + pCopies[index].left;
+			nYDst = surfaceY + pCopies[index].top;
+
+			width = pCopies[index].right - pCopies[index].left;
+			height = pCopies[index].bottom - pCopies[index].top;
+
+			if (!surface->outputDirect)
+			{
+				freerdp_image_copy(pDstData, gdi->format, nDstStep, nXDst, nYDst,
+						width, height, surface->data, surface->format,
+						surface->scanline, pCopies[index].left, pCopies[index].top, NULL);
 
-		gdi_InvalidateRegion(gdi->primary->hdc, nXDst, nYDst, width, height);
+				bytesCopied += width * height * gdi->bytesPerPixel;
+			}
+
+			gdi_InvalidateRegion(gdi->primary->hdc, nXDst, nYDst, width, height);
+		}
 
 		update->EndPaint(gdi->context);
+
+		free(pCopies);
+
+		gdi->frameBytesCopied += bytesCopied;
+		gdi->outputBytesCopied += bytesCopied;
+		gdi->outputBytesExtents += (extents->right - extents->left) *
+				(extents->bottom - extents->top) * gdi->bytesPerPixel;
 	}
 
 	region16_clear(&(surface->invalidRegion));
@@ -226,6 +415,7 @@ UINT gdi_StartFrame(RdpgfxClientContext* context, RDPGFX_START_FRAME_PDU* startF
 	rdpGdi* gdi = (rdpGdi*) context->custom;
 
 	gdi->inGfxFrame = TRUE;
+	gdi->frameBytesCopied = 0;
 
 	return CHANNEL_RC_OK;
 }
@@ -241,6 +431,9 @@ UINT gdi_EndFrame(RdpgfxClientContext* context, RDPGFX_END_FRAME_PDU* endFrame)
 
 	gdi_UpdateSurfaces(gdi);
 
+	WLog_DBG(TAG, "frame %u: %u bytes copied to the primary buffer",
+			endFrame->frameId, gdi->frameBytesCopied);
+
 	gdi->inGfxFrame = FALSE;
 
 	return CHANNEL_RC_OK;
@@ -459,6 +652,7 @@ UINT gdi_SurfaceCommand_H264(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_S
 	int status;
 	UINT32 i;
 	BYTE* DstData = NULL;
+	H264_CONTEXT* h264;
 	gdiGfxSurface* surface;
 	RDPGFX_H264_METABLOCK* meta;
 	RDPGFX_H264_BITMAP_STREAM* bs;
@@ -480,7 +674,12 @@ UINT gdi_SurfaceCommand_H264(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_S
 
 	DstData = surface->data;
 
-	status = h264_decompress(surface->codecs->h264, bs->data, bs->length, &DstData,
+	h264 = surface->codecs->h264;
+
+	if (!h264_trace_bitmap_stream(h264, bs))
+		WLog_WARN(TAG, "h264_trace_bitmap_stream failure");
+
+	status = h264_decompress(h264, bs->data, bs->length, &DstData,
 			PIXEL_FORMAT_XRGB32, surface->scanline, surface->width, surface->height,
 			meta->regionRects, meta->numRegionRects);
 
@@ -490,9 +689,64 @@ UINT gdi_SurfaceCommand_H264(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_S
 		return CHANNEL_RC_OK;
 	}
 
-	for (i = 0; i < meta->numRegionRects; i++)
+	/* a frame threaded decoder returns an earlier frame than this one, or none yet, with its own regions */
+	for (i = 0; i < h264->numOutputRects; i++)
 	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), (RECTANGLE_16*) &(meta->regionRects[i]));
+		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), (RECTANGLE_16*) &(h264->OutputRects[i]));
+	}
+
+	if (!gdi->inGfxFrame)
+		gdi_UpdateSurfaces(gdi);
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context, RDPGFX_SURFACE_COMMAND* cmd)
+{
+	int status;
+	UINT32 i, j;
+	BYTE* DstData = NULL;
+	gdiGfxSurface* surface;
+	RDPGFX_H264_METABLOCK* meta;
+	RDPGFX_AVC444_BITMAP_STREAM* bs;
+
+	surface = (gdiGfxSurface*) context->GetSurfaceData(context, cmd->surfaceId);
+
+	if (!surface)
+		return ERROR_INTERNAL_ERROR;
+
+	if (!freerdp_client_codecs_prepare(surface->codecs, FREERDP_CODEC_H264))
+		return ERROR_INTERNAL_ERROR;
+
+	bs = (RDPGFX_AVC444_BITMAP_STREAM*) cmd->extra;
+
+	if (!bs)
+		return ERROR_INTERNAL_ERROR;
+
+	DstData = surface->data;
+
+	status = h264_decompress_avc444(surface->codecs->h264, bs, &DstData,
+			PIXEL_FORMAT_XRGB32, surface->scanline, surface->width, surface->height);
+
+	if (status < 0)
+	{
+		WLog_WARN(TAG, "h264_decompress_avc444 failure: %d, ignoring update.", status);
+		return CHANNEL_RC_OK;
+	}
+
+	for (i = 0; i < bs->numStreams; i++)
+	{
+		meta = &(bs->bitstream[i].meta);
+
+		for (j = 0; j < meta->numRegionRects; j++)
+		{
+			region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), (RECTANGLE_16*) &(meta->regionRects[j]));
+		}
 	}
 
 	if (!gdi->inGfxFrame)
@@ -674,6 +928,10 @@ UINT gdi_SurfaceCommand(RdpgfxClientContext* context, RDPGFX_SURFACE_COMMAND* cm
 			status = gdi_SurfaceCommand_H264(gdi, context, cmd);
 			break;
 
+		case RDPGFX_CODECID_AVC444:
+			status = gdi_SurfaceCommand_AVC444(gdi, context, cmd);
+			break;
+
 		case RDPGFX_CODECID_ALPHA:
 			status = gdi_SurfaceCommand_Alpha(gdi, context, cmd);
 			break;
@@ -760,7 +1018,10 @@ UINT gdi_DeleteSurface(RdpgfxClientContext* context, RDPGFX_DELETE_SURFACE_PDU*
 	{
 		region16_uninit(&surface->invalidRegion);
 		codecs = surface->codecs;
-		free(surface->data);
+
+		if (!surface->outputDirect)
+			free(surface->data);
+
 		free(surface);
 	}
 
@@ -1022,19 +1283,29 @@ UINT gdi_EvictCacheEntry(RdpgfxClientContext* context, RDPGFX_EVICT_CACHE_ENTRY_
  */
 UINT gdi_MapSurfaceToOutput(RdpgfxClientContext* context, RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* surfaceToOutput)
 {
+	UINT16 mappedCount;
 	gdiGfxSurface* surface;
+	rdpGdi* gdi = (rdpGdi*) context->custom;
 
 	surface = (gdiGfxSurface*) context->GetSurfaceData(context, surfaceToOutput->surfaceId);
 
 	if (!surface)
 		return ERROR_INTERNAL_ERROR;
 
+	/* a direct surface would have its pixels overwritten by the output copies of another one */
+	if (!gdi_DetachSurfaceFromOutput(gdi, surface) ||
+		!gdi_DetachSurfacesFromOutput(gdi, surface->surfaceId, &mappedCount))
+		return CHANNEL_RC_NO_MEMORY;
+
 	surface->outputMapped = TRUE;
 	surface->outputOriginX = surfaceToOutput->outputOriginX;
 	surface->outputOriginY = surfaceToOutput->outputOriginY;
 
 	region16_clear(&surface->invalidRegion);
 
+	if ((mappedCount == 0) && gdi_SurfaceFitsOutput(gdi, surface))
+		gdi_AttachSurfaceToOutput(gdi, surface);
+
 	return CHANNEL_RC_OK;
 }
 
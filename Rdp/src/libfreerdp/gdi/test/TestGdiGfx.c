@@ -0,0 +1,332 @@
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codecs.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/client/rdpgfx.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+/**
+ * Full screen uncompressed surface updates through the gdi at 1080p and 4K, with the
+ * surface mapped 1:1 onto the output so it is decoded straight into the primary buffer,
+ * and with a second surface mapped so the output is copied from the surface buffer.
+ * Checks the primary buffer holds the updates either way and prints the time and the
+ * bytes copied per frame.
+ */
+
+#define TEST_GFX_FRAMES		50
+#define TEST_GFX_SURFACES	2
+
+struct _TEST_GFX
+{
+	RdpgfxClientContext context;
+	void* surfaces[TEST_GFX_SURFACES];
+};
+typedef struct _TEST_GFX TEST_GFX;
+
+static UINT test_gfx_SetSurfaceData(RdpgfxClientContext* context, UINT16 surfaceId, void* pData)
+{
+	if (surfaceId >= TEST_GFX_SURFACES)
+		return ERROR_INVALID_INDEX;
+
+	((TEST_GFX*) context)->surfaces[surfaceId] = pData;
+	return CHANNEL_RC_OK;
+}
+
+static void* test_gfx_GetSurfaceData(RdpgfxClientContext* context, UINT16 surfaceId)
+{
+	if (surfaceId >= TEST_GFX_SURFACES)
+		return NULL;
+
+	return ((TEST_GFX*) context)->surfaces[surfaceId];
+}
+
+static UINT test_gfx_GetSurfaceIds(RdpgfxClientContext* context, UINT16** ppSurfaceIds, UINT16* count)
+{
+	UINT16 index;
+	UINT16* pSurfaceIds;
+
+	pSurfaceIds = (UINT16*) calloc(TEST_GFX_SURFACES, sizeof(UINT16));
+
+	if (!pSurfaceIds)
+		return CHANNEL_RC_NO_MEMORY;
+
+	*count = 0;
+
+	for (index = 0; index < TEST_GFX_SURFACES; index++)
+	{
+		if (((TEST_GFX*) context)->surfaces[index])
+			pSurfaceIds[(*count)++] = index;
+	}
+
+	*ppSurfaceIds = pSurfaceIds;
+	return CHANNEL_RC_OK;
+}
+
+static BOOL test_gfx_BeginPaint(rdpContext* context)
+{
+	rdpGdi* gdi = context->gdi;
+
+	gdi->primary->hdc->hwnd->invalid->null = 1;
+	gdi->primary->hdc->hwnd->ninvalid = 0;
+	return TRUE;
+}
+
+static BOOL test_gfx_EndPaint(rdpContext* context)
+{
+	return TRUE;
+}
+
+static BOOL test_gfx_DesktopResize(rdpContext* context)
+{
+	return gdi_resize(context->gdi, context->settings->DesktopWidth, context->settings->DesktopHeight);
+}
+
+static UINT test_gfx_create_surface(RdpgfxClientContext* context, UINT16 surfaceId,
+		UINT16 x, UINT16 y, UINT16 width, UINT16 height)
+{
+	UINT status;
+	RDPGFX_CREATE_SURFACE_PDU createSurface;
+	RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU surfaceToOutput;
+
+	createSurface.surfaceId = surfaceId;
+	createSurface.width = width;
+	createSurface.height = height;
+	createSurface.pixelFormat = PIXEL_FORMAT_XRGB_8888;
+
+	status = context->CreateSurface(context, &createSurface);
+
+	if (status != CHANNEL_RC_OK)
+		return status;
+
+	surfaceToOutput.surfaceId = surfaceId;
+	surfaceToOutput.reserved = 0;
+	surfaceToOutput.outputOriginX = x;
+	surfaceToOutput.outputOriginY = y;
+
+	return context->MapSurfaceToOutput(context, &surfaceToOutput);
+}
+
+static void test_gfx_delete_surface(RdpgfxClientContext* context, UINT16 surfaceId)
+{
+	RDPGFX_DELETE_SURFACE_PDU deleteSurface;
+
+	deleteSurface.surfaceId = surfaceId;
+	context->DeleteSurface(context, &deleteSurface);
+}
+
+static int test_gfx_output(freerdp* instance, TEST_GFX* gfx, UINT32 width, UINT32 height, BOOL direct)
+{
+	int rc = -1;
+	UINT32 x, y;
+	UINT32 frame;
+	UINT64 start;
+	UINT64 elapsed;
+	UINT64 bytesCopied;
+	BYTE* pSrcData = NULL;
+	UINT32* pixel;
+	gdiGfxSurface* surface;
+	RDPGFX_RESET_GRAPHICS_PDU resetGraphics;
+	RDPGFX_START_FRAME_PDU startFrame;
+	RDPGFX_END_FRAME_PDU endFrame;
+	RDPGFX_SURFACE_COMMAND cmd;
+	RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU surfaceToOutput;
+	rdpGdi* gdi = instance->context->gdi;
+	RdpgfxClientContext* context = &gfx->context;
+
+	ZeroMemory(&resetGraphics, sizeof(resetGraphics));
+	resetGraphics.width = width;
+	resetGraphics.height = height;
+
+	if (context->ResetGraphics(context, &resetGraphics) != CHANNEL_RC_OK)
+		return -1;
+
+	/* a cursor sized surface in the corner keeps the screen surface from being mapped 1:1 */
+	if (!direct && (test_gfx_create_surface(context, 1, 0, 0, 32, 32) != CHANNEL_RC_OK))
+		goto fail;
+
+	if (test_gfx_create_surface(context, 0, 0, 0, width, height) != CHANNEL_RC_OK)
+		goto fail;
+
+	surface = (gdiGfxSurface*) context->GetSurfaceData(context, 0);
+
+	if (surface->outputDirect != direct)
+	{
+		printf("surface %ux%u is %s directly\n", width, height, direct ? "not mapped" : "mapped");
+		goto fail;
+	}
+
+	pSrcData = (BYTE*) malloc(width * height * 4);
+
+	if (!pSrcData)
+		goto fail;
+
+	ZeroMemory(&cmd, sizeof(cmd));
+	cmd.surfaceId = 0;
+	cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
+	cmd.format = PIXEL_FORMAT_XRGB_8888;
+	cmd.right = cmd.width = width;
+	cmd.bottom = cmd.height = height;
+	cmd.length = width * height * 4;
+	cmd.data = pSrcData;
+
+	bytesCopied = gdi->outputBytesCopied;
+	elapsed = 0;
+
+	for (frame = 0; frame < TEST_GFX_FRAMES; frame++)
+	{
+		pixel = (UINT32*) pSrcData;
+
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+				*pixel++ = (frame << 16) ^ (y << 8) ^ x;
+		}
+
+		startFrame.frameId = frame;
+		endFrame.frameId = frame;
+
+		start = GetTickCount64();
+		context->StartFrame(context, &startFrame);
+
+		if (context->SurfaceCommand(context, &cmd) != CHANNEL_RC_OK)
+			goto fail;
+
+		context->EndFrame(context, &endFrame);
+		elapsed += GetTickCount64() - start;
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		pixel = (UINT32*) &gdi->primary_buffer[y * gdi->width * 4];
+
+		for (x = 0; x < width; x++)
+		{
+			if ((pixel[x] & 0xFFFFFF) != ((((TEST_GFX_FRAMES - 1) << 16) ^ (y << 8) ^ x) & 0xFFFFFF))
+			{
+				printf("%ux%u %s: pixel %u,%u is 0x%08X\n", width, height,
+						direct ? "direct" : "copied", x, y, pixel[x]);
+				goto fail;
+			}
+		}
+	}
+
+	bytesCopied = gdi->outputBytesCopied - bytesCopied;
+
+	printf("%4ux%-4u %-7s %6.2f ms %10llu bytes copied per frame\n", width, height,
+			direct ? "direct" : "copied", ((double) elapsed) / TEST_GFX_FRAMES,
+			(unsigned long long) (bytesCopied / TEST_GFX_FRAMES));
+
+	if (direct && bytesCopied)
+		goto fail;
+
+	/* a resize that does not come from ResetGraphics reallocates the primary buffer under the direct surface */
+	if (direct)
+	{
+		if (!gdi_resize(gdi, width, height + 16))
+			goto fail;
+
+		pixel = (UINT32*) surface->data;
+
+		if (surface->outputDirect || (surface->data == gdi->primary_buffer) ||
+			((pixel[width - 1] & 0xFFFFFF) != ((((TEST_GFX_FRAMES - 1) << 16) ^ (width - 1)) & 0xFFFFFF)))
+		{
+			printf("%ux%u: surface not detached by the resize\n", width, height);
+			goto fail;
+		}
+
+		if (!gdi_resize(gdi, width, height))
+			goto fail;
+
+		surfaceToOutput.surfaceId = 0;
+		surfaceToOutput.reserved = 0;
+		surfaceToOutput.outputOriginX = 0;
+		surfaceToOutput.outputOriginY = 0;
+
+		if ((context->MapSurfaceToOutput(context, &surfaceToOutput) != CHANNEL_RC_OK) ||
+			!surface->outputDirect)
+			goto fail;
+	}
+
+	/* mapping another surface gives the direct one a buffer of its own, with the pixels it had */
+	if (direct)
+	{
+		if (test_gfx_create_surface(context, 1, 0, 0, 32, 32) != CHANNEL_RC_OK)
+			goto fail;
+
+		if (surface->outputDirect || (surface->data == gdi->primary_buffer) ||
+			(memcmp(surface->data, gdi->primary_buffer, width * 4) != 0))
+		{
+			printf("%ux%u: surface not detached from the output\n", width, height);
+			goto fail;
+		}
+	}
+
+	rc = 0;
+
+fail:
+	free(pSrcData);
+	test_gfx_delete_surface(context, 0);
+	test_gfx_delete_surface(context, 1);
+	return rc;
+}
+
+int TestGdiGfx(int argc, char* argv[])
+{
+	int rc = -1;
+	TEST_GFX gfx;
+	freerdp* instance;
+
+	ZeroMemory(&gfx, sizeof(gfx));
+	gfx.context.SetSurfaceData = test_gfx_SetSurfaceData;
+	gfx.context.GetSurfaceData = test_gfx_GetSurfaceData;
+	gfx.context.GetSurfaceIds = test_gfx_GetSurfaceIds;
+
+	instance = freerdp_new();
+
+	if (!instance || !freerdp_context_new(instance))
+		return -1;
+
+	instance->settings->DesktopWidth = 1920;
+	instance->settings->DesktopHeight = 1080;
+	instance->settings->ColorDepth = 32;
+	instance->context->codecs = codecs_new(instance->context);
+
+	if (!instance->context->codecs || !gdi_init(instance, CLRCONV_ALPHA | CLRBUF_32BPP, NULL))
+		goto fail;
+
+	instance->update->BeginPaint = test_gfx_BeginPaint;
+	instance->update->EndPaint = test_gfx_EndPaint;
+	instance->update->DesktopResize = test_gfx_DesktopResize;
+
+	gdi_graphics_pipeline_init(instance->context->gdi, &gfx.context);
+
+	if (test_gfx_output(instance, &gfx, 1920, 1080, TRUE) < 0)
+		goto fail;
+
+	if (test_gfx_output(instance, &gfx, 1920, 1080, FALSE) < 0)
+		goto fail;
+
+	if (test_gfx_output(instance, &gfx, 3840, 2160, TRUE) < 0)
+		goto fail;
+
+	if (test_gfx_output(instance, &gfx, 3840, 2160, FALSE) < 0)
+		goto fail;
+
+	rc = 0;
+
+fail:
+	if (instance->context->gdi)
+	{
+		gdi_graphics_pipeline_uninit(instance->context->gdi, &gfx.context);
+		gdi_free(instance);
+	}
+
+	codecs_free(instance->context->codecs);
+
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
@@ -26,6 +26,15 @@
 
 pstatus_t general_YCoCgToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep, BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height, UINT8 shift, BOOL withAlpha, BOOL invert);
 
+#ifdef WITH_SSE2
+pstatus_t ssse3_YCoCgRToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep, BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height, UINT8 shift, BOOL withAlpha, BOOL invert);
+#endif /* WITH_SSE2 */
+
+#ifdef WITH_AVX2
+pstatus_t avx2_YCoCgRToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep, BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height, UINT8 shift, BOOL withAlpha, BOOL invert);
+#endif /* WITH_AVX2 */
+
 void primitives_init_YCoCg_opt(primitives_t* prims);
+void primitives_init_YCoCg_avx2(primitives_t* prims);
 
 #endif /* !__PRIM_YCOCG_H_INCLUDED__ */
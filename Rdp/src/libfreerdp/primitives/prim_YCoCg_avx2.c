@@ -0,0 +1,162 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 YCoCg<->RGB conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_AVX2
+#include <immintrin.h>
+#endif /* WITH_AVX2 */
+
+#include "prim_internal.h"
+#include "prim_YCoCg.h"
+
+#ifdef WITH_AVX2
+
+/* ------------------------------------------------------------------------- */
+/* The steps of ssse3_YCoCgRToRGB_8u_AC4R on 16 pixels at a time. All the
+ * shuffles, unpacks and packs work within the 128-bit lanes, so each lane
+ * takes the place of an SSE register: the low lanes hold pixels 0-3 and 4-7,
+ * the high lanes 8-11 and 12-15.
+ */
+pstatus_t avx2_YCoCgRToRGB_8u_AC4R(
+	const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep,
+	UINT32 width, UINT32 height,
+	UINT8 shift,
+	BOOL withAlpha,
+	BOOL invert)
+{
+	const BYTE *sptr;
+	BYTE *dptr;
+	UINT32 h;
+	/* Shift left by "shift" and divide by two is the same as shift
+	 * left by "shift-1".
+	 */
+	int dataShift = shift - 1;
+	BYTE mask = (BYTE) (0xFFU << dataShift);
+	__m128i count = _mm_cvtsi32_si128(dataShift);
+	__m256i shuffle = _mm256_set_epi32(0x0f0b0703, 0x0e0a0602, 0x0d090501, 0x0c080400,
+		0x0f0b0703, 0x0e0a0602, 0x0d090501, 0x0c080400);
+	__m256i zero = _mm256_setzero_si256();
+	__m256i masks = _mm256_set1_epi8((char) mask);
+	__m256i opaque = _mm256_set1_epi32(0xFFFFFFFF);
+
+	if (width < 16)
+	{
+		return ssse3_YCoCgRToRGB_8u_AC4R(pSrc, srcStep, pDst, dstStep,
+			width, height, shift, withAlpha, invert);
+	}
+
+	for (h = 0; h < height; h++)
+	{
+		UINT32 w = width;
+
+		sptr = pSrc + h * srcStep;
+		dptr = pDst + h * dstStep;
+
+		while (w >= 16)
+		{
+			__m256i R0, R1, R2, R3, R4, R5, R6, R7;
+
+			R0 = _mm256_loadu_si256((const __m256i *) sptr);
+			R1 = _mm256_loadu_si256((const __m256i *) (sptr + 32));
+			sptr += 64;
+			/* R0 = pixels 4-7 | 0-3, R1 = 12-15 | 8-11 */
+			R2 = _mm256_permute2x128_si256(R0, R1, 0x20);
+			R1 = _mm256_permute2x128_si256(R0, R1, 0x31);
+			R0 = R2;
+			/* R0 = pixels 8-11 | 0-3, R1 = 12-15 | 4-7 */
+
+			/* Shuffle to pack all the like types together. */
+			R3 = _mm256_shuffle_epi8(R0, shuffle);
+			R4 = _mm256_shuffle_epi8(R1, shuffle);
+			R5 = _mm256_unpackhi_epi32(R3, R4);
+			R6 = _mm256_unpacklo_epi32(R3, R4);
+			/* Save alphas aside */
+			if (withAlpha) R7 = _mm256_unpackhi_epi64(R5, R5);
+			else R7 = opaque;
+			/* Expand Y's from 8-bit unsigned to 16-bit signed. */
+			R0 = _mm256_unpacklo_epi8(R5, zero);
+			/* Shift Co's and Cg's by (shift-1), before the sign-conversion. */
+			R6 = _mm256_sll_epi16(R6, count);
+			R6 = _mm256_and_si256(R6, masks);
+			/* Expand Co's from 8-bit signed to 16-bit signed */
+			R1 = _mm256_unpackhi_epi8(R6, R6);
+			R1 = _mm256_srai_epi16(R1, 8);
+			/* Expand Cg's form 8-bit signed to 16-bit signed */
+			R2 = _mm256_unpacklo_epi8(R6, R6);
+			R2 = _mm256_srai_epi16(R2, 8);
+			/* Get Y - halfCg and save */
+			R6 = _mm256_subs_epi16(R0, R2);
+
+			/* R = (Y-halfCg) + halfCo */
+			R3 = _mm256_adds_epi16(R6, R1);
+			/* G = Y + Cg(/2) */
+			R4 = _mm256_adds_epi16(R0, R2);
+			/* B = (Y-halfCg) - Co(/2) */
+			R5 = _mm256_subs_epi16(R6, R1);
+
+			/* Repack R's & B's, the order is the only diff between inverted and non-inverted. */
+			if (invert)
+				R0 = _mm256_packus_epi16(R3, R5);
+			else
+				R0 = _mm256_packus_epi16(R5, R3);
+			/* Repack G's and add the A's. */
+			R1 = _mm256_packus_epi16(R4, R4);
+			R1 = _mm256_unpackhi_epi64(R1, R7);
+
+			/* Now do interleaving again. */
+			R2 = _mm256_unpacklo_epi8(R0, R1);
+			R3 = _mm256_unpackhi_epi8(R0, R1);
+			R4 = _mm256_unpacklo_epi16(R2, R3);
+			R5 = _mm256_unpackhi_epi16(R2, R3);
+			/* R4 = pixels 8-11 | 0-3, R5 = 12-15 | 4-7 */
+
+			_mm256_storeu_si256((__m256i *) dptr, _mm256_permute2x128_si256(R4, R5, 0x20));
+			_mm256_storeu_si256((__m256i *) (dptr + 32), _mm256_permute2x128_si256(R4, R5, 0x31));
+			dptr += 64;
+			w -= 16;
+		}
+
+		/* Handle any remainder pixels. */
+		if (w > 0)
+		{
+			general_YCoCgToRGB_8u_AC4R(sptr, srcStep, dptr, dstStep,
+				w, 1, shift, withAlpha, invert);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_AVX2 */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_YCoCg_avx2(primitives_t* prims)
+{
+#if defined(WITH_AVX2)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->YCoCgToRGB_8u_AC4R = avx2_YCoCgRToRGB_8u_AC4R;
+	}
+#endif /* WITH_AVX2 */
+}
@@ -396,4 +396,8 @@ void primitives_init_YCoCg_opt(primitives_t* prims)
 		prims->YCoCgToRGB_8u_AC4R = ssse3_YCoCgRToRGB_8u_AC4R;
 	}
 #endif /* WITH_SSE2 */
+
+#if defined(WITH_AVX2)
+	primitives_init_YCoCg_avx2(prims);
+#endif /* WITH_AVX2 */
 }
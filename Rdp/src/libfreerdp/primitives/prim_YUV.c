@@ -20,6 +20,8 @@
 #include "config.h"
 #endif
 
+#include <winpr/crt.h>
+
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 #include <freerdp/codec/color.h>
@@ -365,10 +367,145 @@ pstatus_t general_RGBToYUV420_8u_P3AC4R(const BYTE* pSrc, INT32 srcStep,
 	return PRIMITIVES_SUCCESS;
 }
 
+pstatus_t general_YUV444ToRGB_8u_P3AC4R(const BYTE* pSrc[3], int srcStep[3],
+		BYTE* pDst, int dstStep, const prim_size_t* roi)
+{
+	int x, y;
+	const BYTE* pY;
+	const BYTE* pU;
+	const BYTE* pV;
+	BYTE* pRGB;
+	int R, G, B;
+	int Yp, Up, Vp;
+
+	for (y = 0; y < roi->height; y++)
+	{
+		pY = pSrc[0] + y * srcStep[0];
+		pU = pSrc[1] + y * srcStep[1];
+		pV = pSrc[2] + y * srcStep[2];
+		pRGB = pDst + y * dstStep;
+
+		for (x = 0; x < roi->width; x++)
+		{
+			Yp = pY[x] << 8;
+			Up = pU[x] - 128;
+			Vp = pV[x] - 128;
+
+			R = (Yp + Vp * 403) >> 8;
+			G = (Yp - Up * 48 - Vp * 120) >> 8;
+			B = (Yp + Up * 475) >> 8;
+
+			if (R < 0)
+				R = 0;
+			else if (R > 255)
+				R = 255;
+
+			if (G < 0)
+				G = 0;
+			else if (G > 255)
+				G = 255;
+
+			if (B < 0)
+				B = 0;
+			else if (B > 255)
+				B = 255;
+
+			*pRGB++ = (BYTE) B;
+			*pRGB++ = (BYTE) G;
+			*pRGB++ = (BYTE) R;
+			*pRGB++ = 0xFF;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/**
+ * AVC444 frames (MS-RDPEGFX 3.3.8.3.2) are sent as a main view, a YUV420 frame holding the luma
+ * and the chroma averaged over 2x2 blocks, and an auxiliary view holding the remaining chroma
+ * samples. Both write into full resolution planes, over rect, which is in frame coordinates and
+ * starts and ends on even coordinates.
+ */
+
+pstatus_t general_AVC444LumaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3],
+		BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect)
+{
+	int x, y;
+	const BYTE* pU;
+	const BYTE* pV;
+	BYTE* pU0;
+	BYTE* pV0;
+	BYTE* pU1;
+	BYTE* pV1;
+	int width = rect->right - rect->left;
+
+	for (y = rect->top; y < rect->bottom; y++)
+		CopyMemory(pDst[0] + y * dstStep[0] + rect->left, pSrc[0] + y * srcStep[0] + rect->left, width);
+
+	for (y = rect->top; y < rect->bottom; y += 2)
+	{
+		pU = pSrc[1] + (y / 2) * srcStep[1] + rect->left / 2;
+		pV = pSrc[2] + (y / 2) * srcStep[2] + rect->left / 2;
+		pU0 = pDst[1] + y * dstStep[1] + rect->left;
+		pV0 = pDst[2] + y * dstStep[2] + rect->left;
+		pU1 = pU0 + dstStep[1];
+		pV1 = pV0 + dstStep[2];
+
+		for (x = 0; x < width; x += 2)
+		{
+			pU0[x] = pU0[x + 1] = pU1[x] = pU1[x + 1] = pU[x / 2];
+			pV0[x] = pV0[x + 1] = pV1[x] = pV1[x + 1] = pV[x / 2];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+pstatus_t general_AVC444ChromaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3],
+		BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect)
+{
+	int x, y;
+	const BYTE* pUa;
+	const BYTE* pVa;
+	BYTE* pU0;
+	BYTE* pV0;
+	BYTE* pU1;
+	BYTE* pV1;
+	int width = rect->right - rect->left;
+
+	for (y = rect->top; y < rect->bottom; y += 2)
+	{
+		pUa = pSrc[1] + (y / 2) * srcStep[1] + rect->left / 2;
+		pVa = pSrc[2] + (y / 2) * srcStep[2] + rect->left / 2;
+		pU0 = pDst[1] + y * dstStep[1] + rect->left;
+		pV0 = pDst[2] + y * dstStep[2] + rect->left;
+		pU1 = pU0 + dstStep[1];
+		pV1 = pV0 + dstStep[2];
+
+		/* the odd rows come from the auxiliary luma plane */
+		CopyMemory(pU1, pSrc[0] + AVC444_AUX_ROW(y) * srcStep[0] + rect->left, width);
+		CopyMemory(pV1, pSrc[0] + (AVC444_AUX_ROW(y) + 8) * srcStep[0] + rect->left, width);
+
+		/* the odd columns of the even rows from the auxiliary chroma planes */
+		for (x = 0; x < width; x += 2)
+		{
+			pU0[x + 1] = pUa[x / 2];
+			pV0[x + 1] = pVa[x / 2];
+			pU0[x] = avc444_chroma_filter(pU0[x], pU0[x + 1], pU1[x], pU1[x + 1]);
+			pV0[x] = avc444_chroma_filter(pV0[x], pV0[x + 1], pV1[x], pV1[x + 1]);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 void primitives_init_YUV(primitives_t* prims)
 {
 	prims->YUV420ToRGB_8u_P3AC4R = general_YUV420ToRGB_8u_P3AC4R;
 	prims->RGBToYUV420_8u_P3AC4R = general_RGBToYUV420_8u_P3AC4R;
+	prims->YUV444ToRGB_8u_P3AC4R = general_YUV444ToRGB_8u_P3AC4R;
+	prims->AVC444LumaToYUV444_8u_P3P3 = general_AVC444LumaToYUV444_8u_P3P3;
+	prims->AVC444ChromaToYUV444_8u_P3P3 = general_AVC444ChromaToYUV444_8u_P3P3;
 	
 	primitives_init_YUV_opt(prims);
 }
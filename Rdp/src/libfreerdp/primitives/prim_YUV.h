@@ -20,6 +20,51 @@
 #define FREERDP_PRIMITIVES_YUV_H
 
 pstatus_t general_yCbCrToRGB_16s8u_P3AC4R(const INT16* pSrc[3], int srcStep, BYTE* pDst, int dstStep, const prim_size_t* roi);
+pstatus_t general_YUV444ToRGB_8u_P3AC4R(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst, int dstStep, const prim_size_t* roi);
+pstatus_t general_AVC444LumaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect);
+pstatus_t general_AVC444ChromaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect);
+
+#ifdef WITH_SSE2
+pstatus_t sse2_YUV444ToRGB_8u_P3AC4R(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst, int dstStep, const prim_size_t* roi);
+pstatus_t sse2_AVC444LumaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect);
+pstatus_t sse2_AVC444ChromaToYUV444_8u_P3P3(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst[3], int dstStep[3], const RECTANGLE_16* rect);
+#endif /* WITH_SSE2 */
+
+#ifdef WITH_AVX2
+pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE* pSrc[3], int srcStep[3], BYTE* pDst, int dstStep, const prim_size_t* roi);
+#endif /* WITH_AVX2 */
+
+/**
+ * The auxiliary view of an AVC444 frame holds the odd rows of the full resolution U and V planes
+ * in its luma plane, interleaved in blocks of 8 rows, U first. Returns the row of the auxiliary
+ * luma plane holding the U row following the even row y, the V row is 8 rows further.
+ */
+#define AVC444_AUX_ROW(_y) ((((_y) / 2) / 8) * 16 + ((_y) / 2) % 8)
+
+/**
+ * The main view of an AVC444 frame holds the average of each 2x2 block of the full resolution U
+ * and V planes. Once the three other samples of a block are known the top left one is rebuilt
+ * from it, unless the result is so close to the average that the difference is coding noise.
+ */
+static INLINE BYTE avc444_chroma_filter(BYTE average, BYTE topRight, BYTE bottomLeft, BYTE bottomRight)
+{
+	INT32 value = 4 * average - topRight - bottomLeft - bottomRight;
+	INT32 diff;
+
+	if (value < 0)
+		value = 0;
+	else if (value > 255)
+		value = 255;
+
+	diff = value - average;
+
+	if ((diff < 30) && (diff > -30))
+		return average;
+
+	return (BYTE) value;
+}
+
+void primitives_init_YUV_avx2(primitives_t* prims);
 
 void primitives_init_YUV(primitives_t* prims);
 void primitives_init_YUV_opt(primitives_t* prims);
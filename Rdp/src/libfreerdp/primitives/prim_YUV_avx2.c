@@ -0,0 +1,125 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 YUV<->RGB conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_AVX2
+#include <immintrin.h>
+#endif /* WITH_AVX2 */
+
+#include "prim_internal.h"
+#include "prim_YUV.h"
+
+#ifdef WITH_AVX2
+
+/* ------------------------------------------------------------------------- */
+/* The math of sse2_YUV444ToRGB_8u_P3AC4R on 16 pixels per step. The bytes
+ * are widened across the lanes, so the words are in pixel order and only the
+ * final interleave, which stays within the lanes, needs the halves swapped.
+ */
+pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(
+	const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst, int dstStep,
+	const prim_size_t *roi)
+{
+	int x, y;
+	const BYTE *pY, *pU, *pV;
+	BYTE *pRGB;
+	prim_size_t tail;
+	const BYTE *pTail[3];
+	int width = roi->width & ~15;
+	__m256i zero, max, c128, alpha, r_v, b_u, g_uv;
+
+	zero = _mm256_setzero_si256();
+	max = _mm256_set1_epi16(255);
+	c128 = _mm256_set1_epi16(128);
+	alpha = _mm256_set1_epi16((short) 0xFF00);
+	r_v = _mm256_set1_epi16(806);	/* 403 << 1 */
+	b_u = _mm256_set1_epi16(950);	/* 475 << 1 */
+	g_uv = _mm256_set1_epi32((INT32) ((((UINT32) (UINT16) -120) << 16) | (UINT16) -48));
+
+	for (y = 0; y < roi->height; y++)
+	{
+		pY = pSrc[0] + y * srcStep[0];
+		pU = pSrc[1] + y * srcStep[1];
+		pV = pSrc[2] + y * srcStep[2];
+		pRGB = pDst + y * dstStep;
+
+		for (x = 0; x < width; x += 16)
+		{
+			__m256i Y, U, V, R, G, B, BG, RA, lo, hi;
+
+			Y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (pY + x)));
+			U = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (pU + x)));
+			V = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (pV + x)));
+			U = _mm256_sub_epi16(U, c128);
+			V = _mm256_sub_epi16(V, c128);
+
+			R = _mm256_add_epi16(Y, _mm256_mulhi_epi16(_mm256_slli_epi16(V, 7), r_v));
+			B = _mm256_add_epi16(Y, _mm256_mulhi_epi16(_mm256_slli_epi16(U, 7), b_u));
+			/* the unpacks and the pack stay within the lanes, which keeps the pixel order */
+			G = _mm256_packs_epi32(
+				_mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(U, V), g_uv), 8),
+				_mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(U, V), g_uv), 8));
+			G = _mm256_add_epi16(Y, G);
+
+			R = _mm256_min_epi16(max, _mm256_max_epi16(R, zero));
+			G = _mm256_min_epi16(max, _mm256_max_epi16(G, zero));
+			B = _mm256_min_epi16(max, _mm256_max_epi16(B, zero));
+
+			BG = _mm256_or_si256(B, _mm256_slli_epi16(G, 8));
+			RA = _mm256_or_si256(R, alpha);
+
+			/* pixels 0-3 and 8-11, 4-7 and 12-15 */
+			lo = _mm256_unpacklo_epi16(BG, RA);
+			hi = _mm256_unpackhi_epi16(BG, RA);
+
+			_mm256_storeu_si256((__m256i *) (pRGB + x * 4), _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i *) (pRGB + x * 4 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+
+	if (width < roi->width)
+	{
+		tail.width = roi->width - width;
+		tail.height = roi->height;
+		pTail[0] = pSrc[0] + width;
+		pTail[1] = pSrc[1] + width;
+		pTail[2] = pSrc[2] + width;
+		general_YUV444ToRGB_8u_P3AC4R(pTail, srcStep, pDst + width * 4, dstStep, &tail);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_AVX2 */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_YUV_avx2(primitives_t* prims)
+{
+#if defined(WITH_AVX2)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->YUV444ToRGB_8u_P3AC4R = avx2_YUV444ToRGB_8u_P3AC4R;
+	}
+#endif /* WITH_AVX2 */
+}
@@ -16,6 +16,7 @@
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 
+#include "prim_YUV.h"
 
 #ifdef WITH_SSE2
 
@@ -357,6 +358,185 @@ pstatus_t ssse3_YUV420ToRGB_8u_P3AC4R(const BYTE **pSrc, int *srcStep,
 	
 	return PRIMITIVES_SUCCESS;
 }
+
+/**
+ * The same integer math as general_YUV444ToRGB_8u_P3AC4R on 8 pixels per step, so both give the
+ * same results: (V * 403) >> 8 and (U * 475) >> 8 are the high words of (V << 7) * 806 and
+ * (U << 7) * 950, and the G term is the sum of a pair of products kept on 32 bits.
+ */
+pstatus_t sse2_YUV444ToRGB_8u_P3AC4R(const BYTE *pSrc[3], int srcStep[3],
+		BYTE *pDst, int dstStep, const prim_size_t *roi)
+{
+	int x, y;
+	const BYTE *pY, *pU, *pV;
+	BYTE *pRGB;
+	prim_size_t tail;
+	const BYTE *pTail[3];
+	int width = roi->width & ~7;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi16(255);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi16((short) 0xFF00);
+	const __m128i r_v = _mm_set1_epi16(806);
+	const __m128i b_u = _mm_set1_epi16(950);
+	const __m128i g_uv = _mm_set_epi16(-120, -48, -120, -48, -120, -48, -120, -48);
+
+	for (y = 0; y < roi->height; y++)
+	{
+		pY = pSrc[0] + y * srcStep[0];
+		pU = pSrc[1] + y * srcStep[1];
+		pV = pSrc[2] + y * srcStep[2];
+		pRGB = pDst + y * dstStep;
+
+		for (x = 0; x < width; x += 8)
+		{
+			__m128i Y, U, V, R, G, B, BG, RA;
+
+			Y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pY + x)), zero);
+			U = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pU + x)), zero);
+			V = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pV + x)), zero);
+			U = _mm_sub_epi16(U, c128);
+			V = _mm_sub_epi16(V, c128);
+
+			R = _mm_add_epi16(Y, _mm_mulhi_epi16(_mm_slli_epi16(V, 7), r_v));
+			B = _mm_add_epi16(Y, _mm_mulhi_epi16(_mm_slli_epi16(U, 7), b_u));
+			G = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(U, V), g_uv), 8),
+				_mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(U, V), g_uv), 8));
+			G = _mm_add_epi16(Y, G);
+
+			R = _mm_min_epi16(max, _mm_max_epi16(R, zero));
+			G = _mm_min_epi16(max, _mm_max_epi16(G, zero));
+			B = _mm_min_epi16(max, _mm_max_epi16(B, zero));
+
+			BG = _mm_or_si128(B, _mm_slli_epi16(G, 8));
+			RA = _mm_or_si128(R, alpha);
+
+			_mm_storeu_si128((__m128i *) (pRGB + x * 4), _mm_unpacklo_epi16(BG, RA));
+			_mm_storeu_si128((__m128i *) (pRGB + x * 4 + 16), _mm_unpackhi_epi16(BG, RA));
+		}
+	}
+
+	if (width < roi->width)
+	{
+		tail.width = roi->width - width;
+		tail.height = roi->height;
+		pTail[0] = pSrc[0] + width;
+		pTail[1] = pSrc[1] + width;
+		pTail[2] = pSrc[2] + width;
+		general_YUV444ToRGB_8u_P3AC4R(pTail, srcStep, pDst + width * 4, dstStep, &tail);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/**
+ * Widens the chroma of the main view 32 columns at a time, the columns left over and the luma go
+ * through general_AVC444LumaToYUV444_8u_P3P3.
+ */
+pstatus_t sse2_AVC444LumaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+		BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect)
+{
+	int x, y, i;
+	const BYTE *pS;
+	BYTE *pD0, *pD1;
+	RECTANGLE_16 tail;
+	int width = (rect->right - rect->left) & ~31;
+
+	for (y = rect->top; y < rect->bottom; y++)
+		CopyMemory(pDst[0] + y * dstStep[0] + rect->left, pSrc[0] + y * srcStep[0] + rect->left, width);
+
+	for (y = rect->top; y < rect->bottom; y += 2)
+	{
+		for (i = 1; i < 3; i++)
+		{
+			pS = pSrc[i] + (y / 2) * srcStep[i] + rect->left / 2;
+			pD0 = pDst[i] + y * dstStep[i] + rect->left;
+			pD1 = pD0 + dstStep[i];
+
+			for (x = 0; x < width; x += 32)
+			{
+				__m128i s = _mm_loadu_si128((const __m128i *) (pS + x / 2));
+				__m128i lo = _mm_unpacklo_epi8(s, s);
+				__m128i hi = _mm_unpackhi_epi8(s, s);
+
+				_mm_storeu_si128((__m128i *) (pD0 + x), lo);
+				_mm_storeu_si128((__m128i *) (pD0 + x + 16), hi);
+				_mm_storeu_si128((__m128i *) (pD1 + x), lo);
+				_mm_storeu_si128((__m128i *) (pD1 + x + 16), hi);
+			}
+		}
+	}
+
+	if (rect->left + width < rect->right)
+	{
+		tail = *rect;
+		tail.left += width;
+		general_AVC444LumaToYUV444_8u_P3P3(pSrc, srcStep, pDst, dstStep, &tail);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/**
+ * Fills and filters the even rows 8 column pairs at a time, with the same math as
+ * avc444_chroma_filter on 16-bit words holding the top left sample of each pair.
+ */
+pstatus_t sse2_AVC444ChromaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+		BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect)
+{
+	int x, y, i;
+	const BYTE *pA;
+	BYTE *pD0, *pD1;
+	int width = rect->right - rect->left;
+	int simdWidth = width & ~15;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	const __m128i threshold = _mm_set1_epi16(30);
+
+	for (y = rect->top; y < rect->bottom; y += 2)
+	{
+		for (i = 1; i < 3; i++)
+		{
+			pA = pSrc[i] + (y / 2) * srcStep[i] + rect->left / 2;
+			pD0 = pDst[i] + y * dstStep[i] + rect->left;
+			pD1 = pD0 + dstStep[i];
+
+			/* the odd rows come from the auxiliary luma plane, the V ones 8 rows below the U ones */
+			CopyMemory(pD1, pSrc[0] + (AVC444_AUX_ROW(y) + (i - 1) * 8) * srcStep[0] + rect->left, width);
+
+			for (x = 0; x < simdWidth; x += 16)
+			{
+				__m128i odd0, row1, even0, even1, odd1, value, diff, keep;
+
+				odd0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pA + x / 2)), zero);
+				even0 = _mm_and_si128(_mm_loadu_si128((const __m128i *) (pD0 + x)), mask);
+				row1 = _mm_loadu_si128((const __m128i *) (pD1 + x));
+				even1 = _mm_and_si128(row1, mask);
+				odd1 = _mm_srli_epi16(row1, 8);
+
+				value = _mm_sub_epi16(_mm_slli_epi16(even0, 2), odd0);
+				value = _mm_sub_epi16(value, _mm_add_epi16(even1, odd1));
+				value = _mm_min_epi16(mask, _mm_max_epi16(value, zero));
+
+				diff = _mm_sub_epi16(value, even0);
+				diff = _mm_max_epi16(diff, _mm_sub_epi16(zero, diff));
+				keep = _mm_cmpgt_epi16(threshold, diff);
+				value = _mm_or_si128(_mm_and_si128(keep, even0), _mm_andnot_si128(keep, value));
+
+				_mm_storeu_si128((__m128i *) (pD0 + x), _mm_or_si128(value, _mm_slli_epi16(odd0, 8)));
+			}
+
+			for (; x < width; x += 2)
+			{
+				pD0[x + 1] = pA[x / 2];
+				pD0[x] = avc444_chroma_filter(pD0[x], pD0[x + 1], pD1[x], pD1[x + 1]);
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif
 
 void primitives_init_YUV_opt(primitives_t *prims)
@@ -366,5 +546,14 @@ void primitives_init_YUV_opt(primitives_t *prims)
 	{
 		prims->YUV420ToRGB_8u_P3AC4R = ssse3_YUV420ToRGB_8u_P3AC4R;
 	}
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->YUV444ToRGB_8u_P3AC4R = sse2_YUV444ToRGB_8u_P3AC4R;
+		prims->AVC444LumaToYUV444_8u_P3P3 = sse2_AVC444LumaToYUV444_8u_P3P3;
+		prims->AVC444ChromaToYUV444_8u_P3P3 = sse2_AVC444ChromaToYUV444_8u_P3P3;
+	}
 #endif
+
+	primitives_init_YUV_avx2(prims);
 }
@@ -27,7 +27,18 @@ pstatus_t general_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3], INT32 srcStep, IN
 pstatus_t general_RGBToYCbCr_16s16s_P3P3(const INT16 *pSrc[3], INT32 srcStep, INT16 *pDst[3], INT32 dstStep, const prim_size_t *roi);
 pstatus_t general_RGBToRGB_16s8u_P3AC4R(const INT16 *pSrc[3], int srcStep, BYTE *pDst, int dstStep, const prim_size_t *roi);
 
+#ifdef WITH_SSE2
+pstatus_t sse2_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3], int srcStep, INT16 *pDst[3], int dstStep, const prim_size_t *roi);
+pstatus_t sse2_RGBToRGB_16s8u_P3AC4R(const INT16 *pSrc[3], INT32 srcStep, BYTE *pDst, INT32 dstStep, const prim_size_t *roi);
+#endif /* WITH_SSE2 */
+
+#ifdef WITH_AVX2
+pstatus_t avx2_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3], int srcStep, INT16 *pDst[3], int dstStep, const prim_size_t *roi);
+pstatus_t avx2_RGBToRGB_16s8u_P3AC4R(const INT16 *pSrc[3], INT32 srcStep, BYTE *pDst, INT32 dstStep, const prim_size_t *roi);
+#endif /* WITH_AVX2 */
+
 void primitives_init_colors_opt(primitives_t* prims);
+void primitives_init_colors_avx2(primitives_t* prims);
 
 #endif /* !__PRIM_COLORS_H_INCLUDED__ */
 
@@ -0,0 +1,177 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 color conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_AVX2
+#include <immintrin.h>
+#endif /* WITH_AVX2 */
+
+#include "prim_internal.h"
+#include "prim_colors.h"
+
+#ifdef WITH_AVX2
+
+#define _mm256_between_epi16(_val, _min, _max) \
+	do { _val = _mm256_min_epi16(_max, _mm256_max_epi16(_val, _min)); } while (0)
+
+/*---------------------------------------------------------------------------*/
+/* The same 14-bit fixed point math as sse2_yCbCrToRGB_16s16s_P3P3, so both
+ * give the same results, on 16 pixels per step. There is no alignment
+ * requirement, the loads and stores are unaligned ones.
+ */
+pstatus_t avx2_yCbCrToRGB_16s16s_P3P3(
+	const INT16 *pSrc[3],
+	int srcStep,
+	INT16 *pDst[3],
+	int dstStep,
+	const prim_size_t *roi)	/* region of interest */
+{
+	__m256i zero, max, r_cr, g_cb, g_cr, b_cb, c4096;
+	const INT16 *y_buf, *cb_buf, *cr_buf;
+	INT16 *r_buf, *g_buf, *b_buf;
+	int yp, i;
+
+	if ((roi->width & 0x0f) || (srcStep & 0x01) || (dstStep & 0x01))
+		return sse2_yCbCrToRGB_16s16s_P3P3(pSrc, srcStep, pDst, dstStep, roi);
+
+	zero = _mm256_setzero_si256();
+	max = _mm256_set1_epi16(255);
+
+	r_cr = _mm256_set1_epi16(22986);	/*  1.403 << 14 */
+	g_cb = _mm256_set1_epi16(-5636);	/* -0.344 << 14 */
+	g_cr = _mm256_set1_epi16(-11698);	/* -0.714 << 14 */
+	b_cb = _mm256_set1_epi16(28999);	/*  1.770 << 14 */
+	c4096 = _mm256_set1_epi16(4096);
+
+	for (yp = 0; yp < roi->height; yp++)
+	{
+		y_buf  = (const INT16*) (((const BYTE*) pSrc[0]) + yp * srcStep);
+		cb_buf = (const INT16*) (((const BYTE*) pSrc[1]) + yp * srcStep);
+		cr_buf = (const INT16*) (((const BYTE*) pSrc[2]) + yp * srcStep);
+		r_buf  = (INT16*) (((BYTE*) pDst[0]) + yp * dstStep);
+		g_buf  = (INT16*) (((BYTE*) pDst[1]) + yp * dstStep);
+		b_buf  = (INT16*) (((BYTE*) pDst[2]) + yp * dstStep);
+
+		for (i = 0; i < roi->width; i += 16)
+		{
+			__m256i y, cb, cr, r, g, b;
+
+			/* y = (y_r_buf[i] + 4096) >> 2 */
+			y = _mm256_loadu_si256((const __m256i*) (y_buf + i));
+			y = _mm256_add_epi16(y, c4096);
+			y = _mm256_srai_epi16(y, 2);
+			cb = _mm256_loadu_si256((const __m256i*) (cb_buf + i));
+			cr = _mm256_loadu_si256((const __m256i*) (cr_buf + i));
+
+			/* (y + HIWORD(cr*22986)) >> 3 */
+			r = _mm256_add_epi16(y, _mm256_mulhi_epi16(cr, r_cr));
+			r = _mm256_srai_epi16(r, 3);
+			_mm256_between_epi16(r, zero, max);
+			_mm256_storeu_si256((__m256i*) (r_buf + i), r);
+
+			/* (y + HIWORD(cb*-5636) + HIWORD(cr*-11698)) >> 3 */
+			g = _mm256_add_epi16(y, _mm256_mulhi_epi16(cb, g_cb));
+			g = _mm256_add_epi16(g, _mm256_mulhi_epi16(cr, g_cr));
+			g = _mm256_srai_epi16(g, 3);
+			_mm256_between_epi16(g, zero, max);
+			_mm256_storeu_si256((__m256i*) (g_buf + i), g);
+
+			/* (y + HIWORD(cb*28999)) >> 3 */
+			b = _mm256_add_epi16(y, _mm256_mulhi_epi16(cb, b_cb));
+			b = _mm256_srai_epi16(b, 3);
+			_mm256_between_epi16(b, zero, max);
+			_mm256_storeu_si256((__m256i*) (b_buf + i), b);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Packs 16 pixels per step into 32-bit BGRA with an opaque alpha, like
+ * sse2_RGBToRGB_16s8u_P3AC4R the values are saturated to 0..255.
+ */
+pstatus_t avx2_RGBToRGB_16s8u_P3AC4R(
+	const INT16 *pSrc[3],	/* 16-bit R,G, and B arrays */
+	INT32 srcStep,			/* bytes between rows in source data */
+	BYTE *pDst,				/* 32-bit interleaved ARGB (ABGR?) data */
+	INT32 dstStep,			/* bytes between rows in dest data */
+	const prim_size_t *roi)	/* region of interest */
+{
+	__m256i zero, max, alpha;
+	const INT16 *r, *g, *b;
+	BYTE *out;
+	int y, x;
+
+	if ((roi->width & 0x0f) || (srcStep & 0x01))
+		return sse2_RGBToRGB_16s8u_P3AC4R(pSrc, srcStep, pDst, dstStep, roi);
+
+	zero = _mm256_setzero_si256();
+	max = _mm256_set1_epi16(255);
+	alpha = _mm256_set1_epi16((short) 0xFF00);
+
+	for (y = 0; y < roi->height; y++)
+	{
+		r = (const INT16*) (((const BYTE*) pSrc[0]) + y * srcStep);
+		g = (const INT16*) (((const BYTE*) pSrc[1]) + y * srcStep);
+		b = (const INT16*) (((const BYTE*) pSrc[2]) + y * srcStep);
+		out = pDst + y * dstStep;
+
+		for (x = 0; x < roi->width; x += 16)
+		{
+			__m256i R, G, B, BG, RA, lo, hi;
+
+			R = _mm256_loadu_si256((const __m256i*) (r + x));
+			G = _mm256_loadu_si256((const __m256i*) (g + x));
+			B = _mm256_loadu_si256((const __m256i*) (b + x));
+			_mm256_between_epi16(R, zero, max);
+			_mm256_between_epi16(G, zero, max);
+			_mm256_between_epi16(B, zero, max);
+
+			/* two bytes of each pixel per word, G1B1 G0B0 and FFR1 FFR0 */
+			BG = _mm256_or_si256(B, _mm256_slli_epi16(G, 8));
+			RA = _mm256_or_si256(R, alpha);
+
+			/* pixels 0-3 and 8-11, 4-7 and 12-15 as the unpacks stay within the 128-bit lanes */
+			lo = _mm256_unpacklo_epi16(BG, RA);
+			hi = _mm256_unpackhi_epi16(BG, RA);
+
+			_mm256_storeu_si256((__m256i*) out, _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*) (out + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+			out += 64;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_AVX2 */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_colors_avx2(primitives_t* prims)
+{
+#if defined(WITH_AVX2)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		prims->RGBToRGB_16s8u_P3AC4R  = avx2_RGBToRGB_16s8u_P3AC4R;
+		prims->yCbCrToRGB_16s16s_P3P3 = avx2_yCbCrToRGB_16s16s_P3P3;
+	}
+#endif /* WITH_AVX2 */
+}
@@ -558,5 +558,10 @@ void primitives_init_colors_opt(primitives_t* prims)
 		prims->yCbCrToRGB_16s16s_P3P3 = neon_yCbCrToRGB_16s16s_P3P3;
 	}
 #endif /* WITH_SSE2 */
+
+#if defined(WITH_AVX2)
+	/* after SSE2, the AVX2 routines fall back to the SSE2 ones */
+	primitives_init_colors_avx2(prims);
+#endif /* WITH_AVX2 */
 }
 
@@ -35,6 +35,10 @@ extern pstatus_t sse2_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3],
 	int srcStep, INT16 *pDst[3], int dstStep, const prim_size_t *roi);
 extern pstatus_t neon_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3],
 	int srcStep, INT16 *pDst[3], int dstStep, const prim_size_t *roi);
+extern pstatus_t avx2_RGBToRGB_16s8u_P3AC4R(const INT16 *pSrc[3],
+	int srcStep, BYTE *pDst, int dstStep, const prim_size_t *roi);
+extern pstatus_t avx2_yCbCrToRGB_16s16s_P3P3(const INT16 *pSrc[3],
+	int srcStep, INT16 *pDst[3], int dstStep, const prim_size_t *roi);
 
 /* ------------------------------------------------------------------------- */
 int test_RGBToRGB_16s8u_P3AC4R_func(void)
@@ -85,6 +89,23 @@ int test_RGBToRGB_16s8u_P3AC4R_func(void)
 		}
 	}
 #endif /* i386 */
+#ifdef WITH_AVX2
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		strcat(testStr, " AVX2");
+		avx2_RGBToRGB_16s8u_P3AC4R((const INT16 **) ptrs, 64*2,
+			(BYTE *) out2, 64*4, &roi);
+		for (i=0; i<4096; ++i)
+		{
+			if (out1[i] != out2[i])
+			{
+				printf("RGBToRGB-AVX2 FAIL: out1[%d]=0x%08x out2[%d]=0x%08x\n",
+					i, out1[i], i, out2[i]);
+				failed = 1;
+			}
+		}
+	}
+#endif /* WITH_AVX2 */
 	if (!failed) printf("All RGBToRGB_16s8u_P3AC4R tests passed (%s).\n", testStr);
 	return (failed > 0) ? FAILURE : SUCCESS;
 }
@@ -193,6 +214,23 @@ int test_yCbCrToRGB_16s16s_P3P3_func(void)
 		}
 	}
 #endif /* i386 */
+#ifdef WITH_AVX2
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		strcat(testStr, " AVX2");
+		avx2_yCbCrToRGB_16s16s_P3P3(in, 64*2, out2, 64*2, &roi);
+		for (i=0; i<4096; ++i)
+		{
+			if ((ABS(r1[i]-r2[i]) > 1)
+					|| (ABS(g1[i]-g2[i]) > 1)
+					|| (ABS(b1[i]-b2[i]) > 1)) {
+				printf("YCbCrToRGB-AVX2 FAIL[%d]: %d,%d,%d vs %d,%d,%d\n", i,
+					r1[i],g1[i],b1[i], r2[i],g2[i],b2[i]);
+				failed = 1;
+			}
+		}
+	}
+#endif /* WITH_AVX2 */
 	if (!failed) printf("All yCbCrToRGB_16s16s_P3P3 tests passed (%s).\n", testStr);
 	return (failed > 0) ? FAILURE : SUCCESS;
 }
@@ -34,6 +34,9 @@ extern pstatus_t general_YCoCgToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
 extern pstatus_t ssse3_YCoCgRToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
 	BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height,
 	UINT8 shift, BOOL withAlpha, BOOL invert);
+extern pstatus_t avx2_YCoCgRToRGB_8u_AC4R(const BYTE *pSrc, INT32 srcStep,
+	BYTE *pDst, INT32 dstStep, UINT32 width, UINT32 height,
+	UINT8 shift, BOOL withAlpha, BOOL invert);
 
 /* ------------------------------------------------------------------------- */
 int test_YCoCgRToRGB_8u_AC4R_func(void)
@@ -79,6 +82,33 @@ int test_YCoCgRToRGB_8u_AC4R_func(void)
 		}
 	}
 #endif /* i386 */
+#ifdef WITH_AVX2
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		strcat(testStr, " AVX2");
+		avx2_YCoCgRToRGB_8u_AC4R((const BYTE *) (in+1), 63*4,
+			(BYTE *) out_sse, 63*4, 63, 61, 2, TRUE, FALSE);
+
+		for (i=0; i<63*61; ++i)
+		{
+			if (out_c[i] != out_sse[i]) {
+				printf("YCoCgRToRGB-AVX2 FAIL[%d]: 0x%08x -> C 0x%08x vs AVX2 0x%08x\n", i,
+					in[i+1], out_c[i], out_sse[i]);
+				failed = TRUE;
+			}
+		}
+		avx2_YCoCgRToRGB_8u_AC4R((const BYTE *) (in+1), 63*4,
+			(BYTE *) out_sse_inv, 63*4, 63, 61, 2, TRUE, TRUE);
+		for (i=0; i<63*61; ++i)
+		{
+			if (out_c_inv[i] != out_sse_inv[i]) {
+				printf("YCoCgRToRGB-AVX2 inverted FAIL[%d]: 0x%08x -> C 0x%08x vs AVX2 0x%08x\n", i,
+					in[i+1], out_c_inv[i], out_sse_inv[i]);
+				failed = TRUE;
+			}
+		}
+	}
+#endif /* WITH_AVX2 */
 	if (!failed) printf("All YCoCgRToRGB_8u_AC4R tests passed (%s).\n", testStr);
 	return (failed > 0) ? FAILURE : SUCCESS;
 }
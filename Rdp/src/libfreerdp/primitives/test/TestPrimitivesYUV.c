@@ -0,0 +1,367 @@
+/* test_YUV.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+#define YUV_WIDTH	67
+#define YUV_HEIGHT	33
+
+/* the AVC444 frame is split as a server would, the auxiliary luma plane padded to 16 rows */
+#define AVC444_WIDTH	70
+#define AVC444_HEIGHT	36
+#define AVC444_PADDED	48
+
+extern BOOL g_TestPrimitivesPerformance;
+
+extern pstatus_t general_YUV444ToRGB_8u_P3AC4R(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst, int dstStep, const prim_size_t *roi);
+extern pstatus_t general_AVC444LumaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect);
+extern pstatus_t general_AVC444ChromaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect);
+extern pstatus_t sse2_YUV444ToRGB_8u_P3AC4R(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst, int dstStep, const prim_size_t *roi);
+extern pstatus_t sse2_AVC444LumaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect);
+extern pstatus_t sse2_AVC444ChromaToYUV444_8u_P3P3(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect);
+extern pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst, int dstStep, const prim_size_t *roi);
+
+typedef pstatus_t (*AVC444_COMBINE_FN)(const BYTE *pSrc[3], int srcStep[3],
+	BYTE *pDst[3], int dstStep[3], const RECTANGLE_16 *rect);
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_YUV444ToRGB_compare(const char *name, const UINT32 *expected, const UINT32 *out)
+{
+	int i;
+
+	for (i = 0; i < YUV_WIDTH * YUV_HEIGHT; ++i)
+	{
+		if (expected[i] != out[i])
+		{
+			printf("YUV444ToRGB-%s FAIL[%d]: C 0x%08x vs 0x%08x\n", name, i, expected[i], out[i]);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+int test_YUV444ToRGB_8u_P3AC4R_func(void)
+{
+	BYTE ALIGN(y[YUV_WIDTH * YUV_HEIGHT]);
+	BYTE ALIGN(u[YUV_WIDTH * YUV_HEIGHT]);
+	BYTE ALIGN(v[YUV_WIDTH * YUV_HEIGHT]);
+	UINT32 ALIGN(out_c[YUV_WIDTH * YUV_HEIGHT]);
+	UINT32 ALIGN(out_opt[YUV_WIDTH * YUV_HEIGHT]);
+	const BYTE *pSrc[3] = { y, u, v };
+	int srcStep[3] = { YUV_WIDTH, YUV_WIDTH, YUV_WIDTH };
+	prim_size_t roi = { YUV_WIDTH, YUV_HEIGHT };
+	char testStr[256];
+	BOOL failed = FALSE;
+
+	testStr[0] = '\0';
+	get_random_data(y, sizeof(y));
+	get_random_data(u, sizeof(u));
+	get_random_data(v, sizeof(v));
+
+	/* the extremes of the clipping */
+	y[0] = 0; u[0] = 0; v[0] = 0;
+	y[1] = 255; u[1] = 255; v[1] = 255;
+	y[2] = 0; u[2] = 255; v[2] = 0;
+	y[3] = 255; u[3] = 0; v[3] = 255;
+
+	general_YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, (BYTE *) out_c, YUV_WIDTH * 4, &roi);
+#ifdef WITH_SSE2
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		strcat(testStr, " SSE2");
+		sse2_YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, (BYTE *) out_opt, YUV_WIDTH * 4, &roi);
+
+		if (!test_YUV444ToRGB_compare("SSE2", out_c, out_opt))
+			failed = TRUE;
+	}
+#endif /* WITH_SSE2 */
+#ifdef WITH_AVX2
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		strcat(testStr, " AVX2");
+		avx2_YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, (BYTE *) out_opt, YUV_WIDTH * 4, &roi);
+
+		if (!test_YUV444ToRGB_compare("AVX2", out_c, out_opt))
+			failed = TRUE;
+	}
+#endif /* WITH_AVX2 */
+	if (!failed) printf("All YUV444ToRGB_8u_P3AC4R tests passed (%s).\n", testStr);
+	return (failed > 0) ? FAILURE : SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Splits a random 4:4:4 frame into the two views of MS-RDPEGFX 3.3.8.3.2. */
+static void test_avc444_split(BYTE *yuv[3], BYTE *mainView[3], BYTE *auxView[3])
+{
+	int x, y, i;
+	int sum;
+
+	for (y = 0; y < AVC444_HEIGHT; y++)
+		CopyMemory(mainView[0] + y * AVC444_WIDTH, yuv[0] + y * AVC444_WIDTH, AVC444_WIDTH);
+
+	for (i = 1; i < 3; i++)
+	{
+		for (y = 0; y < AVC444_HEIGHT; y += 2)
+		{
+			for (x = 0; x < AVC444_WIDTH; x += 2)
+			{
+				sum = yuv[i][y * AVC444_WIDTH + x] + yuv[i][y * AVC444_WIDTH + x + 1] +
+					yuv[i][(y + 1) * AVC444_WIDTH + x] + yuv[i][(y + 1) * AVC444_WIDTH + x + 1];
+				mainView[i][(y / 2) * (AVC444_WIDTH / 2) + x / 2] = (BYTE) (sum / 4);
+				auxView[i][(y / 2) * (AVC444_WIDTH / 2) + x / 2] = yuv[i][y * AVC444_WIDTH + x + 1];
+			}
+
+			/* the odd rows in blocks of 8, U then V */
+			CopyMemory(auxView[0] + (((y / 2) / 8) * 16 + ((y / 2) % 8) + (i - 1) * 8) * AVC444_WIDTH,
+				yuv[i] + (y + 1) * AVC444_WIDTH, AVC444_WIDTH);
+		}
+	}
+}
+
+static BOOL test_avc444_combine(AVC444_COMBINE_FN luma, AVC444_COMBINE_FN chroma,
+	BYTE *mainView[3], BYTE *auxView[3], const RECTANGLE_16 *rect, BYTE *out[3])
+{
+	int step[3] = { AVC444_WIDTH, AVC444_WIDTH / 2, AVC444_WIDTH / 2 };
+	int dstStep[3] = { AVC444_WIDTH, AVC444_WIDTH, AVC444_WIDTH };
+	int i;
+
+	for (i = 0; i < 3; i++)
+		ZeroMemory(out[i], AVC444_WIDTH * AVC444_HEIGHT);
+
+	if (luma((const BYTE **) mainView, step, out, dstStep, rect) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	if (chroma((const BYTE **) auxView, step, out, dstStep, rect) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	return TRUE;
+}
+
+/* The odd samples come back as they were, the top left ones of each 2x2 block from the average. */
+static BOOL test_avc444_check(BYTE *yuv[3], BYTE *mainView[3], BYTE *out[3], const RECTANGLE_16 *rect)
+{
+	int x, y, i;
+	int index;
+	int diff;
+	BYTE average;
+
+	for (i = 0; i < 3; i++)
+	{
+		for (y = 0; y < AVC444_HEIGHT; y++)
+		{
+			for (x = 0; x < AVC444_WIDTH; x++)
+			{
+				index = y * AVC444_WIDTH + x;
+
+				if ((x < rect->left) || (x >= rect->right) || (y < rect->top) || (y >= rect->bottom))
+				{
+					if (out[i][index])
+					{
+						printf("AVC444 FAIL: plane %d %d,%d outside the rect written\n", i, x, y);
+						return FALSE;
+					}
+
+					continue;
+				}
+
+				if ((i == 0) || (x & 1) || (y & 1))
+				{
+					if (out[i][index] != yuv[i][index])
+					{
+						printf("AVC444 FAIL: plane %d %d,%d is %d instead of %d\n", i, x, y,
+							out[i][index], yuv[i][index]);
+						return FALSE;
+					}
+
+					continue;
+				}
+
+				average = mainView[i][(y / 2) * (AVC444_WIDTH / 2) + x / 2];
+				diff = out[i][index] - yuv[i][index];
+
+				if ((out[i][index] != average) && ((diff > 0) || (diff < -3)))
+				{
+					printf("AVC444 FAIL: plane %d %d,%d is %d instead of %d or %d\n", i, x, y,
+						out[i][index], yuv[i][index], average);
+					return FALSE;
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+int test_AVC444ToYUV444_8u_P3P3_func(void)
+{
+	int i, r;
+	int size = AVC444_WIDTH * AVC444_HEIGHT;
+	BYTE *yuv[3], *mainView[3], *auxView[3], *out_c[3], *out_opt[3];
+	BYTE *buffer;
+	char testStr[256];
+	BOOL failed = FALSE;
+	RECTANGLE_16 rects[] =
+	{
+		{ 0, 0, AVC444_WIDTH, AVC444_HEIGHT },
+		{ 2, 4, 60, 20 },
+		{ 34, 18, 70, 36 }
+	};
+
+	testStr[0] = '\0';
+	buffer = (BYTE *) calloc(1, size * 11 + AVC444_WIDTH * AVC444_PADDED);
+
+	if (!buffer)
+		return FAILURE;
+
+	for (i = 0; i < 3; i++)
+	{
+		yuv[i] = buffer + size * i;
+		out_c[i] = buffer + size * (3 + i);
+		out_opt[i] = buffer + size * (6 + i);
+	}
+
+	mainView[0] = buffer + size * 9;
+	mainView[1] = mainView[0] + size;
+	mainView[2] = mainView[1] + size / 4;
+	auxView[0] = mainView[2] + size / 4;
+	auxView[1] = auxView[0] + AVC444_WIDTH * AVC444_PADDED;
+	auxView[2] = auxView[1] + size / 4;
+
+	get_random_data(buffer, size * 3);
+	test_avc444_split(yuv, mainView, auxView);
+
+	for (r = 0; r < sizeof(rects) / sizeof(rects[0]); r++)
+	{
+		if (!test_avc444_combine(general_AVC444LumaToYUV444_8u_P3P3,
+				general_AVC444ChromaToYUV444_8u_P3P3, mainView, auxView, &rects[r], out_c) ||
+			!test_avc444_check(yuv, mainView, out_c, &rects[r]))
+		{
+			failed = TRUE;
+			continue;
+		}
+#ifdef WITH_SSE2
+		if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+		{
+			if (r == 0)
+				strcat(testStr, " SSE2");
+
+			test_avc444_combine(sse2_AVC444LumaToYUV444_8u_P3P3,
+				sse2_AVC444ChromaToYUV444_8u_P3P3, mainView, auxView, &rects[r], out_opt);
+
+			for (i = 0; i < 3; i++)
+			{
+				if (memcmp(out_c[i], out_opt[i], size) != 0)
+				{
+					printf("AVC444ToYUV444-SSE2 FAIL: plane %d of rect %d differs\n", i, r);
+					failed = TRUE;
+				}
+			}
+		}
+#endif /* WITH_SSE2 */
+	}
+
+	free(buffer);
+	if (!failed) printf("All AVC444ToYUV444_8u_P3P3 tests passed (%s).\n", testStr);
+	return (failed > 0) ? FAILURE : SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* A 4K frame through the primitives in use, the AVC444 decode path converts it by bands. */
+int test_YUV444ToRGB_8u_P3AC4R_speed(void)
+{
+	int i;
+	UINT64 start;
+	BYTE *pSrc[3];
+	BYTE *pYUV[3];
+	BYTE *pDst;
+	int srcStep[3] = { 3840, 3840, 3840 };
+	prim_size_t roi = { 3840, 2160 };
+	RECTANGLE_16 rect = { 0, 0, 3840, 2160 };
+	primitives_t *prims = primitives_get();
+
+	pSrc[0] = (BYTE *) malloc(3840 * 2160 * 3);
+	pDst = (BYTE *) malloc(3840 * 2160 * 4);
+
+	if (!pSrc[0] || !pDst)
+	{
+		free(pSrc[0]);
+		free(pDst);
+		return FAILURE;
+	}
+
+	pSrc[1] = pSrc[0] + 3840 * 2160;
+	pSrc[2] = pSrc[1] + 3840 * 2160;
+	get_random_data(pSrc[0], 3840 * 2160 * 3);
+
+	start = GetTickCount64();
+
+	for (i = 0; i < 10; i++)
+		prims->YUV444ToRGB_8u_P3AC4R((const BYTE **) pSrc, srcStep, pDst, 3840 * 4, &roi);
+
+	printf("YUV444ToRGB 3840x2160: %.2f ms\n", (double) (GetTickCount64() - start) / 10);
+
+	pYUV[0] = pDst;
+	pYUV[1] = pYUV[0] + 3840 * 2160;
+	pYUV[2] = pYUV[1] + 3840 * 2160;
+	start = GetTickCount64();
+
+	for (i = 0; i < 10; i++)
+		prims->AVC444ChromaToYUV444_8u_P3P3((const BYTE **) pSrc, srcStep, pYUV, srcStep, &rect);
+
+	printf("AVC444ChromaToYUV444 3840x2160: %.2f ms\n", (double) (GetTickCount64() - start) / 10);
+
+	free(pSrc[0]);
+	free(pDst);
+	return SUCCESS;
+}
+
+int TestPrimitivesYUV(int argc, char* argv[])
+{
+	int status;
+
+	status = test_YUV444ToRGB_8u_P3AC4R_func();
+
+	if (status != SUCCESS)
+		return 1;
+
+	status = test_AVC444ToYUV444_8u_P3P3_func();
+
+	if (status != SUCCESS)
+		return 1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		status = test_YUV444ToRGB_8u_P3AC4R_speed();
+
+		if (status != SUCCESS)
+			return 1;
+	}
+
+	return 0;
+}
@@ -58,117 +58,541 @@ static void module_init()
 
 #else
 
-static TP_POOL DEFAULT_POOL =
+#include <limits.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <pthread.h>
+#endif
+
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#define pool_memory_barrier()	__sync_synchronize()
+
+/* instances a worker keeps for the work it submits itself, the rest go back to the pool */
+#define TP_WORKER_FREE_MAX	32
+#define TP_WORKER_FREE_KEEP	8
+
+static TP_POOL DEFAULT_POOL;
+
+static INIT_ONCE worker_tls_once = INIT_ONCE_STATIC_INIT;
+static DWORD worker_tls_index = TLS_OUT_OF_INDEXES;
+
+/**
+ * Idle workers and threads waiting for work callbacks sleep on a counter
+ * which is bumped before they are woken, they only sleep while it still
+ * has the value they read before checking for what they wait for.
+ */
+
+#if defined(__linux__)
+
+static void pool_park(volatile LONG* address, LONG value)
 {
-	0,    /* DWORD Minimum */
-	500,  /* DWORD Maximum */
-	NULL, /* wArrayList* Threads */
-	NULL, /* wQueue* PendingQueue */
-	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
-};
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
 
-static void* thread_pool_work_func(void* arg)
+static void pool_unpark(volatile LONG* address, int count)
 {
-	DWORD status;
-	PTP_POOL pool;
-	PTP_WORK work;
-	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance;
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
 
-	pool = (PTP_POOL) arg;
+#else
 
-	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+static pthread_mutex_t park_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t park_cond = PTHREAD_COND_INITIALIZER;
 
-	while (1)
+static void pool_park(volatile LONG* address, LONG value)
+{
+	pthread_mutex_lock(&park_mutex);
+
+	if (*address == value)
+		pthread_cond_wait(&park_cond, &park_mutex);
+
+	pthread_mutex_unlock(&park_mutex);
+}
+
+static void pool_unpark(volatile LONG* address, int count)
+{
+	pthread_mutex_lock(&park_mutex);
+	pthread_cond_broadcast(&park_cond);
+	pthread_mutex_unlock(&park_mutex);
+}
+
+#endif
+
+static BOOL CALLBACK worker_tls_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	worker_tls_index = TlsAlloc();
+	return (worker_tls_index != TLS_OUT_OF_INDEXES);
+}
+
+static BOOL worker_deque_push(TP_WORKER* worker, PTP_CALLBACK_INSTANCE instance)
+{
+	LONG bottom = worker->Bottom;
+
+	if ((LONG) (bottom - worker->Top) >= TP_WORKER_DEQUE_SIZE)
+		return FALSE;
+
+	worker->Items[bottom & (TP_WORKER_DEQUE_SIZE - 1)] = instance;
+	InterlockedExchange(&worker->Bottom, bottom + 1);
+
+	return TRUE;
+}
+
+static PTP_CALLBACK_INSTANCE worker_deque_take(TP_WORKER* worker)
+{
+	LONG top;
+	LONG size;
+	LONG bottom;
+	PTP_CALLBACK_INSTANCE instance;
+
+	bottom = worker->Bottom - 1;
+	InterlockedExchange(&worker->Bottom, bottom);
+	top = worker->Top;
+	size = (LONG) (bottom - top);
+
+	if (size < 0)
 	{
-		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		InterlockedExchange(&worker->Bottom, top);
+		return NULL;
+	}
 
-		if (status == WAIT_OBJECT_0)
-			break;
+	instance = worker->Items[bottom & (TP_WORKER_DEQUE_SIZE - 1)];
+
+	if (size > 0)
+		return instance;
+
+	/* the last one, a thief may be taking it as well */
+	if (InterlockedCompareExchange(&worker->Top, top + 1, top) != top)
+		instance = NULL;
+
+	InterlockedExchange(&worker->Bottom, top + 1);
+
+	return instance;
+}
+
+static PTP_CALLBACK_INSTANCE worker_deque_steal(TP_WORKER* worker)
+{
+	LONG top;
+	LONG bottom;
+	PTP_CALLBACK_INSTANCE instance;
+
+	top = worker->Top;
+	pool_memory_barrier();
+	bottom = worker->Bottom;
+
+	if ((LONG) (bottom - top) <= 0)
+		return NULL;
+
+	instance = worker->Items[top & (TP_WORKER_DEQUE_SIZE - 1)];
+
+	if (InterlockedCompareExchange(&worker->Top, top + 1, top) != top)
+		return NULL;
+
+	return instance;
+}
+
+static BOOL thread_pool_has_work(PTP_POOL pool)
+{
+	LONG index;
+	TP_WORKER* worker;
 
-		if (status != (WAIT_OBJECT_0 + 1))
+	if (pool->QueueCount > 0)
+		return TRUE;
+
+	for (index = 0; index < pool->WorkerCount; index++)
+	{
+		worker = pool->Workers[index];
+
+		if ((LONG) (worker->Bottom - worker->Top) > 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Wakes one idle worker unless one is already on its way, that one wakes
+ * the next when it finds more work than it takes.
+ */
+static void thread_pool_wake(PTP_POOL pool)
+{
+	pool_memory_barrier();
+
+	if ((pool->IdleCount > 0) && (InterlockedCompareExchange(&pool->Waking, 1, 0) == 0))
+	{
+		InterlockedIncrement(&pool->IdleEpoch);
+		pool_unpark(&pool->IdleEpoch, 1);
+	}
+}
+
+static PTP_CALLBACK_INSTANCE thread_pool_new_instance(PTP_POOL pool, TP_WORKER* worker)
+{
+	PTP_CALLBACK_INSTANCE instance;
+
+	if (worker && worker->FreeInstances)
+	{
+		instance = worker->FreeInstances;
+		worker->FreeInstances = instance->Next;
+		worker->FreeCount--;
+		return instance;
+	}
+
+	EnterCriticalSection(&pool->Lock);
+	instance = pool->FreeInstances;
+
+	if (instance)
+		pool->FreeInstances = instance->Next;
+
+	LeaveCriticalSection(&pool->Lock);
+
+	if (!instance)
+		instance = (PTP_CALLBACK_INSTANCE) malloc(sizeof(TP_CALLBACK_INSTANCE));
+
+	return instance;
+}
+
+static void thread_pool_free_instance(PTP_POOL pool, TP_WORKER* worker, PTP_CALLBACK_INSTANCE instance)
+{
+	DWORD count;
+	PTP_CALLBACK_INSTANCE last;
+	PTP_CALLBACK_INSTANCE first;
+
+	instance->Next = worker->FreeInstances;
+	worker->FreeInstances = instance;
+	worker->FreeCount++;
+
+	if (worker->FreeCount < TP_WORKER_FREE_MAX)
+		return;
+
+	/* hand the older ones back in one go, the submitting thread takes them from the pool */
+	for (last = worker->FreeInstances, count = 1; count < TP_WORKER_FREE_KEEP; count++)
+		last = last->Next;
+
+	first = last->Next;
+	last->Next = NULL;
+	worker->FreeCount = TP_WORKER_FREE_KEEP;
+
+	for (last = first; last->Next; last = last->Next);
+
+	EnterCriticalSection(&pool->Lock);
+	last->Next = pool->FreeInstances;
+	pool->FreeInstances = first;
+	LeaveCriticalSection(&pool->Lock);
+}
+
+/**
+ * Takes a share of the pool queue, runs the first one and keeps the rest
+ * in the worker deque where the other workers can steal them.
+ */
+static PTP_CALLBACK_INSTANCE thread_pool_dequeue(PTP_POOL pool, TP_WORKER* worker)
+{
+	LONG share;
+	LONG taken;
+	LONG workers;
+	PTP_CALLBACK_INSTANCE instance;
+	PTP_CALLBACK_INSTANCE next;
+
+	if (pool->QueueCount < 1)
+		return NULL;
+
+	EnterCriticalSection(&pool->Lock);
+
+	instance = pool->QueueHead;
+
+	if (!instance)
+	{
+		LeaveCriticalSection(&pool->Lock);
+		return NULL;
+	}
+
+	workers = (pool->WorkerCount > 0) ? pool->WorkerCount : 1;
+	share = (pool->QueueCount + workers - 1) / workers;
+
+	if (share > TP_WORKER_DEQUE_SIZE / 2)
+		share = TP_WORKER_DEQUE_SIZE / 2;
+
+	pool->QueueHead = instance->Next;
+
+	for (taken = 1; (taken < share) && pool->QueueHead; taken++)
+	{
+		next = pool->QueueHead;
+
+		if (!worker_deque_push(worker, next))
 			break;
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE) Queue_Dequeue(pool->PendingQueue);
+		pool->QueueHead = next->Next;
+	}
+
+	if (!pool->QueueHead)
+		pool->QueueTail = NULL;
+
+	InterlockedExchangeAdd(&pool->QueueCount, -taken);
+
+	LeaveCriticalSection(&pool->Lock);
+
+	return instance;
+}
+
+static PTP_CALLBACK_INSTANCE thread_pool_steal(PTP_POOL pool, TP_WORKER* worker)
+{
+	LONG index;
+	LONG count;
+	LONG start;
+	TP_WORKER* victim;
+	PTP_CALLBACK_INSTANCE instance;
+
+	count = pool->WorkerCount;
+
+	if (count < 2)
+		return NULL;
+
+	worker->Seed = worker->Seed * 1103515245 + 12345;
+	start = (LONG) ((worker->Seed >> 16) % count);
+
+	for (index = 0; index < count; index++)
+	{
+		victim = pool->Workers[(start + index) % count];
+
+		if (victim == worker)
+			continue;
+
+		instance = worker_deque_steal(victim);
+
+		if (instance)
+			return instance;
+	}
+
+	return NULL;
+}
+
+static PTP_CALLBACK_INSTANCE thread_pool_find_work(PTP_POOL pool, TP_WORKER* worker)
+{
+	PTP_CALLBACK_INSTANCE instance;
+
+	instance = worker_deque_take(worker);
+
+	if (instance)
+		return instance;
+
+	instance = thread_pool_dequeue(pool, worker);
+
+	if (!instance)
+		instance = thread_pool_steal(pool, worker);
+
+	/* more is left than this worker takes on now */
+	if (instance && thread_pool_has_work(pool))
+		thread_pool_wake(pool);
+
+	return instance;
+}
+
+static void thread_pool_run(PTP_POOL pool, TP_WORKER* worker, PTP_CALLBACK_INSTANCE instance)
+{
+	PTP_WORK work = instance->Work;
+
+	work->WorkCallback(instance, work->CallbackParameter, work);
+	thread_pool_free_instance(pool, worker, instance);
+
+	/* the work may be closed as soon as its count is down, the pool outlives it */
+	if ((InterlockedDecrement(&work->PendingCount) == 0) && (pool->CompletionWaiters > 0))
+	{
+		InterlockedIncrement(&pool->CompletionEpoch);
+		pool_unpark(&pool->CompletionEpoch, INT_MAX);
+	}
+}
+
+static void* thread_pool_work_func(void* arg)
+{
+	LONG epoch;
+	PTP_POOL pool;
+	TP_WORKER* worker;
+	PTP_CALLBACK_INSTANCE instance;
+
+	worker = (TP_WORKER*) arg;
+	pool = worker->Pool;
+
+	TlsSetValue(worker_tls_index, worker);
+
+	while (!pool->Terminate)
+	{
+		instance = thread_pool_find_work(pool, worker);
 
-		if (callbackInstance)
+		if (instance)
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			thread_pool_run(pool, worker, instance);
+			continue;
 		}
+
+		InterlockedIncrement(&pool->IdleCount);
+		epoch = pool->IdleEpoch;
+		pool_memory_barrier();
+
+		if (!pool->Terminate && !thread_pool_has_work(pool))
+			pool_park(&pool->IdleEpoch, epoch);
+
+		InterlockedDecrement(&pool->IdleCount);
+		InterlockedExchange(&pool->Waking, 0);
 	}
 
 	ExitThread(0);
 	return NULL;
 }
 
-static void threads_close(void *thread)
+static BOOL thread_pool_add_worker(PTP_POOL pool)
 {
-	WaitForSingleObject(thread, INFINITE);
-	CloseHandle(thread);
+	TP_WORKER* worker;
+
+	if (pool->WorkerCount >= TP_POOL_MAX_WORKERS)
+		return FALSE;
+
+	worker = (TP_WORKER*) calloc(1, sizeof(TP_WORKER));
+
+	if (!worker)
+		return FALSE;
+
+	worker->Pool = pool;
+	worker->Seed = (DWORD) pool->WorkerCount + 1;
+
+	/* published before the count, thieves only look at the first WorkerCount workers */
+	pool->Workers[pool->WorkerCount] = worker;
+
+	if (!(worker->Thread = CreateThread(NULL, 0,
+				(LPTHREAD_START_ROUTINE) thread_pool_work_func,
+				(void*) worker, 0, NULL)))
+	{
+		pool->Workers[pool->WorkerCount] = NULL;
+		free(worker);
+		return FALSE;
+	}
+
+	InterlockedIncrement(&pool->WorkerCount);
+
+	return TRUE;
 }
 
-static BOOL InitializeThreadpool(PTP_POOL pool)
+static BOOL thread_pool_add_workers(PTP_POOL pool, DWORD count)
 {
-	int index;
-	HANDLE thread;
+	BOOL status = TRUE;
 
-	if (pool->Threads)
+	EnterCriticalSection(&pool->Lock);
+
+	while (status && ((DWORD) pool->WorkerCount < count))
+		status = thread_pool_add_worker(pool);
+
+	LeaveCriticalSection(&pool->Lock);
+
+	return status;
+}
+
+static BOOL InitializeThreadpool(PTP_POOL pool)
+{
+	if (pool->Initialized)
 		return TRUE;
 
+	if (!InitOnceExecuteOnce(&worker_tls_once, worker_tls_init, NULL, NULL))
+		return FALSE;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->Lock, 4000))
+		return FALSE;
+
 	pool->Minimum = 0;
 	pool->Maximum = 500;
+	pool->Terminate = FALSE;
+	pool->Initialized = TRUE;
+
+	return TRUE;
+}
+
+/**
+ * The workers are started with the first submission, as many as there are
+ * processors within the pool minimum and maximum.
+ */
+BOOL ThreadpoolSubmit(PTP_POOL pool, PTP_WORK work)
+{
+	DWORD count;
+	SYSTEM_INFO info;
+	TP_WORKER* worker;
+	PTP_CALLBACK_INSTANCE instance;
+
+	if (pool->WorkerCount < 1)
+	{
+		GetSystemInfo(&info);
+		count = info.dwNumberOfProcessors;
+
+		if (count > pool->Maximum)
+			count = pool->Maximum;
 
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
-		goto fail_queue_new;
+		if (count < pool->Minimum)
+			count = pool->Minimum;
 
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
-		goto fail_countdown_event;
+		if (count < 1)
+			count = 1;
+
+		if (count > TP_POOL_MAX_WORKERS)
+			count = TP_POOL_MAX_WORKERS;
+
+		if (!thread_pool_add_workers(pool, count) && (pool->WorkerCount < 1))
+			return FALSE;
+	}
 
-	if (!(pool->TerminateEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
-		goto fail_terminate_event;
+	worker = (TP_WORKER*) TlsGetValue(worker_tls_index);
 
-	if (!(pool->Threads = ArrayList_New(TRUE)))
-		goto fail_thread_array;
+	if (worker && (worker->Pool != pool))
+		worker = NULL;
 
-	pool->Threads->object.fnObjectFree = threads_close;
+	instance = thread_pool_new_instance(pool, worker);
 
-	for (index = 0; index < 4; index++)
+	if (!instance)
+		return FALSE;
+
+	instance->Work = work;
+	instance->Next = NULL;
+	InterlockedIncrement(&work->PendingCount);
+
+	/* work submitted from a worker stays with it, unless another one is idle to steal it */
+	if (!worker || !worker_deque_push(worker, instance))
 	{
-		if (!(thread = CreateThread(NULL, 0,
-					(LPTHREAD_START_ROUTINE) thread_pool_work_func,
-					(void*) pool, 0, NULL)))
-		{
-			goto fail_create_threads;
-		}
+		EnterCriticalSection(&pool->Lock);
 
-		if (ArrayList_Add(pool->Threads, thread) < 0)
-			goto fail_create_threads;
+		if (pool->QueueTail)
+			pool->QueueTail->Next = instance;
+		else
+			pool->QueueHead = instance;
+
+		pool->QueueTail = instance;
+		InterlockedIncrement(&pool->QueueCount);
+
+		LeaveCriticalSection(&pool->Lock);
 	}
 
+	thread_pool_wake(pool);
+
 	return TRUE;
+}
 
-fail_create_threads:
-	SetEvent(pool->TerminateEvent);
-	ArrayList_Free(pool->Threads);
-	pool->Threads = NULL;
-fail_thread_array:
-	CloseHandle(pool->TerminateEvent);
-	pool->TerminateEvent = NULL;
-fail_terminate_event:
-	CountdownEvent_Free(pool->WorkComplete);
-	pool->WorkComplete = NULL;
-fail_countdown_event:
-	Queue_Free(pool->PendingQueue);
-	pool->WorkComplete = NULL;
-fail_queue_new:
+VOID ThreadpoolWaitForWork(PTP_POOL pool, PTP_WORK work)
+{
+	LONG epoch;
 
-	return FALSE;
+	InterlockedIncrement(&pool->CompletionWaiters);
+
+	while (1)
+	{
+		epoch = pool->CompletionEpoch;
+		pool_memory_barrier();
+
+		if (work->PendingCount == 0)
+			break;
 
+		pool_park(&pool->CompletionEpoch, epoch);
+	}
+
+	InterlockedDecrement(&pool->CompletionWaiters);
 }
 
 PTP_POOL GetDefaultThreadpool()
@@ -218,24 +642,56 @@ VOID CloseThreadpool(PTP_POOL ptpp)
 	if (pCloseThreadpool)
 		pCloseThreadpool(ptpp);
 #else
-	SetEvent(ptpp->TerminateEvent);
+	LONG index;
+	TP_WORKER* worker;
+	PTP_CALLBACK_INSTANCE instance;
 
-	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
-	CloseHandle(ptpp->TerminateEvent);
+	ptpp->Terminate = TRUE;
+	InterlockedIncrement(&ptpp->IdleEpoch);
+	pool_unpark(&ptpp->IdleEpoch, INT_MAX);
 
-	if (ptpp == &DEFAULT_POOL)
+	for (index = 0; index < ptpp->WorkerCount; index++)
 	{
-		ptpp->Threads = NULL;
-		ptpp->PendingQueue = NULL;
-		ptpp->WorkComplete = NULL;
-		ptpp->TerminateEvent = NULL;
+		worker = ptpp->Workers[index];
+		WaitForSingleObject(worker->Thread, INFINITE);
+		CloseHandle(worker->Thread);
 	}
-	else
+
+	for (index = 0; index < ptpp->WorkerCount; index++)
 	{
-		free(ptpp);
+		worker = ptpp->Workers[index];
+
+		while ((instance = worker_deque_take(worker)))
+			free(instance);
+
+		while ((instance = worker->FreeInstances))
+		{
+			worker->FreeInstances = instance->Next;
+			free(instance);
+		}
+
+		free(worker);
+		ptpp->Workers[index] = NULL;
+	}
+
+	while ((instance = ptpp->QueueHead))
+	{
+		ptpp->QueueHead = instance->Next;
+		free(instance);
+	}
+
+	while ((instance = ptpp->FreeInstances))
+	{
+		ptpp->FreeInstances = instance->Next;
+		free(instance);
 	}
+
+	DeleteCriticalSection(&ptpp->Lock);
+
+	if (ptpp == &DEFAULT_POOL)
+		ZeroMemory(ptpp, sizeof(TP_POOL));
+	else
+		free(ptpp);
 #endif
 }
 
@@ -247,22 +703,13 @@ BOOL SetThreadpoolThreadMinimum(PTP_POOL ptpp, DWORD cthrdMic)
 	if (pSetThreadpoolThreadMinimum)
 		return pSetThreadpoolThreadMinimum(ptpp, cthrdMic);
 #else
-	HANDLE thread;
+	if (cthrdMic > TP_POOL_MAX_WORKERS)
+		return FALSE;
 
 	ptpp->Minimum = cthrdMic;
 
-	while (ArrayList_Count(ptpp->Threads) < ptpp->Minimum)
-	{
-		if (!(thread = CreateThread(NULL, 0,
-				(LPTHREAD_START_ROUTINE) thread_pool_work_func,
-				(void*) ptpp, 0, NULL)))
-		{
-			return FALSE;
-		}
-
-		if (ArrayList_Add(ptpp->Threads, thread) < 0)
-			return FALSE;
-	}
+	if (!thread_pool_add_workers(ptpp, ptpp->Minimum))
+		return FALSE;
 #endif
 	return TRUE;
 }
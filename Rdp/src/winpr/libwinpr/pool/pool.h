@@ -28,16 +28,49 @@
 struct _TP_CALLBACK_INSTANCE
 {
 	PTP_WORK Work;
+	PTP_CALLBACK_INSTANCE Next;
 };
 
+/* a power of two, a worker deque which is full overflows into the pool queue */
+#define TP_WORKER_DEQUE_SIZE	256
+#define TP_POOL_MAX_WORKERS		64
+
+/**
+ * Each worker owns a Chase-Lev deque: the owner pushes and takes at the
+ * bottom, idle workers steal from the top. Top and Bottom only grow and
+ * wrap around, their difference is the number of items.
+ */
+struct _TP_WORKER
+{
+	PTP_POOL Pool;
+	HANDLE Thread;
+	DWORD Seed;
+	volatile LONG Top;
+	volatile LONG Bottom;
+	PTP_CALLBACK_INSTANCE volatile Items[TP_WORKER_DEQUE_SIZE];
+	PTP_CALLBACK_INSTANCE FreeInstances;
+	DWORD FreeCount;
+};
+typedef struct _TP_WORKER TP_WORKER;
+
 struct _TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
-	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	BOOL Initialized;
+	volatile BOOL Terminate;
+	CRITICAL_SECTION Lock;
+	TP_WORKER* Workers[TP_POOL_MAX_WORKERS];
+	volatile LONG WorkerCount;
+	PTP_CALLBACK_INSTANCE QueueHead;
+	PTP_CALLBACK_INSTANCE QueueTail;
+	volatile LONG QueueCount;
+	PTP_CALLBACK_INSTANCE FreeInstances;
+	volatile LONG IdleCount;
+	volatile LONG IdleEpoch;
+	volatile LONG Waking;
+	volatile LONG CompletionWaiters;
+	volatile LONG CompletionEpoch;
 };
 
 struct _TP_WORK
@@ -45,6 +78,7 @@ struct _TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	volatile LONG PendingCount;
 };
 
 struct _TP_TIMER
@@ -72,6 +106,9 @@ struct _TP_CLEANUP_GROUP
 PTP_POOL GetDefaultThreadpool(void);
 PTP_CALLBACK_ENVIRON GetDefaultThreadpoolEnvironment(void);
 
+BOOL ThreadpoolSubmit(PTP_POOL pool, PTP_WORK work);
+VOID ThreadpoolWaitForWork(PTP_POOL pool, PTP_WORK work);
+
 #endif
 
 #endif /* WINPR_POOL_PRIVATE_H */
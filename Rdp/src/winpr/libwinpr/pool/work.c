@@ -73,7 +73,7 @@ PTP_WORK CreateThreadpoolWork(PTP_WORK_CALLBACK pfnwk, PVOID pv, PTP_CALLBACK_EN
 		return pCreateThreadpoolWork(pfnwk, pv, pcbe);
 
 #else
-	work = (PTP_WORK) malloc(sizeof(TP_WORK));
+	work = (PTP_WORK) calloc(1, sizeof(TP_WORK));
 
 	if (work)
 	{
@@ -113,16 +113,13 @@ VOID SubmitThreadpoolWork(PTP_WORK pwk)
 
 #else
 	PTP_POOL pool;
-	PTP_CALLBACK_INSTANCE callbackInstance;
 	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE) malloc(sizeof(TP_CALLBACK_INSTANCE));
 
-	if (callbackInstance)
-	{
-		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
-		Queue_Enqueue(pool->PendingQueue, callbackInstance);
-	}
+	if (!pool)
+		pool = GetDefaultThreadpool();
+
+	if (!pool || !ThreadpoolSubmit(pool, pwk))
+		WLog_ERR(TAG, "error submitting work");
 
 #endif
 }
@@ -149,13 +146,14 @@ VOID WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallbacks)
 		pWaitForThreadpoolWorkCallbacks(pwk, fCancelPendingCallbacks);
 
 #else
-	HANDLE event;
 	PTP_POOL pool;
 	pool = pwk->CallbackEnvironment->Pool;
-	event = CountdownEvent_WaitHandle(pool->WorkComplete);
 
-	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
-		WLog_ERR(TAG, "error waiting on work completion");
+	if (!pool)
+		pool = GetDefaultThreadpool();
+
+	if (pool)
+		ThreadpoolWaitForWork(pool, pwk);
 
 #endif
 }
@@ -426,6 +426,10 @@ ULONGLONG GetTickCount64(void)
 	__asm__ __volatile__ ("xgetbv" : "=a" (_lo_), "=d" (_hi_) : "c" (_func_))
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define D_BIT_MMX       (1<<23)
 #define D_BIT_SSE       (1<<25)
 #define D_BIT_SSE2      (1<<26)
@@ -446,6 +450,7 @@ ULONGLONG GetTickCount64(void)
 #define E_BIT_XMM       (1<<1)
 #define E_BIT_YMM       (1<<2)
 #define E_BITS_AVX      (E_BIT_XMM|E_BIT_YMM)
+#define B7_BIT_AVX2     (1<<5)
 
 static void cpuid(
 	unsigned info,
@@ -471,17 +476,35 @@ static void cpuid(
 		"xchg %%rbx, %%rsi;"
 #endif
 	: "=a"(*eax), "=S"(*ebx), "=c"(*ecx), "=d"(*edx)
-			: "0"(info)
+			: "0"(info), "2"(0)
 		);
 #elif defined(_MSC_VER)
 	int a[4];
-	__cpuid(a, info);
+	/* leaf 7 has sub-leaves, the features are reported by sub-leaf 0 */
+	__cpuidex(a, info, 0);
 	*eax = a[0];
 	*ebx = a[1];
 	*ecx = a[2];
 	*edx = a[3];
 #endif
 }
+
+/**
+ * The low word of XCR0, the register state the OS saves on a context switch.
+ * Only valid if CPUID reports OSXSAVE (C_BIT_XGETBV).
+ */
+static unsigned xgetbv0(void)
+{
+#ifdef __GNUC__
+	unsigned lo, hi;
+	__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	return lo;
+#elif defined(_MSC_VER)
+	return (unsigned) _xgetbv(0);
+#else
+	return 0;
+#endif
+}
 #elif defined(_M_ARM)
 #if defined(__linux__)
 // HWCAP flags from linux kernel - uapi/asm/hwcap.h
@@ -822,6 +845,29 @@ BOOL IsProcessorFeaturePresentEx(DWORD ProcessorFeature)
 			break;
 #endif //__AVX__
 
+		case PF_EX_AVX2:
+			{
+				unsigned a7, b7, c7, d7;
+
+				/* AVX2 needs the OS to save the YMM registers just as AVX does */
+				if ((c & C_BITS_AVX) != C_BITS_AVX)
+					break;
+
+				if ((xgetbv0() & E_BITS_AVX) != E_BITS_AVX)
+					break;
+
+				cpuid(0, &a7, &b7, &c7, &d7);
+
+				if (a7 < 7)
+					break;
+
+				cpuid(7, &a7, &b7, &c7, &d7);
+
+				if (b7 & B7_BIT_AVX2)
+					ret = TRUE;
+			}
+			break;
+
 		default:
 			break;
 	}
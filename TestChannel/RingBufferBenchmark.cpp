@@ -0,0 +1,68 @@
+// RingBufferBenchmark.cpp : compares WaitingBuffer with SpscRingBuffer on the AsyncWriter pattern,
+// one thread writes blocks of a given size while another drains the ring in packets of up to 32K.
+//
+
+#include "stdafx.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "WaitingBuffer.h"
+#include "SpscRingBuffer.h"
+#include "RingBufferBenchmark.h"
+using namespace Titanium::TIRA;
+
+static const unsigned int RING_SIZE = 1024 * 1024;
+static const unsigned int READ_SIZE = 1024 * 32;
+static const unsigned long long BYTES_PER_ROUND = 1024ULL * 1024 * 512;
+
+static void DrainWaitingBuffer(WaitingBuffer<unsigned char>& ring, unsigned long long total)
+{
+	std::vector<unsigned char> packet(READ_SIZE);
+	while (total > 0)
+	{
+		total -= ring.ReadAtless(&packet[0], READ_SIZE, 1);
+	}
+}
+
+static void DrainSpscRingBuffer(SpscRingBuffer<unsigned char>& ring, unsigned long long total)
+{
+	while (total > 0)
+	{
+		const unsigned char* pData = nullptr;
+		unsigned int readCount = ring.WaitForReadableSpan(&pData, READ_SIZE, 1);
+		ring.CommitRead(readCount);
+		total -= readCount;
+	}
+}
+
+template<typename Ring, typename Drain>
+static double MeasureMBps(unsigned int writeSize, Drain drain)
+{
+	Ring ring(RING_SIZE);
+	std::vector<unsigned char> block(writeSize, 0x5a);
+	unsigned long long rounds = BYTES_PER_ROUND / writeSize;
+	unsigned long long total = rounds * writeSize;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::thread reader([&]() { drain(ring, total); });
+	for (unsigned long long i = 0; i < rounds; i++)
+	{
+		ring.WriteTillFinish(&block[0], writeSize);
+	}
+	reader.join();
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	return elapsed > 0 ? (double)total / elapsed : 0;
+}
+
+int RunRingBufferBenchmark()
+{
+	printf("%10s %20s %20s\n", "write", "WaitingBuffer MB/s", "SpscRingBuffer MB/s");
+	for (unsigned int writeSize = 1024; writeSize <= 1024 * 1024; writeSize *= 4)
+	{
+		double waiting = MeasureMBps<WaitingBuffer<unsigned char>>(writeSize, DrainWaitingBuffer);
+		double spsc = MeasureMBps<SpscRingBuffer<unsigned char>>(writeSize, DrainSpscRingBuffer);
+		printf("%9uK %20.1f %20.1f\n", writeSize / 1024, waiting, spsc);
+	}
+	return 0;
+}
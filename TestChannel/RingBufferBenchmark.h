@@ -0,0 +1,4 @@
+#pragma once
+
+/// Prints the throughput of WaitingBuffer and SpscRingBuffer for 1K to 1M writes.
+int RunRingBufferBenchmark();
@@ -3,11 +3,15 @@
 
 #include "stdafx.h"
 #include "TcpChannel.h"
+#include "RingBufferBenchmark.h"
 using namespace Titanium;
 using namespace Titanium::TIRA;
 
 int _tmain(int argc, _TCHAR* argv[])
 {
+	if (argc > 1 && 0 == _tcscmp(argv[1], _T("--ring-bench")))
+		return RunRingBufferBenchmark();
+
 	SocketFuncs::Startup();
 	InetAddress addr("10.172.98.205", 43221);
 	auto msock = SocketTcp::ConnectTo(addr);
@@ -1,4 +1,5 @@
 #include "Component.h"
+#include "StreamPool.h"
 
 Component::Component()
 	: _cancelled(false)
@@ -21,6 +22,8 @@ void Component::Start()
 {
 	_thread = std::make_shared<std::thread>([this]()
 	{
+		// a component pops and frees streams at frame rate, keep some of them on its own thread.
+		StreamPool::ThreadCacheScope cacheScope;
 		try
 		{
 			while (CanLoop())
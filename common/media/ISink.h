@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include "Pipe.h"
 
+class ISource;
 class ISink
 {
 	friend class ISource;
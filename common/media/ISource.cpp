@@ -2,13 +2,25 @@
 #include "ISink.h"
 #include "IFilter.h"
 
+ISource::ISource()
+	: _outSize(4)
+	, _outPolicy(PipeOverflowPolicy::Block)
+{
+}
+
 ISource::~ISource()
 {
 }
 
+void ISource::SetOutPipe(size_t size, PipeOverflowPolicy policy)
+{
+	_outSize = size;
+	_outPolicy = policy;
+}
+
 void ISource::operator>>(ISink &sink)
 {
-	_out = std::make_shared<Pipe>(4);
+	_out = std::make_shared<Pipe>(_outSize, _outPolicy);
 	sink.BeLinked(*this);
 }
 
@@ -2,15 +2,24 @@
 #include "Pipe.h"
 #include <memory>
 
+class ISink;
+class IFilter;
 class ISource
 {
 	friend class ISink;
 	friend class IFilter;
 public:
+	ISource();
 	virtual ~ISource();
 
+	/// Takes effect on the next link made with operator>>.
+	void SetOutPipe(size_t size, PipeOverflowPolicy policy = PipeOverflowPolicy::Block);
+
 	virtual void operator>>(ISink &sink);
 	virtual ISource &operator>>(IFilter &sink);
 protected:
 	std::shared_ptr<Pipe> _out;
+private:
+	size_t _outSize;
+	PipeOverflowPolicy _outPolicy;
 };
\ No newline at end of file
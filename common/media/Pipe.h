@@ -1,22 +1,192 @@
 #pragma once
 #include "Stream.h"
-#include <queue>
+#include "Ring.h"
+#include <vector>
+#include <atomic>
 #include <mutex>
+#include <stdexcept>
 #include <condition_variable>
 
-class Pipe
+/// What Push does when the pipe is full.
+enum class PipeOverflowPolicy
+{
+	Block,          //!< wait for the consumer
+	DropOldest,     //!< discard the oldest queued stream to make room, needs a ring with more than one consumer
+	DropNewest      //!< discard the stream being pushed
+};
+
+// A bounded pipe over a lock free ring, the mutex is only taken by a side which has to sleep and
+// by the other side waking it up. "not empty" and "not full" have their own condition variables so
+// a producer never wakes another producer.
+template<template<typename> class Ring>
+class BasicPipe
 {
 public:
-	Pipe(size_t size);
-	virtual ~Pipe();
+	BasicPipe(size_t size, PipeOverflowPolicy policy = PipeOverflowPolicy::Block)
+		: _ring(size)
+		, _policy(policy)
+		, _cancelled(false)
+		, _waitingPoppers(0)
+		, _waitingPushers(0)
+		, _dropped(0)
+	{
+		if (policy == PipeOverflowPolicy::DropOldest && !Ring<Stream>::MULTI_CONSUMER)
+			throw std::invalid_argument("DropOldest needs a ring the producer can pop from.");
+	}
+	virtual ~BasicPipe()
+	{
+		Cancel();
+	}
+
+	/// Queues the stream according to the overflow policy, the stream is discarded once the pipe is cancelled.
+	void Push(Stream stream)
+	{
+		while (!_cancelled.load(std::memory_order_acquire))
+		{
+			if (_ring.TryPush(stream))
+			{
+				WakePoppers();
+				return;
+			}
+
+			switch (_policy)
+			{
+			case PipeOverflowPolicy::DropNewest:
+				_dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			case PipeOverflowPolicy::DropOldest:
+			{
+				Stream oldest(nullptr, 0);
+				if (_ring.TryPop(oldest))
+					_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			break;
+			default:
+				WaitNotFull();
+				break;
+			}
+		}
+	}
+
+	/// Pushes the streams in order, each one is subject to the overflow policy.
+	void PushBatch(std::vector<Stream>& streams)
+	{
+		for (auto it = streams.begin(); it != streams.end(); ++it)
+			Push(std::move(*it));
+		streams.clear();
+	}
+
+	/// Waits for a stream, returns an empty one once the pipe is cancelled.
+	Stream Pop()
+	{
+		Stream stream(nullptr, 0);
+		while (!_ring.TryPop(stream))
+		{
+			if (_cancelled.load(std::memory_order_acquire))
+				return Stream(0);
+			WaitNotEmpty();
+		}
+		WakePushers();
+		return stream;
+	}
+
+	/// Waits for at least one stream and appends up to maxCount queued streams to streams, returns how many were appended.
+	size_t PopBatch(std::vector<Stream>& streams, size_t maxCount)
+	{
+		size_t count = 0;
+		Stream stream(nullptr, 0);
+		while (count < maxCount)
+		{
+			if (_ring.TryPop(stream))
+			{
+				streams.push_back(std::move(stream));
+				count++;
+				continue;
+			}
+			if (count > 0 || _cancelled.load(std::memory_order_acquire))
+				break;
+			WaitNotEmpty();
+		}
+		if (count > 0)
+			WakePushers();
+		return count;
+	}
+
+	void Cancel()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_cancelled = true;
+		_notEmpty.notify_all();
+		_notFull.notify_all();
+	}
+
+	size_t Size() const
+	{
+		return _ring.Size();
+	}
+	size_t Capacity() const
+	{
+		return _ring.Capacity();
+	}
+	/// Streams discarded by the overflow policy so far.
+	unsigned long long GetDroppedCount() const
+	{
+		return _dropped.load(std::memory_order_relaxed);
+	}
 
-	void Push(Stream stream);
-	Stream Pop();
-	void Cancel();
 private:
-	std::queue<Stream> _queue;
+	BasicPipe(const BasicPipe&);
+	BasicPipe& operator=(const BasicPipe&);
+
+	// the waiting count is raised before the ring is checked again under the mutex, and the other side
+	// reads the count after publishing, so a wakeup can not fall between the check and the wait.
+	void WaitNotEmpty()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_waitingPoppers.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		_notEmpty.wait(lock, [this]() { return _cancelled.load() || _ring.Size() > 0; });
+		_waitingPoppers.fetch_sub(1, std::memory_order_relaxed);
+	}
+	void WaitNotFull()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_waitingPushers.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		_notFull.wait(lock, [this]() { return _cancelled.load() || _ring.Size() < _ring.Capacity(); });
+		_waitingPushers.fetch_sub(1, std::memory_order_relaxed);
+	}
+	void WakePoppers()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waitingPoppers.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_notEmpty.notify_one();
+		}
+	}
+	void WakePushers()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waitingPushers.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_notFull.notify_all();
+		}
+	}
+
+	Ring<Stream> _ring;
+	const PipeOverflowPolicy _policy;
+	std::atomic<bool> _cancelled;
+	std::atomic<int> _waitingPoppers;
+	std::atomic<int> _waitingPushers;
+	std::atomic<unsigned long long> _dropped;
 	std::mutex _mutex;
-	std::condition_variable _cv;
-	bool _cancelled;
-	size_t _size;
-};
\ No newline at end of file
+	std::condition_variable _notEmpty;
+	std::condition_variable _notFull;
+};
+
+/// The pipe between components, several threads may push into it, e.g. Stop pushing a wake up stream.
+typedef BasicPipe<MpmcRing> Pipe;
+/// For a pipe with exactly one producing and one consuming thread.
+typedef BasicPipe<SpscRing> SpscPipe;
@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock free rings used by the media pipes, both round the capacity up to a power of two.
+// TryPush takes the value over only when it succeeds, neither of them ever blocks.
+
+static inline size_t RingRoundUpPowerOfTwo(size_t size)
+{
+	size_t result = 2;
+	while (result < size)
+		result <<= 1;
+	return result;
+}
+
+// Any number of producers and consumers, Dmitry Vyukov's bounded queue: every cell carries a
+// sequence number telling whether it is free for the lap of a producer or filled for a consumer.
+template<typename T>
+class MpmcRing
+{
+public:
+	static const bool MULTI_CONSUMER = true;
+
+	explicit MpmcRing(size_t size)
+		: _mask(RingRoundUpPowerOfTwo(size) - 1)
+		, _cells(new Cell[RingRoundUpPowerOfTwo(size)])
+		, _enqueuePos(0)
+		, _dequeuePos(0)
+	{
+		for (size_t i = 0; i <= _mask; i++)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool TryPush(T& value)
+	{
+		Cell* cell;
+		size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &_cells[pos & _mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->data = std::move(value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& value)
+	{
+		Cell* cell;
+		size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &_cells[pos & _mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		// moving out also drops the reference held by the cell instead of keeping it for a lap.
+		value = std::move(cell->data);
+		cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Approximate while other threads are pushing or popping.
+	size_t Size() const
+	{
+		size_t enqueuePos = _enqueuePos.load(std::memory_order_acquire);
+		size_t dequeuePos = _dequeuePos.load(std::memory_order_acquire);
+		return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+	}
+
+	size_t Capacity() const
+	{
+		return _mask + 1;
+	}
+
+private:
+	MpmcRing(const MpmcRing&);
+	MpmcRing& operator=(const MpmcRing&);
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	const size_t _mask;
+	std::unique_ptr<Cell[]> _cells;
+	// the positions are contended by different sides, keep them on separate cache lines.
+	char _padding0[CACHE_LINE_SIZE];
+	std::atomic<size_t> _enqueuePos;
+	char _padding1[CACHE_LINE_SIZE];
+	std::atomic<size_t> _dequeuePos;
+	char _padding2[CACHE_LINE_SIZE];
+};
+
+// Exactly one producing thread and one consuming thread, no compare and swap on either side.
+template<typename T>
+class SpscRing
+{
+public:
+	static const bool MULTI_CONSUMER = false;
+
+	explicit SpscRing(size_t size)
+		: _mask(RingRoundUpPowerOfTwo(size) - 1)
+		, _data(new T[RingRoundUpPowerOfTwo(size)])
+		, _writePos(0)
+		, _readPos(0)
+	{
+	}
+
+	bool TryPush(T& value)
+	{
+		size_t writePos = _writePos.load(std::memory_order_relaxed);
+		if (writePos - _readPos.load(std::memory_order_acquire) > _mask)
+			return false;
+		_data[writePos & _mask] = std::move(value);
+		_writePos.store(writePos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& value)
+	{
+		size_t readPos = _readPos.load(std::memory_order_relaxed);
+		if (readPos == _writePos.load(std::memory_order_acquire))
+			return false;
+		value = std::move(_data[readPos & _mask]);
+		_readPos.store(readPos + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t Size() const
+	{
+		return _writePos.load(std::memory_order_acquire) - _readPos.load(std::memory_order_acquire);
+	}
+
+	size_t Capacity() const
+	{
+		return _mask + 1;
+	}
+
+private:
+	SpscRing(const SpscRing&);
+	SpscRing& operator=(const SpscRing&);
+
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	const size_t _mask;
+	std::unique_ptr<T[]> _data;
+	char _padding0[CACHE_LINE_SIZE];
+	std::atomic<size_t> _writePos;
+	char _padding1[CACHE_LINE_SIZE];
+	std::atomic<size_t> _readPos;
+	char _padding2[CACHE_LINE_SIZE];
+};
@@ -1,10 +1,71 @@
 #include "Stream.h"
+#include "StreamPool.h"
+#include <cstring>
 
 Stream::Stream(size_t size)
-	: buffer(new unsigned char[size], [](unsigned char *p) {delete[]p; }), m_bufferSize(size)
+	: m_bufferSize(size), m_TraceId(0)
 {
+	buffer = StreamPool::Instance().Acquire(size, m_capacity);
+}
+
+Stream::Stream(std::shared_ptr<unsigned char> data, size_t size)
+	: buffer(data), m_bufferSize(size), m_TraceId(0), m_capacity(size)
+{
+}
+
+Stream::Stream(const Stream& other)
+	: buffer(other.buffer), m_bufferSize(other.m_bufferSize), m_ReceivedTime(other.m_ReceivedTime), m_TraceId(other.m_TraceId), m_capacity(other.m_capacity)
+{
+}
+
+Stream::Stream(Stream&& other)
+	: buffer(std::move(other.buffer)), m_bufferSize(other.m_bufferSize), m_ReceivedTime(other.m_ReceivedTime), m_TraceId(other.m_TraceId), m_capacity(other.m_capacity)
+{
+	other.m_bufferSize = 0;
+	other.m_capacity = 0;
 }
 
 Stream::~Stream()
 {
-}
\ No newline at end of file
+}
+
+Stream& Stream::operator=(const Stream& other)
+{
+	buffer = other.buffer;
+	m_bufferSize = other.m_bufferSize;
+	m_ReceivedTime = other.m_ReceivedTime;
+	m_TraceId = other.m_TraceId;
+	m_capacity = other.m_capacity;
+	return *this;
+}
+
+Stream& Stream::operator=(Stream&& other)
+{
+	buffer = std::move(other.buffer);
+	m_bufferSize = other.m_bufferSize;
+	m_ReceivedTime = other.m_ReceivedTime;
+	m_TraceId = other.m_TraceId;
+	m_capacity = other.m_capacity;
+	other.m_bufferSize = 0;
+	other.m_capacity = 0;
+	return *this;
+}
+
+void Stream::Resize(size_t size, bool keepData)
+{
+	if (size > m_capacity)
+	{
+		size_t capacity = 0;
+		auto newBuffer = StreamPool::Instance().Acquire(size, capacity);
+		if (keepData && m_bufferSize > 0)
+			memcpy(newBuffer.get(), buffer.get(), m_bufferSize);
+		buffer = newBuffer;
+		m_capacity = capacity;
+	}
+	m_bufferSize = size;
+}
+
+size_t Stream::GetCapacity() const
+{
+	return m_capacity;
+}
@@ -1,13 +1,31 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <chrono>
 class Stream
 {
 public:
+	/// Draws the buffer from StreamPool, it goes back to the pool when the last copy of the stream is gone.
 	Stream(size_t size = 1);
+	/// Adopts data without copying, it may alias a part of a larger shared buffer.
+	Stream(std::shared_ptr<unsigned char> data, size_t size);
+	Stream(const Stream& other);
+	Stream(Stream&& other);
 	virtual ~Stream();
+	Stream& operator=(const Stream& other);
+	Stream& operator=(Stream&& other);
+
+	/// Changes the payload length, the buffer is only replaced when it is too small, keepData copies the old payload over.
+	void Resize(size_t size, bool keepData = false);
+	size_t GetCapacity() const;
 
 	std::shared_ptr<unsigned char> buffer;
 	int m_bufferSize;
+	/// When the channel delivered the data the stream was made from, zero if the source does not stamp it.
+	std::chrono::steady_clock::time_point m_ReceivedTime;
+	/// Ties the stream to the message it was made from in a LatencyTrace, zero if there is none.
+	unsigned long long m_TraceId;
+private:
+	size_t m_capacity;
 };
 
@@ -0,0 +1,191 @@
+#include "StreamPool.h"
+
+#ifdef __GNUC__
+#define STREAMPOOL_THREAD_LOCAL __thread
+#else
+#define STREAMPOOL_THREAD_LOCAL __declspec(thread)
+#endif
+
+StreamPool::ThreadCacheScope::ThreadCacheScope()
+	: _owner(false)
+{
+	ThreadCache*& cache = CurrentThreadCache();
+	if (cache == nullptr)
+	{
+		cache = new ThreadCache();
+		_owner = true;
+	}
+}
+
+StreamPool::ThreadCacheScope::~ThreadCacheScope()
+{
+	ThreadCache*& cache = CurrentThreadCache();
+	if (!_owner || cache == nullptr)
+		return;
+
+	ThreadCache* flushing = cache;
+	cache = nullptr;
+	StreamPool& pool = Instance();
+	for (int i = 0; i < CLASS_COUNT; i++)
+	{
+		for (int j = 0; j < flushing->counts[i]; j++)
+			pool.ReleaseShared(flushing->buffers[i][j], i);
+	}
+	delete flushing;
+}
+
+StreamPool& StreamPool::Instance()
+{
+	// never destroyed, streams released during static destruction still find it.
+	static StreamPool* pool = new StreamPool();
+	return *pool;
+}
+
+StreamPool::StreamPool()
+	: _hits(0)
+	, _threadHits(0)
+	, _misses(0)
+	, _releases(0)
+	, _frees(0)
+{
+}
+
+StreamPool::~StreamPool()
+{
+	for (int i = 0; i < CLASS_COUNT; i++)
+	{
+		for (auto it = _free[i].begin(); it != _free[i].end(); ++it)
+			delete[] *it;
+	}
+}
+
+std::shared_ptr<unsigned char> StreamPool::Acquire(size_t size, size_t& capacity)
+{
+	int classIndex = GetClassIndex(size);
+	if (classIndex < 0)
+	{
+		_misses.fetch_add(1, std::memory_order_relaxed);
+		capacity = size;
+		return std::shared_ptr<unsigned char>(new unsigned char[size], [this](unsigned char *p)
+		{
+			_releases.fetch_add(1, std::memory_order_relaxed);
+			_frees.fetch_add(1, std::memory_order_relaxed);
+			delete[]p;
+		});
+	}
+
+	capacity = GetClassSize(classIndex);
+	unsigned char* p = Take(classIndex);
+	if (p == nullptr)
+	{
+		_misses.fetch_add(1, std::memory_order_relaxed);
+		p = new unsigned char[capacity];
+	}
+	return std::shared_ptr<unsigned char>(p, [this, classIndex](unsigned char *p)
+	{
+		Release(p, classIndex);
+	});
+}
+
+unsigned char* StreamPool::Take(int classIndex)
+{
+	ThreadCache* cache = CurrentThreadCache();
+	if (cache != nullptr && cache->counts[classIndex] > 0)
+	{
+		_hits.fetch_add(1, std::memory_order_relaxed);
+		_threadHits.fetch_add(1, std::memory_order_relaxed);
+		return cache->buffers[classIndex][--cache->counts[classIndex]];
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<unsigned char*>& freeList = _free[classIndex];
+	if (freeList.empty())
+		return nullptr;
+	unsigned char* p = freeList.back();
+	freeList.pop_back();
+	_hits.fetch_add(1, std::memory_order_relaxed);
+	return p;
+}
+
+void StreamPool::Release(unsigned char* p, int classIndex)
+{
+	_releases.fetch_add(1, std::memory_order_relaxed);
+	ThreadCache* cache = CurrentThreadCache();
+	if (cache != nullptr && cache->counts[classIndex] < GetThreadDepth(classIndex))
+	{
+		cache->buffers[classIndex][cache->counts[classIndex]++] = p;
+		return;
+	}
+	ReleaseShared(p, classIndex);
+}
+
+void StreamPool::ReleaseShared(unsigned char* p, int classIndex)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::vector<unsigned char*>& freeList = _free[classIndex];
+		if (freeList.size() < GetSharedDepth(classIndex))
+		{
+			freeList.push_back(p);
+			return;
+		}
+	}
+	_frees.fetch_add(1, std::memory_order_relaxed);
+	delete[]p;
+}
+
+StreamPool::Counters StreamPool::GetCounters() const
+{
+	Counters counters;
+	counters.hits = _hits.load(std::memory_order_relaxed);
+	counters.threadHits = _threadHits.load(std::memory_order_relaxed);
+	counters.misses = _misses.load(std::memory_order_relaxed);
+	counters.releases = _releases.load(std::memory_order_relaxed);
+	counters.frees = _frees.load(std::memory_order_relaxed);
+	return counters;
+}
+
+void StreamPool::ResetCounters()
+{
+	_hits = 0;
+	_threadHits = 0;
+	_misses = 0;
+	_releases = 0;
+	_frees = 0;
+}
+
+int StreamPool::GetClassIndex(size_t size)
+{
+	int shift = MIN_CLASS_SHIFT;
+	while (((size_t)1 << shift) < size)
+	{
+		if (++shift > MAX_CLASS_SHIFT)
+			return -1;
+	}
+	return shift - MIN_CLASS_SHIFT;
+}
+
+size_t StreamPool::GetClassSize(int classIndex)
+{
+	return (size_t)1 << (classIndex + MIN_CLASS_SHIFT);
+}
+
+size_t StreamPool::GetSharedDepth(int classIndex)
+{
+	// bounds what the shared lists hold on to, about 4 MB per class but never less than 4 buffers.
+	size_t depth = ((size_t)4 << 20) / GetClassSize(classIndex);
+	return depth < 4 ? 4 : (depth > 64 ? 64 : depth);
+}
+
+int StreamPool::GetThreadDepth(int classIndex)
+{
+	// classes above THREAD_CACHE_CLASS_BYTES are not cached per thread, about 1 MB per thread in all.
+	size_t depth = THREAD_CACHE_CLASS_BYTES / GetClassSize(classIndex);
+	return depth < (size_t)THREAD_CACHE_DEPTH ? (int)depth : THREAD_CACHE_DEPTH;
+}
+
+StreamPool::ThreadCache*& StreamPool::CurrentThreadCache()
+{
+	static STREAMPOOL_THREAD_LOCAL ThreadCache* cache = nullptr;
+	return cache;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// Recycles Stream buffers by power of two size classes. A thread which declares a
+// StreamPool::ThreadCacheScope keeps a few buffers of the smaller classes for itself,
+// other threads, large buffers and overflowing caches go through the shared free lists.
+class StreamPool
+{
+public:
+	struct Counters
+	{
+		uint64_t hits;           //!< served from a thread cache or a shared free list
+		uint64_t threadHits;     //!< the part of hits served from a thread cache
+		uint64_t misses;         //!< had to allocate
+		uint64_t releases;       //!< buffers given back
+		uint64_t frees;          //!< given back but freed because the pool was full or the buffer too large
+	};
+
+	// Installs a cache for the current thread, buffers left in it go back to the shared lists when it is destroyed.
+	class ThreadCacheScope
+	{
+	public:
+		ThreadCacheScope();
+		~ThreadCacheScope();
+	private:
+		bool _owner;
+		ThreadCacheScope(const ThreadCacheScope&);
+		ThreadCacheScope& operator=(const ThreadCacheScope&);
+	};
+
+	static StreamPool& Instance();
+
+	/// Returns a buffer of at least size bytes, capacity receives its real size.
+	std::shared_ptr<unsigned char> Acquire(size_t size, size_t& capacity);
+	Counters GetCounters() const;
+	void ResetCounters();
+
+private:
+	static const int MIN_CLASS_SHIFT = 6;     // 64 bytes
+	static const int MAX_CLASS_SHIFT = 22;    // 4 MB
+	static const int CLASS_COUNT = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+	static const int THREAD_CACHE_DEPTH = 4;
+	static const size_t THREAD_CACHE_CLASS_BYTES = 256 * 1024;   // what a thread keeps of one class at most
+
+	struct ThreadCache
+	{
+		unsigned char* buffers[CLASS_COUNT][THREAD_CACHE_DEPTH];
+		int counts[CLASS_COUNT];
+	};
+
+	StreamPool();
+	~StreamPool();
+	static int GetClassIndex(size_t size);
+	static size_t GetClassSize(int classIndex);
+	static size_t GetSharedDepth(int classIndex);
+	static int GetThreadDepth(int classIndex);
+	unsigned char* Take(int classIndex);
+	void Release(unsigned char* p, int classIndex);
+	void ReleaseShared(unsigned char* p, int classIndex);
+	static ThreadCache*& CurrentThreadCache();
+
+	std::mutex _mutex;
+	std::vector<unsigned char*> _free[CLASS_COUNT];
+
+	std::atomic<uint64_t> _hits;
+	std::atomic<uint64_t> _threadHits;
+	std::atomic<uint64_t> _misses;
+	std::atomic<uint64_t> _releases;
+	std::atomic<uint64_t> _frees;
+};
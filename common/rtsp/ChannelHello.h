@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <sstream>
+
+// The projector serves the data connections of every session on one listening port. The redirector
+// learns the port and its session token from the data of the SETUP_*_CHANNEL response and sends a
+// ChannelHello as the first bytes of the connection, so the projector can hand it to the right
+// session and channel.
+
+#define CHANNEL_HELLO_MAGIC 0x32435254 // "TRC2", the hello of a 64 bit token
+
+enum ChannelHelloType
+{
+	CHANNEL_HELLO_SCREEN = 1,
+	CHANNEL_HELLO_HID,
+	CHANNEL_HELLO_DR,
+	CHANNEL_HELLO_AUDIOPLAYBACK,
+	CHANNEL_HELLO_TOUCHANDPEN,
+	CHANNEL_HELLO_MUX          //!< one connection carrying all the others, their types are the stream ids
+};
+
+#pragma pack(push, 1)
+struct ChannelHello
+{
+	unsigned int magic;
+	unsigned long long token;
+	unsigned int channel;
+};
+#pragma pack(pop)
+
+/// Input goes ahead of audio and audio ahead of the bulk screen and drive data on a multiplexed connection.
+inline unsigned int GetChannelStreamPriority(ChannelHelloType channel)
+{
+	switch (channel)
+	{
+	case CHANNEL_HELLO_HID:
+	case CHANNEL_HELLO_TOUCHANDPEN:
+		return 0;
+	case CHANNEL_HELLO_AUDIOPLAYBACK:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+/// The response data telling the redirector where to open a channel, "port:token".
+inline std::string FormatChannelEndpoint(unsigned short port, unsigned long long token)
+{
+	std::ostringstream os;
+	os << port << ':' << token;
+	return os.str();
+}
+
+/// Returns false for an empty or malformed response data, e.g. from a projector with a listener per session.
+inline bool ParseChannelEndpoint(const std::string &data, unsigned short &port, unsigned long long &token)
+{
+	std::istringstream is(data);
+	char separator = 0;
+	if (!(is >> port >> separator >> token) || separator != ':')
+		return false;
+	return true;
+}
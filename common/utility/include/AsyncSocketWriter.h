@@ -17,6 +17,7 @@ namespace Titanium { namespace TIRA
 	public:
 		virtual void WaitTillSourceIdeal();
 		virtual void WriteBytes(unsigned const char* buffer, int bufLen);
+		virtual void WriteBytesV(const ConstBuffer* buffers, int count);
 		virtual void Cancel();
 		virtual bool IsSourceInError();
 	private:
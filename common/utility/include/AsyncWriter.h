@@ -1,5 +1,5 @@
 #pragma once
-#include "WaitingBuffer.h"
+#include "SpscRingBuffer.h"
 #include "AsyncBase.h"
 #include "WritableSource.h"
 
@@ -11,8 +11,12 @@ namespace Titanium { namespace TIRA
 		AsyncWriter(std::shared_ptr<WritableSource> source, unsigned int bufferSize, unsigned int maxPkgSize, unsigned int minPkgSize);
 		virtual ~AsyncWriter();
 		virtual void WaitTillSourceIdeal();
+		/// Only one thread may write at a time, the ring behind it is single producer.
 		virtual void WriteBytes(unsigned const char* buffer, int len);
+		/// Waits till all the queued bytes are written, then writes the buffers straight to the source on the calling thread.
+		virtual void WriteBytesV(const ConstBuffer* buffers, int count);
 		virtual void Cancel();
+		virtual unsigned int GetQueuedBytes();
 		void Close();
 		virtual bool IsSourceInError();
 
@@ -21,9 +25,8 @@ namespace Titanium { namespace TIRA
 		virtual void UnBlockWorkingThread();
 
 	private:
-		WaitingBuffer<unsigned char>	m_Buffer;
+		SpscRingBuffer<unsigned char>	m_Buffer;
 		std::shared_ptr<WritableSource> m_Source;
-		std::unique_ptr<unsigned char[]>	m_TempBuffer; //1K
 		unsigned int m_MaxSize;
 		unsigned int m_MinSize;
 	};
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include "AsyncBase.h"
 #include "ReadableSource.h"
 #include "SignalConnection.h"
@@ -10,6 +11,7 @@ namespace Titanium { namespace TIRA
 	{
 	public:
 		typedef std::function<void(const unsigned char*, unsigned int)> OnDataReadedAction;
+		/// Reads on the event loop of the source when it has one, otherwise on an own blocking thread.
 		AutoReader(std::shared_ptr<ReadableSource> source);
 		virtual ~AutoReader();
 		SignalConnection RegisterDataReadedEvent(OnDataReadedAction action);
@@ -19,10 +21,16 @@ namespace Titanium { namespace TIRA
 		virtual void Workloop();
 		virtual void UnBlockWorkingThread();
 		virtual void OnDataReaded(const unsigned char* pData, unsigned int len);
+	private:
+		void OnSourceReadable();
 	private:
 		std::shared_ptr<ReadableSource> m_Source;
 		Signal<void(const unsigned char*, unsigned int)> m_SigDataReaded;
 		std::unique_ptr<unsigned char[]> m_InternalBuffer;
+		bool m_IsWatchingSource;
+		std::atomic<bool> m_IsClosed;
+		// reads per readiness notification, so one busy socket can not starve the others on the loop.
+		static const int MAX_READS_PER_EVENT = 16;
 	};
 }
 }
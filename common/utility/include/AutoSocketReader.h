@@ -11,6 +11,9 @@ namespace Titanium { namespace TIRA
 		virtual int ReadBytes(unsigned char* buffer, int bufLen);
 		virtual void CancelRead();
 		virtual bool IsSourceInError();
+		virtual bool WatchReadable(std::function<void()> action);
+		virtual void UnwatchReadable();
+		virtual int TryReadBytes(unsigned char* buffer, int bufLen);
 	private:
 		std::shared_ptr<Socket> m_Socket;
 	};
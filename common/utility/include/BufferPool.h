@@ -0,0 +1,81 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "noncopyable.h"
+
+namespace Titanium { namespace TIRA
+{
+	//
+	// Hands out fixed size buffers as shared pointers, a buffer goes back to the pool when its last
+	// reference is dropped instead of being freed. The buffers may outlive the pool, they are freed
+	// normally once the pool is gone.
+	//
+	class BufferPool : public NonCopyable, public std::enable_shared_from_this<BufferPool>
+	{
+	public:
+		BufferPool(unsigned int bufferSize, unsigned int maxPooled)
+			: m_BufferSize(bufferSize)
+			, m_MaxPooled(maxPooled)
+		{
+		}
+		~BufferPool()
+		{
+			std::lock_guard<std::mutex> lock(m_Mtx);
+			for (auto it = m_FreeBuffers.begin(); it != m_FreeBuffers.end(); ++it)
+				delete[] *it;
+			m_FreeBuffers.clear();
+		}
+
+		/// The pool must be owned by a shared_ptr, the returned buffers only keep a weak reference to it.
+		std::shared_ptr<unsigned char> Acquire()
+		{
+			unsigned char* pBuffer = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_Mtx);
+				if (!m_FreeBuffers.empty())
+				{
+					pBuffer = m_FreeBuffers.back();
+					m_FreeBuffers.pop_back();
+				}
+			}
+			if (pBuffer == nullptr)
+				pBuffer = new unsigned char[m_BufferSize];
+
+			std::weak_ptr<BufferPool> weakPool = shared_from_this();
+			return std::shared_ptr<unsigned char>(pBuffer, [weakPool](unsigned char* p)
+			{
+				auto pool = weakPool.lock();
+				if (pool)
+					pool->Release(p);
+				else
+					delete[] p;
+			});
+		}
+		unsigned int GetBufferSize() const
+		{
+			return m_BufferSize;
+		}
+
+	private:
+		void Release(unsigned char* pBuffer)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mtx);
+				if (m_FreeBuffers.size() < m_MaxPooled)
+				{
+					m_FreeBuffers.push_back(pBuffer);
+					return;
+				}
+			}
+			delete[] pBuffer;
+		}
+
+	private:
+		const unsigned int m_BufferSize;
+		const unsigned int m_MaxPooled;
+		std::mutex m_Mtx;
+		std::vector<unsigned char*> m_FreeBuffers;
+	};
+}
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "buffer.h"
+#include <cstring>
 
 namespace Titanium { namespace TIRA
 {
@@ -81,7 +82,7 @@ namespace Titanium { namespace TIRA
 		void AppendFrom(const DataBuffer<DataType>& src)
 		{
 #ifdef __GNUC__
-			AppendFrom<unsigned char>(src.GetPtrForReading(), src.GetDataLength<unsigned char>());
+			AppendFrom<unsigned char>(src.GetPtrForReading(), src.template GetDataLength<unsigned char>());
 #else
 			AppendFrom<unsigned char>(src.GetPtrForReading<unsigned char>(), src.GetDataLength<unsigned char>());
 #endif //#ifdef __GNUC__
@@ -91,7 +92,7 @@ namespace Titanium { namespace TIRA
 		void CopyFrom(const DataBuffer<DataType>& src)
 		{
 #ifdef __GNUC__
-			CopyFrom<unsigned char>(src.GetPtrForReading(), src.GetDataLength<unsigned char>());
+			CopyFrom<unsigned char>(src.GetPtrForReading(), src.template GetDataLength<unsigned char>());
 #else
 			CopyFrom<unsigned char>(src.GetPtrForReading<unsigned char>(), src.GetDataLength<unsigned char>());
 #endif //#ifdef __GNUC__
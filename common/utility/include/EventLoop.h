@@ -0,0 +1,85 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "AsyncBase.h"
+#include "SmartHandle.h"
+#include "noncopyable.h"
+
+namespace Titanium { namespace TIRA
+{
+	//
+	// Readiness notifications for many sockets on one thread, epoll on linux and a completion port on windows.
+	// A watch is one shot, the action runs once on the loop thread and has to be armed again for the next event.
+	// Stop and Unwatch wake the loop immediately instead of waiting for a polling timeout.
+	//
+	class EventLoop : public AsyncBase, public NonCopyable
+	{
+	public:
+		enum EventType
+		{
+			EVENT_READ = 0x01,
+			EVENT_WRITE = 0x02,
+		};
+		/// Receives the events which became ready.
+		typedef std::function<void(int events)> OnReadyAction;
+
+		explicit EventLoop(const std::string& name = "EventLoop");
+		virtual ~EventLoop();
+
+		/// The loop shared by the process, started on first use.
+		static std::shared_ptr<EventLoop> GetDefault();
+
+		void Start();
+		void Stop();
+		/// Arms a one shot watch for EVENT_READ or EVENT_WRITE, read and write can be armed at the same time by different threads.
+		void Watch(SOCKET sockfd, EventType type, OnReadyAction action);
+		/// Drops the watches of the socket, returns only after any action of it running on the loop thread has finished.
+		void Unwatch(SOCKET sockfd, int events = EVENT_READ | EVENT_WRITE);
+		bool IsInLoopThread();
+
+	protected:
+		virtual void Workloop();
+		virtual void UnBlockWorkingThread();
+
+	private:
+		struct WatchEntry;
+		void Dispatch(SOCKET sockfd, int events);
+		void Arm(SOCKET sockfd, WatchEntry& entry);
+		void Disarm(SOCKET sockfd, WatchEntry& entry);
+		void WaitEvents();
+		void Wakeup();
+#ifndef __GNUC__
+		static void CALLBACK OnEventSignaled(PVOID context, BOOLEAN isTimeout);
+#endif
+
+	private:
+		struct WatchEntry
+		{
+			WatchEntry();
+			OnReadyAction readAction;
+			OnReadyAction writeAction;
+			bool isRegistered;
+#ifndef __GNUC__
+			EventLoop* loop;
+			SOCKET sockfd;
+			HANDLE event;
+			HANDLE waitHandle;
+#endif
+		};
+
+		// held while an action runs so Unwatch can wait it out, recursive because actions often re-arm.
+		std::recursive_mutex m_WatchMtx;
+		std::map<SOCKET, WatchEntry> m_Watches;
+		std::thread::id m_LoopThreadId;
+#ifdef __GNUC__
+		int m_PollFd;
+		int m_WakeupFd;
+#else
+		HANDLE m_CompletionPort;
+#endif
+		static const int MAX_EVENTS_PER_WAIT = 64;
+	};
+}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Titanium { namespace TIRA
+{
+	//
+	// Counts durations in micro seconds. Every power of two is cut into SUB_BUCKETS buckets, so a sample is
+	// one increment however long the run and a percentile is off by less than 1/SUB_BUCKETS of its value.
+	// Not synchronized, one thread adds and the others read once it is done.
+	//
+	class LatencyHistogram
+	{
+	public:
+		LatencyHistogram()
+			: m_Buckets(BUCKET_COUNT, 0), m_Count(0), m_Sum(0), m_Min(UINT64_MAX), m_Max(0)
+		{
+		}
+
+		void Add(std::chrono::steady_clock::duration duration)
+		{
+			long long micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+			AddMicros(micros > 0 ? (uint64_t)micros : 0);
+		}
+
+		void AddMicros(uint64_t micros)
+		{
+			m_Buckets[BucketOf(micros)]++;
+			m_Count++;
+			m_Sum += micros;
+			if (micros < m_Min)
+				m_Min = micros;
+			if (micros > m_Max)
+				m_Max = micros;
+		}
+
+		void Merge(const LatencyHistogram& other)
+		{
+			for (size_t i = 0; i < BUCKET_COUNT; i++)
+				m_Buckets[i] += other.m_Buckets[i];
+			m_Count += other.m_Count;
+			m_Sum += other.m_Sum;
+			if (other.m_Min < m_Min)
+				m_Min = other.m_Min;
+			if (other.m_Max > m_Max)
+				m_Max = other.m_Max;
+		}
+
+		void Reset()
+		{
+			std::fill(m_Buckets.begin(), m_Buckets.end(), 0);
+			m_Count = 0;
+			m_Sum = 0;
+			m_Min = UINT64_MAX;
+			m_Max = 0;
+		}
+
+		uint64_t GetCount() const { return m_Count; }
+		uint64_t GetMinMicros() const { return m_Count > 0 ? m_Min : 0; }
+		uint64_t GetMaxMicros() const { return m_Max; }
+		double GetMeanMicros() const { return m_Count > 0 ? (double)m_Sum / m_Count : 0; }
+
+		/// The upper edge of the bucket holding the given share of the samples, percentile is 0 to 100.
+		uint64_t GetPercentileMicros(double percentile) const
+		{
+			if (m_Count == 0)
+				return 0;
+			uint64_t rank = (uint64_t)(percentile / 100 * m_Count + 0.5);
+			if (rank < 1)
+				rank = 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < BUCKET_COUNT; i++)
+			{
+				seen += m_Buckets[i];
+				if (seen >= rank)
+				{
+					uint64_t upper = UpperEdgeOf(i);
+					return upper < m_Max ? upper : m_Max;
+				}
+			}
+			return m_Max;
+		}
+
+		/// One line with the count, mean, p50, p90, p99 and max in milli seconds.
+		std::string Format() const
+		{
+			std::ostringstream os;
+			os << std::fixed << std::setprecision(3)
+				<< "count " << m_Count
+				<< "  mean " << GetMeanMicros() / 1000
+				<< "  p50 " << GetPercentileMicros(50) / 1000.0
+				<< "  p90 " << GetPercentileMicros(90) / 1000.0
+				<< "  p99 " << GetPercentileMicros(99) / 1000.0
+				<< "  max " << GetMaxMicros() / 1000.0 << " ms";
+			return os.str();
+		}
+
+		/// The non empty buckets as "upper edge in micro seconds: count" lines.
+		std::string FormatBuckets() const
+		{
+			std::ostringstream os;
+			for (size_t i = 0; i < BUCKET_COUNT; i++)
+			{
+				if (m_Buckets[i] > 0)
+					os << "<= " << UpperEdgeOf(i) << " us: " << m_Buckets[i] << "\n";
+			}
+			return os.str();
+		}
+
+	private:
+		static const unsigned int SUB_BUCKET_BITS = 3;
+		static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		// the values below SUB_BUCKETS have a bucket each, then SUB_BUCKETS for every further power of two.
+		static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		static size_t BucketOf(uint64_t micros)
+		{
+			if (micros < SUB_BUCKETS)
+				return (size_t)micros;
+			unsigned int power = 0;
+			while ((micros >> power) >= 2 * SUB_BUCKETS)
+				power++;
+			// micros >> power is SUB_BUCKETS to 2 * SUB_BUCKETS - 1 now.
+			return (size_t)(power + 1) * SUB_BUCKETS + (size_t)((micros >> power) - SUB_BUCKETS);
+		}
+
+		static uint64_t UpperEdgeOf(size_t bucket)
+		{
+			if (bucket < SUB_BUCKETS)
+				return bucket;
+			unsigned int power = (unsigned int)(bucket / SUB_BUCKETS) - 1;
+			uint64_t lower = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << power;
+			return lower + ((uint64_t)1 << power) - 1;
+		}
+
+		std::vector<uint64_t> m_Buckets;
+		uint64_t m_Count;
+		uint64_t m_Sum;
+		uint64_t m_Min;
+		uint64_t m_Max;
+	};
+}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Titanium { namespace TIRA
+{
+	//
+	// Records how long the stages a message passes took, e.g. sending, parsing or decoding it. Every thread
+	// has a ring of its own, so recording takes no lock and overwrites the oldest events of the thread. The
+	// ring of a thread which ended goes to the next thread to record, until then its events are kept.
+	// Off by default, then a stage costs a relaxed load. The events kept by all threads are exported as a
+	// Chrome trace, which chrome://tracing and Perfetto open, or summarized as a histogram per stage.
+	//
+	class LatencyTrace
+	{
+	public:
+		static const unsigned int DEFAULT_EVENTS_PER_THREAD = 64 * 1024;
+
+		/// Starts recording, each thread keeps its latest eventsPerThread events, rounded up to a power of two.
+		/// The events recorded before are dropped.
+		static void Enable(unsigned int eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+		static void Disable();
+		static bool IsEnabled()
+		{
+			return s_Enabled.load(std::memory_order_relaxed);
+		}
+
+		/// Micro seconds on the monotonic clock the events are stamped with.
+		static uint64_t Now();
+		static uint64_t ToTraceTime(std::chrono::steady_clock::time_point time);
+		/// name must outlive the trace, e.g. a literal. id ties the stages of one message together.
+		static void Record(const char* name, uint64_t id, uint64_t start, uint64_t end);
+
+		/// The kept events as Chrome trace event format JSON.
+		static std::string ExportChromeTrace();
+		static bool WriteChromeTrace(const std::string& path);
+		/// A line of LatencyHistogram::Format per stage over the kept events.
+		static std::string FormatSummary();
+	private:
+		static std::atomic<bool> s_Enabled;
+	};
+
+	/// Records the time from construction to destruction as a stage when tracing is on.
+	class TraceScope
+	{
+	public:
+		explicit TraceScope(const char* name, uint64_t id = 0)
+			: m_Name(name), m_Id(id), m_IsTracing(LatencyTrace::IsEnabled()), m_Start(m_IsTracing ? LatencyTrace::Now() : 0)
+		{
+		}
+		~TraceScope()
+		{
+			if (m_IsTracing)
+				LatencyTrace::Record(m_Name, m_Id, m_Start, LatencyTrace::Now());
+		}
+		/// For an id only known once the stage is under way.
+		void SetId(uint64_t id)
+		{
+			m_Id = id;
+		}
+	private:
+		TraceScope(const TraceScope&);
+		TraceScope& operator=(const TraceScope&);
+
+		const char* m_Name;
+		uint64_t m_Id;
+		bool m_IsTracing;
+		uint64_t m_Start;
+	};
+}}
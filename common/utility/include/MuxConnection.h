@@ -0,0 +1,118 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "AsyncBase.h"
+#include "BufferPool.h"
+#include "ReadableSource.h"
+#include "WritableSource.h"
+#include "Socket.h"
+#include "noncopyable.h"
+
+#define MUX_MAX_FRAME_PAYLOAD (16 * 1024)        // bulk data is cut into frames of this size so input can get in between
+#define MUX_DEFAULT_WINDOW (256 * 1024)          // what the peer may send ahead on a stream before it is read
+#define MUX_SEND_QUEUE_LIMIT (256 * 1024)        // what a stream queues for sending before WriteBytes blocks
+#define MUX_PRIORITY_LEVELS 4                    // 0 is sent first
+
+namespace Titanium { namespace TIRA
+{
+	struct MuxCore;
+
+	//
+	// One logical stream of a MuxConnection, it is read and written like a socket. A stream only
+	// takes as much from the connection as its receive window allows, so a stream whose reader
+	// falls behind stalls its own sender and never the other streams.
+	//
+	class MuxStream : public ReadableSource, public WritableSource, public NonCopyable
+	{
+	public:
+		~MuxStream();
+
+		unsigned char GetId() const { return m_Id; }
+		unsigned int GetPriority() const { return m_Priority; }
+
+		virtual int ReadBytes(unsigned char* buffer, int bufLen);
+		/// Takes the next received chunk as it is instead of copying it, returns its length.
+		unsigned int ReadChunk(std::shared_ptr<unsigned char>& chunk);
+		virtual void CancelRead();
+		virtual bool IsSourceInError();
+
+		/// Waits until everything written so far has been taken by the sending thread.
+		virtual void WaitTillSourceIdeal();
+		virtual void WriteBytes(const unsigned char* buffer, int bufLen);
+		virtual void WriteBytesV(const ConstBuffer* buffers, int count);
+		virtual void Cancel();
+		virtual unsigned int GetQueuedBytes();
+
+	private:
+		friend class MuxConnection;
+		friend struct MuxCore;
+		struct Chunk
+		{
+			std::shared_ptr<unsigned char> data;
+			unsigned int offset;
+			unsigned int length;
+		};
+
+		MuxStream(std::shared_ptr<MuxCore> core, unsigned char id, unsigned int priority, unsigned int window);
+		void Consume(unsigned int length);
+		void QueueChunk(const Chunk& chunk);
+
+		std::shared_ptr<MuxCore> m_Core;
+		std::mutex m_WriteMtx;               //!< keeps the chunks of concurrent writes apart
+		const unsigned char m_Id;
+		const unsigned int m_Priority;
+		const unsigned int m_Window;
+
+		// guarded by the mutex of the core.
+		std::deque<Chunk> m_Received;
+		unsigned int m_Consumed;             //!< read but not yet given back to the peer
+		unsigned int m_Receivable;           //!< what the peer may still send before it is given more
+		bool m_ReadCancelled;
+		std::condition_variable m_Readable;
+
+		std::deque<Chunk> m_Outgoing;
+		unsigned int m_OutgoingBytes;
+		unsigned int m_Credit;               //!< what the peer is ready to take
+		bool m_WriteCancelled;
+		std::condition_variable m_Writable;
+	};
+
+	//
+	// Carries several streams over one socket. Data is sent in frames of at most MUX_MAX_FRAME_PAYLOAD
+	// bytes, the writer always picks the highest priority stream which has data and credit, streams
+	// of the same priority take turns. Credit comes from the peer in window updates once the reader
+	// of the stream has consumed half its window.
+	//
+	class MuxConnection : public AsyncBase, public NonCopyable
+	{
+	public:
+		explicit MuxConnection(std::shared_ptr<Socket> socket);
+		~MuxConnection();
+
+		/// Opens a stream before Start, the peer opens the same id. Data for ids which are not open is dropped
+		/// and its window given back, a peer which sends more than the window of a stream is disconnected.
+		std::shared_ptr<MuxStream> OpenStream(unsigned char id, unsigned int priority, unsigned int receiveWindow = MUX_DEFAULT_WINDOW);
+		void Start();
+		void Stop();
+		bool IsInError();
+
+	protected:
+		virtual void Workloop();
+		virtual void UnBlockWorkingThread();
+
+	private:
+		void WriterLoop();
+		void ReadFull(unsigned char* buffer, unsigned int length);
+		void Close();
+
+		std::shared_ptr<Socket> m_Socket;
+		std::shared_ptr<MuxCore> m_Core;
+		std::shared_ptr<BufferPool> m_ReceivingPool;
+		std::unique_ptr<std::thread> m_WriterThread;
+	};
+}
+}
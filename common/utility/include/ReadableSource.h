@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <type_traits>
 #include <vector>
 #include "error_handling_utility.h"
@@ -12,6 +13,12 @@ namespace Titanium { namespace TIRA
 		virtual int ReadBytes(unsigned char* buffer, int bufLen) = 0;
 		virtual void CancelRead() = 0;
 		virtual bool IsSourceInError() = 0;
+		/// Arms a one shot notification for when data can be read without blocking, false if the source can not tell.
+		virtual bool WatchReadable(std::function<void()> action) { return false; }
+		/// Drops the notification armed by WatchReadable, the action does not run after it returns.
+		virtual void UnwatchReadable() {}
+		/// Reads what is available without blocking, returns 0 if nothing is. Only valid when WatchReadable is supported.
+		virtual int TryReadBytes(unsigned char* buffer, int bufLen) { return ReadBytes(buffer, bufLen); }
 	public:
 		template<typename _Ty>
 		typename std::enable_if<std::is_pod<_Ty>::value, void>::type
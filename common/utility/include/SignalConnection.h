@@ -1,25 +1,19 @@
 #pragma once
-#include "any.h"
 #include "ScopeGuard.h"
-#include <map>
-#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
-#include <iterator>
 
 namespace Titanium { namespace TIRA
 {
 	struct ConnectionBase
 	{
-		ConnectionBase() {}
-		ConnectionBase(any iter, std::function<void(any)> fnDisconnect)
-			: m_iter(iter), m_fnDisconnect(fnDisconnect)
-		{
-		}
-
-		std::function<void(any)> m_fnDisconnect;
-		any                      m_iter;
+		virtual ~ConnectionBase() {}
+		virtual bool IsConnected() const = 0;
+		virtual void Disconnect() = 0;
 	};
 
 	class SignalConnection
@@ -32,19 +26,15 @@ namespace Titanium { namespace TIRA
 
 		bool connected() const
 		{
-			return m_conn && m_conn->m_fnDisconnect;
+			return m_conn && m_conn->IsConnected();
 		}
 
 		void disconnect()
 		{
-			if (!connected())
+			if (m_conn)
 			{
-				return;
+				m_conn->Disconnect();
 			}
-
-			auto fnDisconn = m_conn->m_fnDisconnect;
-			m_conn->m_fnDisconnect = nullptr;
-			fnDisconn(m_conn->m_iter);
 		}
 
 	private:
@@ -83,87 +73,207 @@ namespace Titanium { namespace TIRA
 	private:
 		std::unique_ptr<SignalConnection> m_conn;
 
-	private: // noncopyable 
+	private: // noncopyable
 		Scoped_connection(Scoped_connection const&);
 		Scoped_connection& operator=(Scoped_connection const&);
 	};
 
-	typedef std::pair<any, std::shared_ptr<ConnectionBase>> TSlot;
-	typedef std::multimap<int, TSlot>                       TSlotStorage;
-	typedef TSlotStorage::iterator                          TSlotIter;
-
-	class SlotManager
+	//
+	// Slots are kept as typed std::function objects (small callables are stored inline) in an immutable
+	// list. connect and disconnect build a new list under a mutex and publish it, an emission pins the
+	// current list with two atomic increments and walks it without locking or allocating. A slot
+	// disconnected while an emission is running is skipped by it, the list it is still in stays alive
+	// until the emission is done.
+	//
+	template <typename Sig>
+	class SignalBase
 	{
 	public:
-		SlotManager()
+		typedef std::function<Sig> TCallback;
+
+		SignalBase()
+			: m_core(std::make_shared<Core>())
 		{
 		}
+		~SignalBase()
+		{
+			m_core->DisconnectAll();
+		}
 
-		void disconnect(TSlotIter iter)
+		SignalConnection connect(std::function<Sig> callback)
 		{
-			m_storage.erase(iter);
+			auto slot = std::make_shared<Slot>(std::move(callback), m_core);
+			m_core->Insert(slot);
+			return SignalConnection(slot);
 		}
 
 		unsigned int size() const
 		{
-			return (unsigned int)m_storage.size();
+			SlotList* list = m_core->Pin();
+			unsigned int count = (unsigned int)list->slots.size();
+			Core::Unpin(list);
+			return count;
 		}
 
+	protected:
+		struct Core;
 
-		std::shared_ptr<ConnectionBase> insert(int key, any slot)
+		struct Slot : public ConnectionBase
 		{
-			auto conn = std::make_shared<ConnectionBase>();
-			auto iter = m_storage.insert(TSlotStorage::value_type(key, TSlot(slot, conn)));
-			conn->m_fnDisconnect = [=](any iter) { disconnect(any_cast<TSlotIter>(iter)); };
-			conn->m_iter = iter;
-			return conn;
-		}
+			Slot(TCallback&& callback, std::shared_ptr<Core> const& core)
+				: m_callback(std::move(callback)), m_core(core), m_connected(true)
+			{
+			}
+			bool IsConnected() const override
+			{
+				return m_connected.load(std::memory_order_acquire);
+			}
+			void Disconnect() override
+			{
+				if (!m_connected.exchange(false, std::memory_order_acq_rel))
+				{
+					return;
+				}
+				// the signal may be gone already, then there is no list to take the slot out of.
+				auto core = m_core.lock();
+				if (core)
+				{
+					core->Remove(this);
+				}
+			}
+
+			TCallback            m_callback;
+			std::weak_ptr<Core>  m_core;
+			std::atomic<bool>    m_connected;
+		};
 
-		void ForEach(std::function<void(any&)> func)
+		struct SlotList
 		{
-			// extra copy, so that the invocation chain can be finished even if the slot manager
-			// gets destroyed during		
-			std::vector<any> slots;
-			std::transform(m_storage.begin(), m_storage.end(), std::back_inserter(slots),
-				[](TSlotStorage::reference slot) { return slot.second.first; });
+			SlotList() : refs(1) {}
 
-			std::for_each(slots.begin(), slots.end(), [&](any& slot)
-			{
-				func(slot);
-			});
-		}
+			std::atomic<int>                   refs;
+			std::vector<std::shared_ptr<Slot>> slots;
+		};
 
-		void FIND_IF(std::function<bool(any&)> func)
+		struct Core
 		{
-			std::vector<any> slots;
-			std::transform(m_storage.begin(), m_storage.end(), std::back_inserter(slots),
-				[](TSlotStorage::reference slot) { return slot.second.first; });
+			Core()
+				: m_list(new SlotList()), m_pinning(0)
+			{
+			}
+			~Core()
+			{
+				Unpin(m_list.load(std::memory_order_relaxed));
+			}
 
-			std::find_if(slots.begin(), slots.end(), [&](any& slot)
+			/// Takes a reference to the current list, never blocks and never allocates.
+			SlotList* Pin()
 			{
-				return func(slot);
-			});
-		}
+				// a writer swapping the list waits for m_pinning to drop, so the list read here can not be
+				// released between loading it and raising its reference count.
+				m_pinning.fetch_add(1, std::memory_order_seq_cst);
+				SlotList* list = m_list.load(std::memory_order_seq_cst);
+				list->refs.fetch_add(1, std::memory_order_relaxed);
+				m_pinning.fetch_sub(1, std::memory_order_release);
+				return list;
+			}
+			static void Unpin(SlotList* list)
+			{
+				if (list->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete list;
+				}
+			}
 
-		~SlotManager()
-		{
-			std::for_each(m_storage.begin(), m_storage.end(), [&](TSlotStorage::reference& slot)
+			void Insert(std::shared_ptr<Slot> const& slot)
 			{
-				slot.second.second->m_fnDisconnect = nullptr;
-			});
-		}
-	protected:
-		TSlotStorage m_storage;
-	};
-	
-	template <typename Sig>
-	class SignalBase : public SlotManager
-	{
-	public:
-		SignalConnection connect(std::function<Sig> callback)
+				std::lock_guard<std::mutex> lock(m_writeMtx);
+				SlotList* list = new SlotList();
+				list->slots.reserve(Current()->slots.size() + 1);
+				list->slots = Current()->slots;
+				list->slots.push_back(slot);
+				Publish(list);
+			}
+			void Remove(Slot* slot)
+			{
+				std::lock_guard<std::mutex> lock(m_writeMtx);
+				SlotList* list = new SlotList();
+				list->slots.reserve(Current()->slots.size());
+				for (auto it = Current()->slots.begin(); it != Current()->slots.end(); ++it)
+				{
+					if (it->get() != slot)
+					{
+						list->slots.push_back(*it);
+					}
+				}
+				Publish(list);
+			}
+			void DisconnectAll()
+			{
+				std::lock_guard<std::mutex> lock(m_writeMtx);
+				for (auto it = Current()->slots.begin(); it != Current()->slots.end(); ++it)
+				{
+					(*it)->m_connected.store(false, std::memory_order_release);
+				}
+				Publish(new SlotList());
+			}
+
+		private:
+			SlotList* Current() const
+			{
+				return m_list.load(std::memory_order_relaxed);
+			}
+			void Publish(SlotList* list)
+			{
+				SlotList* old = m_list.exchange(list, std::memory_order_seq_cst);
+				while (m_pinning.load(std::memory_order_acquire) != 0)
+				{
+					std::this_thread::yield();
+				}
+				Unpin(old);
+			}
+
+			std::atomic<SlotList*> m_list;
+			std::atomic<int>       m_pinning;
+			std::mutex             m_writeMtx;
+		};
+
+		// Keeps the pinned list alive for one emission, the slots stay valid even if the signal gets
+		// destroyed by one of them.
+		class Emission
 		{
-			return SignalConnection(insert(-1, callback));
-		}
+		public:
+			explicit Emission(SignalBase& signal)
+				: m_list(signal.m_core->Pin())
+			{
+			}
+			~Emission()
+			{
+				Core::Unpin(m_list);
+			}
+			template <typename Fn>
+			void ForEach(Fn fn)
+			{
+				for (auto it = m_list->slots.begin(); it != m_list->slots.end(); ++it)
+				{
+					if ((*it)->m_connected.load(std::memory_order_acquire))
+					{
+						fn((*it)->m_callback);
+					}
+				}
+			}
+		private:
+			SlotList* m_list;
+			Emission(Emission const&);
+			Emission& operator=(Emission const&);
+		};
+
+	private:
+		std::shared_ptr<Core> m_core;
+
+	private: // noncopyable
+		SignalBase(SignalBase const&);
+		SignalBase& operator=(SignalBase const&);
 	};
 
 	template <typename S>
@@ -175,10 +285,10 @@ namespace Titanium { namespace TIRA
 	public:
 		void operator()()
 		{
-			typedef std::function<void()> TCallback;
-			this->ForEach([&](any& slot)
+			Emission emission(*this);
+			emission.ForEach([&](TCallback& slot)
 			{
-				any_cast<TCallback&>(slot)();
+				slot();
 			});
 		}
 	};
@@ -189,10 +299,11 @@ namespace Titanium { namespace TIRA
 	public:
 		void operator()(T1 a1)
 		{
-			typedef std::function<void(T1)> TCallback;
-			this->ForEach([&](any& slot)
+			typedef typename SignalBase<void(T1)>::TCallback TCallback;
+			typename SignalBase<void(T1)>::Emission emission(*this);
+			emission.ForEach([&](TCallback& slot)
 			{
-				any_cast<TCallback&>(slot)(a1);
+				slot(a1);
 			});
 		}
 	};
@@ -203,10 +314,11 @@ namespace Titanium { namespace TIRA
 	public:
 		void operator()(T1 a1, T2 a2)
 		{
-			typedef std::function<void(T1, T2)> TCallback;
-			this->ForEach([&](any& slot)
+			typedef typename SignalBase<void(T1, T2)>::TCallback TCallback;
+			typename SignalBase<void(T1, T2)>::Emission emission(*this);
+			emission.ForEach([&](TCallback& slot)
 			{
-				any_cast<TCallback&>(slot)(a1, a2);
+				slot(a1, a2);
 			});
 		}
 	};
@@ -217,10 +329,11 @@ namespace Titanium { namespace TIRA
 	public:
 		void operator()(T1 a1, T2 a2, T3 a3)
 		{
-			typedef std::function<void(T1, T2, T3)> TCallback;
-			this->ForEach([&](any& slot)
+			typedef typename SignalBase<void(T1, T2, T3)>::TCallback TCallback;
+			typename SignalBase<void(T1, T2, T3)>::Emission emission(*this);
+			emission.ForEach([&](TCallback& slot)
 			{
-				any_cast<TCallback&>(slot)(a1, a2, a3);
+				slot(a1, a2, a3);
 			});
 		}
 	};
@@ -231,10 +344,11 @@ namespace Titanium { namespace TIRA
 	public:
 		void operator()(T1 a1, T2 a2, T3 a3, T4 a4)
 		{
-			typedef std::function<void(T1, T2, T3, T4)> TCallback;
-			this->ForEach([&](any& slot)
+			typedef typename SignalBase<void(T1, T2, T3, T4)>::TCallback TCallback;
+			typename SignalBase<void(T1, T2, T3, T4)>::Emission emission(*this);
+			emission.ForEach([&](TCallback& slot)
 			{
-				any_cast<TCallback&>(slot)(a1, a2, a3, a4);
+				slot(a1, a2, a3, a4);
 			});
 		}
 	};
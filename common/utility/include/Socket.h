@@ -1,13 +1,19 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 #include "SmartHandle.h"
+#include "networkdefs.h"
+#include "waitable_event.h"
 #ifdef __GNUC__
 #include <netinet/in.h>
 #endif
 namespace Titanium { namespace TIRA
 {
+	class EventLoop;
+
 	class InetAddress
 	{
 	public:
@@ -72,10 +78,14 @@ namespace Titanium { namespace TIRA
 		virtual void GetSocketOption(int level, int optName, socklen_t* optVal);
 
 		virtual int Send(const unsigned char* buffer, int bufLen);
+		/// Sends all the buffers in order with gathered writes, returns after every byte is sent.
+		virtual int SendV(const ConstBuffer* buffers, int count);
 		virtual int SendTo(const InetAddress& pDest, const char* data, int len);
 		virtual void CancelSend();
 
 		virtual int Recv(unsigned char* buffer, int bufLen);
+		/// Reads what is available without waiting, returns 0 if nothing is.
+		virtual int TryRecv(unsigned char* buffer, int bufLen);
 		virtual int ReceiveFrom(unsigned char* data, int len, InetAddress* pSrc);
 		virtual void CancelRecv();
 
@@ -83,10 +93,20 @@ namespace Titanium { namespace TIRA
 		virtual bool IsAlive();
 		virtual bool IsError();
 		virtual void GetPeerAddress(InetAddress* address);
+
+		/// Waits for readiness on the loop instead of polling with select, call it before the socket is used.
+		void AttachEventLoop(std::shared_ptr<EventLoop> loop);
+		/// Runs the action once on the attached loop thread when data arrives, for readers which do not block a thread.
+		/// It shares the read watch with Recv, so a socket is read either this way or by blocking calls.
+		void WatchReadable(std::function<void()> action);
+		/// Drops the read watch, no action armed by WatchReadable runs after it returns.
+		void UnwatchReadable();
+		bool IsEventLoopAttached();
 	protected:
 		void WaitForReadReady();
 		void WaitForWriteReady();
 		int CheckSocketReturn(int result);
+		int SendVInternal(const ConstBuffer* buffers, int count, unsigned int offset);
 
 		SmartHandle<SOCKET> _sockfd;
 	private:
@@ -94,7 +114,11 @@ namespace Titanium { namespace TIRA
 		std::atomic<bool>		m_IsError;
 		std::atomic<bool>		m_IsCancelRead;
 		std::atomic<bool>		m_IsCancelWrite;
+		std::shared_ptr<EventLoop>	m_EventLoop;
+		auto_reset_event		m_ReadReadyEvent;
+		auto_reset_event		m_WriteReadyEvent;
 		static const int WAITING_TIME = 500;
+		static const int MAX_SENDV_BUFFERS = 16;
 	};
 }
 }
@@ -4,6 +4,16 @@
 
 namespace Titanium { namespace TIRA
 {
+	/// What the kernel measured on a connection.
+	struct TcpInfo
+	{
+		unsigned int rttMicros;              //!< smoothed round trip time
+		unsigned int retransmits;            //!< since the connection was opened
+		unsigned long long bytesSent;
+		unsigned long long bytesRetransmitted;
+		unsigned int congestionWindowBytes;  //!< what may be in flight unacknowledged, 0 if unknown
+	};
+
 	class SocketTcp : public Socket
 	{
 		friend class SocketTcpServer;
@@ -12,6 +22,8 @@ namespace Titanium { namespace TIRA
 		int SetRecvBufferSize(socklen_t buffsz = SOCKET_TCP_MAX_BUF_SIZE);
 		int SetSendBufferSize(socklen_t buffsz = SOCKET_TCP_MAX_BUF_SIZE);
 		void SetTcpNoDelay(bool yes);
+		/// Returns false when the system does not report it, e.g. Windows before 10 1703.
+		bool GetTcpInfo(TcpInfo& info);
 	private:
 		SocketTcp(SmartHandle<SOCKET> sockfd);
 		static const unsigned int SOCKET_TCP_STANDARD_BUF_SIZE = (8 * 1024);
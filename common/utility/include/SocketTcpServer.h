@@ -14,10 +14,18 @@ namespace Titanium { namespace TIRA
 		void StopListening();
 		unsigned GetListeningPort();
 		std::shared_ptr<SocketTcp> WaitForConnection();
+
+		/// Accepts on the loop instead of blocking, the accepted sockets are attached to the same loop.
+		void AttachEventLoop(std::shared_ptr<EventLoop> loop);
+		/// Runs the action once on the loop thread when a connection is pending.
+		void WatchConnection(std::function<void()> action);
+		/// Returns nullptr if no connection is pending.
+		std::shared_ptr<SocketTcp> TryAcceptConnection();
 	private:
 		SmartHandle<SOCKET>  m_Sockfd;
 		unsigned int m_Connections;
 		std::atomic<bool> m_AlreadyShutdown;
+		std::shared_ptr<EventLoop> m_EventLoop;
 	};
 }
 }
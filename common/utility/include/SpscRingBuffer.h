@@ -0,0 +1,262 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "error_handling_utility.h"
+#include "ScopeGuard.h"
+
+#ifndef MIN
+#define MIN(a,b)            (((a) < (b)) ? (a) : (b))
+#endif
+
+namespace Titanium { namespace TIRA
+{
+	//
+	// Lock free ring buffer for exactly one writing thread and one reading thread.
+	// The positions are free running counters, the capacity is rounded up to a power of two so
+	// wrapping is a mask instead of a modulo. The mutex is only touched when one side has to park
+	// because the ring is full or empty, the cancel semantics are the same as WaitingBuffer.
+	//
+	template<typename value_type>
+	class SpscRingBuffer
+	{
+	public:
+		SpscRingBuffer(unsigned int size)
+			: m_Size(RoundUpPowerOfTwo(size))
+			, m_Mask(RoundUpPowerOfTwo(size) - 1)
+			, m_ReadPos(0)
+			, m_WritePos(0)
+			, m_IsReaderParked(false)
+			, m_IsWriterParked(false)
+			, m_IsWaiterParked(false)
+			, m_IsCancelRead(false)
+			, m_IsCancelWait(false)
+			, m_IsCancelWrite(false)
+		{
+			m_Buffer.reset(new value_type[m_Size]);
+		}
+		virtual ~SpscRingBuffer()
+		{
+			CancelAllOperation();
+		}
+
+	public:
+		//
+		// writer side
+		//
+		/// Returns the contiguous free space at the write position without blocking, may be less than the total free space.
+		unsigned int GetWritableSpan(value_type** ppData)
+		{
+			unsigned int writePos = m_WritePos.load(std::memory_order_relaxed);
+			unsigned int freeLen = m_Size - (writePos - m_ReadPos.load(std::memory_order_acquire));
+			unsigned int offset = writePos & m_Mask;
+			*ppData = m_Buffer.get() + offset;
+			return MIN(freeLen, m_Size - offset);
+		}
+		/// Publishes len elements written into the span returned by GetWritableSpan.
+		void CommitWrite(unsigned int len)
+		{
+			m_WritePos.store(m_WritePos.load(std::memory_order_relaxed) + len, std::memory_order_seq_cst);
+			if (m_IsReaderParked.load(std::memory_order_seq_cst))
+			{
+				std::lock_guard<std::mutex> lock(m_ParkMtx);
+				m_ReadCV.notify_all();
+			}
+		}
+		void WriteTillFinish(const value_type* buffer, unsigned int len)
+		{
+			ON_SCOPE_EXIT([&]()
+			{
+				m_IsCancelWrite = false;
+			});
+			while (len > 0)
+			{
+				if (m_IsCancelWrite)
+					throw ExceptionWithString("Writing is Canceled!");
+
+				value_type* pSpan = nullptr;
+				unsigned int spanLen = GetWritableSpan(&pSpan);
+				if (spanLen > 0)
+				{
+					unsigned int writenLen = MIN(spanLen, len);
+					memcpy(pSpan, buffer, writenLen * sizeof(value_type));
+					CommitWrite(writenLen);
+					buffer += writenLen;
+					len -= writenLen;
+				}
+				else
+				{
+					Park(m_IsWriterParked, m_WriteCV, [&]() { return m_IsCancelWrite || DataLen() < m_Size; });
+				}
+			}
+		}
+		/// May be called from another thread than the writer, it is woken apart from a blocked WriteTillFinish.
+		void WaitTillBufferEmpty()
+		{
+			ON_SCOPE_EXIT([&]()
+			{
+				m_IsCancelWait = false;
+			});
+			while (DataLen() > 0 && !m_IsCancelWait)
+			{
+				Park(m_IsWaiterParked, m_EmptyCV, [&]() { return m_IsCancelWait || DataLen() == 0; });
+			}
+			if (m_IsCancelWait)
+				throw ExceptionWithString("SpscRingBuffer has been canceled.");
+		}
+
+		//
+		// reader side
+		//
+		/// Waits till at least atless elements are buffered, returns the contiguous readable span at the read position.
+		/// The span is capped by maxLen and may be shorter than atless when the data wraps around the end of the ring.
+		unsigned int WaitForReadableSpan(const value_type** ppData, unsigned int maxLen, unsigned int atless)
+		{
+			ON_SCOPE_EXIT([&]()
+			{
+				m_IsCancelRead = false;
+			});
+			atless = MIN(MIN(atless, maxLen), m_Size);
+			while (true)
+			{
+				if (m_IsCancelRead)
+					throw ExceptionWithString("SpscRingBuffer: Reading is canceled!");
+
+				unsigned int spanLen = GetReadableSpan(ppData);
+				if (spanLen > 0 && (spanLen >= atless || DataLen() >= atless))
+					return MIN(spanLen, maxLen);
+
+				Park(m_IsReaderParked, m_ReadCV, [&]() { return m_IsCancelRead || (DataLen() > 0 && DataLen() >= atless); });
+			}
+		}
+		/// Returns the contiguous readable span at the read position without blocking.
+		unsigned int GetReadableSpan(const value_type** ppData)
+		{
+			unsigned int readPos = m_ReadPos.load(std::memory_order_relaxed);
+			unsigned int dataLen = m_WritePos.load(std::memory_order_acquire) - readPos;
+			unsigned int offset = readPos & m_Mask;
+			*ppData = m_Buffer.get() + offset;
+			return MIN(dataLen, m_Size - offset);
+		}
+		/// Releases len elements of the span returned by GetReadableSpan or WaitForReadableSpan back to the writer.
+		void CommitRead(unsigned int len)
+		{
+			m_ReadPos.store(m_ReadPos.load(std::memory_order_relaxed) + len, std::memory_order_seq_cst);
+			if (m_IsWriterParked.load(std::memory_order_seq_cst))
+			{
+				std::lock_guard<std::mutex> lock(m_ParkMtx);
+				m_WriteCV.notify_all();
+			}
+			if (m_IsWaiterParked.load(std::memory_order_seq_cst))
+			{
+				std::lock_guard<std::mutex> lock(m_ParkMtx);
+				m_EmptyCV.notify_all();
+			}
+		}
+		void ReadTilFinish(value_type* buffer, unsigned int len)
+		{
+			ReadAtless(buffer, len, len);
+		}
+		unsigned int ReadAtless(value_type* buffer, unsigned int len, unsigned int atless)
+		{
+			unsigned int readCount = 0;
+			while (atless > readCount)
+			{
+				const value_type* pSpan = nullptr;
+				unsigned int readLen = WaitForReadableSpan(&pSpan, len, 1);
+				memcpy(buffer, pSpan, readLen * sizeof(value_type));
+				CommitRead(readLen);
+				buffer += readLen;
+				readCount += readLen;
+				len -= readLen;
+			}
+			return readCount;
+		}
+
+		//
+		// either side
+		//
+		void CancelAllOperation()
+		{
+			CancelRead();
+			CancelWrite();
+			CancelWait();
+		}
+		void CancelRead()
+		{
+			std::lock_guard<std::mutex> lock(m_ParkMtx);
+			m_IsCancelRead = true;
+			m_ReadCV.notify_all();
+		}
+		void CancelWrite()
+		{
+			std::lock_guard<std::mutex> lock(m_ParkMtx);
+			m_IsCancelWrite = true;
+			m_WriteCV.notify_all();
+		}
+		void CancelWait()
+		{
+			std::lock_guard<std::mutex> lock(m_ParkMtx);
+			m_IsCancelWait = true;
+			m_EmptyCV.notify_all();
+		}
+		unsigned int DataLen() const
+		{
+			return m_WritePos.load(std::memory_order_acquire) - m_ReadPos.load(std::memory_order_acquire);
+		}
+		unsigned int Capacity() const
+		{
+			return m_Size;
+		}
+
+	private:
+		// the parked flag is raised before the condition is checked again under the mutex, and the other side
+		// reads the flag after publishing its position, so a wakeup can not fall between the check and the wait.
+		// Every kind of wait has a flag and a condition of its own, one finishing never hides another still parked.
+		template<typename Pred>
+		void Park(std::atomic<bool>& isParked, std::condition_variable& cv, Pred canWake)
+		{
+			std::unique_lock<std::mutex> lock(m_ParkMtx);
+			isParked.store(true, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ON_SCOPE_EXIT([&]()
+			{
+				isParked.store(false, std::memory_order_relaxed);
+			});
+			cv.wait(lock, canWake);
+		}
+		static unsigned int RoundUpPowerOfTwo(unsigned int size)
+		{
+			unsigned int result = 1;
+			while (result < size)
+				result <<= 1;
+			return result;
+		}
+
+	private:
+		static const unsigned int CACHE_LINE_SIZE = 64;
+		std::unique_ptr<value_type[]> m_Buffer;
+		const unsigned int m_Size;
+		const unsigned int m_Mask;
+
+		// the positions are written by one side each, keep them on separate cache lines.
+		char m_Padding0[CACHE_LINE_SIZE];
+		std::atomic<unsigned int> m_ReadPos;
+		char m_Padding1[CACHE_LINE_SIZE];
+		std::atomic<unsigned int> m_WritePos;
+		char m_Padding2[CACHE_LINE_SIZE];
+
+		std::atomic<bool> m_IsReaderParked;
+		std::atomic<bool> m_IsWriterParked;
+		std::atomic<bool> m_IsWaiterParked;  //!< WaitTillBufferEmpty, which may run beside a parked writer
+		std::mutex m_ParkMtx;
+		std::condition_variable m_ReadCV;
+		std::condition_variable m_WriteCV;
+		std::condition_variable m_EmptyCV;
+		std::atomic<bool> m_IsCancelRead;
+		std::atomic<bool> m_IsCancelWait;
+		std::atomic<bool> m_IsCancelWrite;
+	};
+}
+}
@@ -11,6 +11,8 @@ namespace Titanium
 		typedef std::function<void(std::shared_ptr<TIRA::SocketTcp>)> OnConnectionAcceptedAction;
 	public:
 		TcpListener(unsigned int port);
+		/// Accepts on the loop instead of an own thread, the accepted sockets are attached to the loop.
+		TcpListener(unsigned int port, std::shared_ptr<TIRA::EventLoop> loop);
 		~TcpListener(void);
 	public:
 		TIRA::SignalConnection RegisterConnectionAcceptedEvent(OnConnectionAcceptedAction action);
@@ -20,11 +22,14 @@ namespace Titanium
 	protected:
 		virtual void Workloop();
 		virtual void UnBlockWorkingThread();
+	private:
+		void OnConnectionPending();
 	private:
 		std::shared_ptr<TIRA::SocketTcpServer> m_pServer;
 		TIRA::Signal<void(std::shared_ptr<TIRA::SocketTcp>)> m_SigConnected;
 
 		unsigned int m_Port;
+		std::shared_ptr<TIRA::EventLoop> m_EventLoop;
 	};
 }
 
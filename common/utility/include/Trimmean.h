@@ -1,6 +1,7 @@
 #pragma once
 #include <list>
 #include <algorithm>
+#include <mutex>
 
 namespace Titanium { namespace TIRA
 {
@@ -38,6 +39,13 @@ namespace Titanium { namespace TIRA
 			m_List.push_back(val);
 		}
 
+		/// Starts over as if all the samples were val.
+		void Fill(T val)
+		{
+			std::lock_guard<std::mutex> lock(m_Mtx);
+			std::fill(m_List.begin(), m_List.end(), val);
+		}
+
 	private:
 		std::list<T> m_List;
 		std::mutex m_Mtx;
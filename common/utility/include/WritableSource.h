@@ -3,6 +3,7 @@
 #include <vector>
 #include <algorithm>
 #include "rectdefs.h"
+#include "networkdefs.h"
 
 namespace Titanium { namespace TIRA
 {
@@ -13,6 +14,20 @@ namespace Titanium { namespace TIRA
 		virtual void WriteBytes(const unsigned char* buffer, int bufLen) = 0;
 		virtual void Cancel() = 0;
 		virtual bool IsSourceInError() = 0;
+		/// Writes several buffers in order as one unit, sources which support gathered writes should override it.
+		virtual void WriteBytesV(const ConstBuffer* buffers, int count)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				if (buffers[i].length > 0)
+					WriteBytes(buffers[i].data, buffers[i].length);
+			}
+		}
+		/// Bytes written but not yet handed on, sources which queue the writes should override it.
+		virtual unsigned int GetQueuedBytes()
+		{
+			return 0;
+		}
 	public:
 		template<typename _Ty>
 		inline void Write(const _Ty &val)
@@ -9,5 +9,12 @@ namespace Titanium { namespace TIRA
 		TLT,
 		RTP,
 	}TransmissionMethod;
+
+	/// Describes one piece of a gathered write, the memory is owned by the caller.
+	struct ConstBuffer
+	{
+		const unsigned char* data;
+		unsigned int length;
+	};
 }
 }
@@ -13,7 +13,14 @@ void WritableSocket::Cancel()
 
 void WritableSocket::WriteBytes(unsigned const char* buffer, int bufLen)
 {
-	m_Socket->Send(buffer, bufLen);
+	// Send may return after a partial write on the non-blocking socket.
+	ConstBuffer buf = { buffer, (unsigned int)bufLen };
+	m_Socket->SendV(&buf, 1);
+}
+
+void WritableSocket::WriteBytesV(const ConstBuffer* buffers, int count)
+{
+	m_Socket->SendV(buffers, count);
 }
 
 void WritableSocket::WaitTillSourceIdeal()
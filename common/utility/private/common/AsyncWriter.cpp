@@ -8,7 +8,6 @@ AsyncWriter::AsyncWriter(std::shared_ptr<WritableSource> source, unsigned int bu
 	, m_MinSize(minPkgSize)
 	, m_Buffer(bufferSize)
 {
-	m_TempBuffer.reset(new unsigned char[m_MaxSize]);
 	StartAsyncBase();
 }
 
@@ -21,13 +20,17 @@ void AsyncWriter::Workloop()
 {
 	while (CanLoopContinue())
 	{
-		unsigned int readCount = m_Buffer.ReadAtless(
-			m_TempBuffer.get(),
+		const unsigned char* pData = nullptr;
+		unsigned int readCount = m_Buffer.WaitForReadableSpan(
+			&pData,
 			m_MaxSize,
 			m_MinSize);
 		if (readCount > 0)
 		{
-			m_Source->WriteBytes(m_TempBuffer.get(), readCount);
+			// the ring memory is handed to the source directly, and only released once it is written,
+			// so an empty ring also means nothing is left in flight.
+			m_Source->WriteBytes(pData, readCount);
+			m_Buffer.CommitRead(readCount);
 		}
 	}
 }
@@ -56,6 +59,19 @@ void AsyncWriter::WriteBytes(unsigned const char* buffer, int len)
 	m_Buffer.WriteTillFinish(buffer, len);
 }
 
+void AsyncWriter::WriteBytesV(const ConstBuffer* buffers, int count)
+{
+	ENSURE(IsAsyncBaseRunning())("Current Writer is not running, it may have either been Closed or encounted error!")(m_status);
+	// the queued bytes must leave first, otherwise the frame would overtake them on the wire.
+	WaitTillSourceIdeal();
+	m_Source->WriteBytesV(buffers, count);
+}
+
+unsigned int AsyncWriter::GetQueuedBytes()
+{
+	return m_Buffer.DataLen();
+}
+
 void AsyncWriter::WaitTillSourceIdeal()
 {
 	m_Buffer.WaitTillBufferEmpty();
@@ -24,8 +24,37 @@ void AutoReader::Workloop()
 	}
 }
 
+void AutoReader::OnSourceReadable()
+{
+	if (m_IsClosed)
+		return;
+	try
+	{
+		for (int i = 0; i < MAX_READS_PER_EVENT; i++)
+		{
+			int readCount = m_Source->TryReadBytes(m_InternalBuffer.get(), AUTOREADER_BUF_SIZE);
+			if (readCount <= 0)
+				break;
+			OnDataReaded(m_InternalBuffer.get(), readCount);
+		}
+		if (!m_IsClosed)
+			m_Source->WatchReadable([this]() { OnSourceReadable(); });
+	}
+	catch (ExceptionWithString &e)
+	{
+		TRACE("AutoReader: %s\n", e.what());
+		m_status = Status_Error;
+	}
+}
+
 void AutoReader::Close()
 {
+	if (m_IsWatchingSource)
+	{
+		m_IsClosed = true;
+		m_Source->UnwatchReadable();
+		return;
+	}
 	StopAsyncBase();
 }
 
@@ -47,7 +76,11 @@ AutoReader::~AutoReader()
 AutoReader::AutoReader(std::shared_ptr<ReadableSource> source)
 	: AsyncBase("AutoReader")
 	, m_Source(source)
+	, m_IsWatchingSource(false)
+	, m_IsClosed(false)
 {
 	m_InternalBuffer.reset(new unsigned char[AUTOREADER_BUF_SIZE]);
-	StartAsyncBase();
+	m_IsWatchingSource = m_Source->WatchReadable([this]() { OnSourceReadable(); });
+	if (!m_IsWatchingSource)
+		StartAsyncBase();
 }
\ No newline at end of file
@@ -16,6 +16,24 @@ int ReadableSocket::ReadBytes(unsigned char* buffer, int bufLen)
 	return m_Socket->Recv(buffer, bufLen);
 }
 
+bool ReadableSocket::WatchReadable(std::function<void()> action)
+{
+	if (!m_Socket->IsEventLoopAttached())
+		return false;
+	m_Socket->WatchReadable(action);
+	return true;
+}
+
+void ReadableSocket::UnwatchReadable()
+{
+	m_Socket->UnwatchReadable();
+}
+
+int ReadableSocket::TryReadBytes(unsigned char* buffer, int bufLen)
+{
+	return m_Socket->TryRecv(buffer, bufLen);
+}
+
 ReadableSocket::ReadableSocket(std::shared_ptr<Socket> socket):
 m_Socket(socket)
 {
@@ -0,0 +1,327 @@
+#include "EventLoop.h"
+#ifdef __GNUC__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+using namespace Titanium::TIRA;
+
+EventLoop::WatchEntry::WatchEntry()
+	: isRegistered(false)
+#ifndef __GNUC__
+	, loop(nullptr)
+	, sockfd(INVALID_SOCKET)
+	, event(NULL)
+	, waitHandle(NULL)
+#endif
+{
+}
+
+std::shared_ptr<EventLoop> EventLoop::GetDefault()
+{
+	static std::shared_ptr<EventLoop> defaultLoop;
+	static std::mutex defaultMtx;
+
+	std::lock_guard<std::mutex> lock(defaultMtx);
+	if (!defaultLoop)
+	{
+		defaultLoop = std::make_shared<EventLoop>("DefaultEventLoop");
+		defaultLoop->Start();
+	}
+	return defaultLoop;
+}
+
+EventLoop::EventLoop(const std::string& name)
+	: AsyncBase(name)
+{
+#ifdef __GNUC__
+	m_PollFd = epoll_create1(EPOLL_CLOEXEC);
+	ENSURE(m_PollFd >= 0)(errno);
+	m_WakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ENSURE(m_WakeupFd >= 0)(errno);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = m_WakeupFd;
+	ENSURE(0 == epoll_ctl(m_PollFd, EPOLL_CTL_ADD, m_WakeupFd, &ev))(errno);
+#else
+	m_CompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	ENSURE_WIN32(m_CompletionPort != NULL);
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+	MuteAllExceptions([&]() { Stop(); });
+
+	std::lock_guard<std::recursive_mutex> lock(m_WatchMtx);
+	for (auto it = m_Watches.begin(); it != m_Watches.end(); ++it)
+	{
+		Disarm(it->first, it->second);
+	}
+	m_Watches.clear();
+#ifdef __GNUC__
+	close(m_WakeupFd);
+	close(m_PollFd);
+#else
+	CloseHandle(m_CompletionPort);
+#endif
+}
+
+void EventLoop::Start()
+{
+	StartAsyncBase();
+}
+
+void EventLoop::Stop()
+{
+	StopAsyncBase();
+}
+
+bool EventLoop::IsInLoopThread()
+{
+	return std::this_thread::get_id() == m_LoopThreadId;
+}
+
+void EventLoop::Watch(SOCKET sockfd, EventType type, OnReadyAction action)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_WatchMtx);
+	WatchEntry& entry = m_Watches[sockfd];
+	if (type == EVENT_READ)
+		entry.readAction = action;
+	else
+		entry.writeAction = action;
+	Arm(sockfd, entry);
+}
+
+void EventLoop::Unwatch(SOCKET sockfd, int events)
+{
+	// an action in progress holds the mutex, so once it is taken here no action of the socket is running.
+	std::lock_guard<std::recursive_mutex> lock(m_WatchMtx);
+	auto it = m_Watches.find(sockfd);
+	if (it == m_Watches.end())
+		return;
+
+	WatchEntry& entry = it->second;
+	if (events & EVENT_READ)
+		entry.readAction = nullptr;
+	if (events & EVENT_WRITE)
+		entry.writeAction = nullptr;
+	if (entry.readAction || entry.writeAction)
+	{
+		Arm(sockfd, entry);
+		return;
+	}
+	Disarm(sockfd, entry);
+	m_Watches.erase(it);
+}
+
+void EventLoop::Dispatch(SOCKET sockfd, int events)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_WatchMtx);
+	auto it = m_Watches.find(sockfd);
+	if (it == m_Watches.end())
+		return;
+
+	WatchEntry& entry = it->second;
+	OnReadyAction readAction;
+	OnReadyAction writeAction;
+	if (events & EVENT_READ)
+		readAction.swap(entry.readAction);
+	if (events & EVENT_WRITE)
+		writeAction.swap(entry.writeAction);
+
+	// the watch is one shot, keep the direction which did not fire armed.
+	if (entry.readAction || entry.writeAction)
+		Arm(sockfd, entry);
+
+	if (readAction)
+		MuteAllExceptions([&]() { readAction(EVENT_READ); }, "EventLoop read action");
+	// the read action may have dropped the watch.
+	if (writeAction && m_Watches.find(sockfd) != m_Watches.end())
+		MuteAllExceptions([&]() { writeAction(EVENT_WRITE); }, "EventLoop write action");
+}
+
+void EventLoop::Workloop()
+{
+	m_LoopThreadId = std::this_thread::get_id();
+	while (CanLoopContinue())
+	{
+		WaitEvents();
+	}
+}
+
+void EventLoop::UnBlockWorkingThread()
+{
+	Wakeup();
+}
+
+#ifdef __GNUC__
+
+void EventLoop::Arm(SOCKET sockfd, WatchEntry& entry)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLONESHOT;
+	if (entry.readAction)
+		ev.events |= EPOLLIN | EPOLLRDHUP;
+	if (entry.writeAction)
+		ev.events |= EPOLLOUT;
+	ev.data.fd = sockfd;
+
+	int op = entry.isRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	ENSURE(0 == epoll_ctl(m_PollFd, op, sockfd, &ev))(errno);
+	entry.isRegistered = true;
+}
+
+void EventLoop::Disarm(SOCKET sockfd, WatchEntry& entry)
+{
+	if (entry.isRegistered)
+	{
+		// the socket may already be closed, in which case the kernel has dropped it by itself.
+		epoll_ctl(m_PollFd, EPOLL_CTL_DEL, sockfd, nullptr);
+		entry.isRegistered = false;
+	}
+}
+
+void EventLoop::Wakeup()
+{
+	uint64_t one = 1;
+	ssize_t written = write(m_WakeupFd, &one, sizeof(one));
+	(void)written;
+}
+
+void EventLoop::WaitEvents()
+{
+	struct epoll_event events[MAX_EVENTS_PER_WAIT];
+	int count = epoll_wait(m_PollFd, events, MAX_EVENTS_PER_WAIT, -1);
+	if (count < 0)
+	{
+		ENSURE(EINTR == errno)(errno);
+		return;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (events[i].data.fd == m_WakeupFd)
+		{
+			uint64_t value = 0;
+			ssize_t readCount = read(m_WakeupFd, &value, sizeof(value));
+			(void)readCount;
+			continue;
+		}
+
+		int ready = 0;
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			ready |= EVENT_READ;
+		if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			ready |= EVENT_WRITE;
+		Dispatch(events[i].data.fd, ready);
+	}
+}
+
+#else
+
+// the socket state is reported by WSAEventSelect on a per-socket event, a one shot thread pool wait on that
+// event forwards it to the completion port so the loop thread dequeues sockets and wakeups from one queue.
+void CALLBACK EventLoop::OnEventSignaled(PVOID context, BOOLEAN isTimeout)
+{
+	WatchEntry* entry = (WatchEntry*)context;
+	PostQueuedCompletionStatus(entry->loop->m_CompletionPort, 0, (ULONG_PTR)entry->sockfd, NULL);
+}
+
+void EventLoop::Arm(SOCKET sockfd, WatchEntry& entry)
+{
+	if (entry.event == NULL)
+	{
+		entry.loop = this;
+		entry.sockfd = sockfd;
+		entry.event = WSACreateEvent();
+		ENSURE(entry.event != WSA_INVALID_EVENT)(WSAGetLastError());
+	}
+	if (entry.waitHandle != NULL)
+	{
+		UnregisterWaitEx(entry.waitHandle, INVALID_HANDLE_VALUE);
+		entry.waitHandle = NULL;
+	}
+
+	long networkEvents = 0;
+	if (entry.readAction)
+		networkEvents |= FD_READ | FD_ACCEPT | FD_CLOSE;
+	if (entry.writeAction)
+		networkEvents |= FD_WRITE | FD_CONNECT | FD_CLOSE;
+	// the event is signaled right away if the condition already holds.
+	ENSURE(SOCKET_ERROR != WSAEventSelect(sockfd, entry.event, networkEvents))(WSAGetLastError());
+	ENSURE_WIN32(RegisterWaitForSingleObject(&entry.waitHandle, entry.event, OnEventSignaled, &entry, INFINITE, WT_EXECUTEONLYONCE));
+	entry.isRegistered = true;
+}
+
+void EventLoop::Disarm(SOCKET sockfd, WatchEntry& entry)
+{
+	if (entry.waitHandle != NULL)
+	{
+		UnregisterWaitEx(entry.waitHandle, INVALID_HANDLE_VALUE);
+		entry.waitHandle = NULL;
+	}
+	if (entry.isRegistered)
+	{
+		// the socket is left non-blocking, which is how Socket uses it anyway.
+		WSAEventSelect(sockfd, NULL, 0);
+		entry.isRegistered = false;
+	}
+	if (entry.event != NULL)
+	{
+		WSACloseEvent(entry.event);
+		entry.event = NULL;
+	}
+}
+
+void EventLoop::Wakeup()
+{
+	PostQueuedCompletionStatus(m_CompletionPort, 0, (ULONG_PTR)INVALID_SOCKET, NULL);
+}
+
+void EventLoop::WaitEvents()
+{
+	OVERLAPPED_ENTRY entries[MAX_EVENTS_PER_WAIT];
+	ULONG count = 0;
+	if (!GetQueuedCompletionStatusEx(m_CompletionPort, entries, MAX_EVENTS_PER_WAIT, &count, INFINITE, FALSE))
+		return;
+
+	for (ULONG i = 0; i < count; i++)
+	{
+		SOCKET sockfd = (SOCKET)entries[i].lpCompletionKey;
+		if (sockfd == INVALID_SOCKET)
+			continue;
+
+		int ready = 0;
+		{
+			std::lock_guard<std::recursive_mutex> lock(m_WatchMtx);
+			auto it = m_Watches.find(sockfd);
+			if (it == m_Watches.end())
+				continue;
+
+			WSANETWORKEVENTS networkEvents;
+			if (SOCKET_ERROR == WSAEnumNetworkEvents(sockfd, it->second.event, &networkEvents))
+			{
+				ready = EVENT_READ | EVENT_WRITE;
+			}
+			else
+			{
+				if (networkEvents.lNetworkEvents & (FD_READ | FD_ACCEPT | FD_CLOSE))
+					ready |= EVENT_READ;
+				if (networkEvents.lNetworkEvents & (FD_WRITE | FD_CONNECT | FD_CLOSE))
+					ready |= EVENT_WRITE;
+			}
+			if (ready == 0)
+			{
+				// nothing was recorded, the wait has fired so it must be armed again.
+				Arm(sockfd, it->second);
+				continue;
+			}
+		}
+		Dispatch(sockfd, ready);
+	}
+}
+
+#endif
@@ -0,0 +1,281 @@
+#include "LatencyTrace.h"
+#include "LatencyHistogram.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#ifdef _WIN32
+#include "target_os.h"
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __GNUC__
+#define LATENCYTRACE_THREAD_LOCAL __thread
+#else
+#define LATENCYTRACE_THREAD_LOCAL __declspec(thread)
+#endif
+
+using namespace std;
+using namespace Titanium::TIRA;
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* name;
+		uint64_t id;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Written by its thread only, head is published after the event it counts so a reader never sees a
+	// half written event, except one the thread overwrites while it is being read, see CopyEvents.
+	struct ThreadRing
+	{
+		ThreadRing(unsigned int capacity, unsigned int generation, unsigned int threadIndex)
+			: events(capacity), mask(capacity - 1), head(0), generation(generation), threadIndex(threadIndex), isExited(false)
+		{
+		}
+
+		vector<TraceEvent> events;
+		const uint64_t mask;
+		atomic<uint64_t> head;
+		const unsigned int generation;
+		unsigned int threadIndex;
+		// the thread ended, the ring is exported until the next thread starting to record takes it over.
+		bool isExited;
+	};
+
+	// the rings of the current generation are exported, an older one is freed by its thread when it records
+	// next or ends. The ring of a thread which ended is reused, so there are no more rings than threads which
+	// recorded at the same time, however many come and go.
+	mutex g_Mutex;
+	vector<ThreadRing*> g_Rings;
+	unsigned int g_Capacity = LatencyTrace::DEFAULT_EVENTS_PER_THREAD;
+	unsigned int g_ThreadCount = 0;
+	atomic<unsigned int> g_Generation(0);
+	LATENCYTRACE_THREAD_LOCAL ThreadRing* t_Ring = nullptr;
+#ifdef _WIN32
+	DWORD g_ExitKey = FLS_OUT_OF_INDEXES;
+#else
+	pthread_key_t g_ExitKey;
+	bool g_HasExitKey = false;
+#endif
+
+	/// The caller holds g_Mutex.
+	void FreeRing(ThreadRing* ring)
+	{
+		for (auto it = g_Rings.begin(); it != g_Rings.end(); ++it)
+		{
+			if (*it == ring)
+			{
+				g_Rings.erase(it);
+				break;
+			}
+		}
+		delete ring;
+	}
+
+	/// Runs on the thread which ended, its ring is kept for the next thread or freed when it is outdated.
+	void OnThreadExit(void* context)
+	{
+		ThreadRing* ring = (ThreadRing*)context;
+		if (!ring)
+			return;
+		lock_guard<mutex> lock(g_Mutex);
+		if (ring->generation == g_Generation.load(memory_order_acquire))
+			ring->isExited = true;
+		else
+			FreeRing(ring);
+		t_Ring = nullptr;
+	}
+
+#ifdef _WIN32
+	void WINAPI OnFiberExit(void* context)
+	{
+		OnThreadExit(context);
+	}
+#endif
+
+	/// Has OnThreadExit called with the ring when the calling thread ends, the caller holds g_Mutex.
+	void WatchThreadExit(ThreadRing* ring)
+	{
+#ifdef _WIN32
+		if (g_ExitKey == FLS_OUT_OF_INDEXES)
+			g_ExitKey = FlsAlloc(OnFiberExit);
+		if (g_ExitKey != FLS_OUT_OF_INDEXES)
+			FlsSetValue(g_ExitKey, ring);
+#else
+		if (!g_HasExitKey)
+			g_HasExitKey = pthread_key_create(&g_ExitKey, OnThreadExit) == 0;
+		if (g_HasExitKey)
+			pthread_setspecific(g_ExitKey, ring);
+#endif
+	}
+
+	ThreadRing* AttachRing(ThreadRing* old, unsigned int generation)
+	{
+		lock_guard<mutex> lock(g_Mutex);
+		unsigned int threadIndex = old ? old->threadIndex : ++g_ThreadCount;
+		if (old)
+			FreeRing(old);
+
+		ThreadRing* ring = nullptr;
+		for (auto it = g_Rings.begin(); it != g_Rings.end(); ++it)
+		{
+			if ((*it)->isExited && (*it)->generation == generation)
+			{
+				// the events of the thread which ended go, the ring has the capacity of the generation.
+				ring = *it;
+				ring->isExited = false;
+				ring->threadIndex = threadIndex;
+				ring->head.store(0, memory_order_relaxed);
+				break;
+			}
+		}
+		if (!ring)
+		{
+			ring = new ThreadRing(g_Capacity, generation, threadIndex);
+			g_Rings.push_back(ring);
+		}
+		WatchThreadExit(ring);
+		return ring;
+	}
+
+	/// Appends what the ring keeps, the caller holds g_Mutex.
+	void CopyEvents(const ThreadRing& ring, vector<pair<unsigned int, TraceEvent>>& events)
+	{
+		uint64_t head = ring.head.load(memory_order_acquire);
+		uint64_t capacity = ring.mask + 1;
+		uint64_t first = head > capacity ? head - capacity : 0;
+		size_t begin = events.size();
+		for (uint64_t i = first; i < head; i++)
+			events.push_back(make_pair(ring.threadIndex, ring.events[i & ring.mask]));
+
+		// events the thread overwrote meanwhile, and the one it may be writing, are left out.
+		uint64_t newHead = ring.head.load(memory_order_acquire);
+		uint64_t valid = newHead + 1 > capacity ? newHead + 1 - capacity : 0;
+		if (valid > first)
+		{
+			size_t torn = (size_t)min(valid - first, head - first);
+			events.erase(events.begin() + begin, events.begin() + begin + torn);
+		}
+	}
+
+	vector<pair<unsigned int, TraceEvent>> CollectEvents()
+	{
+		vector<pair<unsigned int, TraceEvent>> events;
+		lock_guard<mutex> lock(g_Mutex);
+		unsigned int generation = g_Generation.load(memory_order_acquire);
+		for (auto it = g_Rings.begin(); it != g_Rings.end(); ++it)
+		{
+			if ((*it)->generation == generation)
+				CopyEvents(**it, events);
+		}
+		return events;
+	}
+
+	void AppendJsonString(ostringstream& os, const char* text)
+	{
+		os << '"';
+		for (const char* p = text; *p; p++)
+		{
+			if (*p == '"' || *p == '\\')
+				os << '\\';
+			os << *p;
+		}
+		os << '"';
+	}
+}
+
+atomic<bool> LatencyTrace::s_Enabled(false);
+
+void LatencyTrace::Enable(unsigned int eventsPerThread)
+{
+	{
+		lock_guard<mutex> lock(g_Mutex);
+		unsigned int capacity = 1;
+		while (capacity < eventsPerThread && capacity < 0x80000000)
+			capacity <<= 1;
+		g_Capacity = capacity;
+		g_Generation++;
+		// the rings left by threads which ended are outdated, the others go when their threads record or end.
+		for (size_t i = g_Rings.size(); i > 0; i--)
+		{
+			if (g_Rings[i - 1]->isExited)
+				FreeRing(g_Rings[i - 1]);
+		}
+	}
+	s_Enabled.store(true, memory_order_relaxed);
+}
+void LatencyTrace::Disable()
+{
+	s_Enabled.store(false, memory_order_relaxed);
+}
+uint64_t LatencyTrace::Now()
+{
+	return ToTraceTime(chrono::steady_clock::now());
+}
+uint64_t LatencyTrace::ToTraceTime(chrono::steady_clock::time_point time)
+{
+	return (uint64_t)chrono::duration_cast<chrono::microseconds>(time.time_since_epoch()).count();
+}
+void LatencyTrace::Record(const char* name, uint64_t id, uint64_t start, uint64_t end)
+{
+	if (!IsEnabled())
+		return;
+	ThreadRing* ring = t_Ring;
+	unsigned int generation = g_Generation.load(memory_order_acquire);
+	if (!ring || ring->generation != generation)
+		ring = t_Ring = AttachRing(ring, generation);
+
+	uint64_t head = ring->head.load(memory_order_relaxed);
+	TraceEvent& event = ring->events[head & ring->mask];
+	event.name = name;
+	event.id = id;
+	event.start = start;
+	event.end = end < start ? start : end;
+	ring->head.store(head + 1, memory_order_release);
+}
+string LatencyTrace::ExportChromeTrace()
+{
+	auto events = CollectEvents();
+	ostringstream os;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const TraceEvent& event = events[i].second;
+		if (i > 0)
+			os << ",\n";
+		os << "{\"name\":";
+		AppendJsonString(os, event.name);
+		os << ",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":" << events[i].first
+			<< ",\"ts\":" << event.start << ",\"dur\":" << event.end - event.start
+			<< ",\"args\":{\"id\":" << event.id << "}}";
+	}
+	os << "]}\n";
+	return os.str();
+}
+bool LatencyTrace::WriteChromeTrace(const string& path)
+{
+	string trace = ExportChromeTrace();
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool isWritten = fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+	return fclose(file) == 0 && isWritten;
+}
+string LatencyTrace::FormatSummary()
+{
+	auto events = CollectEvents();
+	map<string, LatencyHistogram> stages;
+	for (auto it = events.begin(); it != events.end(); ++it)
+		stages[it->second.name].AddMicros(it->second.end - it->second.start);
+
+	ostringstream os;
+	for (auto it = stages.begin(); it != stages.end(); ++it)
+		os << it->first << ": " << it->second.Format() << "\n";
+	return os.str();
+}
@@ -0,0 +1,461 @@
+#include "MuxConnection.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include "exception.h"
+
+using namespace std;
+using namespace Titanium::TIRA;
+
+namespace
+{
+	enum MuxFrameType
+	{
+		MUX_FRAME_DATA = 0,
+		MUX_FRAME_WINDOW = 1   //!< the payload is the number of bytes the sender may send more
+	};
+
+#pragma pack(push, 1)
+	struct MuxFrameHeader
+	{
+		unsigned char streamId;
+		unsigned char type;
+		unsigned short reserved;
+		unsigned int length;
+	};
+#pragma pack(pop)
+
+	const unsigned int MUX_MAX_POOLED_FRAMES = 64;
+}
+
+namespace Titanium { namespace TIRA
+{
+	struct MuxCore
+	{
+		MuxCore()
+			: sendingPool(make_shared<BufferPool>(MUX_MAX_FRAME_PAYLOAD, MUX_MAX_POOLED_FRAMES))
+			, closed(false)
+		{
+			memset(nextInLevel, 0, sizeof(nextInLevel));
+		}
+
+		// the streams unregister themselves when they are destroyed.
+		MuxStream* Find(unsigned char id)
+		{
+			auto it = streams.find(id);
+			return it == streams.end() ? nullptr : it->second;
+		}
+
+		/// The stream to send from next, or null if none has both data and credit.
+		MuxStream* PickStream()
+		{
+			for (unsigned int level = 0; level < MUX_PRIORITY_LEVELS; level++)
+			{
+				auto& candidates = byPriority[level];
+				for (size_t i = 0; i < candidates.size(); i++)
+				{
+					size_t index = (nextInLevel[level] + i) % candidates.size();
+					auto stream = candidates[index];
+					if (!stream->m_Outgoing.empty() && stream->m_Credit > 0)
+					{
+						// the others of the level go first next time.
+						nextInLevel[level] = index + 1;
+						return stream;
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		void CloseAll()
+		{
+			closed = true;
+			for (auto it = streams.begin(); it != streams.end(); ++it)
+			{
+				it->second->m_Readable.notify_all();
+				it->second->m_Writable.notify_all();
+			}
+			writerCv.notify_all();
+		}
+
+		mutex mtx;
+		condition_variable writerCv;
+		map<unsigned char, MuxStream*> streams;
+		vector<MuxStream*> byPriority[MUX_PRIORITY_LEVELS];
+		size_t nextInLevel[MUX_PRIORITY_LEVELS];
+		deque<pair<unsigned char, unsigned int>> windowUpdates;
+		shared_ptr<BufferPool> sendingPool;
+		bool closed;
+	};
+}
+}
+
+MuxStream::MuxStream(shared_ptr<MuxCore> core, unsigned char id, unsigned int priority, unsigned int window)
+	: m_Core(core)
+	, m_Id(id)
+	, m_Priority(min(priority, (unsigned int)MUX_PRIORITY_LEVELS - 1))
+	, m_Window(window)
+	, m_Consumed(0)
+	, m_Receivable(window)
+	, m_ReadCancelled(false)
+	, m_OutgoingBytes(0)
+	, m_Credit(0)
+	, m_WriteCancelled(false)
+{
+}
+
+MuxStream::~MuxStream()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	m_Core->streams.erase(m_Id);
+	auto& level = m_Core->byPriority[m_Priority];
+	level.erase(remove(level.begin(), level.end(), this), level.end());
+}
+
+int MuxStream::ReadBytes(unsigned char* buffer, int bufLen)
+{
+	unique_lock<mutex> lock(m_Core->mtx);
+	m_Readable.wait(lock, [&]() { return !m_Received.empty() || m_ReadCancelled || m_Core->closed; });
+	if (m_ReadCancelled)
+		throw ExceptionWithString("Read on mux stream is cancelled!");
+	if (m_Received.empty())
+		throw ExceptionWithString("Mux connection has been closed!");
+
+	auto& chunk = m_Received.front();
+	unsigned int count = min((unsigned int)bufLen, chunk.length);
+	memcpy(buffer, chunk.data.get() + chunk.offset, count);
+	chunk.offset += count;
+	chunk.length -= count;
+	if (chunk.length == 0)
+		m_Received.pop_front();
+	Consume(count);
+	return (int)count;
+}
+
+unsigned int MuxStream::ReadChunk(shared_ptr<unsigned char>& chunk)
+{
+	unique_lock<mutex> lock(m_Core->mtx);
+	m_Readable.wait(lock, [&]() { return !m_Received.empty() || m_ReadCancelled || m_Core->closed; });
+	if (m_ReadCancelled)
+		throw ExceptionWithString("Read on mux stream is cancelled!");
+	if (m_Received.empty())
+		throw ExceptionWithString("Mux connection has been closed!");
+
+	auto& front = m_Received.front();
+	// shares the ownership of the frame buffer but points at what is left of it.
+	chunk = shared_ptr<unsigned char>(front.data, front.data.get() + front.offset);
+	unsigned int count = front.length;
+	m_Received.pop_front();
+	Consume(count);
+	return count;
+}
+
+void MuxStream::CancelRead()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	m_ReadCancelled = true;
+	// nobody reads what is queued anymore, the peer gets its window back.
+	unsigned int dropped = 0;
+	for (auto it = m_Received.begin(); it != m_Received.end(); ++it)
+		dropped += it->length;
+	m_Received.clear();
+	Consume(dropped);
+	m_Readable.notify_all();
+}
+
+bool MuxStream::IsSourceInError()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	return m_Core->closed;
+}
+
+void MuxStream::WaitTillSourceIdeal()
+{
+	unique_lock<mutex> lock(m_Core->mtx);
+	m_Writable.wait(lock, [&]() { return m_Outgoing.empty() || m_WriteCancelled || m_Core->closed; });
+}
+
+void MuxStream::WriteBytes(const unsigned char* buffer, int bufLen)
+{
+	ConstBuffer buf = { buffer, (unsigned int)bufLen };
+	WriteBytesV(&buf, 1);
+}
+
+void MuxStream::WriteBytesV(const ConstBuffer* buffers, int count)
+{
+	lock_guard<mutex> writeLock(m_WriteMtx);
+	int index = 0;
+	unsigned int offset = 0;
+	while (index < count)
+	{
+		// packs the small buffers together, so a header and its body go in one frame.
+		Chunk chunk = { m_Core->sendingPool->Acquire(), 0, 0 };
+		while (index < count && chunk.length < MUX_MAX_FRAME_PAYLOAD)
+		{
+			unsigned int length = min(buffers[index].length - offset, MUX_MAX_FRAME_PAYLOAD - chunk.length);
+			memcpy(chunk.data.get() + chunk.length, buffers[index].data + offset, length);
+			chunk.length += length;
+			offset += length;
+			if (offset == buffers[index].length)
+			{
+				index++;
+				offset = 0;
+			}
+		}
+		if (chunk.length > 0)
+			QueueChunk(chunk);
+	}
+}
+
+void MuxStream::Cancel()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	m_WriteCancelled = true;
+	m_Outgoing.clear();
+	m_OutgoingBytes = 0;
+	m_Writable.notify_all();
+}
+
+unsigned int MuxStream::GetQueuedBytes()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	return m_OutgoingBytes;
+}
+
+void MuxStream::QueueChunk(const Chunk& chunk)
+{
+	unique_lock<mutex> lock(m_Core->mtx);
+	m_Writable.wait(lock, [&]() { return m_OutgoingBytes < MUX_SEND_QUEUE_LIMIT || m_WriteCancelled || m_Core->closed; });
+	if (m_WriteCancelled)
+		throw ExceptionWithString("Write on mux stream is cancelled!");
+	if (m_Core->closed)
+		throw ExceptionWithString("Mux connection has been closed!");
+
+	m_Outgoing.push_back(chunk);
+	m_OutgoingBytes += chunk.length;
+	m_Core->writerCv.notify_one();
+}
+
+// called with the mutex of the core held.
+void MuxStream::Consume(unsigned int length)
+{
+	m_Consumed += length;
+	if (m_Consumed >= m_Window / 2)
+	{
+		m_Core->windowUpdates.push_back(make_pair(m_Id, m_Consumed));
+		m_Receivable += m_Consumed;
+		m_Consumed = 0;
+		m_Core->writerCv.notify_one();
+	}
+}
+
+MuxConnection::MuxConnection(shared_ptr<Socket> socket)
+	: AsyncBase("MuxConnection")
+	, m_Socket(socket)
+	, m_Core(make_shared<MuxCore>())
+	, m_ReceivingPool(make_shared<BufferPool>(MUX_MAX_FRAME_PAYLOAD, MUX_MAX_POOLED_FRAMES))
+{
+}
+
+MuxConnection::~MuxConnection()
+{
+	MuteAllExceptions([&]() { Stop(); });
+}
+
+shared_ptr<MuxStream> MuxConnection::OpenStream(unsigned char id, unsigned int priority, unsigned int receiveWindow)
+{
+	ENSURE(receiveWindow >= 2)("The receive window of a mux stream is too small!");
+	shared_ptr<MuxStream> stream(new MuxStream(m_Core, id, priority, receiveWindow));
+
+	lock_guard<mutex> lock(m_Core->mtx);
+	ENSURE(m_Core->streams.count(id) == 0)("Mux stream is opened twice!");
+	m_Core->streams[id] = stream.get();
+	m_Core->byPriority[stream->m_Priority].push_back(stream.get());
+	// the peer may not send on the stream until it is told the window.
+	m_Core->windowUpdates.push_back(make_pair(id, receiveWindow));
+	m_Core->writerCv.notify_one();
+	return stream;
+}
+
+void MuxConnection::Start()
+{
+	StartAsyncBase();
+	if (!m_WriterThread)
+		m_WriterThread.reset(new thread([this]() { WriterLoop(); }));
+}
+
+void MuxConnection::Stop()
+{
+	Close();
+	StopAsyncBase();
+	if (m_WriterThread)
+	{
+		if (m_WriterThread->joinable())
+			m_WriterThread->join();
+		m_WriterThread.reset();
+	}
+}
+
+bool MuxConnection::IsInError()
+{
+	lock_guard<mutex> lock(m_Core->mtx);
+	return m_Core->closed || IsAsyncBaseInError();
+}
+
+void MuxConnection::UnBlockWorkingThread()
+{
+	m_Socket->CancelRecv();
+}
+
+void MuxConnection::Close()
+{
+	{
+		lock_guard<mutex> lock(m_Core->mtx);
+		m_Core->CloseAll();
+	}
+	m_Socket->CancelSend();
+}
+
+void MuxConnection::ReadFull(unsigned char* buffer, unsigned int length)
+{
+	while (length > 0)
+	{
+		int count = m_Socket->Recv(buffer, length);
+		buffer += count;
+		length -= count;
+	}
+}
+
+void MuxConnection::Workloop()
+{
+	try
+	{
+		while (CanLoopContinue())
+		{
+			MuxFrameHeader header;
+			ReadFull((unsigned char*)&header, sizeof(header));
+			if (header.length > MUX_MAX_FRAME_PAYLOAD)
+				throw ExceptionWithString("Mux frame is too large!");
+
+			if (header.type == MUX_FRAME_WINDOW)
+			{
+				unsigned int increment = 0;
+				ENSURE(header.length == sizeof(increment))("Malformed mux window update!");
+				ReadFull((unsigned char*)&increment, sizeof(increment));
+
+				lock_guard<mutex> lock(m_Core->mtx);
+				auto stream = m_Core->Find(header.streamId);
+				if (stream)
+				{
+					stream->m_Credit += increment;
+					m_Core->writerCv.notify_one();
+				}
+				continue;
+			}
+
+			// the peer has to keep within the window, so queueing never waits for a slow reader.
+			MuxStream::Chunk chunk = { m_ReceivingPool->Acquire(), 0, header.length };
+			ReadFull(chunk.data.get(), header.length);
+			if (chunk.length == 0)
+				continue;
+
+			lock_guard<mutex> lock(m_Core->mtx);
+			auto stream = m_Core->Find(header.streamId);
+			if (!stream)
+			{
+				// the stream is closed on this side only, the peer must not stall on the credit it spent.
+				m_Core->windowUpdates.push_back(make_pair(header.streamId, chunk.length));
+				m_Core->writerCv.notify_one();
+				continue;
+			}
+
+			if (chunk.length > stream->m_Receivable)
+				throw ExceptionWithString("Mux stream received more than its window!");
+			stream->m_Receivable -= chunk.length;
+
+			if (stream->m_ReadCancelled)
+			{
+				stream->Consume(chunk.length);
+				continue;
+			}
+			stream->m_Received.push_back(chunk);
+			stream->m_Readable.notify_one();
+		}
+	}
+	catch (ExceptionWithString&)
+	{
+		// wakes up everybody waiting on a stream.
+		Close();
+		throw;
+	}
+}
+
+void MuxConnection::WriterLoop()
+{
+	try
+	{
+		while (true)
+		{
+			MuxFrameHeader header = {};
+			unsigned int increment = 0;
+			shared_ptr<unsigned char> sending;
+			ConstBuffer buffers[2];
+
+			{
+				unique_lock<mutex> lock(m_Core->mtx);
+				MuxStream* stream = nullptr;
+				m_Core->writerCv.wait(lock, [&]()
+				{
+					if (m_Core->closed || !m_Core->windowUpdates.empty())
+						return true;
+					stream = m_Core->PickStream();
+					return stream != nullptr;
+				});
+				if (m_Core->closed)
+					break;
+
+				// window updates go first, holding them back would stall the peer.
+				if (!m_Core->windowUpdates.empty())
+				{
+					auto update = m_Core->windowUpdates.front();
+					m_Core->windowUpdates.pop_front();
+					header.streamId = update.first;
+					header.type = MUX_FRAME_WINDOW;
+					header.length = sizeof(increment);
+					increment = update.second;
+					buffers[1].data = (const unsigned char*)&increment;
+					buffers[1].length = sizeof(increment);
+				}
+				else
+				{
+					auto& chunk = stream->m_Outgoing.front();
+					unsigned int length = min(chunk.length, stream->m_Credit);
+					header.streamId = stream->m_Id;
+					header.type = MUX_FRAME_DATA;
+					header.length = length;
+					// the data stays alive in the pool buffer even if the stream goes away meanwhile.
+					sending = chunk.data;
+					buffers[1].data = chunk.data.get() + chunk.offset;
+					buffers[1].length = length;
+
+					chunk.offset += length;
+					chunk.length -= length;
+					if (chunk.length == 0)
+						stream->m_Outgoing.pop_front();
+					stream->m_Credit -= length;
+					stream->m_OutgoingBytes -= length;
+					stream->m_Writable.notify_all();
+				}
+			}
+
+			buffers[0].data = (const unsigned char*)&header;
+			buffers[0].length = sizeof(header);
+			m_Socket->SendV(buffers, 2);
+		}
+	}
+	catch (ExceptionWithString& e)
+	{
+		TRACE("MuxConnection: %s\n", e.what());
+		Close();
+	}
+}
@@ -1,4 +1,5 @@
 ﻿#include "Socket.h"
+#include "EventLoop.h"
 #include "error_handling_utility.h"
 #pragma comment(lib, "ws2_32")
 #ifdef __GNUC__
@@ -13,9 +14,19 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #endif
 using namespace Titanium::TIRA;
 
+static bool IsWouldBlockError()
+{
+#ifdef __GNUC__
+	return EAGAIN == errno || EWOULDBLOCK == errno;
+#else
+	return WSAEWOULDBLOCK == WSAGetLastError();
+#endif
+}
+
 bool InetAddress::GetInetAddressByHostname(const std::string hostname, std::string& ip)
 {
 	struct addrinfo	hints, *res;
@@ -260,6 +271,8 @@ SocketFuncs::SocketFuncs()
 
 Socket::Socket(SmartHandle<SOCKET> sockfd):
 _sockfd(sockfd)
+, m_ReadReadyEvent(false)
+, m_WriteReadyEvent(false)
 {
 	unsigned long nIoctlOpt = 1;
 	ioctlsocket(_sockfd.get(), FIONBIO, &nIoctlOpt); 	// set socket to non-blocking mode.
@@ -291,6 +304,17 @@ void Socket::WaitForWriteReady()
 	{
 		m_IsCancelWrite = false;
 	});
+	if (m_EventLoop)
+	{
+		if (!m_IsCancelWrite)
+		{
+			m_EventLoop->Watch(_sockfd.get(), EventLoop::EVENT_WRITE, [this](int) { m_WriteReadyEvent.set(); });
+			m_WriteReadyEvent.wait();
+		}
+		if (m_IsCancelWrite)
+			throw ExceptionWithString("Writing is canceled!");
+		return;
+	}
 	while (true)
 	{
 		if (m_IsCancelWrite)
@@ -307,6 +331,17 @@ void Socket::WaitForReadReady()
 	{
 		m_IsCancelRead = false;
 	});
+	if (m_EventLoop)
+	{
+		if (!m_IsCancelRead)
+		{
+			m_EventLoop->Watch(_sockfd.get(), EventLoop::EVENT_READ, [this](int) { m_ReadReadyEvent.set(); });
+			m_ReadReadyEvent.wait();
+		}
+		if (m_IsCancelRead)
+			throw ExceptionWithString("Socket: Reading is canceled!");
+		return;
+	}
 	while (true)
 	{
 		if (true == m_IsCancelRead)
@@ -345,6 +380,8 @@ void Socket::Shutdown()
 		{
 			CancelSend();
 			CancelRecv();
+			if (m_EventLoop)
+				m_EventLoop->Unwatch(_sockfd.get());
 			SocketFuncs::Shutdown(_sockfd.get());
 		}
 		, "Shutdown Socket!");
@@ -354,6 +391,29 @@ void Socket::Shutdown()
 void Socket::CancelRecv()
 {
 	m_IsCancelRead = true;
+	m_ReadReadyEvent.set();
+}
+
+void Socket::WatchReadable(std::function<void()> action)
+{
+	ENSURE(m_EventLoop != nullptr)("No event loop is attached to the socket!");
+	m_EventLoop->Watch(_sockfd.get(), EventLoop::EVENT_READ, [action](int) { action(); });
+}
+
+void Socket::UnwatchReadable()
+{
+	if (m_EventLoop)
+		m_EventLoop->Unwatch(_sockfd.get(), EventLoop::EVENT_READ);
+}
+
+void Socket::AttachEventLoop(std::shared_ptr<EventLoop> loop)
+{
+	m_EventLoop = loop;
+}
+
+bool Socket::IsEventLoopAttached()
+{
+	return m_EventLoop != nullptr;
 }
 
 int Socket::ReceiveFrom(unsigned char* data, int len, InetAddress* pSrc)
@@ -376,10 +436,33 @@ int Socket::ReceiveFrom(unsigned char* data, int len, InetAddress* pSrc)
 	return CheckSocketReturn(recvCount);
 }
 
+int Socket::TryRecv(unsigned char* buffer, int bufLen)
+{
+	if (!m_IsAlive)
+		throw ExceptionWithString("Call on a dead socket!");
+	int recvCount = recv(_sockfd.get(), (char*)buffer, bufLen, 0);
+	if (recvCount == 0)
+		throw ExceptionWithString("Socket has been closed gracefully!");
+	if (SOCKET_ERROR == recvCount && IsWouldBlockError())
+		return 0;
+	return CheckSocketReturn(recvCount);
+}
+
 int Socket::Recv(unsigned char* buffer, int bufLen)
 {
 	if (!m_IsAlive)
 		throw ExceptionWithString("Call on a dead socket!");
+	if (m_EventLoop)
+	{
+		// the data is usually there already, only go to the loop when the socket would block.
+		while (true)
+		{
+			int recvCount = TryRecv(buffer, bufLen);
+			if (recvCount > 0)
+				return recvCount;
+			WaitForReadReady();
+		}
+	}
 	WaitForReadReady();
 	int recvCount = recv(_sockfd.get(), (char*)buffer, bufLen, 0);
 	if (recvCount == 0)
@@ -390,6 +473,7 @@ int Socket::Recv(unsigned char* buffer, int bufLen)
 void Socket::CancelSend()
 {
 	m_IsCancelWrite = true;
+	m_WriteReadyEvent.set();
 }
 
 int Socket::SendTo(const InetAddress& pDest, const char* data, int len)
@@ -408,11 +492,88 @@ int Socket::Send(const unsigned char* buffer, int bufLen)
 {
 	if (!m_IsAlive)
 		throw ExceptionWithString("Call on a dead socket!");
+	if (m_EventLoop)
+	{
+		while (true)
+		{
+			int sentCount = send(_sockfd.get(), (const char*)buffer, bufLen, 0);
+			if (SOCKET_ERROR == sentCount && IsWouldBlockError())
+			{
+				WaitForWriteReady();
+				continue;
+			}
+			return CheckSocketReturn(sentCount);
+		}
+	}
 	WaitForWriteReady();
 	int sentCount = send(_sockfd.get(), (const char*)buffer, bufLen, 0);
 	return CheckSocketReturn(sentCount);
 }
 
+int Socket::SendVInternal(const ConstBuffer* buffers, int count, unsigned int offset)
+{
+	count = MIN(count, MAX_SENDV_BUFFERS);
+#ifdef __GNUC__
+	struct iovec vecs[MAX_SENDV_BUFFERS];
+	for (int i = 0; i < count; i++)
+	{
+		vecs[i].iov_base = (void*)(buffers[i].data + offset);
+		vecs[i].iov_len = buffers[i].length - offset;
+		offset = 0;
+	}
+	int sentCount = (int)::writev(_sockfd.get(), vecs, count);
+	if (SOCKET_ERROR == sentCount && IsWouldBlockError())
+		return 0;
+	return sentCount;
+#else
+	WSABUF vecs[MAX_SENDV_BUFFERS];
+	for (int i = 0; i < count; i++)
+	{
+		vecs[i].buf = (char*)(buffers[i].data + offset);
+		vecs[i].len = buffers[i].length - offset;
+		offset = 0;
+	}
+	DWORD sentCount = 0;
+	if (SOCKET_ERROR == ::WSASend(_sockfd.get(), vecs, count, &sentCount, 0, nullptr, nullptr))
+	{
+		if (IsWouldBlockError())
+			return 0;
+		return SOCKET_ERROR;
+	}
+	return (int)sentCount;
+#endif
+}
+
+int Socket::SendV(const ConstBuffer* buffers, int count)
+{
+	if (!m_IsAlive)
+		throw ExceptionWithString("Call on a dead socket!");
+
+	int totalSent = 0;
+	int current = 0;
+	unsigned int offset = 0;
+	while (true)
+	{
+		// skips the buffers which have been sent completely, a partial write resumes in the middle of a buffer.
+		while (current < count && offset >= buffers[current].length)
+		{
+			offset -= buffers[current].length;
+			current++;
+		}
+		if (current >= count)
+			break;
+
+		if (!m_EventLoop)
+			WaitForWriteReady();
+		int sentCount = CheckSocketReturn(SendVInternal(buffers + current, count - current, offset));
+		if (0 == sentCount && m_EventLoop)
+			WaitForWriteReady();
+		offset += sentCount;
+		totalSent += sentCount;
+	}
+	return totalSent;
+}
+
 void Socket::GetSocketOption(int level, int optName, socklen_t* optVal)
 {
 	SocketFuncs::GetSocketOption(_sockfd.get(), level, optName, optVal);
@@ -1,6 +1,32 @@
 #include "SocketTcp.h"
 #ifdef __GNUC__
 #include <linux/tcp.h>
+#include <cstring>
+#elif !defined(SIO_TCP_INFO)
+// from mstcpip.h of the Windows 10 SDK, the ioctl fails on older systems.
+#define SIO_TCP_INFO _WSAIORW(IOC_VENDOR, 39)
+typedef struct _TCP_INFO_v0
+{
+	int State;
+	ULONG Mss;
+	ULONG64 ConnectionTimeMs;
+	BOOLEAN TimestampsEnabled;
+	ULONG RttUs;
+	ULONG MinRttUs;
+	ULONG BytesInFlight;
+	ULONG Cwnd;
+	ULONG SndWnd;
+	ULONG RcvWnd;
+	ULONG RcvBuf;
+	ULONG64 BytesOut;
+	ULONG64 BytesIn;
+	ULONG BytesReordered;
+	ULONG BytesRetrans;
+	ULONG FastRetrans;
+	ULONG DupAcksIn;
+	ULONG TimeoutEpisodes;
+	UCHAR SynRetrans;
+} TCP_INFO_v0;
 #endif
 using namespace Titanium::TIRA;
 
@@ -39,4 +65,33 @@ int SocketTcp::SetRecvBufferSize(socklen_t buffsz /*= SOCKET_TCP_MAX_BUF_SIZE*/)
 	GetSocketOption(SOL_SOCKET, SO_RCVBUF, &buffsz);
 
 	return buffsz;
-}
\ No newline at end of file
+}
+
+bool SocketTcp::GetTcpInfo(TcpInfo& info)
+{
+#ifdef __GNUC__
+	struct tcp_info tcpInfo;
+	socklen_t length = sizeof(tcpInfo);
+	memset(&tcpInfo, 0, sizeof(tcpInfo));
+	if (getsockopt(_sockfd.get(), IPPROTO_TCP, TCP_INFO, &tcpInfo, &length) != 0)
+		return false;
+	info.rttMicros = tcpInfo.tcpi_rtt;
+	info.retransmits = tcpInfo.tcpi_total_retrans;
+	// both stay 0 before Linux 4.19.
+	info.bytesSent = tcpInfo.tcpi_bytes_sent;
+	info.bytesRetransmitted = tcpInfo.tcpi_bytes_retrans;
+	info.congestionWindowBytes = tcpInfo.tcpi_snd_cwnd * tcpInfo.tcpi_snd_mss;
+#else
+	DWORD version = 0;
+	TCP_INFO_v0 tcpInfo;
+	DWORD length = 0;
+	if (WSAIoctl(_sockfd.get(), SIO_TCP_INFO, &version, sizeof(version), &tcpInfo, sizeof(tcpInfo), &length, NULL, NULL) != 0)
+		return false;
+	info.rttMicros = tcpInfo.RttUs;
+	info.retransmits = tcpInfo.FastRetrans + tcpInfo.TimeoutEpisodes;
+	info.bytesSent = tcpInfo.BytesOut;
+	info.bytesRetransmitted = tcpInfo.BytesRetrans;
+	info.congestionWindowBytes = tcpInfo.Cwnd;
+#endif
+	return true;
+}
@@ -1,4 +1,9 @@
 ﻿#include "SocketTcpServer.h"
+#include "EventLoop.h"
+#ifdef __GNUC__
+#include <sys/ioctl.h>
+#define ioctlsocket ioctl
+#endif
 using namespace Titanium::TIRA;
 
 std::shared_ptr<SocketTcp> SocketTcpServer::WaitForConnection()
@@ -9,6 +14,32 @@ std::shared_ptr<SocketTcp> SocketTcpServer::WaitForConnection()
 	return tcpSocket;
 }
 
+void SocketTcpServer::AttachEventLoop(std::shared_ptr<EventLoop> loop)
+{
+	unsigned long nIoctlOpt = 1;
+	ioctlsocket(m_Sockfd.get(), FIONBIO, &nIoctlOpt); 	// accepting is only tried once the loop reports a connection.
+	m_EventLoop = loop;
+}
+
+void SocketTcpServer::WatchConnection(std::function<void()> action)
+{
+	ENSURE(m_EventLoop != nullptr)("No event loop is attached to the server!");
+	m_EventLoop->Watch(m_Sockfd.get(), EventLoop::EVENT_READ, [action](int) { action(); });
+}
+
+std::shared_ptr<SocketTcp> SocketTcpServer::TryAcceptConnection()
+{
+	SOCKET rt = accept(m_Sockfd.get(), nullptr, 0);
+	if (INVALID_SOCKET == rt || SOCKET_ERROR == (int)rt)
+		return nullptr;
+
+	SmartHandle<SOCKET> sockfd(rt);
+	std::shared_ptr<SocketTcp> tcpSocket;
+	tcpSocket.reset(new SocketTcp(sockfd));
+	tcpSocket->AttachEventLoop(m_EventLoop);
+	return tcpSocket;
+}
+
 unsigned SocketTcpServer::GetListeningPort()
 {
 	return SocketFuncs::GetBindedPort(m_Sockfd.get());
@@ -21,6 +52,8 @@ void SocketTcpServer::StopListening()
 	if (alreadyShutdown)
 		return;
 
+	if (m_EventLoop)
+		m_EventLoop->Unwatch(m_Sockfd.get());
 	SocketFuncs::Shutdown(m_Sockfd.get());
 }
 
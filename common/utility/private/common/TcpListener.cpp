@@ -1,4 +1,5 @@
 #include "TcpListener.h"
+#include "EventLoop.h"
 
 using namespace Titanium::TIRA;
 namespace Titanium
@@ -9,6 +10,12 @@ namespace Titanium
 		, m_Port(port)
 	{
 	}
+	TcpListener::TcpListener(unsigned int port, std::shared_ptr<EventLoop> loop)
+		: AsyncBase("TcpListener")
+		, m_Port(port)
+		, m_EventLoop(loop)
+	{
+	}
 	TcpListener::~TcpListener(void)
 	{
 		Stop();
@@ -17,14 +24,34 @@ namespace Titanium
 	{
 		m_pServer = std::make_shared<SocketTcpServer>(m_Port);
 		m_pServer->StartListening();
+		if (m_EventLoop)
+		{
+			m_pServer->AttachEventLoop(m_EventLoop);
+			m_pServer->WatchConnection([this]() { OnConnectionPending(); });
+			return;
+		}
 		AsyncBase::StartAsyncBase();
 	}
+	void TcpListener::OnConnectionPending()
+	{
+		while (auto connection = m_pServer->TryAcceptConnection())
+		{
+			m_SigConnected(connection);
+		}
+		m_pServer->WatchConnection([this]() { OnConnectionPending(); });
+	}
 	SignalConnection TcpListener::RegisterConnectionAcceptedEvent(OnConnectionAcceptedAction action)
 	{
 		return std::move(m_SigConnected.connect(action));
 	}
 	void TcpListener::Stop()
 	{
+		if (m_EventLoop)
+		{
+			if (m_pServer)
+				m_pServer->StopListening();
+			return;
+		}
 		AsyncBase::StopAsyncBase();
 	}
 	void TcpListener::Workloop()
@@ -3,8 +3,7 @@ extern "C" _declspec(dllimport) void(*gSendAudioFormatInfo)(void *data, unsigned
 Titanium::IChannel * g_Channel;
 void OnAudioFormatInfodataReceive(void* buf, unsigned int len)
 {
-	g_Channel->Send((unsigned char*)&len, sizeof(len));
-	g_Channel->Send((unsigned char*)buf, len);
+	g_Channel->SendFrame((unsigned char*)&len, sizeof(len), (unsigned char*)buf, len);
 }
 AudioSource::AudioSource(std::shared_ptr<Titanium::IChannel> channel) :IRdpSource(channel)
 {
@@ -0,0 +1,198 @@
+#include "ChannelAcceptor.h"
+#include "TcpListener.h"
+#include "EventLoop.h"
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Titanium;
+using namespace Titanium::TIRA;
+
+// a connection has this long to send its ChannelHello, the overdue ones are looked for at the interval.
+#define HELLO_TIMEOUT_MS 10000
+#define HELLO_SWEEP_INTERVAL_MS 1000
+
+ChannelAcceptor::ChannelAcceptor(unsigned short port, shared_ptr<EventLoop> loop)
+	: m_Port(port)
+	, m_Listener(make_shared<TcpListener>(port, loop))
+	, m_Sweeper(HELLO_SWEEP_INTERVAL_MS, "channel hello sweeper")
+	, m_Stopped(false)
+{
+}
+
+ChannelAcceptor::~ChannelAcceptor()
+{
+	Stop();
+}
+
+void ChannelAcceptor::Start()
+{
+	m_AcceptedConnection = m_Listener->RegisterConnectionAcceptedEvent([this](shared_ptr<SocketTcp> socket)
+	{
+		OnConnectionAccepted(socket);
+	});
+	m_Sweeper.RegisterCallback([this](void*)
+	{
+		SweepPending();
+	});
+	m_Sweeper.Start();
+	m_Listener->Start();
+}
+
+void ChannelAcceptor::Stop()
+{
+	m_Listener->Stop();
+	m_AcceptedConnection.Disconnect();
+	m_Sweeper.Stop();
+
+	set<shared_ptr<PendingHello>> pending;
+	map<TChannelKey, shared_ptr<SocketTcp>> arrived;
+	{
+		lock_guard<mutex> lock(m_Mtx);
+		m_Stopped = true;
+		pending.swap(m_Pending);
+		arrived.swap(m_Arrived);
+		m_Cv.notify_all();
+	}
+	for (auto it = pending.begin(); it != pending.end(); ++it)
+	{
+		(*it)->socket->UnwatchReadable();
+		(*it)->socket->Shutdown();
+	}
+	for (auto it = arrived.begin(); it != arrived.end(); ++it)
+		it->second->Shutdown();
+}
+
+shared_ptr<SocketTcp> ChannelAcceptor::WaitForChannel(unsigned long long token, ChannelHelloType channel, chrono::milliseconds timeout)
+{
+	TChannelKey key(token, (unsigned int)channel);
+	unique_lock<mutex> lock(m_Mtx);
+	if (!m_Cv.wait_for(lock, timeout, [&]() { return m_Stopped || m_Arrived.count(key) > 0; }))
+		throw runtime_error("Wait for channel connection timeout.");
+	if (m_Stopped)
+		throw runtime_error("Channel acceptor is stopped.");
+
+	auto socket = m_Arrived[key];
+	m_Arrived.erase(key);
+	return socket;
+}
+
+void ChannelAcceptor::AddSession(unsigned long long token)
+{
+	lock_guard<mutex> lock(m_Mtx);
+	m_Sessions.insert(token);
+}
+
+void ChannelAcceptor::DropSession(unsigned long long token)
+{
+	vector<shared_ptr<SocketTcp>> dropped;
+	{
+		lock_guard<mutex> lock(m_Mtx);
+		m_Sessions.erase(token);
+		for (auto it = m_Arrived.begin(); it != m_Arrived.end();)
+		{
+			if (it->first.first == token)
+			{
+				dropped.push_back(it->second);
+				it = m_Arrived.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	for (auto it = dropped.begin(); it != dropped.end(); ++it)
+		(*it)->Shutdown();
+}
+
+void ChannelAcceptor::OnConnectionAccepted(shared_ptr<SocketTcp> socket)
+{
+	auto pending = make_shared<PendingHello>();
+	pending->socket = socket;
+	pending->received = 0;
+	pending->deadline = chrono::steady_clock::now() + chrono::milliseconds(HELLO_TIMEOUT_MS);
+	{
+		lock_guard<mutex> lock(m_Mtx);
+		if (m_Stopped)
+			return;
+		m_Pending.insert(pending);
+	}
+	socket->WatchReadable([this, pending]() { OnHelloReadable(pending); });
+}
+
+void ChannelAcceptor::OnHelloReadable(shared_ptr<PendingHello> pending)
+{
+	bool complete = false;
+	try
+	{
+		int count = pending->socket->TryRecv((unsigned char*)&pending->hello + pending->received, sizeof(ChannelHello) - pending->received);
+		pending->received += count;
+		complete = pending->received == sizeof(ChannelHello);
+	}
+	catch (std::exception&)
+	{
+		// closed before saying which channel it is.
+		lock_guard<mutex> lock(m_Mtx);
+		m_Pending.erase(pending);
+		return;
+	}
+
+	if (!complete)
+	{
+		// the watch fires once, arm it again for the rest of the hello, unless the sweeper took the connection.
+		lock_guard<mutex> lock(m_Mtx);
+		if (m_Pending.count(pending) > 0)
+			pending->socket->WatchReadable([this, pending]() { OnHelloReadable(pending); });
+		return;
+	}
+
+	shared_ptr<SocketTcp> refused;
+	{
+		lock_guard<mutex> lock(m_Mtx);
+		// swept meanwhile, the sweeper closes it.
+		if (m_Pending.erase(pending) == 0)
+			return;
+		TChannelKey key(pending->hello.token, pending->hello.channel);
+		// the first connection for a channel keeps it, a second one can not take it over.
+		if (m_Stopped || pending->hello.magic != CHANNEL_HELLO_MAGIC || m_Sessions.count(pending->hello.token) == 0
+			|| m_Arrived.count(key) > 0)
+		{
+			refused = pending->socket;
+		}
+		else
+		{
+			m_Arrived[key] = pending->socket;
+			m_Cv.notify_all();
+		}
+	}
+	if (refused)
+		refused->Shutdown();
+}
+
+void ChannelAcceptor::SweepPending()
+{
+	vector<shared_ptr<PendingHello>> expired;
+	auto now = chrono::steady_clock::now();
+	{
+		lock_guard<mutex> lock(m_Mtx);
+		for (auto it = m_Pending.begin(); it != m_Pending.end();)
+		{
+			if ((*it)->deadline <= now)
+			{
+				expired.push_back(*it);
+				it = m_Pending.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	// unwatching waits for a read of the hello running on the loop, which then finds it is no longer pending.
+	for (auto it = expired.begin(); it != expired.end(); ++it)
+	{
+		(*it)->socket->UnwatchReadable();
+		(*it)->socket->Shutdown();
+	}
+}
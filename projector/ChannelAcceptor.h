@@ -0,0 +1,70 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <chrono>
+#include "SocketTcp.h"
+#include "SignalConnection.h"
+#include "timebased_worker.h"
+#include "ChannelHello.h"
+
+namespace Titanium
+{
+	class TcpListener;
+	namespace TIRA
+	{
+		class EventLoop;
+	}
+}
+
+// The one data port shared by all sessions. Connections are accepted on the event loop, their
+// ChannelHello is read there as well and the connection is parked until the session waiting for
+// that token and channel picks it up, so a session setting up a channel never takes another one's.
+// A connection which does not finish its hello in time, names a token no session holds or a channel
+// another connection is parked for already, is closed.
+class ChannelAcceptor
+{
+public:
+	ChannelAcceptor(unsigned short port, std::shared_ptr<Titanium::TIRA::EventLoop> loop);
+	~ChannelAcceptor();
+
+	void Start();
+	void Stop();
+	unsigned short GetPort() const { return m_Port; }
+
+	/// Waits for the redirector to open the channel of the session, throws on timeout or when stopped.
+	std::shared_ptr<Titanium::TIRA::SocketTcp> WaitForChannel(unsigned long long token, ChannelHelloType channel, std::chrono::milliseconds timeout);
+	/// Accepts connections for the token from now on.
+	void AddSession(unsigned long long token);
+	/// Closes the connections parked for a session which is going away, later ones for it are refused.
+	void DropSession(unsigned long long token);
+
+private:
+	struct PendingHello
+	{
+		std::shared_ptr<Titanium::TIRA::SocketTcp> socket;
+		ChannelHello hello;
+		unsigned int received;
+		std::chrono::steady_clock::time_point deadline;
+	};
+	typedef std::pair<unsigned long long, unsigned int> TChannelKey;
+
+	void OnConnectionAccepted(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	void OnHelloReadable(std::shared_ptr<PendingHello> pending);
+	/// Closes the connections whose hello is overdue.
+	void SweepPending();
+
+	const unsigned short m_Port;
+	std::shared_ptr<Titanium::TcpListener> m_Listener;
+	Titanium::TIRA::Scoped_connection m_AcceptedConnection;
+	Titanium::TIRA::TimeBasedWorker m_Sweeper;
+
+	std::mutex m_Mtx;
+	std::condition_variable m_Cv;
+	std::set<std::shared_ptr<PendingHello>> m_Pending;
+	std::map<TChannelKey, std::shared_ptr<Titanium::TIRA::SocketTcp>> m_Arrived;
+	std::set<unsigned long long> m_Sessions;
+	bool m_Stopped;
+};
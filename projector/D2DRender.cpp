@@ -1,18 +1,25 @@
 #include "D2DRender.h"
+#include "GfxPdu.h"
+#include "LatencyTrace.h"
 #include <iostream>
+#include <stdexcept>
 extern "C"
 {
 #include"rdpgfx_main.h"
-#include "wf_client.h"
 IWTSVirtualChannel* dvcman_find_channel_by_id(IWTSVirtualChannelManager* pChannelMgr, UINT32 ChannelId);
 }
-D2DRender::D2DRender(drdynvcPlugin* g_drdynvc) :m_IsAlive(false)
+D2DRender::D2DRender(drdynvcPlugin* g_drdynvc) :m_IsAlive(false), m_QueueDepthInFrames(0), m_CoalescedFrames(0), m_TotalFramesDecoded(0)
 {
 	if (g_drdynvc == NULL)
-		throw std::exception("INVALID INPUT");
+		throw std::invalid_argument("INVALID INPUT");
 	DVCMAN_CHANNEL* channel = (DVCMAN_CHANNEL*)dvcman_find_channel_by_id(g_drdynvc->channel_mgr, 6);
 	m_channelCallback = channel->channel_callback;
 }
+D2DRender::D2DRender(IWTSVirtualChannelCallback* channelCallback) :m_channelCallback(channelCallback), m_IsAlive(false), m_QueueDepthInFrames(0), m_CoalescedFrames(0), m_TotalFramesDecoded(0)
+{
+	if (channelCallback == NULL)
+		throw std::invalid_argument("INVALID INPUT");
+}
 
 D2DRender::~D2DRender()
 {
@@ -22,7 +29,7 @@ void D2DRender::Start()
 	if (m_channelCallback)
 		m_IsAlive = true;
 	else
-		throw std::exception("Channel Initial Failed");
+		throw std::runtime_error("Channel Initial Failed");
 	Component::Start();
 }
 void D2DRender::Stop()
@@ -37,10 +44,88 @@ void D2DRender::Process()
 {
 	if (m_IsAlive)
 	{
-		auto inStream = _in->Pop();
-		wStream *s = Stream_New(inStream.buffer.get(), inStream.m_bufferSize);
-		if (s->length > 1)
-		rdpgfx_on_data_received_Core(m_channelCallback, s);
-		Stream_Free(s, FALSE);
+		// drain everything queued per wakeup, more than one frame in the batch means rendering is behind.
+		_in->PopBatch(m_Batch, MAX_ITEMS_PER_BATCH);
+		unsigned int framesLeft = 0;
+		m_IsFrame.resize(m_Batch.size());
+		for (size_t i = 0; i < m_Batch.size(); i++)
+		{
+			unsigned int frameId = 0;
+			m_IsFrame[i] = IsGfxFrame(m_Batch[i], frameId);
+			if (m_IsFrame[i])
+				framesLeft++;
+		}
+
+		for (size_t i = 0; i < m_Batch.size() && m_IsAlive; i++)
+		{
+			BYTE* pData = m_Batch[i].buffer.get();
+			size_t len = m_Batch[i].m_bufferSize;
+			// skips the wake up stream pushed by Stop.
+			if (len <= 1)
+				continue;
+
+			unsigned int frameId = 0;
+			if (m_IsFrame[i])
+			{
+				IsGfxFrame(m_Batch[i], frameId);
+				// back to back frames are decoded as one: every surface and cache pdu is still applied in
+				// order, only the EndFrame/StartFrame pairs between them go, so just the last one is presented.
+				if (i > 0 && m_IsFrame[i - 1])
+				{
+					pData += GFX_STARTFRAME_PDU_SIZE;
+					len -= GFX_STARTFRAME_PDU_SIZE;
+				}
+				if (i + 1 < m_Batch.size() && m_IsFrame[i + 1])
+				{
+					len -= GFX_ENDFRAME_PDU_SIZE;
+					m_CoalescedFrames++;
+				}
+			}
+
+			auto decodeStart = std::chrono::steady_clock::now();
+			wStream *s = Stream_New(pData, len);
+			rdpgfx_recv_pdus_Core(m_channelCallback, s);
+			Stream_Free(s, FALSE);
+			auto decodeEnd = std::chrono::steady_clock::now();
+			if (Titanium::TIRA::LatencyTrace::IsEnabled())
+				TraceStream(m_Batch[i], decodeStart, decodeEnd);
+			m_StreamDecoded(m_Batch[i], decodeStart, decodeEnd);
+
+			if (m_IsFrame[i])
+			{
+				framesLeft--;
+				m_TotalFramesDecoded++;
+				unsigned int queueDepth = framesLeft + (unsigned int)_in->Size();
+				m_QueueDepthInFrames = queueDepth;
+				// coalesced frames are acknowledged too, the server counts on every frame id coming back.
+				m_FrameDecoded(frameId, queueDepth, m_TotalFramesDecoded);
+			}
+		}
+		m_QueueDepthInFrames = (unsigned int)_in->Size();
+		m_Batch.clear();
 	}
-}
\ No newline at end of file
+}
+void D2DRender::TraceStream(const Stream& stream, std::chrono::steady_clock::time_point decodeStart, std::chrono::steady_clock::time_point decodeEnd)
+{
+	using Titanium::TIRA::LatencyTrace;
+	uint64_t start = LatencyTrace::ToTraceTime(decodeStart);
+	if (stream.m_ReceivedTime.time_since_epoch().count() != 0)
+		LatencyTrace::Record("projector.queue", stream.m_TraceId, LatencyTrace::ToTraceTime(stream.m_ReceivedTime), start);
+	LatencyTrace::Record("projector.decode", stream.m_TraceId, start, LatencyTrace::ToTraceTime(decodeEnd));
+}
+Titanium::TIRA::SignalConnection D2DRender::RegisterFrameDecodedEvent(OnFrameDecodedAction action)
+{
+	return m_FrameDecoded.connect(action);
+}
+Titanium::TIRA::SignalConnection D2DRender::RegisterStreamDecodedEvent(OnStreamDecodedAction action)
+{
+	return m_StreamDecoded.connect(action);
+}
+unsigned int D2DRender::GetQueueDepthInFrames() const
+{
+	return m_QueueDepthInFrames;
+}
+unsigned int D2DRender::GetCoalescedFrameCount() const
+{
+	return m_CoalescedFrames;
+}
@@ -1,6 +1,10 @@
 #pragma once
 #include "Component.h"
 #include "ISink.h"
+#include "SignalConnection.h"
+#include <vector>
+#include <atomic>
+#include <chrono>
 extern "C"
 {
 #include "drdynvc_main.h"
@@ -9,13 +13,35 @@ class D2DRender : public Component, public ISink
 {
 public:
 	D2DRender(drdynvcPlugin* g_drdynvc);
+	/// Decodes through the given rdpgfx channel callback instead of the one drdynvc opened, e.g. a HeadlessGfx's.
+	explicit D2DRender(IWTSVirtualChannelCallback* channelCallback);
 	virtual ~D2DRender();
 	virtual void Start();
 	virtual void Stop();
+
+	typedef std::function<void(unsigned int frameId, unsigned int queueDepth, unsigned int totalFramesDecoded)> OnFrameDecodedAction;
+	/// Occurs on the render thread after each frame is decoded, queueDepth counts the frames still waiting.
+	Titanium::TIRA::SignalConnection RegisterFrameDecodedEvent(OnFrameDecodedAction action);
+	typedef std::function<void(const Stream& stream, std::chrono::steady_clock::time_point decodeStart, std::chrono::steady_clock::time_point decodeEnd)> OnStreamDecodedAction;
+	/// Occurs on the render thread after rdpgfx is done with each stream, e.g. to tell queueing from decoding.
+	Titanium::TIRA::SignalConnection RegisterStreamDecodedEvent(OnStreamDecodedAction action);
+	/// Frames queued for decoding, counting what is left of the batch in progress.
+	unsigned int GetQueueDepthInFrames() const;
+	/// Frames which were decoded but not presented because a newer frame was queued behind them.
+	unsigned int GetCoalescedFrameCount() const;
 protected:
 	virtual void Process();
 	IWTSVirtualChannelCallback* m_channelCallback;
 private:
+	void TraceStream(const Stream& stream, std::chrono::steady_clock::time_point decodeStart, std::chrono::steady_clock::time_point decodeEnd);
 	bool m_IsAlive;
+	std::vector<Stream> m_Batch;
+	std::vector<bool> m_IsFrame;
+	Titanium::TIRA::Signal<void(unsigned int, unsigned int, unsigned int)> m_FrameDecoded;
+	Titanium::TIRA::Signal<void(const Stream&, std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point)> m_StreamDecoded;
+	std::atomic<unsigned int> m_QueueDepthInFrames;
+	std::atomic<unsigned int> m_CoalescedFrames;
+	unsigned int m_TotalFramesDecoded;
+	static const size_t MAX_ITEMS_PER_BATCH = 64;
 };
 
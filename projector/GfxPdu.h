@@ -0,0 +1,47 @@
+#pragma once
+#include "Stream.h"
+
+// Just enough of the RDPGFX wire format to find frame boundaries in decompressed gfx data.
+const unsigned short GFX_CMDID_STARTFRAME = 0x000B;
+const unsigned short GFX_CMDID_ENDFRAME = 0x000C;
+const unsigned int GFX_HEADER_SIZE = 8;
+const unsigned int GFX_STARTFRAME_PDU_SIZE = GFX_HEADER_SIZE + 8;
+const unsigned int GFX_ENDFRAME_PDU_SIZE = GFX_HEADER_SIZE + 4;
+
+struct GfxPduHeader
+{
+	unsigned short cmdId;
+	unsigned short flags;
+	unsigned int pduLength;
+};
+
+inline unsigned int ReadGfxUInt32(const unsigned char* p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/// Returns false when len can not hold the header or the pdu it announces.
+inline bool ReadGfxPduHeader(const unsigned char* p, unsigned int len, GfxPduHeader& header)
+{
+	if (len < GFX_HEADER_SIZE)
+		return false;
+	header.cmdId = (unsigned short)(p[0] | (p[1] << 8));
+	header.flags = (unsigned short)(p[2] | (p[3] << 8));
+	header.pduLength = ReadGfxUInt32(p + 4);
+	return header.pduLength >= GFX_HEADER_SIZE && header.pduLength <= len;
+}
+
+/// A queued frame starts with its StartFrame pdu and ends with its EndFrame pdu, everything else is state pdus.
+inline bool IsGfxFrame(const Stream& stream, unsigned int& frameId)
+{
+	const unsigned char* p = stream.buffer.get();
+	unsigned int len = stream.m_bufferSize;
+	GfxPduHeader header;
+	if (len < GFX_STARTFRAME_PDU_SIZE + GFX_ENDFRAME_PDU_SIZE || !ReadGfxPduHeader(p, len, header) || header.cmdId != GFX_CMDID_STARTFRAME)
+		return false;
+	const unsigned char* pEnd = p + len - GFX_ENDFRAME_PDU_SIZE;
+	if (!ReadGfxPduHeader(pEnd, GFX_ENDFRAME_PDU_SIZE, header) || header.cmdId != GFX_CMDID_ENDFRAME)
+		return false;
+	frameId = ReadGfxUInt32(pEnd + GFX_HEADER_SIZE);
+	return true;
+}
@@ -4,9 +4,12 @@
 #include "RedirectPipe.h"
 #include "rdpStreamingDef.h"
 extern "C" _declspec(dllimport) void(*gmSendHIDData)(void *data, unsigned int size);
+// gmSendHIDData carries no session, the input is routed to the pipe of the active redirector.
+std::mutex g_HIDPipeMtx;
 RedirectPipe* g_HIDPipe = nullptr;
 void OnHIDdataReceive(void* buf, unsigned int len)
 {
+	std::lock_guard<std::mutex> lg(g_HIDPipeMtx);
 	if (g_HIDPipe)
 	{
 		g_HIDPipe->HIDDataReceivedEvent(buf, len);
@@ -23,7 +26,6 @@ HIDRedirector::~HIDRedirector()
 void HIDRedirector::Start()
 {
 	 _Pipe = std::make_shared<RedirectPipe>();
-	 g_HIDPipe = _Pipe.get();
 	 gmSendHIDData = OnHIDdataReceive;
 	 _Pipe->HIDDataReceivedEvent = [this](void *data, unsigned int size)
 	 {
@@ -36,17 +38,29 @@ void HIDRedirector::Start()
 			 }
 			 catch (std::exception &e)
 			 {
-				 g_HIDPipe = nullptr;
 				 _RedirectChannel.reset();
 			 }
 		 }
 	 };
+	 Activate();
+}
+
+void HIDRedirector::Activate()
+{
+	std::lock_guard<std::mutex> lg(g_HIDPipeMtx);
+	if (_Pipe)
+		g_HIDPipe = _Pipe.get();
 }
 
 void HIDRedirector::Stop()
 {
+	{
+		// taken before m_mux, OnHIDdataReceive holds it while the event takes m_mux.
+		std::lock_guard<std::mutex> pipeLock(g_HIDPipeMtx);
+		if (g_HIDPipe == _Pipe.get())
+			g_HIDPipe = nullptr;
+	}
 	std::lock_guard<std::mutex> lg(m_mux);
 	if (_RedirectChannel)
 		_RedirectChannel->Stop();
-	g_HIDPipe = nullptr;
 }
\ No newline at end of file
@@ -8,4 +8,6 @@ public:
 	~HIDRedirector();
 	virtual void Start();
 	virtual void Stop();
+	/// The local input of the projector goes to the active redirector, the session which connected last or was activated.
+	void Activate();
 };
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "HeadlessGfx.h"
+#include <cstring>
+#include <stdexcept>
+extern "C"
+{
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/client/rdpgfx.h>
+#include <freerdp/codec/color.h>
+UINT rdpgfx_DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints);
+}
+
+namespace
+{
+	// what drdynvc offers a plugin while loading it, there is just the one plugin here.
+	struct EntryPoints
+	{
+		IDRDYNVC_ENTRY_POINTS iface;
+		IWTSPlugin* plugin;
+		rdpSettings* settings;
+	};
+	UINT RegisterPlugin(IDRDYNVC_ENTRY_POINTS* pEntryPoints, const char* name, IWTSPlugin* pPlugin)
+	{
+		((EntryPoints*)pEntryPoints)->plugin = pPlugin;
+		return CHANNEL_RC_OK;
+	}
+	IWTSPlugin* GetPlugin(IDRDYNVC_ENTRY_POINTS* pEntryPoints, const char* name)
+	{
+		return ((EntryPoints*)pEntryPoints)->plugin;
+	}
+	ADDIN_ARGV* GetPluginData(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
+	{
+		return NULL;
+	}
+	void* GetRdpSettings(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
+	{
+		return ((EntryPoints*)pEntryPoints)->settings;
+	}
+
+	// the invalid rectangles are collected between the two like for a window, then dropped.
+	BOOL BeginPaint(rdpContext* context)
+	{
+		rdpGdi* gdi = context->gdi;
+		gdi->primary->hdc->hwnd->invalid->null = 1;
+		gdi->primary->hdc->hwnd->ninvalid = 0;
+		return TRUE;
+	}
+	BOOL EndPaint(rdpContext* context)
+	{
+		return TRUE;
+	}
+	BOOL DesktopResize(rdpContext* context)
+	{
+		return gdi_resize(context->gdi, context->settings->DesktopWidth, context->settings->DesktopHeight);
+	}
+}
+
+HeadlessGfx::HeadlessGfx(unsigned int width, unsigned int height)
+	:m_Instance(NULL), m_Plugin(NULL), m_ChannelCallback(NULL), m_PduSent(0)
+{
+	memset(&m_Channel, 0, sizeof(m_Channel));
+	m_Channel.iface.Write = OnChannelWrite;
+	m_Channel.owner = this;
+	memset(&m_ChannelManager, 0, sizeof(m_ChannelManager));
+	m_ChannelManager.iface.CreateListener = OnCreateListener;
+
+	m_Instance = freerdp_new();
+	if (!m_Instance || !freerdp_context_new(m_Instance))
+	{
+		Release();
+		throw std::runtime_error("freerdp_context_new failed.");
+	}
+
+	rdpSettings* settings = m_Instance->settings;
+	settings->DesktopWidth = width;
+	settings->DesktopHeight = height;
+	settings->ColorDepth = 32;
+	settings->SupportGraphicsPipeline = TRUE;
+	// freerdp_connect would create the codecs the gdi shares with the surfaces, ResetGraphics resets them.
+	m_Instance->context->codecs = codecs_new(m_Instance->context);
+	if (!m_Instance->context->codecs)
+	{
+		Release();
+		throw std::runtime_error("codecs_new failed.");
+	}
+	if (!gdi_init(m_Instance, CLRCONV_ALPHA | CLRBUF_32BPP, NULL))
+	{
+		Release();
+		throw std::runtime_error("gdi_init failed.");
+	}
+	m_Instance->update->BeginPaint = BeginPaint;
+	m_Instance->update->EndPaint = EndPaint;
+	m_Instance->update->DesktopResize = DesktopResize;
+
+	// load the plugin, let it listen and open its channel the way drdynvc would.
+	EntryPoints entryPoints;
+	memset(&entryPoints, 0, sizeof(entryPoints));
+	entryPoints.iface.RegisterPlugin = RegisterPlugin;
+	entryPoints.iface.GetPlugin = GetPlugin;
+	entryPoints.iface.GetPluginData = GetPluginData;
+	entryPoints.iface.GetRdpSettings = GetRdpSettings;
+	entryPoints.settings = settings;
+	BOOL accept = TRUE;
+	if (rdpgfx_DVCPluginEntry(&entryPoints.iface) != CHANNEL_RC_OK || !entryPoints.plugin ||
+		entryPoints.plugin->Initialize(entryPoints.plugin, &m_ChannelManager.iface) != CHANNEL_RC_OK ||
+		!m_ChannelManager.listenerCallback ||
+		m_ChannelManager.listenerCallback->OnNewChannelConnection(m_ChannelManager.listenerCallback, &m_Channel.iface, NULL, &accept, &m_ChannelCallback) != CHANNEL_RC_OK)
+	{
+		m_Plugin = entryPoints.plugin;
+		Release();
+		throw std::runtime_error("rdpgfx failed to load.");
+	}
+	m_Plugin = entryPoints.plugin;
+	gdi_graphics_pipeline_init(m_Instance->context->gdi, (RdpgfxClientContext*)m_Plugin->pInterface);
+}
+HeadlessGfx::~HeadlessGfx()
+{
+	Release();
+}
+void HeadlessGfx::Release()
+{
+	// the channel deletes the surfaces and cache entries through the gdi, the plugin then frees its context.
+	if (m_ChannelCallback)
+	{
+		m_ChannelCallback->OnClose(m_ChannelCallback);
+		m_ChannelCallback = NULL;
+	}
+	if (m_Plugin)
+	{
+		if (m_Instance && m_Instance->context && m_Instance->context->gdi)
+			gdi_graphics_pipeline_uninit(m_Instance->context->gdi, (RdpgfxClientContext*)m_Plugin->pInterface);
+		m_Plugin->Terminated(m_Plugin);
+		m_Plugin = NULL;
+	}
+	if (m_Instance)
+	{
+		if (m_Instance->context)
+		{
+			gdi_free(m_Instance);
+			codecs_free(m_Instance->context->codecs);
+			m_Instance->context->codecs = NULL;
+			freerdp_context_free(m_Instance);
+		}
+		freerdp_free(m_Instance);
+		m_Instance = NULL;
+	}
+}
+IWTSVirtualChannelCallback* HeadlessGfx::GetChannelCallback() const
+{
+	return m_ChannelCallback;
+}
+const unsigned char* HeadlessGfx::GetPrimaryBuffer(unsigned int& width, unsigned int& height) const
+{
+	rdpGdi* gdi = m_Instance->context->gdi;
+	width = gdi->width;
+	height = gdi->height;
+	return gdi->primary_buffer;
+}
+unsigned int HeadlessGfx::GetPduSentCount() const
+{
+	return m_PduSent;
+}
+void HeadlessGfx::GetOutputBytes(unsigned long long& copied, unsigned long long& extents) const
+{
+	rdpGdi* gdi = m_Instance->context->gdi;
+	copied = gdi->outputBytesCopied;
+	extents = gdi->outputBytesExtents;
+}
+UINT HeadlessGfx::OnChannelWrite(IWTSVirtualChannel* pChannel, ULONG cbSize, BYTE* pBuffer, void* pReserved)
+{
+	((Channel*)pChannel)->owner->m_PduSent++;
+	return CHANNEL_RC_OK;
+}
+UINT HeadlessGfx::OnCreateListener(IWTSVirtualChannelManager* pChannelMgr, const char* pszChannelName, ULONG ulFlags,
+	IWTSListenerCallback* pListenerCallback, IWTSListener** ppListener)
+{
+	ChannelManager* manager = (ChannelManager*)pChannelMgr;
+	manager->listenerCallback = pListenerCallback;
+	*ppListener = &manager->listener;
+	return CHANNEL_RC_OK;
+}
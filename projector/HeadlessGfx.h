@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include "noncopyable.h"
+extern "C"
+{
+#include <freerdp/freerdp.h>
+#include <freerdp/dvc.h>
+}
+
+// The rdpgfx client with the software gdi behind it, without a connection or a window. Pdus handed to
+// the channel callback, e.g. by a D2DRender, are decoded into the primary buffer of the gdi like they are
+// for the desktop. Frame acknowledges and other pdus to the server are counted and dropped. Like the rest
+// of the projector it is built for Windows only.
+class HeadlessGfx : public Titanium::TIRA::NonCopyable
+{
+public:
+	/// The size of the primary buffer until a ResetGraphics pdu changes it.
+	HeadlessGfx(unsigned int width, unsigned int height);
+	~HeadlessGfx();
+
+	IWTSVirtualChannelCallback* GetChannelCallback() const;
+	/// The primary buffer, 32 bits a pixel, valid until the next ResetGraphics.
+	const unsigned char* GetPrimaryBuffer(unsigned int& width, unsigned int& height) const;
+	unsigned int GetPduSentCount() const;
+	/// The bytes the gdi copied from the surfaces into the primary buffer, and those the bounding boxes of the
+	/// damage hold, which a copy of each box would have taken.
+	void GetOutputBytes(unsigned long long& copied, unsigned long long& extents) const;
+private:
+	struct Channel
+	{
+		IWTSVirtualChannel iface;
+		HeadlessGfx* owner;
+	};
+	struct ChannelManager
+	{
+		IWTSVirtualChannelManager iface;
+		IWTSListener listener;
+		IWTSListenerCallback* listenerCallback;
+	};
+	static UINT OnChannelWrite(IWTSVirtualChannel* pChannel, ULONG cbSize, BYTE* pBuffer, void* pReserved);
+	static UINT OnCreateListener(IWTSVirtualChannelManager* pChannelMgr, const char* pszChannelName, ULONG ulFlags,
+		IWTSListenerCallback* pListenerCallback, IWTSListener** ppListener);
+	void Release();
+
+	freerdp* m_Instance;
+	IWTSPlugin* m_Plugin;
+	IWTSVirtualChannelCallback* m_ChannelCallback;
+	Channel m_Channel;
+	ChannelManager m_ChannelManager;
+	std::atomic<unsigned int> m_PduSent;
+};
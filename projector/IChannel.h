@@ -13,32 +13,36 @@ namespace Titanium{
 			availbelbitrate = 0;
 			losspacketsrate = 0;	
 			bytesReceived = 0;
+			bytesSent = 0;
+			messagesReceived = 0;
+			messagesSent = 0;
+			sendQueueBytes = 0;
+			receiveBitrate = 0;
+			sendBitrate = 0;
+			rttMicros = 0;
+			retransmits = 0;
+			blockedMicros = 0;
 		}
 
-		ChannelState(const ChannelState& ioMetrics)
-		{
-			availbelbitrate = ioMetrics.availbelbitrate;
-			losspacketsrate = ioMetrics.losspacketsrate;
-			bytesReceived = ioMetrics.bytesReceived;
-		}
-
-		ChannelState& operator=(const ChannelState& ioMetrics)
-		{
-			availbelbitrate = ioMetrics.availbelbitrate;
-			losspacketsrate = ioMetrics.losspacketsrate;
-			bytesReceived = ioMetrics.bytesReceived;
-
-			return *this;
-		}
-
-		uint32_t availbelbitrate;           //!< The current bit rate calculated by channel
+		uint32_t availbelbitrate;           //!< what the connection can carry, a congestion window per round trip, 0 if unknown
 		double  losspacketsrate;   //!< The rate of lost packets
 		uint64_t bytesReceived;
+		uint64_t bytesSent;
+		uint64_t messagesReceived;          //!< reads handed to the receivers
+		uint64_t messagesSent;              //!< Send and SendFrame calls
+		uint32_t sendQueueBytes;            //!< written but not yet handed to the connection
+		uint32_t receiveBitrate;            //!< trimmed mean of the latest samples, bits per second
+		uint32_t sendBitrate;
+		uint32_t rttMicros;                 //!< smoothed round trip time the kernel measured, 0 if unknown
+		uint32_t retransmits;
+		uint64_t blockedMicros;             //!< senders waiting for the queued data to leave
 	};
 	class IChannel
 	{
 	public:
 		typedef std::function<void(const unsigned char* pData, unsigned int dataLen)> OnDataReceivedAction;
+		/// pData shares ownership of the receiving buffer, holding it keeps the data valid without copying.
+		typedef std::function<void(std::shared_ptr<unsigned char> pData, unsigned int dataLen)> OnBufferReceivedAction;
 	public:
 		/// Starts the worker.
 		virtual void Start() = 0;
@@ -46,12 +50,16 @@ namespace Titanium{
 		virtual void Stop() = 0;
 		/// Puts data to internal buffer, Flush method will be called automatically if the internal buffer is full.
 		virtual void Send(const unsigned char* pData, unsigned int dataLen) = 0;
+		/// Sends header and payload as one frame with a gathered write, neither of them is copied.
+		virtual void SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen) = 0;
 		/// Cancel pending sending request.
 		virtual void CancelSend() = 0;
 		/// Sends all buffered data.
 		virtual void Flush() = 0;
 		/// Occurs when receives data.
 		virtual TIRA::SignalConnection RegisterDataReceivedEvent(OnDataReceivedAction action) = 0;
+		/// Occurs when receives data, same as RegisterDataReceivedEvent but the receiving buffer can be kept.
+		virtual TIRA::SignalConnection RegisterBufferReceivedEvent(OnBufferReceivedAction action) = 0;
 		/// inquiry channel ChannelState.
 		virtual bool GetChannelState(ChannelState& curChannelState) = 0;
 		/// Get channel Name.
@@ -1,9 +1,11 @@
 #include "IRdpSource.h"
 #include "RdpStreamingDef.h"
 #include "RdpStreamingParser.h"
+#include "LatencyTrace.h"
+#include <cstdint>
 
 
-IRdpSource::IRdpSource(std::shared_ptr<IChannel> channel) :m_Channel(channel), m_Parser(std::make_shared<RdpStreamingParser>())
+IRdpSource::IRdpSource(std::shared_ptr<IChannel> channel) :m_Channel(channel), m_Parser(std::make_shared<RdpStreamingParser>()), m_PushedStreams(0), m_MessageId(0), m_MinClockOffset(INT64_MAX)
 {
 
 }
@@ -13,15 +15,19 @@ IRdpSource::~IRdpSource()
 }
 void IRdpSource::Start()
 {
-	m_Channel->RegisterDataReceivedEvent([&](const unsigned char *data, int size)
+	m_Channel->RegisterBufferReceivedEvent([&](std::shared_ptr<unsigned char> data, unsigned int size)
 	{
+		m_ReceivedTime = std::chrono::steady_clock::now();
+		TraceScope trace("projector.receive");
 		m_Parser->Process(data, size);
 	});
-	m_Parser->RegisterMessageParsedEvent([&](const RdpStreamingMessage &msg)
+	m_Parser->RegisterMessageParsedEvent([&](const RdpStreamingMessage &msg, std::shared_ptr<unsigned char> body)
 	{
-		Stream stream(msg.m_ObjectHeader.m_PayloadLength);
-		memcpy(stream.buffer.get(), msg.m_ObjectBody, msg.m_ObjectHeader.m_PayloadLength);
-		_out->Push(stream);
+		m_MessageId = msg.m_HasExtension ? msg.m_Extension.m_Sequence : m_MessageId + 1;
+		if (msg.m_HasExtension && LatencyTrace::IsEnabled())
+			TraceNetwork(msg.m_Extension);
+		TraceScope trace("projector.source", m_MessageId);
+		OnMessage(body, msg.m_ObjectHeader.m_PayloadLength);
 	});
 	m_Channel->Start();
 }
@@ -32,3 +38,32 @@ void IRdpSource::Stop()
 void IRdpSource::Process()
 {
 }
+void IRdpSource::OnMessage(std::shared_ptr<unsigned char> body, unsigned int len)
+{
+	// the body is handed to the pipe as is, it may still point into the channel's receiving buffer.
+	if (body)
+		Push(Stream(body, len));
+	else
+		Push(Stream(0));
+}
+void IRdpSource::Push(Stream stream)
+{
+	stream.m_ReceivedTime = m_ReceivedTime;
+	stream.m_TraceId = m_MessageId;
+	_out->Push(std::move(stream));
+	m_PushedStreams++;
+}
+void IRdpSource::TraceNetwork(const RdpStreamingMsgExtension& extension)
+{
+	// the clocks of the redirector and the projector are unrelated. The smallest difference seen stands for
+	// their offset plus the fastest transit, so the stage is how much longer than that the message took.
+	long long received = (long long)LatencyTrace::ToTraceTime(m_ReceivedTime);
+	long long offset = received - (long long)extension.m_SentTime;
+	if (offset < m_MinClockOffset)
+		m_MinClockOffset = offset;
+	LatencyTrace::Record("projector.network", extension.m_Sequence, (uint64_t)((long long)extension.m_SentTime + m_MinClockOffset), (uint64_t)received);
+}
+unsigned long long IRdpSource::GetPushedStreamCount() const
+{
+	return m_PushedStreams;
+}
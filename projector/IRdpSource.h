@@ -3,6 +3,7 @@
 #include "ISource.h"
 #include "IChannel.h"
 class RdpStreamingParser;
+struct RdpStreamingMsgExtension;
 class IRdpSource : public Component, public ISource
 {
 public:
@@ -10,10 +11,23 @@ public:
 	virtual ~IRdpSource();
 	void Start();
 	void Stop();
+	/// Streams pushed to the pipe so far.
+	unsigned long long GetPushedStreamCount() const;
 protected:
 	virtual void Process();
+	/// Runs on the channel's receiving thread for every message, pushes the body to the pipe as is by default.
+	virtual void OnMessage(std::shared_ptr<unsigned char> body, unsigned int len);
+	/// Pushes the stream to the pipe stamped with the time the channel delivered the end of the current message.
+	void Push(Stream stream);
 	std::shared_ptr<Titanium::IChannel> m_Channel;
 private:
 	std::shared_ptr<RdpStreamingParser>	m_Parser;
+	void TraceNetwork(const RdpStreamingMsgExtension& extension);
+
+	std::chrono::steady_clock::time_point m_ReceivedTime;
+	std::atomic<unsigned long long> m_PushedStreams;
+	// the sequence the redirector gave the message being handled, or a count of its own.
+	unsigned long long m_MessageId;
+	long long m_MinClockOffset;
 };
 
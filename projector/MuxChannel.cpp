@@ -0,0 +1,25 @@
+#include "MuxChannel.h"
+using namespace Titanium;
+using namespace Titanium::TIRA;
+
+MuxChannel::MuxChannel(std::shared_ptr<MuxStream> stream, std::shared_ptr<SocketTcp> socket)
+	: TcpChannel(stream, stream, socket)
+	, m_Stream(stream)
+{
+	SetChannelName("MuxChannel");
+}
+
+MuxChannel::~MuxChannel()
+{
+	MuteAllExceptions([&]() { StopAsyncBase(); });
+}
+
+void MuxChannel::Workloop()
+{
+	while (CanLoopContinue())
+	{
+		std::shared_ptr<unsigned char> chunk;
+		unsigned int length = m_Stream->ReadChunk(chunk);
+		OnDataReceived(chunk, length);
+	}
+}
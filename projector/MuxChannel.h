@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+#include "TcpChannel.h"
+#include "MuxConnection.h"
+
+namespace Titanium
+{
+	// A channel carried as one stream of the multiplexed connection, the received frames are handed on
+	// as they are instead of being copied into a reading buffer.
+	class MuxChannel : public TcpChannel
+	{
+	public:
+		/// socket carries the connection, its round trip time is reported for every stream, it may be null.
+		explicit MuxChannel(std::shared_ptr<TIRA::MuxStream> stream, std::shared_ptr<TIRA::SocketTcp> socket = nullptr);
+		~MuxChannel();
+	protected:
+		virtual void Workloop();
+	private:
+		std::shared_ptr<TIRA::MuxStream> m_Stream;
+	};
+}
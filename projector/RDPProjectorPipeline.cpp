@@ -6,15 +6,17 @@ extern "C"
 #include "drdynvc_main.h"
 #include "rdpdr_main.h"
 #include "rdpsnd_main.h"
-__declspec(dllimport) drdynvcPlugin* g_drdynvc;
 __declspec(dllimport) BOOL g_IsAlive;
-__declspec(dllimport) rdpdrPlugin* g_rdpdrPlugin;
-__declspec(dllimport) rdpsndPlugin* g_rdpsndPlugin;
+__declspec(dllimport) drdynvcPlugin* drdynvc_find_plugin(rdpContext* context);
+__declspec(dllimport) rdpdrPlugin* rdpdr_find_plugin(rdpContext* context);
+__declspec(dllimport) rdpsndPlugin* rdpsnd_find_plugin(rdpContext* context);
 }
 #include <string>
-rdpContext* g_context = NULL;
+#include <atomic>
 const int Max_Hostname_Len = 40;
-RDPProjectorPipeline::RDPProjectorPipeline() :m_rdynvcPlugin(nullptr), m_rdpdrPlugin(nullptr), m_rdpsndPlugin(nullptr)
+// g_IsAlive is process wide, it is only cleared when the last session stops.
+static std::atomic<int> s_RunningPipelines(0);
+RDPProjectorPipeline::RDPProjectorPipeline() :m_Context(NULL), m_rdynvcPlugin(nullptr), m_rdpdrPlugin(nullptr), m_rdpsndPlugin(nullptr)
 { 
 }										 
 
@@ -23,16 +25,17 @@ RDPProjectorPipeline::~RDPProjectorPipeline()
 }
 void  RDPProjectorPipeline::Stop()
 {
-	if (g_context)
+	if (m_Context)
 	{
-		freerdp_client_stop(g_context);
-		freerdp_client_context_free(g_context);
-		g_context = NULL;
+		freerdp_client_stop(m_Context);
+		freerdp_client_context_free(m_Context);
+		m_Context = NULL;
+		if (--s_RunningPipelines == 0)
+			g_IsAlive = FALSE;
 	}
-	g_rdpdrPlugin = NULL;
-	g_rdpsndPlugin = NULL;
-	g_IsAlive = FALSE;
-	g_drdynvc = NULL;
+	m_rdynvcPlugin = nullptr;
+	m_rdpdrPlugin = nullptr;
+	m_rdpsndPlugin = nullptr;
 }
 void RDPProjectorPipeline::Start()
 {
@@ -48,8 +51,8 @@ void RDPProjectorPipeline::Start()
 	clientEntryPoints.Size = sizeof(RDP_CLIENT_ENTRY_POINTS);
 	clientEntryPoints.Version = RDP_CLIENT_INTERFACE_VERSION;
 	RdpClientEntry(&clientEntryPoints);
-	g_context = freerdp_client_context_new(&clientEntryPoints);
-	settings = g_context->settings;
+	m_Context = freerdp_client_context_new(&clientEntryPoints);
+	settings = m_Context->settings;
 	char *hostname = (char*)malloc(Max_Hostname_Len*sizeof(char));
 	std::string shostname("RdpProjector");
 	memcpy(hostname, shostname.c_str(), shostname.length()+1);
@@ -58,47 +61,63 @@ void RDPProjectorPipeline::Start()
 	settings->SoftwareGdi = TRUE;
 	settings->Fullscreen = TRUE;
 	g_IsAlive = TRUE;
-	g_context->argc = __argc;
-	g_context->argv = (char**)malloc(sizeof(char*) * (__argc + 1)); // to fix 
+	m_Context->argc = __argc;
+	m_Context->argv = (char**)malloc(sizeof(char*) * (__argc + 1)); // to fix 
 
-	if (!g_context->argv)
+	if (!m_Context->argv)
 	{
 		ret = 1;
 		printf("cmdline input error\n");
 		return;
 	}
-	for (index = 0; index < g_context->argc; index++)
+	for (index = 0; index < m_Context->argc; index++)
 	{
-		g_context->argv[index] = _strdup("");
-		if (!g_context->argv[index])
+		m_Context->argv[index] = _strdup("");
+		if (!m_Context->argv[index])
 		{
 			ret = 1;
 			for (--index; index >= 0; --index)
-				free(g_context->argv[index]);
-			free(g_context->argv);
-			g_context->argv = NULL;
+				free(m_Context->argv[index]);
+			free(m_Context->argv);
+			m_Context->argv = NULL;
 		}
 
 	}
 	// to fix
-	g_context->argc = 2;
-	g_context->argv[1] = "/vc:rdpsnd";
-	status = freerdp_client_settings_parse_command_line(settings, g_context->argc, g_context->argv, FALSE);
+	m_Context->argc = 2;
+	m_Context->argv[1] = "/vc:rdpsnd";
+	status = freerdp_client_settings_parse_command_line(settings, m_Context->argc, m_Context->argv, FALSE);
 	if (status)//Initialized failed
 	{
-		freerdp_client_context_free(g_context);
+		freerdp_client_context_free(m_Context);
+		m_Context = NULL;
 		return;
 	}
-	ret = freerdp_client_start(g_context);
-		
-	if (g_drdynvc == NULL || g_rdpdrPlugin == NULL || g_rdpsndPlugin == NULL || ret)
+	ret = freerdp_client_start(m_Context);
+	if (ret)
 	{
-		printf("g_drdynvc,g_rdpdrPlugin ,g_rdpsndPlugin could not be NULL \n");
+		// not counted as running, Stop has nothing to stop and the last pipeline still clears g_IsAlive.
+		printf("freerdp_client_start failed (%d)\n", ret);
+		freerdp_client_context_free(m_Context);
+		m_Context = NULL;
+		if (s_RunningPipelines == 0)
+			g_IsAlive = FALSE;
 		return;
 	}
-	m_rdynvcPlugin = g_drdynvc;
-	m_rdpdrPlugin = g_rdpdrPlugin;
-	m_rdpsndPlugin = g_rdpsndPlugin;
+	s_RunningPipelines++;
+
+	// the plugins are looked up by context, several sessions have their own instances loaded.
+	drdynvcPlugin* drdynvc = drdynvc_find_plugin(m_Context);
+	rdpdrPlugin* rdpdr = rdpdr_find_plugin(m_Context);
+	rdpsndPlugin* rdpsnd = rdpsnd_find_plugin(m_Context);
+	if (drdynvc == NULL || rdpdr == NULL || rdpsnd == NULL)
+	{
+		printf("drdynvc,rdpdr ,rdpsnd plugins could not be NULL \n");
+		return;
+	}
+	m_rdynvcPlugin = drdynvc;
+	m_rdpdrPlugin = rdpdr;
+	m_rdpsndPlugin = rdpsnd;
 	return;
 
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+struct rdp_context;
+/// One FreeRDP client context, each session runs its own.
 class RDPProjectorPipeline
 {
 public:
@@ -10,6 +12,7 @@ public:
 	void Start();
 	void Stop();
 private:
+	rdp_context* m_Context;
 	void* m_rdynvcPlugin;
 	void* m_rdpdrPlugin;
 	void* m_rdpsndPlugin;
@@ -1,10 +1,118 @@
 #include "RdpScreenSource.h"
+#include "GfxPdu.h"
+#include "error_handling_utility.h"
+#include "Logger.h"
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+extern "C"
+{
+#include <freerdp/codec/zgfx.h>
+#include <freerdp/channels/rdpgfx.h>
+}
 
-RdpScreenSource::RdpScreenSource(std::shared_ptr<Titanium::IChannel> channel) :IRdpSource(channel)
+using namespace Titanium::TIRA;
+
+RdpScreenSource::RdpScreenSource(std::shared_ptr<Titanium::IChannel> channel) :IRdpSource(channel), m_Frame(nullptr, 0), m_IsInFrame(false), m_IsBroken(false), m_FrameId(0), m_TotalFramesDecoded(0)
 {	
+	m_Zgfx = zgfx_context_new(FALSE);
+	if (!m_Zgfx)
+		throw std::runtime_error("zgfx_context_new failed.");
 }
 RdpScreenSource::~RdpScreenSource()
 {
 	Stop();
+	zgfx_context_free(m_Zgfx);
+}
+void RdpScreenSource::AcknowledgeFrame(unsigned int frameId, unsigned int queueDepth, unsigned int totalFramesDecoded)
+{
+	// same layout as RDPGFX_FRAME_ACKNOWLEDGE_PDU without the header, which is what the redirector reads.
+	unsigned int ack[] = { queueDepth, frameId, totalFramesDecoded };
+	m_TotalFramesDecoded = totalFramesDecoded;
+	m_Channel->Send((const unsigned char*)ack, sizeof(ack));
+}
+void RdpScreenSource::OnDecompressFailed(unsigned int len)
+{
+	std::ostringstream os;
+	os << "RdpScreenSource: zgfx_decompress failed on a " << len << " bytes message";
+	if (m_IsInFrame)
+		os << " in frame " << m_FrameId;
+	os << ", the screen stream is dropped from here on.";
+	LOGGING(os.str());
+
+	// the redirector relays the acknowledgements, the server counts a frame nobody acknowledges as in flight for good.
+	// the history is out of step with the server's, nothing later decodes right and the frames in it can
+	// not be acknowledged one by one.
+	MuteAllExceptions([&]()
+	{
+		if (m_IsInFrame)
+			AcknowledgeFrame(m_FrameId, 0, m_TotalFramesDecoded);
+		AcknowledgeFrame(0, SUSPEND_FRAME_ACKNOWLEDGEMENT, m_TotalFramesDecoded);
+	}, "AcknowledgeFrame");
+	m_Frame = Stream(nullptr, 0);
+	m_IsInFrame = false;
+	m_IsBroken = true;
+	zgfx_context_reset(m_Zgfx, FALSE);
 }
+void RdpScreenSource::OnMessage(std::shared_ptr<unsigned char> body, unsigned int len)
+{
+	if (!body || len == 0 || m_IsBroken)
+		return;
+
+	BYTE* pDstData = NULL;
+	UINT32 dstSize = 0;
+	if (zgfx_decompress(m_Zgfx, body.get(), len, &pDstData, &dstSize, 0) < 0)
+	{
+		// this runs on the channel's receiving thread, a broken message costs the screen stream, not the pipeline.
+		OnDecompressFailed(len);
+		return;
+	}
+
+	const unsigned char* p = pDstData;
+	unsigned int remaining = dstSize;
+	// consecutive pdus outside frames, they are pushed together before the next frame starts.
+	Stream state(nullptr, 0);
+	while (remaining > 0)
+	{
+		GfxPduHeader header;
+		if (!ReadGfxPduHeader(p, remaining, header))
+		{
+			// let the decoder report the broken pdu, do not guess frame boundaries any more for this message.
+			AppendPdu(m_IsInFrame ? m_Frame : state, p, remaining);
+			break;
+		}
+
+		if (!m_IsInFrame && header.cmdId == GFX_CMDID_STARTFRAME)
+		{
+			if (state.m_bufferSize > 0)
+			{
+				Push(std::move(state));
+				state = Stream(nullptr, 0);
+			}
+			m_Frame = Stream(INITIAL_FRAME_CAPACITY);
+			m_Frame.Resize(0);
+			m_IsInFrame = true;
+			m_FrameId = header.pduLength >= GFX_STARTFRAME_PDU_SIZE ? ReadGfxUInt32(p + GFX_HEADER_SIZE + 4) : 0;
+		}
 
+		AppendPdu(m_IsInFrame ? m_Frame : state, p, header.pduLength);
+		if (m_IsInFrame && header.cmdId == GFX_CMDID_ENDFRAME)
+		{
+			Push(std::move(m_Frame));
+			m_Frame = Stream(nullptr, 0);
+			m_IsInFrame = false;
+		}
+		p += header.pduLength;
+		remaining -= header.pduLength;
+	}
+	free(pDstData);
+
+	if (state.m_bufferSize > 0)
+		Push(std::move(state));
+}
+void RdpScreenSource::AppendPdu(Stream& stream, const unsigned char* pPdu, unsigned int len)
+{
+	size_t offset = stream.m_bufferSize;
+	stream.Resize(offset + len, true);
+	memcpy(stream.buffer.get() + offset, pPdu, len);
+}
@@ -1,10 +1,33 @@
 #pragma once
 #include "IRdpSource.h"
+#include <atomic>
 
+struct _ZGFX_CONTEXT;
 class RdpScreenSource : public IRdpSource
 {
 public:
 	RdpScreenSource(std::shared_ptr<Titanium::IChannel> channel);
 	virtual ~RdpScreenSource();
+	/// Reports a decoded frame to the redirector, which passes it on to the server as a FrameAcknowledge.
+	void AcknowledgeFrame(unsigned int frameId, unsigned int queueDepth, unsigned int totalFramesDecoded);
+protected:
+	/// Decompresses the gfx data and pushes every complete frame as one stream, pdus outside frames are pushed as they come.
+	/// A message that fails to decompress is dropped along with the frame being collected, which is acknowledged
+	/// so the server does not wait for it. The zgfx history no longer matches the server's from then on, the
+	/// later messages are dropped as well and the server is told to stop waiting for acknowledgements.
+	virtual void OnMessage(std::shared_ptr<unsigned char> body, unsigned int len);
+private:
+	void AppendPdu(Stream& stream, const unsigned char* pPdu, unsigned int len);
+	/// Drops the frame being collected and gives up on the stream after a message failed to decompress.
+	void OnDecompressFailed(unsigned int len);
+	struct _ZGFX_CONTEXT* m_Zgfx;
+	// the frame being collected, it may span several messages.
+	Stream m_Frame;
+	bool m_IsInFrame;
+	bool m_IsBroken;
+	// from the StartFrame of the frame being collected.
+	unsigned int m_FrameId;
+	// as the decoder last reported it, for the acknowledgements of the frames it never got.
+	std::atomic<unsigned int> m_TotalFramesDecoded;
+	static const unsigned int INITIAL_FRAME_CAPACITY = 64 * 1024;
 };
-
@@ -4,10 +4,25 @@ struct RdpStreamingMsgHeader
 	unsigned int  m_PayloadLength;
 };
 
+/// Set in m_PayloadLength when an RdpStreamingMsgExtension follows the header, the rest is the payload length.
+const unsigned int RDP_STREAMING_EXTENSION_FLAG = 0x80000000;
+
+#pragma pack(push, 1)
+/// Sent by a redirector which traces its latency, the projector takes the stages of the message from there on.
+struct RdpStreamingMsgExtension
+{
+	unsigned long long m_SentTime;   //!< micro seconds on the redirector's LatencyTrace clock when the channel data came in
+	unsigned int m_Sequence;         //!< counts the messages of the channel, the id of the message in a trace
+	unsigned int m_Reserved;
+};
+#pragma pack(pop)
+
 struct RdpStreamingMessage
 {
 	RdpStreamingMsgHeader m_ObjectHeader;
 	unsigned char*    m_ObjectBody;
+	bool m_HasExtension;
+	RdpStreamingMsgExtension m_Extension;
 };
 
 const unsigned int g_MsgHeaderSize = sizeof(RdpStreamingMsgHeader);
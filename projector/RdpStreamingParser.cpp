@@ -1,7 +1,12 @@
 #include "RdpStreamingParser.h"
 #include "RdpStreamingDef.h"
+#include "Stream.h"
+#include <algorithm>
+#include <cstring>
 
 RdpStreamingParser::RdpStreamingParser() :
+m_BodyLength(0),
+m_ExtensionLength(0),
 m_Stage(ParseStage::Header)
 {
 	m_HeaderBuffer.SetBufferSizeLowerBound(g_MessageSize);
@@ -11,6 +16,14 @@ m_Stage(ParseStage::Header)
 	m_pMessage = (RdpStreamingMessage*)m_HeaderBuffer.GetPtrForWriting();
 }
 void RdpStreamingParser::Process(const unsigned char* pData, unsigned int len)
+{
+	ProcessInternal(nullptr, pData, len);
+}
+void RdpStreamingParser::Process(std::shared_ptr<unsigned char> pData, unsigned int len)
+{
+	ProcessInternal(pData, pData.get(), len);
+}
+void RdpStreamingParser::ProcessInternal(const std::shared_ptr<unsigned char>& owner, const unsigned char* pData, unsigned int len)
 {
 	while (len > 0)
 	{
@@ -19,34 +32,47 @@ void RdpStreamingParser::Process(const unsigned char* pData, unsigned int len)
 		case ParseStage::Header:
 		{
 			unsigned int headerBytesNeed = g_MsgHeaderSize - m_HeaderBuffer.GetDataLength();
-			unsigned int headerBytesToProcess = MIN(len, headerBytesNeed);
+			unsigned int headerBytesToProcess = std::min(len, headerBytesNeed);
 			m_HeaderBuffer.AppendFrom(pData, headerBytesToProcess);
 			pData += headerBytesToProcess;
 			len -= headerBytesToProcess;
 			if (g_MsgHeaderSize == m_HeaderBuffer.GetDataLength())
 			{
-				if (m_pHeader->m_PayloadLength == 0)
+				m_pMessage->m_HasExtension = (m_pHeader->m_PayloadLength & RDP_STREAMING_EXTENSION_FLAG) != 0;
+				m_pHeader->m_PayloadLength &= ~RDP_STREAMING_EXTENSION_FLAG;
+				if (m_pMessage->m_HasExtension)
 				{
-					OnMessageParsed();
+					m_Stage = ParseStage::Extension;
+					m_ExtensionLength = 0;
 				}
 				else
-				{
-					m_Stage = ParseStage::Body;
-					m_BodyBuffer.SetBufferSizeLowerBound(m_pHeader->m_PayloadLength);
-					m_BodyBuffer.Clear();
-					m_pMessage->m_ObjectBody = m_BodyBuffer.GetPtrForWriting();
-				}
+					StartBody(owner, pData, len);
+			}
+		}
+		break;
+		case ParseStage::Extension:
+		{
+			unsigned int extensionBytesToProcess = std::min(len, (unsigned int)sizeof(m_Extension) - m_ExtensionLength);
+			memcpy((unsigned char*)&m_Extension + m_ExtensionLength, pData, extensionBytesToProcess);
+			m_ExtensionLength += extensionBytesToProcess;
+			pData += extensionBytesToProcess;
+			len -= extensionBytesToProcess;
+			if (m_ExtensionLength == sizeof(m_Extension))
+			{
+				m_pMessage->m_Extension = m_Extension;
+				StartBody(owner, pData, len);
 			}
 		}
 		break;
 		case ParseStage::Body:
 		{
-			unsigned int bodyBytesNeed = m_pHeader->m_PayloadLength - m_BodyBuffer.GetDataLength();
-			unsigned int bodyBytesToProcess = MIN(len, bodyBytesNeed);
-			m_BodyBuffer.AppendFrom(pData, bodyBytesToProcess);
+			unsigned int bodyBytesNeed = m_pHeader->m_PayloadLength - m_BodyLength;
+			unsigned int bodyBytesToProcess = std::min(len, bodyBytesNeed);
+			memcpy(m_Body.get() + m_BodyLength, pData, bodyBytesToProcess);
+			m_BodyLength += bodyBytesToProcess;
 			pData += bodyBytesToProcess;
 			len -= bodyBytesToProcess;
-			if (m_pHeader->m_PayloadLength == m_BodyBuffer.GetDataLength())
+			if (m_pHeader->m_PayloadLength == m_BodyLength)
 			{
 				OnMessageParsed();
 			}
@@ -54,12 +80,39 @@ void RdpStreamingParser::Process(const unsigned char* pData, unsigned int len)
 		}
 	}
 }
+void RdpStreamingParser::StartBody(const std::shared_ptr<unsigned char>& owner, const unsigned char*& pData, unsigned int& len)
+{
+	unsigned int payloadLength = m_pHeader->m_PayloadLength;
+	if (payloadLength == 0)
+	{
+		m_Body.reset();
+		OnMessageParsed();
+	}
+	else if (owner && len >= payloadLength)
+	{
+		// the whole body is in the received buffer, share it instead of copying.
+		m_Body = std::shared_ptr<unsigned char>(owner, const_cast<unsigned char*>(pData));
+		pData += payloadLength;
+		len -= payloadLength;
+		OnMessageParsed();
+	}
+	else
+	{
+		// the body straddles received buffers, collect it into one of its own.
+		m_Stage = ParseStage::Body;
+		m_Body = Stream(payloadLength).buffer;
+		m_BodyLength = 0;
+	}
+}
 void RdpStreamingParser::OnMessageParsed()
 {
+	std::shared_ptr<unsigned char> body;
+	body.swap(m_Body);
+	m_BodyLength = 0;
 	m_Stage = ParseStage::Header;
 	m_HeaderBuffer.Clear();
-	m_BodyBuffer.Clear();
-	m_MessageParsed(*m_pMessage);
+	m_pMessage->m_ObjectBody = body.get();
+	m_MessageParsed(*m_pMessage, body);
 }
 SignalConnection RdpStreamingParser::RegisterMessageParsedEvent(OnMessageParsedAction action)
 {
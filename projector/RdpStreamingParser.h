@@ -1,29 +1,40 @@
 #pragma once
 #include <functional>
+#include <memory>
 #include "SignalConnection.h"
 #include "DataBuffer.h"
+#include "RdpStreamingDef.h"
 
-struct RdpStreamingMessage;
-struct RdpStreamingMsgHeader;
 using namespace Titanium;
 using namespace Titanium::TIRA;
 class RdpStreamingParser
 {
 public:
-	typedef std::function<void(const RdpStreamingMessage &msg)> OnMessageParsedAction;
+	/// body owns the payload of msg, it is null when the payload is empty.
+	typedef std::function<void(const RdpStreamingMessage &msg, std::shared_ptr<unsigned char> body)> OnMessageParsedAction;
 	RdpStreamingParser();
+	/// Copies every body out of pData.
 	void Process(const unsigned char* pData, unsigned int len);
+	/// pData shares ownership of the received buffer, a body lying entirely inside it is handed out as a view without copying.
+	void Process(std::shared_ptr<unsigned char> pData, unsigned int len);
 	SignalConnection RegisterMessageParsedEvent(OnMessageParsedAction);
 protected:
 	void OnMessageParsed();
 private:
+	void ProcessInternal(const std::shared_ptr<unsigned char>& owner, const unsigned char* pData, unsigned int len);
+	/// Takes the body out of pData when it is all there, otherwise starts collecting it.
+	void StartBody(const std::shared_ptr<unsigned char>& owner, const unsigned char*& pData, unsigned int& len);
 	enum class ParseStage
 	{
 		Header,
+		Extension,
 		Body
 	};
-	Signal<void(const RdpStreamingMessage &msg)> m_MessageParsed;
-	DataBuffer<unsigned char> m_BodyBuffer;
+	Signal<void(const RdpStreamingMessage &msg, std::shared_ptr<unsigned char> body)> m_MessageParsed;
+	std::shared_ptr<unsigned char> m_Body;
+	unsigned int m_BodyLength;
+	RdpStreamingMsgExtension m_Extension;
+	unsigned int m_ExtensionLength;
 	DataBuffer<unsigned char> m_HeaderBuffer;
 	RdpStreamingMsgHeader *m_pHeader;
 	RdpStreamingMessage *m_pMessage;
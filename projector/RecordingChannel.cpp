@@ -0,0 +1,141 @@
+#include "RecordingChannel.h"
+#include "AsyncWriter.h"
+#include "error_handling_utility.h"
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace Titanium;
+using namespace Titanium::TIRA;
+
+namespace
+{
+	class FileWriter : public WritableSource
+	{
+	public:
+		explicit FileWriter(const std::string& path) :m_File(fopen(path.c_str(), "wb")), m_IsInError(false)
+		{
+			if (!m_File)
+				throw std::runtime_error("Failed to create " + path);
+		}
+		~FileWriter()
+		{
+			fclose(m_File);
+		}
+		virtual void WaitTillSourceIdeal()
+		{
+			fflush(m_File);
+		}
+		/// Drops the data once a write failed, the writer keeps draining its ring so the recording side never blocks on it.
+		virtual void WriteBytes(const unsigned char* buffer, int bufLen)
+		{
+			if (!m_IsInError && fwrite(buffer, 1, bufLen, m_File) != (size_t)bufLen)
+				m_IsInError = true;
+		}
+		virtual void Cancel()
+		{
+		}
+		virtual bool IsSourceInError()
+		{
+			return m_IsInError;
+		}
+	private:
+		FILE* m_File;
+		std::atomic<bool> m_IsInError;
+	};
+}
+
+RecordingChannel::RecordingChannel(std::shared_ptr<IChannel> channel, ChannelHelloType type, const std::string& path)
+	:m_Channel(channel), m_StartTime(std::chrono::steady_clock::now())
+{
+	m_Writer = std::make_shared<AsyncWriter>(std::make_shared<FileWriter>(path), WRITER_RING_SIZE, WRITER_MAX_WRITE, 1);
+	ChannelRecordingHeader header = { CHANNEL_RECORDING_MAGIC, CHANNEL_RECORDING_VERSION, (unsigned int)type };
+	m_Writer->Write(header);
+	// connected ahead of the receivers, so every buffer is on disk before anything it starts runs.
+	m_RecordingConnection = m_Channel->RegisterBufferReceivedEvent([this](std::shared_ptr<unsigned char> data, unsigned int size)
+	{
+		Record(data.get(), size);
+	});
+}
+RecordingChannel::~RecordingChannel()
+{
+	m_RecordingConnection.Disconnect();
+	if (m_Writer)
+	{
+		MuteAllExceptions([&]()
+		{
+			if (!m_Writer->IsSourceInError())
+				m_Writer->WaitTillSourceIdeal();
+			m_Writer->Close();
+		}, "RecordingChannel");
+	}
+}
+void RecordingChannel::Record(const unsigned char* pData, unsigned int dataLen)
+{
+	if (!m_Writer)
+		return;
+	if (m_Writer->IsSourceInError())
+	{
+		MuteAllExceptions([&]() { m_Writer->Close(); }, "RecordingChannel");
+		m_Writer.reset();
+		return;
+	}
+
+	ChannelRecordingEntry entry;
+	entry.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_StartTime).count();
+	entry.length = dataLen;
+	try
+	{
+		m_Writer->Write(entry);
+		m_Writer->WriteBytes(pData, dataLen);
+	}
+	catch (...)
+	{
+		MuteAllExceptions([&]() { m_Writer->Close(); }, "RecordingChannel");
+		m_Writer.reset();
+	}
+}
+void RecordingChannel::Start()
+{
+	m_Channel->Start();
+}
+void RecordingChannel::Stop()
+{
+	m_Channel->Stop();
+}
+void RecordingChannel::Send(const unsigned char* pData, unsigned int dataLen)
+{
+	m_Channel->Send(pData, dataLen);
+}
+void RecordingChannel::SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen)
+{
+	m_Channel->SendFrame(pHeader, headerLen, pPayload, payloadLen);
+}
+void RecordingChannel::CancelSend()
+{
+	m_Channel->CancelSend();
+}
+void RecordingChannel::Flush()
+{
+	m_Channel->Flush();
+}
+SignalConnection RecordingChannel::RegisterDataReceivedEvent(OnDataReceivedAction action)
+{
+	return m_Channel->RegisterDataReceivedEvent(action);
+}
+SignalConnection RecordingChannel::RegisterBufferReceivedEvent(OnBufferReceivedAction action)
+{
+	return m_Channel->RegisterBufferReceivedEvent(action);
+}
+bool RecordingChannel::GetChannelState(ChannelState& curChannelState)
+{
+	return m_Channel->GetChannelState(curChannelState);
+}
+std::string RecordingChannel::GetChannelName()
+{
+	return m_Channel->GetChannelName();
+}
+void RecordingChannel::SetChannelName(const std::string& SetName)
+{
+	m_Channel->SetChannelName(SetName);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include "IChannel.h"
+#include "ChannelHello.h"
+#include "noncopyable.h"
+
+#define CHANNEL_RECORDING_MAGIC 0x43455254 // "TREC"
+#define CHANNEL_RECORDING_VERSION 1
+
+// A recording is a ChannelRecordingHeader followed by every buffer the channel received, each as a
+// ChannelRecordingEntry and its bytes. The buffers are the length prefixed RdpStreaming messages as they
+// came off the connection, cut wherever the reads happened to end.
+#pragma pack(push, 1)
+struct ChannelRecordingHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int channel;      //!< ChannelHelloType
+};
+struct ChannelRecordingEntry
+{
+	unsigned long long time;   //!< micro seconds since the recording started
+	unsigned int length;
+};
+#pragma pack(pop)
+
+namespace Titanium
+{
+	namespace TIRA
+	{
+		class AsyncWriter;
+	}
+
+	// Passes everything through to the channel it wraps and records what the channel receives, see
+	// ReplayChannel for playing it back. The file is written on a thread of its own, the receiving thread
+	// only waits when the disk falls behind by more than the writer's ring. A failing file ends the
+	// recording and never the channel.
+	class RecordingChannel : public IChannel, public TIRA::NonCopyable
+	{
+	public:
+		RecordingChannel(std::shared_ptr<IChannel> channel, ChannelHelloType type, const std::string& path);
+		~RecordingChannel();
+	public:
+		virtual void Start();
+		virtual void Stop();
+		virtual void Send(const unsigned char* pData, unsigned int dataLen);
+		virtual void SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen);
+		virtual void CancelSend();
+		virtual void Flush();
+		virtual TIRA::SignalConnection RegisterDataReceivedEvent(OnDataReceivedAction action);
+		virtual TIRA::SignalConnection RegisterBufferReceivedEvent(OnBufferReceivedAction action);
+		virtual bool GetChannelState(ChannelState& curChannelState);
+		virtual std::string GetChannelName();
+		virtual void SetChannelName(const std::string& SetName);
+	private:
+		void Record(const unsigned char* pData, unsigned int dataLen);
+
+		std::shared_ptr<IChannel> m_Channel;
+		std::shared_ptr<TIRA::AsyncWriter> m_Writer;
+		std::chrono::steady_clock::time_point m_StartTime;
+		TIRA::Scoped_connection m_RecordingConnection;
+		static const unsigned int WRITER_RING_SIZE = 8 * 1024 * 1024;
+		static const unsigned int WRITER_MAX_WRITE = 256 * 1024;
+	};
+}
@@ -3,18 +3,28 @@
 #include "D2DRender.h"
 #include "RdpScreenSource.h"
 #include "HIDRedirector.h"
-#include "SocketTcpServer.h"
+#include "ChannelAcceptor.h"
+#include "EventLoop.h"
 #include "TcpChannel.h"
+#include "MuxChannel.h"
+#include "RecordingChannel.h"
 #include "AudioSource.h"
 #include "AudioPlayback.h"
 #include "RdpDRSource.h"
 #include "DeviceRedirecr.h"
 #include "TouchAndPen.h"
+#include "error_handling_utility.h"
 #include <functional>
+#include <iomanip>
+#include <sstream>
 
-static const int RDP_STREAMING_LISTENING_PORT = 5263;
+static const int CHANNEL_WAIT_TIMEOUT_MS = 30000;
 static const int DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE = 6000;
 static const int DEFAULT_SOCKET_SEND_BUFFER_SIZE = 1400;
+// whole frames and runs of state pdus, when it is full the redirector and then the server are held back.
+static const int SCREEN_QUEUE_SIZE = 16;
+// the screen is the one stream which keeps the connection busy, let it have more in flight.
+static const unsigned int MUX_SCREEN_WINDOW = 4 * MUX_DEFAULT_WINDOW;
 using namespace std;
 using namespace Titanium;
 using namespace Titanium::TIRA;
@@ -23,13 +33,44 @@ extern "C"
 #include "rdpdr_main.h"
 #include "rdpsnd_main.h"
 }
-RedirectChannelFactory::RedirectChannelFactory(std::shared_ptr<Titanium::TIRA::SocketTcp> socket) :m_Server(std::make_shared<SocketTcpServer>(RDP_STREAMING_LISTENING_PORT))
+RedirectChannelFactory::RedirectChannelFactory(std::shared_ptr<ChannelAcceptor> acceptor, unsigned long long token) :m_Acceptor(acceptor), m_Token(token)
 {
-	m_Server->StartListening();
 }
 RedirectChannelFactory::~RedirectChannelFactory()
 {
-	m_Server->StopListening();
+}
+std::shared_ptr<SocketTcp> RedirectChannelFactory::WaitForChannel(ChannelHelloType channel)
+{
+	// only this session's connection is taken, other sessions may be setting up their channels at the same time.
+	return m_Acceptor->WaitForChannel(m_Token, channel, std::chrono::milliseconds(CHANNEL_WAIT_TIMEOUT_MS));
+}
+std::shared_ptr<TcpChannel> RedirectChannelFactory::OpenChannel(ChannelHelloType channel, const char* name)
+{
+	std::shared_ptr<TcpChannel> opened;
+	if (m_MuxConnection)
+	{
+		opened = std::make_shared<MuxChannel>(m_MuxStreams[channel], m_MuxSocket);
+	}
+	else
+	{
+		auto socket = WaitForChannel(channel);
+		socket->SetTcpNoDelay(true);
+		socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
+		socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
+		socket->AttachEventLoop(EventLoop::GetDefault());
+		opened = std::make_shared<TcpChannel>(socket);
+	}
+	lock_guard<mutex> lock(m_ChannelsMtx);
+	m_Channels.push_back(make_pair(string(name), opened));
+	return opened;
+}
+std::shared_ptr<IChannel> RedirectChannelFactory::RecordChannel(std::shared_ptr<IChannel> channel, ChannelHelloType type, const char* name)
+{
+	if (m_RecordingDirectory.empty())
+		return channel;
+	ostringstream path;
+	path << m_RecordingDirectory << "/session" << m_Token << "-" << name << ".rec";
+	return std::make_shared<RecordingChannel>(channel, type, path.str());
 }
 void RedirectChannelFactory::InitialRDPProjectorPipeline()
 {
@@ -47,33 +88,31 @@ void RedirectChannelFactory::InitialRDPProjectorPipeline()
 }
 void RedirectChannelFactory::SetupScreenPipeline()
 {
-	auto socket = m_Server->WaitForConnection();
-	socket->SetTcpNoDelay(true);
-	socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
-	socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
-	auto videosocket = std::make_shared<TcpChannel>(socket);
+	auto videosocket = RecordChannel(OpenChannel(CHANNEL_HELLO_SCREEN, "screen"), CHANNEL_HELLO_SCREEN, "screen");
 	m_RdpSource = std::make_shared<RdpScreenSource>(videosocket);
+	m_RdpSource->SetOutPipe(SCREEN_QUEUE_SIZE);
 	(*m_RdpSource) >> (*m_D2DRender);
+	std::weak_ptr<RdpScreenSource> weakSource = m_RdpSource;
+	m_FrameAckConnection = m_D2DRender->RegisterFrameDecodedEvent([weakSource](unsigned int frameId, unsigned int queueDepth, unsigned int totalFramesDecoded)
+	{
+		auto source = weakSource.lock();
+		if (source)
+		{
+			MuteAllExceptions([&]() { source->AcknowledgeFrame(frameId, queueDepth, totalFramesDecoded); }, "AcknowledgeFrame");
+		}
+	});
 	m_RdpSource->Start();
 	m_D2DRender->Start();
 }
 void RedirectChannelFactory::SetupHIDPipeline()
 {
-	auto socket = m_Server->WaitForConnection();
-	socket->SetTcpNoDelay(true);
-	socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
-	socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
-	auto hidsocket = std::make_shared<TcpChannel>(socket);
+	auto hidsocket = OpenChannel(CHANNEL_HELLO_HID, "hid");
 	m_HIDRedirector = std::make_shared<HIDRedirector>(hidsocket);
 	m_HIDRedirector->Start();
 }
 void RedirectChannelFactory::SetupDrRedirect()
 {
-	auto socket = m_Server->WaitForConnection();
-	socket->SetTcpNoDelay(true);
-	socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
-	socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
-	auto drsocket = std::make_shared<TcpChannel>(socket);
+	auto drsocket = RecordChannel(OpenChannel(CHANNEL_HELLO_DR, "dr"), CHANNEL_HELLO_DR, "dr");
 	m_RdpDRSource = std::make_shared<RdpDRSource>(drsocket);
 	(*m_RdpDRSource) >> (*m_DeviceRedirecr);
 	m_RdpDRSource->Start();
@@ -81,11 +120,7 @@ void RedirectChannelFactory::SetupDrRedirect()
 }
 void RedirectChannelFactory::SetupAudioPlaybackRedirect()
 {
-	auto socket = m_Server->WaitForConnection();
-	socket->SetTcpNoDelay(true);
-	socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
-	socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
-	auto audiosocket = std::make_shared<TcpChannel>(socket);
+	auto audiosocket = RecordChannel(OpenChannel(CHANNEL_HELLO_AUDIOPLAYBACK, "audio"), CHANNEL_HELLO_AUDIOPLAYBACK, "audio");
 	m_AudioSource = std::make_shared<AudioSource>(audiosocket);
 	(*m_AudioSource) >> (*m_AudioPlayback);
 	m_AudioSource->Start();
@@ -93,13 +128,31 @@ void RedirectChannelFactory::SetupAudioPlaybackRedirect()
 }
 void RedirectChannelFactory::SetupTouchAndPenRedirect()
 {
-	auto socket = m_Server->WaitForConnection();
-	socket->SetTcpNoDelay(true);
-	socket->SetRecvBufferSize(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE);
-	socket->SetSendBufferSize(DEFAULT_SOCKET_SEND_BUFFER_SIZE);
-	auto touchAndPenChannel = std::make_shared<TcpChannel>(socket);
+	auto touchAndPenChannel = OpenChannel(CHANNEL_HELLO_TOUCHANDPEN, "touchandpen");
 	m_TouchAndPen = std::make_shared<TouchAndPen>(touchAndPenChannel);
 }
+void RedirectChannelFactory::SetupMultiplexedChannels()
+{
+	auto socket = WaitForChannel(CHANNEL_HELLO_MUX);
+	socket->SetTcpNoDelay(true);
+	socket->AttachEventLoop(EventLoop::GetDefault());
+	m_MuxConnection = std::make_shared<MuxConnection>(socket);
+	m_MuxSocket = socket;
+
+	const ChannelHelloType channels[] = { CHANNEL_HELLO_SCREEN, CHANNEL_HELLO_HID, CHANNEL_HELLO_DR, CHANNEL_HELLO_AUDIOPLAYBACK, CHANNEL_HELLO_TOUCHANDPEN };
+	for (auto channel : channels)
+	{
+		unsigned int window = channel == CHANNEL_HELLO_SCREEN ? MUX_SCREEN_WINDOW : MUX_DEFAULT_WINDOW;
+		m_MuxStreams[channel] = m_MuxConnection->OpenStream((unsigned char)channel, GetChannelStreamPriority(channel), window);
+	}
+	m_MuxConnection->Start();
+
+	SetupScreenPipeline();
+	SetupHIDPipeline();
+	SetupDrRedirect();
+	SetupAudioPlaybackRedirect();
+	SetupTouchAndPenRedirect();
+}
 void RedirectChannelFactory::DestoryAllChannel()
 {
 	// stop oreder must like this ,because of the dependence of each module
@@ -121,4 +174,37 @@ void RedirectChannelFactory::DestoryAllChannel()
 		m_AudioPlayback->Stop();
 	if (m_TouchAndPen)
 		m_TouchAndPen.reset();
-}
\ No newline at end of file
+	// the channels above are done with their streams by now.
+	if (m_MuxConnection)
+		m_MuxConnection->Stop();
+}
+void RedirectChannelFactory::SetRecordingDirectory(const std::string& directory)
+{
+	m_RecordingDirectory = directory;
+}
+void RedirectChannelFactory::Activate()
+{
+	if (m_HIDRedirector)
+		m_HIDRedirector->Activate();
+}
+std::string RedirectChannelFactory::FormatChannelStats()
+{
+	vector<pair<string, shared_ptr<TcpChannel>>> channels;
+	{
+		lock_guard<mutex> lock(m_ChannelsMtx);
+		channels = m_Channels;
+	}
+	ostringstream os;
+	os << fixed << setprecision(2);
+	for (auto it = channels.begin(); it != channels.end(); ++it)
+	{
+		ChannelState state;
+		if (!it->second->GetChannelState(state))
+			continue;
+		os << "session" << m_Token << " " << it->first << ": received " << state.bytesReceived << " B in " << state.messagesReceived
+			<< " at " << state.receiveBitrate / 1000000.0 << " Mbit/s, sent " << state.bytesSent << " B in " << state.messagesSent
+			<< " at " << state.sendBitrate / 1000000.0 << " Mbit/s, queued " << state.sendQueueBytes << " B, blocked "
+			<< state.blockedMicros / 1000.0 << " ms, rtt " << state.rttMicros / 1000.0 << " ms, " << state.retransmits << " retransmits\n";
+	}
+	return os.str();
+}
@@ -1,7 +1,14 @@
 #pragma once
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "SocketTcp.h"
-class Titanium::TIRA::SocketTcpServer;
+#include "MuxConnection.h"
+#include "SignalConnection.h"
+#include "ChannelHello.h"
+class ChannelAcceptor;
 class RDPProjectorPipeline;
 class D2DRender;
 class RdpScreenSource;
@@ -11,10 +18,15 @@ class AudioPlayback;
 class RdpDRSource;
 class DeviceRedirecr;
 class TouchAndPen;
+namespace Titanium
+{
+	class IChannel;
+	class TcpChannel;
+}
 class RedirectChannelFactory
 {
 public:
-	RedirectChannelFactory(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	RedirectChannelFactory(std::shared_ptr<ChannelAcceptor> acceptor, unsigned long long token);
 	~RedirectChannelFactory();
 	void InitialRDPProjectorPipeline();
 	void SetupScreenPipeline();
@@ -22,9 +34,23 @@ public:
 	void SetupDrRedirect();
 	void SetupAudioPlaybackRedirect();
 	void SetupTouchAndPenRedirect();
+	/// Takes all the channels from one connection instead of a connection each, the pipeline must be initialized.
+	void SetupMultiplexedChannels();
 	void DestoryAllChannel();
+	void Activate();
+	/// The channels set up from now on are recorded into the directory as session<token>-<channel>.rec.
+	void SetRecordingDirectory(const std::string& directory);
+	/// A line per channel opened so far with its counters, see ChannelState.
+	std::string FormatChannelStats();
 private:
-	std::shared_ptr<Titanium::TIRA::SocketTcpServer> m_Server;
+	std::shared_ptr<Titanium::TIRA::SocketTcp> WaitForChannel(ChannelHelloType channel);
+	std::shared_ptr<Titanium::TcpChannel> OpenChannel(ChannelHelloType channel, const char* name);
+	/// Wraps the channel in a RecordingChannel when there is a recording directory.
+	std::shared_ptr<Titanium::IChannel> RecordChannel(std::shared_ptr<Titanium::IChannel> channel, ChannelHelloType type, const char* name);
+
+	std::shared_ptr<ChannelAcceptor> m_Acceptor;
+	const unsigned long long m_Token;
+	std::string m_RecordingDirectory;
 	std::shared_ptr<RDPProjectorPipeline> m_RDPProjectorPipeline;
 	std::shared_ptr<D2DRender> m_D2DRender;
 	std::shared_ptr<RdpScreenSource> m_RdpSource;
@@ -34,4 +60,11 @@ private:
 	std::shared_ptr<RdpDRSource> m_RdpDRSource;
 	std::shared_ptr<DeviceRedirecr> m_DeviceRedirecr;
 	std::shared_ptr<TouchAndPen> m_TouchAndPen;
+	Titanium::TIRA::Scoped_connection m_FrameAckConnection;
+	std::shared_ptr<Titanium::TIRA::MuxConnection> m_MuxConnection;
+	std::map<ChannelHelloType, std::shared_ptr<Titanium::TIRA::MuxStream>> m_MuxStreams;
+	std::shared_ptr<Titanium::TIRA::SocketTcp> m_MuxSocket;
+	// the channels are opened on the rtsp thread and asked for their state on the one dumping the stats.
+	std::mutex m_ChannelsMtx;
+	std::vector<std::pair<std::string, std::shared_ptr<Titanium::TcpChannel>>> m_Channels;
 };
\ No newline at end of file
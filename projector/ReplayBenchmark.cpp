@@ -0,0 +1,205 @@
+// ReplayBenchmark.cpp : replays what the redirector sent on one channel through the stages it passes in a
+// session: ReplayChannel -> RdpStreamingParser -> source -> Pipe -> D2DRender -> rdpgfx -> gdi.
+//
+
+#include "ReplayBenchmark.h"
+#include "ReplayChannel.h"
+#include "RdpScreenSource.h"
+#include "AudioSource.h"
+#include "RdpDRSource.h"
+#include "D2DRender.h"
+#include "HeadlessGfx.h"
+#include "LatencyHistogram.h"
+#include "LatencyTrace.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+
+using namespace Titanium;
+using namespace Titanium::TIRA;
+
+// the session's screen queue, see RedirectChannelFactory.
+static const int SCREEN_QUEUE_SIZE = 16;
+// until the first ResetGraphics pdu sizes the primary surface.
+static const unsigned int DESKTOP_WIDTH = 1920;
+static const unsigned int DESKTOP_HEIGHT = 1080;
+static const std::chrono::seconds IDLE_TIMEOUT(5);
+
+namespace
+{
+	// What the pipeline did with the streams of the source, filled on the thread taking them.
+	struct StageStats
+	{
+		StageStats() :streams(0), frames(0) {}
+
+		LatencyHistogram queue;   //!< channel delivered to the sink taking the stream
+		LatencyHistogram decode;  //!< in rdpgfx and the gdi
+		LatencyHistogram total;   //!< channel delivered to decoded
+		std::atomic<unsigned long long> streams;
+		std::atomic<unsigned long long> frames;
+		std::mutex mtx;
+		std::condition_variable taken;
+
+		void Add(const Stream& stream, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+		{
+			queue.Add(start - stream.m_ReceivedTime);
+			decode.Add(end - start);
+			total.Add(end - stream.m_ReceivedTime);
+			std::lock_guard<std::mutex> lock(mtx);
+			streams++;
+			taken.notify_all();
+		}
+		/// Waits until the sink took as many streams as the source pushed, or took none for a while because
+		/// it skipped some, e.g. D2DRender a stream of one byte.
+		void WaitFor(const IRdpSource& source)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			while (streams < source.GetPushedStreamCount())
+			{
+				unsigned long long before = streams;
+				if (!taken.wait_for(lock, IDLE_TIMEOUT, [&]() { return streams != before; }))
+					break;
+			}
+		}
+	};
+
+	// Stands in for AudioPlayback and DeviceRedirecr, their rdpsnd and rdpdr plugins need a connection and a device.
+	class CountingSink : public Component, public ISink
+	{
+	public:
+		explicit CountingSink(StageStats& stats) :m_Stats(stats), m_IsAlive(false) {}
+		virtual void Start()
+		{
+			m_IsAlive = true;
+			Component::Start();
+		}
+		virtual void Stop()
+		{
+			m_IsAlive = false;
+			_in->Push(Stream(0));
+			Component::Stop();
+		}
+	protected:
+		virtual void Process()
+		{
+			Stream stream = _in->Pop();
+			// an empty message is a stream too, only the one pushed by Stop is not.
+			if (!m_IsAlive)
+				return;
+			auto now = std::chrono::steady_clock::now();
+			m_Stats.Add(stream, now, now);
+		}
+	private:
+		StageStats& m_Stats;
+		std::atomic<bool> m_IsAlive;
+	};
+
+	void PrintStage(const char* name, const LatencyHistogram& histogram)
+	{
+		printf("%-10s %s\n", name, histogram.Format().c_str());
+	}
+	double PerSecond(double count, std::chrono::microseconds duration)
+	{
+		return duration.count() > 0 ? count * 1000000 / duration.count() : 0;
+	}
+}
+
+int RunReplayBenchmark(const std::string& path, bool timed)
+{
+	std::shared_ptr<ReplayChannel> channel;
+	try
+	{
+		channel = std::make_shared<ReplayChannel>(path);
+	}
+	catch (std::exception& ex)
+	{
+		printf("%s\n", ex.what());
+		return 1;
+	}
+	channel->SetTimed(timed);
+
+	StageStats stats;
+	std::shared_ptr<IRdpSource> source;
+	std::shared_ptr<Component> sink;
+	std::shared_ptr<HeadlessGfx> gfx;
+	Scoped_connection frameAckConnection;
+	Scoped_connection streamDecodedConnection;
+	switch (channel->GetRecordedChannel())
+	{
+	case CHANNEL_HELLO_SCREEN:
+	{
+		gfx = std::make_shared<HeadlessGfx>(DESKTOP_WIDTH, DESKTOP_HEIGHT);
+		auto screenSource = std::make_shared<RdpScreenSource>(channel);
+		auto render = std::make_shared<D2DRender>(gfx->GetChannelCallback());
+		screenSource->SetOutPipe(SCREEN_QUEUE_SIZE);
+		(*screenSource) >> (*render);
+		RdpScreenSource* ackSource = screenSource.get();
+		frameAckConnection = render->RegisterFrameDecodedEvent([ackSource, &stats](unsigned int frameId, unsigned int queueDepth, unsigned int totalFramesDecoded)
+		{
+			stats.frames++;
+			ackSource->AcknowledgeFrame(frameId, queueDepth, totalFramesDecoded);
+		});
+		streamDecodedConnection = render->RegisterStreamDecodedEvent([&stats](const Stream& stream, std::chrono::steady_clock::time_point decodeStart, std::chrono::steady_clock::time_point decodeEnd)
+		{
+			stats.Add(stream, decodeStart, decodeEnd);
+		});
+		source = screenSource;
+		sink = render;
+	}
+	break;
+	case CHANNEL_HELLO_AUDIOPLAYBACK:
+	case CHANNEL_HELLO_DR:
+	{
+		auto countingSink = std::make_shared<CountingSink>(stats);
+		if (channel->GetRecordedChannel() == CHANNEL_HELLO_DR)
+			source = std::make_shared<RdpDRSource>(channel);
+		else
+			source = std::make_shared<AudioSource>(channel);
+		(*source) >> (*countingSink);
+		sink = countingSink;
+	}
+	break;
+	default:
+		printf("%s holds channel %u, only the screen, audio and device redirection channels are replayed.\n", path.c_str(), (unsigned int)channel->GetRecordedChannel());
+		return 1;
+	}
+
+	printf("replaying %s: %u buffers, %llu bytes, %.3f s recorded%s\n", path.c_str(), (unsigned int)channel->GetBufferCount(),
+		channel->GetRecordedBytes(), channel->GetRecordedDuration().count() / 1000000.0, timed ? ", timed" : "");
+	auto start = std::chrono::steady_clock::now();
+	sink->Start();
+	source->Start();
+	bool isComplete = channel->WaitTillFinished();
+	if (isComplete)
+		stats.WaitFor(*source);
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	source->Stop();
+	sink->Stop();
+	frameAckConnection.Disconnect();
+	streamDecodedConnection.Disconnect();
+
+	if (!isComplete)
+		printf("replay failed: %s\n", channel->GetError().c_str());
+	PrintStage("channel", channel->GetDeliveryHistogram());
+	PrintStage("queue", stats.queue);
+	PrintStage("decode", stats.decode);
+	PrintStage("total", stats.total);
+	if (timed)
+		PrintStage("lag", channel->GetLagHistogram());
+	printf("%llu streams, %llu frames in %.3f s: %.1f fps\n", (unsigned long long)stats.streams, (unsigned long long)stats.frames,
+		elapsed.count() / 1000000.0, PerSecond((double)stats.frames, elapsed));
+	printf("%.2f MB/s replayed, %.2f MB/s recorded, %llu bytes sent back\n", PerSecond(channel->GetRecordedBytes() / 1048576.0, elapsed),
+		PerSecond(channel->GetRecordedBytes() / 1048576.0, channel->GetRecordedDuration()), channel->GetBytesSent());
+	if (gfx)
+	{
+		unsigned long long copied, extents;
+		gfx->GetOutputBytes(copied, extents);
+		printf("%llu bytes copied to the primary buffer, %.1f KB a frame, %.1f%% of the damage bounding boxes\n", copied,
+			stats.frames > 0 ? copied / 1024.0 / stats.frames : 0.0, extents > 0 ? copied * 100.0 / extents : 0.0);
+	}
+	if (LatencyTrace::IsEnabled())
+		printf("%s", LatencyTrace::FormatSummary().c_str());
+	return isComplete ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+
+/// Plays a channel recording through the projector pipeline without a redirector or a window and prints the
+/// latency of every stage, the frame rate and the throughput. A screen recording is decoded by rdpgfx into the
+/// software gdi, audio and device redirection recordings are parsed and their streams counted. timed replays
+/// at the recorded pace instead of as fast as the pipeline takes it. Returns 0 when the whole recording played.
+/// Windows only, it is built into the projector and the replay path has no build for other platforms.
+int RunReplayBenchmark(const std::string& path, bool timed);
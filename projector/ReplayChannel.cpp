@@ -0,0 +1,181 @@
+#include "ReplayChannel.h"
+#include "RecordingChannel.h"
+#include <cstdio>
+#include <stdexcept>
+
+using namespace Titanium;
+using namespace Titanium::TIRA;
+
+ReplayChannel::ReplayChannel(const std::string& path)
+	:m_RecordedBytes(0), m_IsTimed(false), m_IsStopping(false), m_IsFinished(false), m_BytesDelivered(0), m_BytesSent(0)
+{
+	SetChannelName("ReplayChannel");
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		throw std::runtime_error("Failed to open " + path);
+
+	ChannelRecordingHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CHANNEL_RECORDING_MAGIC || header.version != CHANNEL_RECORDING_VERSION)
+	{
+		fclose(file);
+		throw std::runtime_error(path + " is not a channel recording.");
+	}
+	m_RecordedChannel = (ChannelHelloType)header.channel;
+
+	// a recording cut short by the projector going down ends in a partial entry, which is left out.
+	ChannelRecordingEntry entry;
+	while (fread(&entry, sizeof(entry), 1, file) == 1)
+	{
+		std::shared_ptr<unsigned char> data(new unsigned char[entry.length > 0 ? entry.length : 1], std::default_delete<unsigned char[]>());
+		if (fread(data.get(), 1, entry.length, file) != entry.length)
+			break;
+		Entry replayed = { std::chrono::microseconds(entry.time), data, entry.length };
+		m_Entries.push_back(replayed);
+		m_RecordedBytes += entry.length;
+	}
+	fclose(file);
+}
+ReplayChannel::~ReplayChannel()
+{
+	Stop();
+}
+void ReplayChannel::Start()
+{
+	if (m_Thread)
+		return;
+	m_Thread.reset(new std::thread([this]() { Replay(); }));
+}
+void ReplayChannel::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mtx);
+		m_IsStopping = true;
+		m_StateChanged.notify_all();
+	}
+	if (m_Thread && m_Thread->get_id() != std::this_thread::get_id())
+	{
+		m_Thread->join();
+		m_Thread.reset();
+	}
+}
+void ReplayChannel::Replay()
+{
+	auto start = std::chrono::steady_clock::now();
+	auto firstTime = m_Entries.empty() ? std::chrono::microseconds(0) : m_Entries.front().time;
+	for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it)
+	{
+		auto due = start + (it->time - firstTime);
+		{
+			std::unique_lock<std::mutex> lock(m_Mtx);
+			if (m_IsTimed)
+				m_StateChanged.wait_until(lock, due, [this]() { return m_IsStopping; });
+			if (m_IsStopping)
+				break;
+		}
+
+		auto delivered = std::chrono::steady_clock::now();
+		if (m_IsTimed)
+			m_Lag.Add(delivered - due);
+		try
+		{
+			m_SignalBufferReceived(it->data, it->length);
+			m_SignalDataReceived(it->data.get(), it->length);
+		}
+		catch (std::exception& ex)
+		{
+			Finish(ex.what());
+			return;
+		}
+		m_Delivery.Add(std::chrono::steady_clock::now() - delivered);
+		m_BytesDelivered += it->length;
+	}
+	Finish(std::string());
+}
+void ReplayChannel::Finish(const std::string& error)
+{
+	std::lock_guard<std::mutex> lock(m_Mtx);
+	m_Error = error;
+	m_IsFinished = true;
+	m_StateChanged.notify_all();
+}
+bool ReplayChannel::WaitTillFinished()
+{
+	std::unique_lock<std::mutex> lock(m_Mtx);
+	m_StateChanged.wait(lock, [this]() { return m_IsFinished || m_IsStopping; });
+	return m_Error.empty();
+}
+std::string ReplayChannel::GetError()
+{
+	std::lock_guard<std::mutex> lock(m_Mtx);
+	return m_Error;
+}
+ChannelHelloType ReplayChannel::GetRecordedChannel() const
+{
+	return m_RecordedChannel;
+}
+void ReplayChannel::SetTimed(bool timed)
+{
+	m_IsTimed = timed;
+}
+size_t ReplayChannel::GetBufferCount() const
+{
+	return m_Entries.size();
+}
+unsigned long long ReplayChannel::GetRecordedBytes() const
+{
+	return m_RecordedBytes;
+}
+std::chrono::microseconds ReplayChannel::GetRecordedDuration() const
+{
+	if (m_Entries.empty())
+		return std::chrono::microseconds(0);
+	return m_Entries.back().time - m_Entries.front().time;
+}
+unsigned long long ReplayChannel::GetBytesSent() const
+{
+	return m_BytesSent;
+}
+const LatencyHistogram& ReplayChannel::GetDeliveryHistogram() const
+{
+	return m_Delivery;
+}
+const LatencyHistogram& ReplayChannel::GetLagHistogram() const
+{
+	return m_Lag;
+}
+void ReplayChannel::Send(const unsigned char* pData, unsigned int dataLen)
+{
+	m_BytesSent += dataLen;
+}
+void ReplayChannel::SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen)
+{
+	m_BytesSent += headerLen + payloadLen;
+}
+void ReplayChannel::CancelSend()
+{
+}
+void ReplayChannel::Flush()
+{
+}
+SignalConnection ReplayChannel::RegisterDataReceivedEvent(OnDataReceivedAction action)
+{
+	return m_SignalDataReceived.connect(action);
+}
+SignalConnection ReplayChannel::RegisterBufferReceivedEvent(OnBufferReceivedAction action)
+{
+	return m_SignalBufferReceived.connect(action);
+}
+bool ReplayChannel::GetChannelState(ChannelState& curChannelState)
+{
+	curChannelState.bytesReceived = m_BytesDelivered;
+	curChannelState.bytesSent = m_BytesSent;
+	return true;
+}
+std::string ReplayChannel::GetChannelName()
+{
+	return m_ChannelName;
+}
+void ReplayChannel::SetChannelName(const std::string& SetName)
+{
+	m_ChannelName = SetName;
+}
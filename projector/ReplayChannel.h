@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IChannel.h"
+#include "ChannelHello.h"
+#include "LatencyHistogram.h"
+#include "noncopyable.h"
+
+namespace Titanium
+{
+	// Plays a recording of RecordingChannel back as if the redirector sent it. The buffers are delivered on
+	// a thread of the channel, either back to back or each at its recorded time after the first one.
+	// Whatever is sent to the channel is counted and dropped.
+	class ReplayChannel : public IChannel, public TIRA::NonCopyable
+	{
+	public:
+		/// Reads the whole recording, throws if the file is not one.
+		explicit ReplayChannel(const std::string& path);
+		~ReplayChannel();
+
+		ChannelHelloType GetRecordedChannel() const;
+		/// Delivers the buffers at their recorded times instead of back to back, set it before Start.
+		void SetTimed(bool timed);
+		/// Waits until the receivers are done with the last buffer or the channel is stopped, returns false
+		/// when a receiver threw, GetError tells what.
+		bool WaitTillFinished();
+		std::string GetError();
+
+		size_t GetBufferCount() const;
+		unsigned long long GetRecordedBytes() const;
+		std::chrono::microseconds GetRecordedDuration() const;
+		unsigned long long GetBytesSent() const;
+		/// The time the receivers took for each buffer, read it once the replay finished.
+		const TIRA::LatencyHistogram& GetDeliveryHistogram() const;
+		/// How much later than recorded each buffer was delivered, only filled by a timed replay.
+		const TIRA::LatencyHistogram& GetLagHistogram() const;
+	public:
+		virtual void Start();
+		virtual void Stop();
+		virtual void Send(const unsigned char* pData, unsigned int dataLen);
+		virtual void SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen);
+		virtual void CancelSend();
+		virtual void Flush();
+		virtual TIRA::SignalConnection RegisterDataReceivedEvent(OnDataReceivedAction action);
+		virtual TIRA::SignalConnection RegisterBufferReceivedEvent(OnBufferReceivedAction action);
+		virtual bool GetChannelState(ChannelState& curChannelState);
+		virtual std::string GetChannelName();
+		virtual void SetChannelName(const std::string& SetName);
+	private:
+		struct Entry
+		{
+			std::chrono::microseconds time;
+			std::shared_ptr<unsigned char> data;
+			unsigned int length;
+		};
+		void Replay();
+		void Finish(const std::string& error);
+
+		std::vector<Entry> m_Entries;
+		ChannelHelloType m_RecordedChannel;
+		unsigned long long m_RecordedBytes;
+		bool m_IsTimed;
+		std::unique_ptr<std::thread> m_Thread;
+		std::mutex m_Mtx;
+		std::condition_variable m_StateChanged;
+		bool m_IsStopping;
+		bool m_IsFinished;
+		std::string m_Error;
+		std::atomic<unsigned long long> m_BytesDelivered;
+		std::atomic<unsigned long long> m_BytesSent;
+		TIRA::LatencyHistogram m_Delivery;
+		TIRA::LatencyHistogram m_Lag;
+		TIRA::Signal<void(const unsigned char*, unsigned int)> m_SignalDataReceived;
+		TIRA::Signal<void(std::shared_ptr<unsigned char>, unsigned int)> m_SignalBufferReceived;
+	};
+}
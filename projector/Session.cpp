@@ -3,6 +3,8 @@
 #include "RedirectChannelFactory.h"
 #include "TcpChannel.h"
 #include "RtspSession.h"
+#include "ChannelAcceptor.h"
+#include "ChannelHello.h"
 #include <iostream>
 #include <sstream>
 #include <memory>
@@ -11,10 +13,14 @@ using namespace std;
 using namespace Titanium;
 using namespace Titanium::TIRA;
 
-Session::Session(shared_ptr<SocketTcp> socket)
-	: _rtsp(make_shared<RtspSession>(socket))
-	, m_RedirectChannelFactory(std::make_shared<RedirectChannelFactory>(socket))
+Session::Session(shared_ptr<SocketTcp> socket, shared_ptr<ChannelAcceptor> acceptor, unsigned long long token)
+	: m_Acceptor(acceptor)
+	, m_Token(token)
+	, m_RedirectChannelFactory(std::make_shared<RedirectChannelFactory>(acceptor, token))
+	, _rtsp(make_shared<RtspSession>(socket))
+	, m_Stopped(false)
 {
+	m_Acceptor->AddSession(m_Token);
 }
 
 Session::~Session()
@@ -41,7 +47,7 @@ void Session::Start()
 			try
 			{
 				m_RedirectChannelFactory->InitialRDPProjectorPipeline();
-				_rtsp->Send(ResponseMsg(request.GetCSeq(), true));
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
 				m_RedirectChannelFactory->SetupScreenPipeline();
 			}
 			catch (std::exception &e)
@@ -49,12 +55,30 @@ void Session::Start()
 				_rtsp->Send(ResponseMsg(request.GetCSeq(), false, e.what()));
 			}
 		}
+		else if (request.GetCmd() == "SETUP_MUX_CHANNEL")
+		{
+			// every channel of the session over the one connection the redirector opens next.
+			try
+			{
+				m_RedirectChannelFactory->InitialRDPProjectorPipeline();
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
+				m_RedirectChannelFactory->SetupMultiplexedChannels();
+				if (ConnectedEvent)
+					ConnectedEvent(this);
+			}
+			catch (std::exception &e)
+			{
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), false, e.what()));
+			}
+		}
 		else if (request.GetCmd() == "SETUP_HID_CHANNEL")
 		{
 			try
 			{
-				_rtsp->Send(ResponseMsg(request.GetCSeq(), true));
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
 				m_RedirectChannelFactory->SetupHIDPipeline();
+				if (ConnectedEvent)
+					ConnectedEvent(this);
 			}
 			catch (std::exception &e)
 			{
@@ -65,7 +89,7 @@ void Session::Start()
 		{
 			try
 			{
-				_rtsp->Send(ResponseMsg(request.GetCSeq(), true));
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
 				m_RedirectChannelFactory->SetupDrRedirect();
 			}
 			catch (std::exception &e)
@@ -77,7 +101,7 @@ void Session::Start()
 		{
 			try
 			{
-				_rtsp->Send(ResponseMsg(request.GetCSeq(), true));
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
 				m_RedirectChannelFactory->SetupAudioPlaybackRedirect();
 			}
 			catch (std::exception &e)
@@ -89,7 +113,7 @@ void Session::Start()
 		{
 			try
 			{
-				_rtsp->Send(ResponseMsg(request.GetCSeq(), true));
+				_rtsp->Send(ResponseMsg(request.GetCSeq(), true, GetChannelEndpoint()));
 				m_RedirectChannelFactory->SetupTouchAndPenRedirect();
 			}
 			catch (std::exception &e)
@@ -100,13 +124,38 @@ void Session::Start()
 	};
 	_rtsp->DisconnectedByClientEvent = [this]()
 	{
-		DisconnectedEvent(this);
+		if (DisconnectedEvent)
+			DisconnectedEvent(this);
 	};
 	_rtsp->Start();
 }
 
 void Session::Stop()
 {
+	if (m_Stopped)
+		return;
+	m_Stopped = true;
 	_rtsp->Stop();
 	m_RedirectChannelFactory->DestoryAllChannel();
+	m_Acceptor->DropSession(m_Token);
+}
+
+void Session::Activate()
+{
+	m_RedirectChannelFactory->Activate();
+}
+
+void Session::SetRecordingDirectory(const std::string& directory)
+{
+	m_RedirectChannelFactory->SetRecordingDirectory(directory);
+}
+
+std::string Session::FormatChannelStats()
+{
+	return m_RedirectChannelFactory->FormatChannelStats();
+}
+
+std::string Session::GetChannelEndpoint() const
+{
+	return FormatChannelEndpoint(m_Acceptor->GetPort(), m_Token);
 }
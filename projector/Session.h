@@ -4,19 +4,32 @@
 #include "SocketTcp.h"
 class RedirectChannelFactory;
 class RtspSession;
+class ChannelAcceptor;
 class Session
 {
 public:
-	Session(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	Session(std::shared_ptr<Titanium::TIRA::SocketTcp> socket, std::shared_ptr<ChannelAcceptor> acceptor, unsigned long long token);
 	~Session();
 
 	void Start();
+	/// Joins the session's threads and closes its channels, later calls do nothing.
 	void Stop();
+	/// Routes the local input to this session.
+	void Activate();
+	/// Records the screen, audio and device redirection channels into the directory, set it before Start.
+	void SetRecordingDirectory(const std::string& directory);
+	/// A line per channel with its counters.
+	std::string FormatChannelStats();
 
 	std::function<void(Session*)> ConnectedEvent;
 	std::function<void(Session*)> DisconnectedEvent;
 private:
+	std::string GetChannelEndpoint() const;
+
+	std::shared_ptr<ChannelAcceptor> m_Acceptor;
+	unsigned long long m_Token;
 	std::shared_ptr<RedirectChannelFactory> m_RedirectChannelFactory;
 	std::shared_ptr<RtspSession> _rtsp;
+	bool m_Stopped;
 };
 
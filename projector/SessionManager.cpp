@@ -1,24 +1,159 @@
 #include "SessionManager.h"
 #include "Session.h"
+#include "ChannelAcceptor.h"
+#include "EventLoop.h"
+#include <stdexcept>
+#include <thread>
+extern "C"
+{
+#include <winpr/crypto.h>
+}
 
 using namespace std;
+using namespace Titanium::TIRA;
 
-void SessionManager::Add(shared_ptr<Session> session)
+SessionManager::SessionManager(unsigned short channelPort)
+	: _acceptor(make_shared<ChannelAcceptor>(channelPort, EventLoop::GetDefault()))
+	, _activeSession(nullptr)
+	, _stopping(false)
 {
-	lock_guard<mutex> lock(_mutex);
-	_sessions.push_back(session);
+	_remover = thread([this]() { RemoverLoop(); });
+	_acceptor->Start();
 }
-void SessionManager::Remove(Session *session)
+SessionManager::~SessionManager()
 {
-	lock_guard<mutex> lock(_mutex);
-	if (session == _activeSession)
+	list<shared_ptr<Session>> sessions;
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+		sessions.swap(_sessions);
 		_activeSession = nullptr;
-	_sessions.remove_if([=](shared_ptr<Session> s){return session == s.get(); });
+		_removeQueue.clear();
+	}
+	_removeCv.notify_all();
+	_remover.join();
+	// a session disconnecting until it is stopped finds the manager stopping and leaves it alone, once
+	// stopped none of its threads is left to raise an event.
+	for (auto it = sessions.begin(); it != sessions.end(); ++it)
+	{
+		(*it)->Stop();
+		(*it)->ConnectedEvent = nullptr;
+		(*it)->DisconnectedEvent = nullptr;
+	}
+	sessions.clear();
+	_acceptor->Stop();
+}
+shared_ptr<Session> SessionManager::StartSession(shared_ptr<SocketTcp> socket)
+{
+	auto session = make_shared<Session>(socket, _acceptor, NewToken());
+	{
+		lock_guard<mutex> lock(_mutex);
+		session->SetRecordingDirectory(_recordingDirectory);
+	}
+	session->ConnectedEvent = [this](Session* s)
+	{
+		SetActive(s);
+	};
+	session->DisconnectedEvent = [this](Session* s)
+	{
+		// raised on the session's own rtsp thread, which the session joins when it is destroyed.
+		{
+			lock_guard<mutex> lock(_mutex);
+			if (_stopping)
+				return;
+			_removeQueue.push_back(s);
+		}
+		_removeCv.notify_one();
+	};
+	{
+		lock_guard<mutex> lock(_mutex);
+		_sessions.push_back(session);
+	}
+	session->Start();
+	return session;
+}
+void SessionManager::Remove(Session *session)
+{
+	shared_ptr<Session> removed;
+	shared_ptr<Session> activated;
+	{
+		lock_guard<mutex> lock(_mutex);
+		for (auto it = _sessions.begin(); it != _sessions.end(); ++it)
+		{
+			if (it->get() == session)
+			{
+				removed = *it;
+				_sessions.erase(it);
+				break;
+			}
+		}
+		if (session == _activeSession)
+		{
+			// the input goes to the most recent presenter left.
+			_activeSession = _sessions.empty() ? nullptr : _sessions.back().get();
+			if (!_sessions.empty())
+				activated = _sessions.back();
+		}
+	}
+	// stopping joins the session's threads, keep it out of the lock.
+	removed.reset();
+	if (activated)
+		activated->Activate();
 }
 void SessionManager::SetActive(Session *session)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_activeSession = session;
+	}
+	session->Activate();
+}
+size_t SessionManager::GetSessionCount()
+{
+	lock_guard<mutex> lock(_mutex);
+	return _sessions.size();
+}
+void SessionManager::SetRecordingDirectory(const std::string& directory)
 {
 	lock_guard<mutex> lock(_mutex);
-	if (_activeSession != nullptr)
-		Remove(_activeSession);
-	_activeSession = session;
-}
\ No newline at end of file
+	_recordingDirectory = directory;
+}
+std::string SessionManager::FormatChannelStats()
+{
+	// a session removed meanwhile is kept alive by the copy until it is formatted.
+	list<shared_ptr<Session>> sessions;
+	{
+		lock_guard<mutex> lock(_mutex);
+		sessions = _sessions;
+	}
+	string stats;
+	for (auto it = sessions.begin(); it != sessions.end(); ++it)
+		stats += (*it)->FormatChannelStats();
+	return stats;
+}
+void SessionManager::RemoverLoop()
+{
+	unique_lock<mutex> lock(_mutex);
+	while (true)
+	{
+		_removeCv.wait(lock, [this]() { return _stopping || !_removeQueue.empty(); });
+		if (_stopping)
+			return;
+		Session* session = _removeQueue.front();
+		_removeQueue.pop_front();
+		lock.unlock();
+		Remove(session);
+		lock.lock();
+	}
+}
+unsigned long long SessionManager::NewToken()
+{
+	// the token is all a data connection shows to be part of a session, it must not be guessable from another one.
+	unsigned long long token = 0;
+	do
+	{
+		if (winpr_RAND((BYTE*)&token, sizeof(token)) < 0)
+			throw runtime_error("winpr_RAND failed.");
+	} while (token == 0);
+	return token;
+}
@@ -1,17 +1,43 @@
 #pragma once
+#include <condition_variable>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include "SocketTcp.h"
 
 class Session;
+class ChannelAcceptor;
+// Hosts the concurrent sessions, they share one data port and each gets a token the redirector
+// names in the hello of its data connections. The active session receives the local input.
 class SessionManager
 {
 public:
-	void Add(std::shared_ptr<Session> session);
+	explicit SessionManager(unsigned short channelPort);
+	~SessionManager();
+
+	/// Creates and starts a session for a negotiation connection.
+	std::shared_ptr<Session> StartSession(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
 	void Remove(Session *session);
 	void SetActive(Session *session);
+	size_t GetSessionCount();
+	/// Sessions started from now on record their channels into the directory, none do when it is empty.
+	void SetRecordingDirectory(const std::string& directory);
+	/// The channel counters of all sessions, a line per channel.
+	std::string FormatChannelStats();
 private:
+	/// A random token from the crypto generator, never 0.
+	static unsigned long long NewToken();
+	/// Removes the sessions which disconnected, off their own threads since removing one joins them.
+	void RemoverLoop();
+
+	std::shared_ptr<ChannelAcceptor> _acceptor;
 	std::list<std::shared_ptr<Session>> _sessions;
 	Session *_activeSession;
+	std::string _recordingDirectory;
 	std::mutex _mutex;
-};
\ No newline at end of file
+	std::condition_variable _removeCv;
+	std::list<Session*> _removeQueue;
+	bool _stopping;
+	std::thread _remover;
+};
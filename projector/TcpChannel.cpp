@@ -6,16 +6,57 @@
 using namespace Titanium;
 using namespace Titanium::TIRA;
 
-#define READING_BUF_SIZE 16
+#define READING_BUF_SIZE (256 * 1024)
+#define READING_BUF_MIN_SPACE (16 * 1024)
+#define READING_BUF_POOLED 8
 #define WRITING_BUF_SIZE 1316
 #define random(x) (rand()%x)
+// the throughput is the trimmed mean of this many samples, taken when the state is asked for.
+#define THROUGHPUT_SAMPLES 8
+#define THROUGHPUT_MIN_SAMPLE_US 500000
 
 TcpChannel::TcpChannel(std::shared_ptr<SocketTcp> socket)
 	: AsyncBase("SimpleTcpChannel")
+	, m_ReadingPool(std::make_shared<BufferPool>(READING_BUF_SIZE, READING_BUF_POOLED))
+	, m_ReadingOffset(0)
 	, m_Writer(std::make_shared<AsyncSocketWriter>(socket))
 	, m_Reader(std::make_shared<ReadableSocket>(socket))
+	, m_Socket(socket)
+	, m_BytesReceived(0)
+	, m_BytesSent(0)
+	, m_MessagesReceived(0)
+	, m_MessagesSent(0)
+	, m_BlockedMicros(0)
+	, m_LastSampleTime(std::chrono::steady_clock::now())
+	, m_LastBytesReceived(0)
+	, m_LastBytesSent(0)
+	, m_ReceiveBitrate(THROUGHPUT_SAMPLES)
+	, m_SendBitrate(THROUGHPUT_SAMPLES)
+	, m_HasThroughput(false)
+{
+	m_InternalWritingBuffer.SetBufferSizeLowerBound(WRITING_BUF_SIZE);
+	SetChannelName("SimpleTcpChannel");
+}
+
+TcpChannel::TcpChannel(std::shared_ptr<ReadableSource> reader, std::shared_ptr<WritableSource> writer, std::shared_ptr<SocketTcp> socket)
+	: AsyncBase("SimpleTcpChannel")
+	, m_ReadingPool(std::make_shared<BufferPool>(READING_BUF_SIZE, READING_BUF_POOLED))
+	, m_ReadingOffset(0)
+	, m_Writer(writer)
+	, m_Reader(reader)
+	, m_Socket(socket)
+	, m_BytesReceived(0)
+	, m_BytesSent(0)
+	, m_MessagesReceived(0)
+	, m_MessagesSent(0)
+	, m_BlockedMicros(0)
+	, m_LastSampleTime(std::chrono::steady_clock::now())
+	, m_LastBytesReceived(0)
+	, m_LastBytesSent(0)
+	, m_ReceiveBitrate(THROUGHPUT_SAMPLES)
+	, m_SendBitrate(THROUGHPUT_SAMPLES)
+	, m_HasThroughput(false)
 {
-	m_InternalBuffer.SetBufferSizeLowerBound(READING_BUF_SIZE);
 	m_InternalWritingBuffer.SetBufferSizeLowerBound(WRITING_BUF_SIZE);
 	SetChannelName("SimpleTcpChannel");
 }
@@ -28,6 +69,9 @@ void TcpChannel::Send(const unsigned char* pData, unsigned int dataLen)
 {
 	//if (!IsAsyncBaseRunning())
 		//throw ExceptionWithString("Channel is not started!");
+	std::lock_guard<std::mutex> lock(m_SendMtx);
+	m_BytesSent += dataLen;
+	m_MessagesSent++;
 	while (dataLen > 0)
 	{
 		unsigned int canWrite = MIN(dataLen, m_InternalWritingBuffer.GetSpaceLeave());
@@ -41,6 +85,19 @@ void TcpChannel::Send(const unsigned char* pData, unsigned int dataLen)
 	}
 }
 
+void TcpChannel::SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen)
+{
+	std::lock_guard<std::mutex> lock(m_SendMtx);
+	m_BytesSent += headerLen + payloadLen;
+	m_MessagesSent++;
+	Flush();
+	// the writer would wait for the queue itself, waiting here counts the time.
+	WaitTillWriterIdle();
+
+	ConstBuffer frame[] = { { pHeader, headerLen }, { pPayload, payloadLen } };
+	m_Writer->WriteBytesV(frame, 2);
+}
+
 void TcpChannel::CancelSend()
 {
 	m_Writer->Cancel();
@@ -51,7 +108,7 @@ void TcpChannel::Flush()
 //	ENSURE(IsAsyncBaseRunning())("Flush on a dead channel.");
 	if (m_InternalWritingBuffer.GetDataLength() > 0)
 	{
-		m_Writer->WaitTillSourceIdeal();
+		WaitTillWriterIdle();
 
 		m_Writer->WriteBytes(m_InternalWritingBuffer.GetPtrForReading(), m_InternalWritingBuffer.GetDataLength());
 		m_InternalWritingBuffer.Clear();
@@ -61,18 +118,38 @@ SignalConnection TcpChannel::RegisterDataReceivedEvent(OnDataReceivedAction acti
 {
 	return m_SignalDataReceived.connect(action);
 }
-void TcpChannel::OnDataReceived(const unsigned char* pData, unsigned int len)
+SignalConnection TcpChannel::RegisterBufferReceivedEvent(OnBufferReceivedAction action)
+{
+	return m_SignalBufferReceived.connect(action);
+}
+void TcpChannel::WaitTillWriterIdle()
+{
+	auto start = std::chrono::steady_clock::now();
+	m_Writer->WaitTillSourceIdeal();
+	m_BlockedMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+void TcpChannel::OnDataReceived(std::shared_ptr<unsigned char> pData, unsigned int len)
 {
-	m_SignalDataReceived(pData, len);
+	m_BytesReceived += len;
+	m_MessagesReceived++;
+	m_SignalBufferReceived(pData, len);
+	m_SignalDataReceived(pData.get(), len);
 }
 void TcpChannel::Workloop()
 {
 	while (CanLoopContinue())
 	{
-		int readCount = m_Reader->ReadBytes(m_InternalBuffer.GetPtrForWriting(), m_InternalBuffer.GetBufferSize());
+		if (!m_ReadingBuffer || READING_BUF_SIZE - m_ReadingOffset < READING_BUF_MIN_SPACE)
+		{
+			m_ReadingBuffer = m_ReadingPool->Acquire();
+			m_ReadingOffset = 0;
+		}
+		unsigned char* pReading = m_ReadingBuffer.get() + m_ReadingOffset;
+		int readCount = m_Reader->ReadBytes(pReading, READING_BUF_SIZE - m_ReadingOffset);
 		if (readCount > 0)
 		{
-			OnDataReceived(m_InternalBuffer.GetPtrForReading(), readCount);
+			m_ReadingOffset += readCount;
+			OnDataReceived(std::shared_ptr<unsigned char>(m_ReadingBuffer, pReading), readCount);
 		}
 	}
 }
@@ -81,9 +158,55 @@ void TcpChannel::UnBlockWorkingThread()
 	m_Reader->CancelRead();
 	m_Writer->Cancel();
 }
+void TcpChannel::SampleThroughput(uint64_t bytesReceived, uint64_t bytesSent)
+{
+	std::lock_guard<std::mutex> lock(m_SampleMtx);
+	auto now = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_LastSampleTime).count();
+	if (elapsed < THROUGHPUT_MIN_SAMPLE_US)
+		return;
+	double receiveBitrate = (bytesReceived - m_LastBytesReceived) * 8000000.0 / elapsed;
+	double sendBitrate = (bytesSent - m_LastBytesSent) * 8000000.0 / elapsed;
+	// the first sample stands for the ones before it, the mean would start out at a fraction of it otherwise.
+	if (!m_HasThroughput)
+	{
+		m_ReceiveBitrate.Fill(receiveBitrate);
+		m_SendBitrate.Fill(sendBitrate);
+		m_HasThroughput = true;
+	}
+	else
+	{
+		m_ReceiveBitrate.Push(receiveBitrate);
+		m_SendBitrate.Push(sendBitrate);
+	}
+	m_LastSampleTime = now;
+	m_LastBytesReceived = bytesReceived;
+	m_LastBytesSent = bytesSent;
+}
 bool TcpChannel::GetChannelState(ChannelState& curGetChannelState)
 {
-	return false;
+	curGetChannelState.bytesReceived = m_BytesReceived;
+	curGetChannelState.bytesSent = m_BytesSent;
+	curGetChannelState.messagesReceived = m_MessagesReceived;
+	curGetChannelState.messagesSent = m_MessagesSent;
+	curGetChannelState.blockedMicros = m_BlockedMicros;
+	curGetChannelState.sendQueueBytes = m_Writer->GetQueuedBytes();
+
+	SampleThroughput(curGetChannelState.bytesReceived, curGetChannelState.bytesSent);
+	curGetChannelState.receiveBitrate = (uint32_t)m_ReceiveBitrate.GetMean();
+	curGetChannelState.sendBitrate = (uint32_t)m_SendBitrate.GetMean();
+
+	TcpInfo info;
+	if (m_Socket && m_Socket->GetTcpInfo(info))
+	{
+		// the sender can not have more than a congestion window unacknowledged, so it moves at most one per round trip.
+		if (info.rttMicros > 0)
+			curGetChannelState.availbelbitrate = (uint32_t)MIN(UINT32_MAX, info.congestionWindowBytes * 8000000ULL / info.rttMicros);
+		curGetChannelState.rttMicros = info.rttMicros;
+		curGetChannelState.retransmits = info.retransmits;
+		curGetChannelState.losspacketsrate = info.bytesSent > 0 ? (double)info.bytesRetransmitted / info.bytesSent : 0;
+	}
+	return true;
 }
 void TcpChannel::Start()
 {
@@ -1,9 +1,14 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include "AsyncBase.h"
+#include "BufferPool.h"
 #include "DataBuffer.h"
 #include "noncopyable.h"
 #include "SocketTcp.h"
+#include "Trimmean.h"
 #include "IChannel.h"
 
 namespace Titanium
@@ -26,26 +31,60 @@ namespace Titanium
 		virtual bool IsInError();
 	public:
 		virtual void Send(const unsigned char* pData, unsigned int dataLen);
+		virtual void SendFrame(const unsigned char* pHeader, unsigned int headerLen, const unsigned char* pPayload, unsigned int payloadLen);
 		virtual void CancelSend();
 		virtual void Flush();
 		virtual TIRA::SignalConnection RegisterDataReceivedEvent(OnDataReceivedAction action);
+		virtual TIRA::SignalConnection RegisterBufferReceivedEvent(OnBufferReceivedAction action);
 		virtual std::string GetChannelName();
 		virtual void SetChannelName(const std::string& SetName);
 		virtual bool GetChannelState(ChannelState& curGetChannelState);
 	protected:
-		virtual void OnDataReceived(const unsigned char* pData, unsigned int len);
+		/// For channels over something else than a socket of their own, socket is the connection they are
+		/// carried on for its round trip time and retransmits, it may be null.
+		TcpChannel(std::shared_ptr<TIRA::ReadableSource> reader, std::shared_ptr<TIRA::WritableSource> writer, std::shared_ptr<TIRA::SocketTcp> socket);
+		virtual void OnDataReceived(std::shared_ptr<unsigned char> pData, unsigned int len);
 
 
 	protected:
+		/// Reads on a thread of the channel's own, blocking in ReadBytes even when the socket is on an event loop.
+		/// The received data is handed to the subscribers on the reading thread and the screen source pushes it
+		/// into a pipe which blocks when the decoder falls behind; on the shared loop that would stall every
+		/// socket watched by it, the channel hellos of other sessions included.
 		virtual void Workloop();
 		virtual void UnBlockWorkingThread();
 	private:
-		TIRA::DataBuffer<unsigned char> m_InternalBuffer;
+		/// Waits for the writer to send what is queued, the time counts as blocked.
+		void WaitTillWriterIdle();
+		/// Pushes the throughput since the last sample, unless it is too recent to tell.
+		void SampleThroughput(uint64_t bytesReceived, uint64_t bytesSent);
+
+		// the received data is appended to the current buffer until it runs short of space, buffers still
+		// referenced by parsed messages are left alone and return to the pool when the last message is done.
+		std::shared_ptr<TIRA::BufferPool> m_ReadingPool;
+		std::shared_ptr<unsigned char> m_ReadingBuffer;
+		unsigned int m_ReadingOffset;
 		TIRA::DataBuffer<unsigned char> m_InternalWritingBuffer;
+		std::mutex m_SendMtx;
 
 		std::shared_ptr<TIRA::WritableSource> m_Writer;
 		std::shared_ptr<TIRA::ReadableSource> m_Reader;
 
 		TIRA::Signal<void(const unsigned char*, unsigned int)> m_SignalDataReceived;
+		TIRA::Signal<void(std::shared_ptr<unsigned char>, unsigned int)> m_SignalBufferReceived;
+
+		std::shared_ptr<TIRA::SocketTcp> m_Socket;
+		std::atomic<uint64_t> m_BytesReceived;
+		std::atomic<uint64_t> m_BytesSent;
+		std::atomic<uint64_t> m_MessagesReceived;
+		std::atomic<uint64_t> m_MessagesSent;
+		std::atomic<uint64_t> m_BlockedMicros;
+		std::mutex m_SampleMtx;
+		std::chrono::steady_clock::time_point m_LastSampleTime;
+		uint64_t m_LastBytesReceived;
+		uint64_t m_LastBytesSent;
+		TIRA::Trimmean<double> m_ReceiveBitrate;
+		TIRA::Trimmean<double> m_SendBitrate;
+		bool m_HasThroughput;
 	};
 }
\ No newline at end of file
@@ -1,35 +1,95 @@
 #include "Session.h"
 #include "SocketTcpServer.h"
 #include "SessionManager.h"
+#include "ReplayBenchmark.h"
+#include "LatencyTrace.h"
+#include <cstdio>
+#include <cstring>
 #include <thread>
 #define COMMAND_SERVER_PORT 5262
+// shared by the data connections of all sessions, the redirector is told it in the setup responses.
+#define CHANNEL_SERVER_PORT 5263
+// the trace file is rewritten with the latest events this often.
+#define TRACE_EXPORT_INTERVAL_MS 10000
+// the channel counters are printed this often.
+#define STATS_DUMP_INTERVAL_MS 5000
 
 using namespace std;
 using namespace Titanium;
 using namespace Titanium::TIRA;
 
+// projector [--record <dir>] [--trace <file>] [--stats]
+//   --record  records the screen, audio and device redirection channels of every session
+//   --trace   keeps writing the latency of the latest messages as a Chrome trace
+//   --stats   keeps printing the throughput, queue depth and round trip time of every channel
+// projector --replay <file> [--timed] [--trace <file>]
+//   plays a recording through the pipeline and prints how long each stage took
 int main(int argc, char* argv[])
 {
+	string recordingDirectory;
+	string tracePath;
+	string replayPath;
+	bool timed = false;
+	bool dumpStats = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--timed") == 0)
+			timed = true;
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordingDirectory = argv[++i];
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (strcmp(argv[i], "--stats") == 0)
+			dumpStats = true;
+	}
+	if (!replayPath.empty())
+	{
+		if (!tracePath.empty())
+			LatencyTrace::Enable();
+		int result = RunReplayBenchmark(replayPath, timed);
+		if (!tracePath.empty())
+			LatencyTrace::WriteChromeTrace(tracePath);
+		return result;
+	}
+	if (!tracePath.empty())
+	{
+		LatencyTrace::Enable();
+		thread([tracePath]()
+		{
+			while (true)
+			{
+				this_thread::sleep_for(chrono::milliseconds(TRACE_EXPORT_INTERVAL_MS));
+				LatencyTrace::WriteChromeTrace(tracePath);
+				printf("%s", LatencyTrace::FormatSummary().c_str());
+			}
+		}).detach();
+	}
+
 	SocketFuncs::Startup();
-	SessionManager sessionManager;
+	SessionManager sessionManager(CHANNEL_SERVER_PORT);
+	sessionManager.SetRecordingDirectory(recordingDirectory);
+	if (dumpStats)
+	{
+		// the session manager lives as long as the process, the accept loop below never ends.
+		SessionManager* manager = &sessionManager;
+		thread([manager]()
+		{
+			while (true)
+			{
+				this_thread::sleep_for(chrono::milliseconds(STATS_DUMP_INTERVAL_MS));
+				printf("%s", manager->FormatChannelStats().c_str());
+			}
+		}).detach();
+	}
 
 	auto serverSocket = make_shared<SocketTcpServer>(COMMAND_SERVER_PORT);
 	serverSocket->StartListening();
-	unsigned int tm = 0;
 	while (true)
 	{
 		auto socket = serverSocket->WaitForConnection();
-		auto session = make_shared<Session>(socket);
-		session->ConnectedEvent = [&](Session* s)
-		{
-			sessionManager.SetActive(s);
-		};
-		session->DisconnectedEvent = [&](Session* s)
-		{
-			thread([&]() { sessionManager.Remove(s); }).detach();
-		};
-		session->Start();
-		sessionManager.Add(session);
+		sessionManager.StartSession(socket);
 	}
 	return 0;
 }
\ No newline at end of file
@@ -1,9 +1,9 @@
 #include "AudioSocketReader.h"
 
 
-AudioSocketReader::AudioSocketReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket)
+AudioSocketReader::AudioSocketReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader)
 	:AsyncBase("AudioSocketReader")
-	, m_socket(socket)
+	, m_reader(reader)
 {
 }
 
@@ -19,7 +19,7 @@ void AudioSocketReader::Start()
 
 void AudioSocketReader::Stop()
 {
-	m_socket->CancelRecv();
+	m_reader->CancelRead();
 	StopAsyncBase();
 }
 
@@ -34,14 +34,14 @@ void AudioSocketReader::Workloop()
 		int lentemp = 0;
 		try
 		{
-			lentemp = m_socket->Recv((unsigned char*)&size, sizeof(unsigned int));
+			lentemp = m_reader->ReadBytes((unsigned char*)&size, sizeof(unsigned int));
 		}
 		catch (...) { return; }
 		while (1)
 		{
 			try
 			{
-				lentemp = m_socket->Recv(bufpointer, min(size, size - len));
+				lentemp = m_reader->ReadBytes(bufpointer, min(size, size - len));
 			}
 			catch (...) { return; }
 			len += lentemp;
@@ -58,5 +58,5 @@ void AudioSocketReader::Workloop()
 
 void AudioSocketReader::Cancel()
 {
-	m_socket->CancelRecv();
+	m_reader->CancelRead();
 }
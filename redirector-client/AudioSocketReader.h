@@ -1,18 +1,19 @@
 #pragma once
 #include "SocketTcp.h"
+#include "ReadableSource.h"
 #include "AsyncBase.h"
 
 class AudioSocketReader : public Titanium::TIRA::AsyncBase
 {
 public:
-	AudioSocketReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	AudioSocketReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader);
 	std::function<void(void *data, unsigned int size)> OnDataReceivedEvent;
 	~AudioSocketReader();
 	void Start();
 	void Stop();
 	void Cancel();
 private:
-	std::shared_ptr<Titanium::TIRA::SocketTcp> m_socket;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> m_reader;
 	virtual void Workloop() override;
 };
 
@@ -0,0 +1,202 @@
+#include "GfxRateController.h"
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+// the queueDepth telling the server not to wait for acknowledgements, see MS-RDPEGFX 2.2.2.13.
+static const UINT32 SUSPEND_FRAME_ACKNOWLEDGEMENT_VALUE = 0xFFFFFFFF;
+
+static const milliseconds EVALUATION_WINDOW(1000);
+// share of a window spent writing from which the channel counts as congested, and up to which as relieved.
+static const double CONGESTED_BUSY_SHARE = 0.5;
+static const double RELIEVED_BUSY_SHARE = 0.2;
+// the frames are fitted into this share of the capacity, the rest is left for the other channels and bursts.
+static const double TARGET_CAPACITY_SHARE = 0.8;
+static const int CAPACITY_SAMPLES = 5;
+static const unsigned int MIN_FRAME_RATE = 5;
+// the cap is lifted once it would be raised beyond this.
+static const unsigned int MAX_ADAPTIVE_FRAME_RATE = 30;
+static const unsigned int RAISE_AFTER_WINDOWS = 3;
+// switching the codec resets the graphics, so it takes a while of congestion, and longer to switch back.
+static const unsigned int CODEC_SWITCH_WINDOWS = 5;
+static const unsigned int CODEC_RESTORE_WINDOWS = 60;
+
+GfxRateController::GfxRateController()
+	: AsyncBase("GfxRateController")
+	, _isStopping(false)
+	, _maxFrameRate(0)
+	, _isCodecSwitchAllowed(false)
+	, _prefersH264(false)
+	, _windowBytes(0)
+	, _windowWriteTime(steady_clock::duration::zero())
+	, _windowFrames(0)
+	, _capacity(CAPACITY_SAMPLES)
+	, _hasCapacity(false)
+	, _adaptiveFrameRate(0)
+	, _congestedWindows(0)
+	, _relievedWindows(0)
+{
+}
+GfxRateController::~GfxRateController()
+{
+	MuteAllExceptions([&]() { Stop(); });
+}
+void GfxRateController::Start()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_isStopping = false;
+		_windowStart = steady_clock::now();
+		_lastRelease = _windowStart;
+	}
+	StartAsyncBase();
+}
+void GfxRateController::Stop()
+{
+	StopAsyncBase();
+	// what is held back is of no use to a server which is gone.
+	lock_guard<mutex> lock(_mutex);
+	_pendingAcks.clear();
+}
+void GfxRateController::SetMaxFrameRate(unsigned int framesPerSecond)
+{
+	lock_guard<mutex> lock(_mutex);
+	_maxFrameRate = framesPerSecond;
+}
+void GfxRateController::SetCodecSwitchAllowed(bool allowed)
+{
+	lock_guard<mutex> lock(_mutex);
+	_isCodecSwitchAllowed = allowed;
+}
+unsigned int GfxRateController::GetFrameRateCap()
+{
+	lock_guard<mutex> lock(_mutex);
+	return GetFrameRateCapLocked();
+}
+unsigned int GfxRateController::GetFrameRateCapLocked() const
+{
+	if (_maxFrameRate == 0 || _adaptiveFrameRate == 0)
+		return max(_maxFrameRate, _adaptiveFrameRate);
+	return min(_maxFrameRate, _adaptiveFrameRate);
+}
+void GfxRateController::OnPduRelayed(unsigned int size, steady_clock::duration writeTime)
+{
+	lock_guard<mutex> lock(_mutex);
+	_windowBytes += size;
+	_windowWriteTime += writeTime;
+}
+void GfxRateController::OnFrameAcknowledged(const RDPGFX_FRAME_ACKNOWLEDGE_PDU& ack)
+{
+	lock_guard<mutex> lock(_mutex);
+	_windowFrames++;
+	_pendingAcks.push_back(ack);
+	_wakeup.notify_all();
+}
+void GfxRateController::Workloop()
+{
+	while (CanLoopContinue())
+	{
+		unique_lock<mutex> lock(_mutex);
+		if (_isStopping)
+			break;
+		auto now = steady_clock::now();
+		if (now - _windowStart >= EVALUATION_WINDOW && Evaluate(now))
+		{
+			bool prefersH264 = _prefersH264;
+			lock.unlock();
+			if (CodecPreferenceChangedEvent)
+				CodecPreferenceChangedEvent(prefersH264);
+			continue;
+		}
+
+		unsigned int cap = GetFrameRateCapLocked();
+		auto releaseTime = cap > 0 ? _lastRelease + microseconds(1000000 / cap) : now;
+		if (!_pendingAcks.empty() && now >= releaseTime)
+		{
+			RDPGFX_FRAME_ACKNOWLEDGE_PDU ack = _pendingAcks.front();
+			_pendingAcks.pop_front();
+			// the frames held back here are queued as much as those the projector has not decoded yet.
+			if (ack.queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT_VALUE && cap > 0)
+				ack.queueDepth += (UINT32)_pendingAcks.size();
+			_lastRelease = now;
+			lock.unlock();
+			if (RelayAckEvent)
+				RelayAckEvent(ack);
+			continue;
+		}
+
+		auto wakeTime = _windowStart + EVALUATION_WINDOW;
+		if (!_pendingAcks.empty())
+			wakeTime = min(wakeTime, releaseTime);
+		size_t pending = _pendingAcks.size();
+		_wakeup.wait_until(lock, wakeTime, [&]() { return _isStopping || (pending == 0 && !_pendingAcks.empty()); });
+	}
+}
+void GfxRateController::UnBlockWorkingThread()
+{
+	lock_guard<mutex> lock(_mutex);
+	_isStopping = true;
+	_wakeup.notify_all();
+}
+bool GfxRateController::Evaluate(steady_clock::time_point now)
+{
+	double window = (double)duration_cast<microseconds>(now - _windowStart).count();
+	double busyShare = duration_cast<microseconds>(_windowWriteTime).count() / window;
+	double bytesPerSecond = _windowBytes * 1000000.0 / window;
+
+	if (busyShare >= CONGESTED_BUSY_SHARE)
+	{
+		// the channel was the limit, so what it carried is what it can carry.
+		if (!_hasCapacity)
+			_capacity.Fill(bytesPerSecond);
+		else
+			_capacity.Push(bytesPerSecond);
+		_hasCapacity = true;
+		_congestedWindows++;
+		_relievedWindows = 0;
+		if (_windowFrames > 0)
+		{
+			double frameBytes = (double)_windowBytes / _windowFrames;
+			unsigned int rate = (unsigned int)(_capacity.GetMean() * TARGET_CAPACITY_SHARE / frameBytes);
+			rate = max(rate, MIN_FRAME_RATE);
+			_adaptiveFrameRate = _adaptiveFrameRate == 0 ? min(rate, MAX_ADAPTIVE_FRAME_RATE) : min(rate, _adaptiveFrameRate);
+		}
+	}
+	else if (busyShare <= RELIEVED_BUSY_SHARE)
+	{
+		_relievedWindows++;
+		_congestedWindows = 0;
+		if (_adaptiveFrameRate > 0 && _relievedWindows % RAISE_AFTER_WINDOWS == 0)
+		{
+			_adaptiveFrameRate += max(1u, _adaptiveFrameRate / 4);
+			if (_adaptiveFrameRate > MAX_ADAPTIVE_FRAME_RATE)
+			{
+				_adaptiveFrameRate = 0;
+				_hasCapacity = false;
+			}
+		}
+	}
+	else
+	{
+		_congestedWindows = 0;
+		_relievedWindows = 0;
+	}
+
+	_windowStart = now;
+	_windowBytes = 0;
+	_windowWriteTime = steady_clock::duration::zero();
+	_windowFrames = 0;
+
+	if (_isCodecSwitchAllowed && !_prefersH264 && _congestedWindows >= CODEC_SWITCH_WINDOWS)
+	{
+		_prefersH264 = true;
+		return true;
+	}
+	if (_prefersH264 && _relievedWindows >= CODEC_RESTORE_WINDOWS)
+	{
+		_prefersH264 = false;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include "AsyncBase.h"
+#include "Trimmean.h"
+#include "ScreenDataChannel.h"
+
+//
+// Fits the screen stream to what the channel to the projector carries. While writing the relayed pdus keeps
+// the channel busy most of the time, their data rate is taken as its capacity and the frame rate is capped to
+// what fits into it, by holding back the frame acknowledgements: the server sends no more frames than it may
+// leave unacknowledged. The cap is raised step by step once the channel is idle again. If the channel stays
+// congested the server can be asked for AVC420 instead of the bulkier RemoteFX, progressive and planar tiles.
+//
+class GfxRateController : public Titanium::TIRA::AsyncBase
+{
+public:
+	GfxRateController();
+	~GfxRateController();
+	void Start();
+	void Stop();
+
+	/// Caps the frame rate whatever the channel carries, 0 for no fixed cap.
+	void SetMaxFrameRate(unsigned int framesPerSecond);
+	/// Lets a congested channel switch the server to AVC420, the projector must be able to decode it.
+	void SetCodecSwitchAllowed(bool allowed);
+	/// The frame rate the acknowledgements are paced to, 0 if they are relayed as they come.
+	unsigned int GetFrameRateCap();
+
+	/// A pdu of size bytes was relayed to the projector, writing it took writeTime.
+	void OnPduRelayed(unsigned int size, std::chrono::steady_clock::duration writeTime);
+	/// An acknowledgement of the projector, RelayAckEvent passes it on once the frame rate allows.
+	void OnFrameAcknowledged(const RDPGFX_FRAME_ACKNOWLEDGE_PDU& ack);
+
+	/// Raised on the thread of the controller.
+	std::function<void(const RDPGFX_FRAME_ACKNOWLEDGE_PDU& ack)> RelayAckEvent;
+	/// Raised on the thread of the controller, true asks the server for AVC420 and false for the codecs it picks itself.
+	std::function<void(bool preferH264)> CodecPreferenceChangedEvent;
+protected:
+	virtual void Workloop();
+	virtual void UnBlockWorkingThread();
+private:
+	/// Updates the cap from the window which just ended, returns true if the codec preference changed.
+	bool Evaluate(std::chrono::steady_clock::time_point now);
+	unsigned int GetFrameRateCapLocked() const;
+
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	bool _isStopping;
+	unsigned int _maxFrameRate;
+	bool _isCodecSwitchAllowed;
+	bool _prefersH264;
+
+	std::deque<RDPGFX_FRAME_ACKNOWLEDGE_PDU> _pendingAcks;
+	std::chrono::steady_clock::time_point _lastRelease;
+
+	// the window being measured.
+	std::chrono::steady_clock::time_point _windowStart;
+	unsigned long long _windowBytes;
+	std::chrono::steady_clock::duration _windowWriteTime;
+	unsigned int _windowFrames;
+
+	Titanium::TIRA::Trimmean<double> _capacity;   //!< bytes per second the congested windows carried
+	bool _hasCapacity;
+	unsigned int _adaptiveFrameRate;               //!< 0 while the channel keeps up
+	unsigned int _congestedWindows;
+	unsigned int _relievedWindows;
+};
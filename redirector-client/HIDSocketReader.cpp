@@ -1,9 +1,9 @@
 #include "HIDSocketReader.h"
 
 
-HIDSocketReader::HIDSocketReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket)
+HIDSocketReader::HIDSocketReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader)
 :AsyncBase("HIDSocketReader")
-,m_socket(socket)
+,m_reader(reader)
 {
 }
 
@@ -29,7 +29,7 @@ void HIDSocketReader::Workloop()
 	int len = 0;
 	while (CanLoopContinue())
 	{
-		int lentemp = m_socket->Recv(bufpointer, min(sizeof(HIDDATASTRUCT), sizeof(HIDDATASTRUCT)-len));
+		int lentemp = m_reader->ReadBytes(bufpointer, min(sizeof(HIDDATASTRUCT), sizeof(HIDDATASTRUCT)-len));
 		len += lentemp;
 		bufpointer += lentemp;
 		if (len == sizeof(HIDDATASTRUCT))
@@ -48,5 +48,5 @@ void HIDSocketReader::Workloop()
 
 void HIDSocketReader::Cancel()
 {
-	m_socket->CancelRecv();
+	m_reader->CancelRead();
 }
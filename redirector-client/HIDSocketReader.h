@@ -1,5 +1,6 @@
 #pragma once
 #include "SocketTcp.h"
+#include "ReadableSource.h"
 #include "AsyncBase.h"
 
 
@@ -12,14 +13,14 @@ typedef struct HIDDATA {
 class HIDSocketReader : public Titanium::TIRA::AsyncBase
 {
 public:
-	HIDSocketReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	HIDSocketReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader);
 	std::function<void(const HIDDATASTRUCT* pHidData)> OnDataReceivedEvent;
 	~HIDSocketReader();
 	void Start();
 	void Stop();
 	void Cancel();
 private:
-	std::shared_ptr<Titanium::TIRA::SocketTcp> m_socket;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> m_reader;
 	virtual void Workloop() override;
 };
 
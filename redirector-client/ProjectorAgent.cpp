@@ -13,6 +13,7 @@ ProjectorAgent::ProjectorAgent(const ProjectorSetting &setting)
 , _setupDrChannelRequest("SETUP_DR_CHANNEL")
 , _setupAudioPlaybackChannelRequest("SETUP_AUDIOPLAYBACK_CHANNEL")
 , _setupTouchAndPenChannelRequest("SETUP_TOUCHANDPEN_CHANNEL")
+, _setupMuxChannelRequest("SETUP_MUX_CHANNEL")
 , _resolutionReceived(false)
 , _setupScreenChannelReceived(false)
 , _setupScreenChannelResult(false)
@@ -21,6 +22,8 @@ ProjectorAgent::ProjectorAgent(const ProjectorSetting &setting)
 , _setupDrChannelReceived(false)
 , _setupAudioPlaybackChannelReceived(false)
 , _setupTouchAndPenChannelReceived(false)
+, _setupMuxChannelReceived(false)
+, _setupMuxChannelResult(false)
 {
 	_rtsp.DisconnectedByClientEvent = [this]()
 	{
@@ -40,33 +43,46 @@ ProjectorAgent::ProjectorAgent(const ProjectorSetting &setting)
 		{
 			unique_lock<mutex> lock(_mutex);
 			_setupScreenChannelResult = response.GetResult();
+			_channelEndpoint = response.GetData();
 			_setupScreenChannelReceived = true;
 			_cv.notify_one();
 		}
 		else if (_setupHIDChannelRequest.GetCSeq() == response.GetCSeq())
 		{
 			unique_lock<mutex> lock(_mutex);
+			_channelEndpoint = response.GetData();
 			_setupHIDChannelReceived = true;
 			_cv.notify_one();
 		}
 		else if (_setupDrChannelRequest.GetCSeq() == response.GetCSeq())
 		{
 			unique_lock<mutex> lock(_mutex);
+			_channelEndpoint = response.GetData();
 			_setupDrChannelReceived = true;
 			_cv.notify_one();
 		}
 		else if (_setupAudioPlaybackChannelRequest.GetCSeq() == response.GetCSeq())
 		{
 			unique_lock<mutex> lock(_mutex);
+			_channelEndpoint = response.GetData();
 			_setupAudioPlaybackChannelReceived = true;
 			_cv.notify_one();
 		}
 		else if (_setupTouchAndPenChannelRequest.GetCSeq() == response.GetCSeq())
 		{
 			unique_lock<mutex> lock(_mutex);
+			_channelEndpoint = response.GetData();
 			_setupTouchAndPenChannelReceived = true;
 			_cv.notify_one();
 		}
+		else if (_setupMuxChannelRequest.GetCSeq() == response.GetCSeq())
+		{
+			unique_lock<mutex> lock(_mutex);
+			_setupMuxChannelResult = response.GetResult();
+			_channelEndpoint = response.GetData();
+			_setupMuxChannelReceived = true;
+			_cv.notify_one();
+		}
 	};
 }
 
@@ -105,7 +121,7 @@ std::shared_ptr<SocketTcp> ProjectorAgent::SetupScreenChannel()
 		throw runtime_error("Wait for rtsp response timeout.");
 	if (!_setupScreenChannelResult)
 		throw runtime_error("Projector cannot setup screen channel.");
-	return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+	return ConnectChannel(CHANNEL_HELLO_SCREEN);
 }
 
 
@@ -119,7 +135,7 @@ std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupHIDChannel()
 	if (!_setupHIDChannelReceived)
 		throw runtime_error("Projector cannot setup screen channel.");
 
-	return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+	return ConnectChannel(CHANNEL_HELLO_HID);
 }
 std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupDrChannel()
 {
@@ -130,7 +146,7 @@ std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupDrChannel()
 	if (!_setupDrChannelReceived)
 		throw runtime_error("Projector cannot setup screen channel.");
 
-	return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+	return ConnectChannel(CHANNEL_HELLO_DR);
 }
 std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupAudioPlaybackChannel()
 {
@@ -141,7 +157,7 @@ std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupAudioPlaybackCha
 	if (!_setupAudioPlaybackChannelReceived)
 		throw runtime_error("Projector cannot setup screen channel.");
 
-	return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+	return ConnectChannel(CHANNEL_HELLO_AUDIOPLAYBACK);
 }
 std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupTouchAndPenChannel()
 {
@@ -152,7 +168,46 @@ std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupTouchAndPenChann
 	if (!_setupTouchAndPenChannelReceived)
 		throw runtime_error("Projector cannot setup screen channel.");
 
-	return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+	return ConnectChannel(CHANNEL_HELLO_TOUCHANDPEN);
+}
+std::shared_ptr<Titanium::TIRA::SocketTcp> ProjectorAgent::SetupMuxChannel()
+{
+	unique_lock<mutex> lock(_mutex);
+	_rtsp.Send(_setupMuxChannelRequest);
+	if (!_cv.wait_for(lock, chrono::seconds(51), [this]() {return _setupMuxChannelReceived || _canncelled; })) // todo: move 5 seconds somewhere else
+		throw runtime_error("Wait for rtsp SetupMuxChannel response timeout.");
+	if (!_setupMuxChannelResult)
+		throw runtime_error("Projector cannot setup mux channel.");
+
+	return ConnectChannel(CHANNEL_HELLO_MUX);
+}
+std::shared_ptr<SocketTcp> ProjectorAgent::ConnectChannel(ChannelHelloType channel)
+{
+	unsigned short port;
+	unsigned long long token;
+	if (!ParseChannelEndpoint(_channelEndpoint, port, token))
+		return SocketTcp::ConnectTo(_setting.GetMeidaAddress());
+
+	// the projector shares the port between its sessions, the hello tells it which session and channel this is.
+	InetAddress address = _setting.GetMeidaAddress();
+	address.setPort(port);
+	auto socket = SocketTcp::ConnectTo(address);
+	ChannelHello hello;
+	hello.magic = CHANNEL_HELLO_MAGIC;
+	hello.token = token;
+	hello.channel = channel;
+	// a short write would leave the projector waiting for the rest of the hello until it drops the connection.
+	ConstBuffer helloBuffer[] = { { (const unsigned char*)&hello, sizeof(hello) } };
+	try
+	{
+		socket->SendV(helloBuffer, 1);
+	}
+	catch (std::exception&)
+	{
+		socket->Shutdown();
+		throw runtime_error("Cannot send the channel hello to the projector.");
+	}
+	return socket;
 }
 Resolution ProjectorAgent::ParseResolution(const std::string & str)
 {
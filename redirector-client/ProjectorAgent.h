@@ -4,6 +4,7 @@
 #include "Socket.h"
 #include "Resolution.h"
 #include "ProjectorSetting.h"
+#include "ChannelHello.h"
 #include <functional>
 #include <mutex>
 #include <condition_variable>
@@ -24,8 +25,12 @@ public:
 	std::shared_ptr<Titanium::TIRA::SocketTcp> SetupDrChannel();
 	std::shared_ptr<Titanium::TIRA::SocketTcp> SetupAudioPlaybackChannel();
 	std::shared_ptr<Titanium::TIRA::SocketTcp> SetupTouchAndPenChannel();
+	/// Sets up every channel at once, they are streams of the returned connection.
+	std::shared_ptr<Titanium::TIRA::SocketTcp> SetupMuxChannel();
+	bool IsMultiplexed() const { return _setting.IsMultiplexed(); }
 private:
 	Resolution ParseResolution(const std::string &str);
+	std::shared_ptr<Titanium::TIRA::SocketTcp> ConnectChannel(ChannelHelloType channel);
 	
 	ProjectorSetting _setting;
 	RtspSession _rtsp;
@@ -34,12 +39,15 @@ private:
 	std::condition_variable _cv;
 
 	Resolution _resolution;
+	// "port:token" from the last setup response, where the projector expects the data connections.
+	std::string _channelEndpoint;
 	RequestMsg _resolutionRequest;
 	RequestMsg _setupScreenChannelRequest;
 	RequestMsg _setupHIDChannelRequest;
 	RequestMsg _setupDrChannelRequest;
 	RequestMsg _setupAudioPlaybackChannelRequest;
 	RequestMsg _setupTouchAndPenChannelRequest;
+	RequestMsg _setupMuxChannelRequest;
 	bool _resolutionReceived;
 	bool _setupScreenChannelReceived;
 	bool _setupScreenChannelResult;
@@ -48,5 +56,7 @@ private:
 	bool _setupDrChannelReceived;
 	bool _setupAudioPlaybackChannelReceived;
 	bool _setupTouchAndPenChannelReceived;
+	bool _setupMuxChannelReceived;
+	bool _setupMuxChannelResult;
 };
 
@@ -4,6 +4,7 @@ ProjectorSetting::ProjectorSetting(const std::string & ip, unsigned short negoti
 	: _ip(ip)
 	, _negotiationPort(negotiationPort)
 	, _mediaPort(mediaPort)
+	, _multiplexed(false)
 {
 }
 
@@ -16,3 +17,13 @@ Titanium::TIRA::InetAddress ProjectorSetting::GetMeidaAddress() const
 {
 	return Titanium::TIRA::InetAddress(_ip, _mediaPort);
 }
+
+void ProjectorSetting::SetMultiplexed(bool multiplexed)
+{
+	_multiplexed = multiplexed;
+}
+
+bool ProjectorSetting::IsMultiplexed() const
+{
+	return _multiplexed;
+}
@@ -8,9 +8,13 @@ public:
 
 	Titanium::TIRA::InetAddress GetNegotiationAddress() const;
 	Titanium::TIRA::InetAddress GetMeidaAddress() const;
+	/// Carries all the channels over one connection instead of a connection each.
+	void SetMultiplexed(bool multiplexed);
+	bool IsMultiplexed() const;
 private:
 	std::string _ip;
 	unsigned short _negotiationPort;
 	unsigned short _mediaPort;
+	bool _multiplexed;
 };
 
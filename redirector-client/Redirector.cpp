@@ -5,6 +5,10 @@
 #include "freerdp\client\rdpei.h"
 #include "HIDSocketReader.h"
 #include "TouchAndPenMsgReader.h"
+#include "AutoSocketReader.h"
+#include "AsyncSocketWriter.h"
+#include "LatencyTrace.h"
+#include "RdpStreamingDef.h"
 
 using namespace Titanium;
 using namespace Titanium::TIRA;
@@ -15,6 +19,10 @@ using namespace Titanium::TIRA;
 
 class RdpAgent *gRdpAgent;
 extern "C" _declspec(dllimport) void(*gSendScreenData)(void *data, unsigned int size);
+extern "C" _declspec(dllimport) BOOL gRelayFrameAcks;
+extern "C" _declspec(dllimport) BOOL gGfxRelayOnly;
+extern "C" _declspec(dllimport) UINT tirardpgfx_relay_frame_acknowledge(UINT32 queueDepth, UINT32 frameId, UINT32 totalFramesDecoded);
+extern "C" _declspec(dllimport) UINT tirardpgfx_advertise_caps(BOOL h264);
 extern "C" _declspec(dllimport) void(*gReportState)(int state);
 extern "C" _declspec(dllimport) void(*gRdpDisconnect)();
 extern "C" _declspec(dllimport) void(*gSendHIDData)(void *data, unsigned int size);
@@ -36,6 +44,24 @@ enum HIDType
 };
 
 
+// Frames the channel data for the projector's RdpStreamingParser. When tracing, the header carries when the
+// data came in and the sequence of the message, so the projector can trace the message from there on.
+static void WriteMessage(WritableSource& writer, void* data, unsigned int size, unsigned int& sequence)
+{
+	if (!LatencyTrace::IsEnabled())
+	{
+		ConstBuffer frame[] = { { (const unsigned char*)&size, 4 }, { (const unsigned char*)data, size } };
+		writer.WriteBytesV(frame, 2);
+		return;
+	}
+	RdpStreamingMsgHeader header = { size | RDP_STREAMING_EXTENSION_FLAG };
+	RdpStreamingMsgExtension extension = { LatencyTrace::Now(), ++sequence, 0 };
+	TraceScope trace("redirector.send", extension.m_Sequence);
+	ConstBuffer frame[] = { { (const unsigned char*)&header, sizeof(header) }, { (const unsigned char*)&extension, sizeof(extension) },
+		{ (const unsigned char*)data, size } };
+	writer.WriteBytesV(frame, 3);
+}
+
 void OnRdpDisconnect()
 {
 	if (gRdpAgent)
@@ -48,19 +74,16 @@ void OnScreendataReceive(void* buf, unsigned int len)
 {
 	if (gRdpAgent)
 		gRdpAgent->ScreenDataReceivedEvent(buf, len);
-	OutputDebugStringA((char*)buf);
 }
 void OnDRdataReceive(void* buf, unsigned int len)
 {
 	if (gRdpAgent)
 		gRdpAgent->DRDataReceivedEvent(buf, len);
-	OutputDebugStringA((char*)buf);
 }
 void OnAudiodataReceive(void* buf, unsigned int len)
 {
 	if (gRdpAgent)
 		gRdpAgent->AudioDataReceivedEvent(buf, len);
-	OutputDebugStringA((char*)buf);
 }
 void OnStateChanged(int status)
 {
@@ -88,8 +111,10 @@ bool SendKeyBoardEvent(bool down, UINT32 rdp_scancode)
 	return true;
 }
 Redirector::Redirector()
+	: _screenSequence(0), _drSequence(0), _audioSequence(0)
 {
 	_rdp = std::make_shared<RdpAgent>();
+	_gfxRateController = std::make_shared<GfxRateController>();
 }
 
 Redirector::~Redirector()
@@ -115,13 +140,35 @@ void Redirector::Start(const ProjectorSetting &projectorSetting, RdpSetting rdpS
 	gSendAudioplayData = OnAudiodataReceive;
 	gReportState = OnStateChanged;
 	gRdpDisconnect = OnRdpDisconnect;
+	// nothing is shown here, the projector decodes the screen.
+	gGfxRelayOnly = TRUE;
 	_rdp->StageChangedEvent = [this](RdpAgent::Stage stage)
 	{
 		if (stage == RdpAgent::Stage::CONNECTION_STATE_ACTIVE)
 		{
-			_projectorScreenSocket = _projector->SetupScreenChannel();
-			_projectorHIDSocket = _projector->SetupHIDChannel();
-			_HidDataReader = std::make_shared<HIDSocketReader>(_projectorHIDSocket);
+			if (_projector->IsMultiplexed())
+				SetupMultiplexedChannels();
+			else
+				SetupChannels();
+			// the projector acknowledges the frames it has decoded, hand them to the server instead of acknowledging
+			// here, as fast as the channel to the projector carries the frames.
+			_gfxRateController->RelayAckEvent = [](const RDPGFX_FRAME_ACKNOWLEDGE_PDU& ack)
+			{
+				tirardpgfx_relay_frame_acknowledge(ack.queueDepth, ack.frameId, ack.totalFramesDecoded);
+			};
+			_gfxRateController->CodecPreferenceChangedEvent = [](bool preferH264)
+			{
+				tirardpgfx_advertise_caps(preferH264 ? TRUE : FALSE);
+			};
+			_gfxRateController->Start();
+			_screenAckReader = std::make_shared<ScreenDataChannel>(_screenReader, _screenWriter);
+			_screenAckReader->OnDataReceivedEvent = [this](RDPGFX_FRAME_ACKNOWLEDGE_PDU* pAck)
+			{
+				_gfxRateController->OnFrameAcknowledged(*pAck);
+			};
+			_screenAckReader->Start();
+			gRelayFrameAcks = TRUE;
+			_HidDataReader = std::make_shared<HIDSocketReader>(_hidReader);
 			_HidDataReader->OnDataReceivedEvent = ([&](const HIDDATASTRUCT* pHidData)
 			{
 				if (pHidData->type == HIDType::HID_MOUSE)
@@ -143,17 +190,14 @@ void Redirector::Start(const ProjectorSetting &projectorSetting, RdpSetting rdpS
 				}
 			});
 			_HidDataReader->Start();
-			_drSocket = _projector->SetupDrChannel();
-			_audioplaybackSocket = _projector->SetupAudioPlaybackChannel();
-			_AudioDataReader = std::make_shared<AudioSocketReader>(_audioplaybackSocket);
+			_AudioDataReader = std::make_shared<AudioSocketReader>(_audioReader);
 			_AudioDataReader->OnDataReceivedEvent = ([&](void *data, unsigned int size)
 			{
 				if (ginjectAudioFormatInfo)
 					ginjectAudioFormatInfo(data, size);
 			});
 			_AudioDataReader->Start();
-			_toucAndPenSocket = _projector->SetupTouchAndPenChannel();
-			_touchAndPenReader = std::make_shared<TouchAndPenMsgReader>(_toucAndPenSocket);
+			_touchAndPenReader = std::make_shared<TouchAndPenMsgReader>(_touchReader);
 			_touchAndPenReader->OnTouchFrameReceivedEvent = [&](POINTER_INFO* pointers, int count)
 			{
 				if (gMultitouchContext)
@@ -172,27 +216,23 @@ void Redirector::Start(const ProjectorSetting &projectorSetting, RdpSetting rdpS
 	};
 	_rdp->ScreenDataReceivedEvent = [this](void *data, unsigned int size)
 	{
-		if (_projectorScreenSocket)
+		if (_screenWriter)
 		{
-			_projectorScreenSocket->Send((const unsigned char*)&size, 4);
-			_projectorScreenSocket->Send((const unsigned char*)data, size);
+			// a write which takes long is one the channel could not take right away.
+			auto start = std::chrono::steady_clock::now();
+			WriteMessage(*_screenWriter, data, size, _screenSequence);
+			_gfxRateController->OnPduRelayed(size, std::chrono::steady_clock::now() - start);
 		}
 	};
 	_rdp->DRDataReceivedEvent = [this](void *data, unsigned int size)
 	{
-		if (_drSocket)
-		{
-			_drSocket->Send((const unsigned char*)&size, 4);
-			_drSocket->Send((const unsigned char*)data, size);
-		}
+		if (_drWriter)
+			WriteMessage(*_drWriter, data, size, _drSequence);
 	};
 	_rdp->AudioDataReceivedEvent = [this](void *data, unsigned int size)
 	{
-		if (_audioplaybackSocket)
-		{
-			_audioplaybackSocket->Send((const unsigned char*)&size, 4);
-			_audioplaybackSocket->Send((const unsigned char*)data, size);
-		}
+		if (_audioWriter)
+			WriteMessage(*_audioWriter, data, size, _audioSequence);
 	};
 	_rdp->DisconnectEvent = [&]()
 	{
@@ -214,12 +254,63 @@ void Redirector::Start(const ProjectorSetting &projectorSetting, RdpSetting rdpS
 	};
 }
 
+void Redirector::SetMaxFrameRate(unsigned int framesPerSecond)
+{
+	_gfxRateController->SetMaxFrameRate(framesPerSecond);
+}
+void Redirector::SetCodecSwitchAllowed(bool allowed)
+{
+	_gfxRateController->SetCodecSwitchAllowed(allowed);
+}
+
+void Redirector::SetupChannels()
+{
+	auto screenSocket = _projector->SetupScreenChannel();
+	_screenReader = std::make_shared<ReadableSocket>(screenSocket);
+	_screenWriter = std::make_shared<WritableSocket>(screenSocket);
+	_hidReader = std::make_shared<ReadableSocket>(_projector->SetupHIDChannel());
+	_drWriter = std::make_shared<WritableSocket>(_projector->SetupDrChannel());
+	_audioplaybackSocket = _projector->SetupAudioPlaybackChannel();
+	_audioReader = std::make_shared<ReadableSocket>(_audioplaybackSocket);
+	_audioWriter = std::make_shared<WritableSocket>(_audioplaybackSocket);
+	_touchReader = std::make_shared<ReadableSocket>(_projector->SetupTouchAndPenChannel());
+}
+void Redirector::SetupMultiplexedChannels()
+{
+	// a stream id is the hello type the channel would have on a connection of its own.
+	auto socket = _projector->SetupMuxChannel();
+	socket->SetTcpNoDelay(true);
+	_muxConnection = std::make_shared<MuxConnection>(socket);
+	auto screen = _muxConnection->OpenStream(CHANNEL_HELLO_SCREEN, GetChannelStreamPriority(CHANNEL_HELLO_SCREEN));
+	auto hid = _muxConnection->OpenStream(CHANNEL_HELLO_HID, GetChannelStreamPriority(CHANNEL_HELLO_HID));
+	auto dr = _muxConnection->OpenStream(CHANNEL_HELLO_DR, GetChannelStreamPriority(CHANNEL_HELLO_DR));
+	auto audio = _muxConnection->OpenStream(CHANNEL_HELLO_AUDIOPLAYBACK, GetChannelStreamPriority(CHANNEL_HELLO_AUDIOPLAYBACK));
+	auto touchAndPen = _muxConnection->OpenStream(CHANNEL_HELLO_TOUCHANDPEN, GetChannelStreamPriority(CHANNEL_HELLO_TOUCHANDPEN));
+	_muxConnection->Start();
+
+	_screenReader = screen;
+	_screenWriter = screen;
+	_hidReader = hid;
+	_drWriter = dr;
+	_audioReader = audio;
+	_audioWriter = audio;
+	_touchReader = touchAndPen;
+}
+
 void Redirector::Disconnect()
 {
+	if (_screenAckReader)
+	{
+		gRelayFrameAcks = FALSE;
+		_screenAckReader->Stop();
+	}
+	_gfxRateController->Stop();
 	if (_audioplaybackSocket)
 	{
 		_audioplaybackSocket->CancelRecv();
 		_audioplaybackSocket->Shutdown();
 	}
+	if (_muxConnection)
+		_muxConnection->Stop();
 	_rdp->Disconnect();
 }
@@ -6,9 +6,12 @@
 #include "RdpAgent.h"
 #include "RdpSetting.h"
 #include "Socket.h"
+#include "MuxConnection.h"
 #include "HIDSocketReader.h"
 #include "TouchAndPenMsgReader.h"
 #include "AudioSocketReader.h"
+#include "ScreenDataChannel.h"
+#include "GfxRateController.h"
 class Redirector
 {
 public:
@@ -16,18 +19,36 @@ public:
 	virtual ~Redirector();
 	void Start(const ProjectorSetting &projectorSetting, RdpSetting rdpSetting);
 	void Disconnect();
+	/// Caps the frame rate of the screen by holding back the frame acknowledgements, 0 for no fixed cap.
+	void SetMaxFrameRate(unsigned int framesPerSecond);
+	/// Lets a congested screen channel switch the server to AVC420, the projector must be able to decode it.
+	void SetCodecSwitchAllowed(bool allowed);
 
 	std::function<void(int)> OnStageChanged;
 	std::function<void(bool)> DisconnectedEvent;
 private:
+	void SetupChannels();
+	void SetupMultiplexedChannels();
+
 	std::shared_ptr<ProjectorAgent> _projector;
 	std::shared_ptr<RdpAgent> _rdp;
-	std::shared_ptr<Titanium::TIRA::Socket> _projectorScreenSocket;
-	std::shared_ptr<Titanium::TIRA::SocketTcp> _projectorHIDSocket;
-	std::shared_ptr<Titanium::TIRA::SocketTcp> _drSocket;
 	std::shared_ptr<Titanium::TIRA::SocketTcp> _audioplaybackSocket;
-	std::shared_ptr<Titanium::TIRA::SocketTcp> _toucAndPenSocket;
+	std::shared_ptr<Titanium::TIRA::MuxConnection> _muxConnection;
+	// the channels are sockets of their own or streams of the mux connection.
+	std::shared_ptr<Titanium::TIRA::ReadableSource> _screenReader;
+	std::shared_ptr<Titanium::TIRA::WritableSource> _screenWriter;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> _hidReader;
+	std::shared_ptr<Titanium::TIRA::WritableSource> _drWriter;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> _audioReader;
+	std::shared_ptr<Titanium::TIRA::WritableSource> _audioWriter;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> _touchReader;
+	std::shared_ptr<ScreenDataChannel> _screenAckReader;
+	std::shared_ptr<GfxRateController> _gfxRateController;
 	std::shared_ptr<HIDSocketReader> _HidDataReader;
 	std::shared_ptr<AudioSocketReader> _AudioDataReader;
 	std::shared_ptr<TouchAndPenMsgReader> _touchAndPenReader;
+	// the sequences of the messages sent on each channel, only counted while tracing.
+	unsigned int _screenSequence;
+	unsigned int _drSequence;
+	unsigned int _audioSequence;
 };
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "ScreenDataChannel.h"
 
-ScreenDataChannel::ScreenDataChannel(std::shared_ptr<Titanium::TIRA::SocketTcp> socket)
+ScreenDataChannel::ScreenDataChannel(std::shared_ptr<Titanium::TIRA::ReadableSource> reader, std::shared_ptr<Titanium::TIRA::WritableSource> writer)
 :AsyncBase("ScreenDataChannel")
-, m_socket(socket)
+, m_reader(reader)
+, m_writer(writer)
 {
 }
 
@@ -28,7 +29,7 @@ void ScreenDataChannel::Workloop()
 	int len = 0;
 	while (CanLoopContinue())
 	{
-		int lentemp = m_socket->Recv(bufpointer, min(sizeof(RDPGFX_FRAME_ACKNOWLEDGE_PDU), sizeof(RDPGFX_FRAME_ACKNOWLEDGE_PDU)-len));
+		int lentemp = m_reader->ReadBytes(bufpointer, min(sizeof(RDPGFX_FRAME_ACKNOWLEDGE_PDU), sizeof(RDPGFX_FRAME_ACKNOWLEDGE_PDU)-len));
 		len += lentemp;
 		bufpointer += lentemp;
 		if (len == sizeof(RDPGFX_FRAME_ACKNOWLEDGE_PDU))
@@ -47,11 +48,16 @@ void ScreenDataChannel::Workloop()
 
 void ScreenDataChannel::Cancel()
 {
-	m_socket->CancelRecv();
+	m_reader->CancelRead();
+}
+
+void ScreenDataChannel::UnBlockWorkingThread()
+{
+	Cancel();
 }
 
 void ScreenDataChannel::Send(void *data, unsigned int size)
 {
-	m_socket->Send((const unsigned char*)&size, 4);
-	m_socket->Send((const unsigned char*)data, size);
+	Titanium::TIRA::ConstBuffer frame[] = { { (const unsigned char*)&size, 4 }, { (const unsigned char*)data, size } };
+	m_writer->WriteBytesV(frame, 2);
 }
@@ -1,6 +1,8 @@
 
 #pragma once
 #include "SocketTcp.h"
+#include "ReadableSource.h"
+#include "WritableSource.h"
 #include "AsyncBase.h"
 
 
@@ -15,7 +17,7 @@ typedef struct _RDPGFX_FRAME_ACKNOWLEDGE_PDU RDPGFX_FRAME_ACKNOWLEDGE_PDU;
 class ScreenDataChannel : public Titanium::TIRA::AsyncBase
 {
 public:
-	ScreenDataChannel(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	ScreenDataChannel(std::shared_ptr<Titanium::TIRA::ReadableSource> reader, std::shared_ptr<Titanium::TIRA::WritableSource> writer);
 	std::function<void(RDPGFX_FRAME_ACKNOWLEDGE_PDU* pScreeData)> OnDataReceivedEvent;
 	~ScreenDataChannel();
 	void Start();
@@ -23,7 +25,9 @@ public:
 	void Cancel();
 	void Send(void *data, unsigned int size);
 private:
-	std::shared_ptr<Titanium::TIRA::SocketTcp> m_socket;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> m_reader;
+	std::shared_ptr<Titanium::TIRA::WritableSource> m_writer;
 	virtual void Workloop() override;
+	virtual void UnBlockWorkingThread() override;
 };
 
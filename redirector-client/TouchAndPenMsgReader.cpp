@@ -7,9 +7,9 @@ struct POINTER_DATA
 	int count;
 	POINTER_INFO pointers[10];
 };
-TouchAndPenMsgReader::TouchAndPenMsgReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket)
+TouchAndPenMsgReader::TouchAndPenMsgReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader)
 	:AsyncBase("TouchAndPenMsgReader")
-	, m_socket(socket)
+	, m_reader(reader)
 {
 }
 
@@ -35,7 +35,7 @@ void TouchAndPenMsgReader::Workloop()
 	int len = 0;
 	while (CanLoopContinue())
 	{
-		int lentemp = m_socket->Recv(bufpointer, min(sizeof(POINTER_DATA), sizeof(POINTER_DATA) - len));
+		int lentemp = m_reader->ReadBytes(bufpointer, min(sizeof(POINTER_DATA), sizeof(POINTER_DATA) - len));
 		len += lentemp;
 		bufpointer += lentemp;
 		if (len == sizeof(POINTER_DATA))
@@ -59,5 +59,5 @@ void TouchAndPenMsgReader::Workloop()
 
 void TouchAndPenMsgReader::Cancel()
 {
-	m_socket->CancelRecv();
+	m_reader->CancelRead();
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "SocketTcp.h"
+#include "ReadableSource.h"
 #include "AsyncBase.h"
 #ifdef _WINRT_DLL
 #include "MouseTouchPenMsg.h"
@@ -8,7 +9,7 @@
 class TouchAndPenMsgReader : public Titanium::TIRA::AsyncBase
 {
 public:
-	TouchAndPenMsgReader(std::shared_ptr<Titanium::TIRA::SocketTcp> socket);
+	TouchAndPenMsgReader(std::shared_ptr<Titanium::TIRA::ReadableSource> reader);
 	std::function<void(POINTER_INFO*, int)> OnTouchFrameReceivedEvent;
 	std::function<void(POINTER_PEN_INFO*)> OnPenFrameReceivedEvent;
 	~TouchAndPenMsgReader();
@@ -16,7 +17,7 @@ public:
 	void Stop();
 	void Cancel();
 private:
-	std::shared_ptr<Titanium::TIRA::SocketTcp> m_socket;
+	std::shared_ptr<Titanium::TIRA::ReadableSource> m_reader;
 	virtual void Workloop() override;
 };
 
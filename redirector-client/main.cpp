@@ -3,10 +3,20 @@
 #include "Redirector.h"
 #include "ProjectorSetting.h"
 #include "Socket.h"
+#include "LatencyTrace.h"
+#include <cstdlib>
 #include <exception>
 using namespace std;
 using namespace Titanium::TIRA;
 
+// the trace file is rewritten with the latest events this often.
+static const int TRACE_EXPORT_INTERVAL_MS = 10000;
+static const int IDLE_INTERVAL_MS = 200;
+
+// redirector-client [-mux] [-trace <file>] [-maxfps <n>] [-adaptive-codec]
+// -trace records the latency of the channels and stamps their messages, the projector has to understand the stamps.
+// -maxfps caps the frame rate of the screen, it is capped anyway while the channel to the projector is congested.
+// -adaptive-codec asks the server for AVC420 while the channel is congested, the projector has to decode it.
 int main(int argc, char* argv[])
 {
 	SocketFuncs::Startup();
@@ -14,6 +24,20 @@ int main(int argc, char* argv[])
 
 	RdpSetting rdpSetting = { "", "", "", "" };
 	ProjectorSetting projectorSetting = { "", 5262, 5263 };
+	string tracePath;
+	for (int i = 1; i < argc; i++)
+	{
+		if (string(argv[i]) == "-mux")
+			projectorSetting.SetMultiplexed(true);
+		else if (string(argv[i]) == "-trace" && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (string(argv[i]) == "-maxfps" && i + 1 < argc)
+			pRedirector->SetMaxFrameRate(atoi(argv[++i]));
+		else if (string(argv[i]) == "-adaptive-codec")
+			pRedirector->SetCodecSwitchAllowed(true);
+	}
+	if (!tracePath.empty())
+		LatencyTrace::Enable();
 
 	try
 	{
@@ -23,9 +47,17 @@ int main(int argc, char* argv[])
 	{
 		OutputDebugStringA(e.what());
 	}
+	int sinceExport = 0;
 	while (true)
 	{
-		Sleep(200);
+		Sleep(IDLE_INTERVAL_MS);
+		sinceExport += IDLE_INTERVAL_MS;
+		if (!tracePath.empty() && sinceExport >= TRACE_EXPORT_INTERVAL_MS)
+		{
+			LatencyTrace::WriteChromeTrace(tracePath);
+			OutputDebugStringA(LatencyTrace::FormatSummary().c_str());
+			sinceExport = 0;
+		}
 	}
 	return 0;
 }